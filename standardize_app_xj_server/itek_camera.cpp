@@ -472,6 +472,12 @@ bool ItekCamera::open()
 		res = ItkStreamStart(m_pStream, ITKSTREAM_CONTINUOUS);
 		CHECK(res);
 
+		// raw bayer frames stay single channel, demosaicing is left to app
+		if (dynamic_pointer_cast<ItekCameraConfig>(m_pConfig)->rawBayerEnable() && strncmp(pixelFormat, "Bayer", 5) == 0)
+		{
+			dtype = CV_8UC1;
+		}
+
 		m_pOverlapFrame = make_shared<Mat>(dynamic_pointer_cast<ItekCameraConfig>(m_pConfig)->overlap(),
 										   nWidth, dtype, Scalar(255, 255, 255));
 
@@ -729,11 +735,13 @@ bool ItekCamera::nonBlockRead(Mat &frame)
 				}
 
 				int overlap = dynamic_pointer_cast<ItekCameraConfig>(m_pConfig)->overlap();
+				// raw bayer skips IKapC conversion and is copied like mono, app demosaics only the region it needs
+				bool bRawBayer = dynamic_pointer_cast<ItekCameraConfig>(m_pConfig)->rawBayerEnable() && strncmp(pixelFormat, "Bayer", 5) == 0;
 
 				ITKBUFFER pDesBuffer = nullptr;
 				void *pDst = nullptr;
 
-				if (string(pixelFormat).find("Mono") == string::npos)
+				if (!bRawBayer && string(pixelFormat).find("Mono") == string::npos)
 				{
 					res = ItkBufferNew(nWidth, nHeight, nOutputPixelFormat, &pDesBuffer);
 					CHECK(res);
@@ -751,7 +759,7 @@ bool ItekCamera::nonBlockRead(Mat &frame)
 					CHECK(res);
 					memcpy(m_pOverlapFrame->data, frame.data + (frame.rows - overlap) * nWidth * 3, overlap * nWidth * 3); // copy new overFrame to overFrame
 				}
-				else // Mono
+				else // Mono or raw bayer
 				{
 					pDesBuffer = pSrcBuffer;
 					frame = Mat(nHeight + overlap, nWidth, CV_8UC1);
@@ -26,7 +26,8 @@ ItekCameraConfig::ItekCameraConfig() : CameraConfig(),
 									   m_pCapture(nullptr),
 									   m_iBufferNumbers(1),
 									   m_iOverlap(0),
-									   m_bTransposeEnable(false)
+									   m_bTransposeEnable(false),
+									   m_bRawBayerEnable(false)
 {
 }
 
@@ -54,7 +55,8 @@ ItekCameraConfig::ItekCameraConfig(const string &model, const int width, const i
 																				m_pCapture(nullptr),
 																				m_iBufferNumbers(1),
 																				m_iOverlap(0),
-																				m_bTransposeEnable(false)
+																				m_bTransposeEnable(false),
+																				m_bRawBayerEnable(false)
 {
 }
 
@@ -79,7 +81,8 @@ ItekCameraConfig::ItekCameraConfig(const int readTimeout, const string &model, c
 																												m_pCapture(nullptr),
 																												m_iBufferNumbers(1),
 																												m_iOverlap(0),
-																												m_bTransposeEnable(false)
+																												m_bTransposeEnable(false),
+																												m_bRawBayerEnable(false)
 {
 }
 
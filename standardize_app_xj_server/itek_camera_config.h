@@ -81,6 +81,11 @@ public:
 
 	void setTransposeEnable(const bool transposeEnable) { m_bTransposeEnable = transposeEnable; }
 	bool transposeEnable() const { return m_bTransposeEnable; }
+
+	// if raw bayer is enable, bayer frames are read as single channel raw data without demosaicing,
+	// app demosaics only the region it needs. overlap should be even to keep the bayer phase
+	void setRawBayerEnable(const bool rawBayerEnable) { m_bRawBayerEnable = rawBayerEnable; }
+	bool rawBayerEnable() const { return m_bRawBayerEnable; }
 protected:
 	// GENAPI_NAMESPACE::INodeMap *m_pNodeMap;
 	ITKDEVICE m_pCapture;
@@ -109,6 +114,7 @@ private:
 	int m_iOverlap;
 
 	bool m_bTransposeEnable;
+	bool m_bRawBayerEnable;
 };
 
 #endif // ITEK_CAMERA_CONFIG
\ No newline at end of file
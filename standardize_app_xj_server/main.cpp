@@ -5,11 +5,13 @@
 #include "xj_app_io_manager.h"
 #include "customized_json_config.h"
 #include "xj_app_json_config.h"
+#include "xj_app_run_state.h"
 #include "database.h"
 #include "logger.h"
 
 
 #include <csignal>
+#include <atomic>
 #include <thread>
 #include <iostream>
 
@@ -119,6 +121,7 @@ int main(int argc, char const *argv[])
 	// set params config path
 	const string sParamsJsonPath = CustomizedJsonConfig::instance().get<string>("PARAMS_CONFIG_PATH");
 	AppJsonConfig::instance().setJsonPath(sParamsJsonPath);
+	AppJsonConfig::instance().setCheckInterval(CustomizedJsonConfig::instance().get<int>("PARAMS_CONFIG_CHECK_INTERVAL_MS"));
 
 	// initial camera manager
 	shared_ptr<CameraManager> pCameraManager = make_shared<CameraManager>();
@@ -201,28 +204,28 @@ int main(int argc, char const *argv[])
 
 		// start detector threads
 		vector<thread> detectorThreads;
+		atomic<int> numRunningDetectors(xjServer.totalDetectors());
 		for (int detectorIdx = 0; detectorIdx < xjServer.totalDetectors(); detectorIdx++)
 		{
 			LogINFO << "Detector thread " << detectorIdx << " started...";
-			detectorThreads.emplace_back(&XJAppServer::startDetector, &xjServer, detectorIdx);
+			detectorThreads.emplace_back([&xjServer, &numRunningDetectors, detectorIdx]()
+			{
+				xjServer.startDetector(detectorIdx);
+				numRunningDetectors--;
+				AppRunState::instance().notify("detector exited");
+			});
 		}
 
+		// heartbeat, merge total, database report and retention run in one scheduler thread
 		const bool bIsEnable = CustomizedJsonConfig::instance().get<bool>("IS_ENABLE_HEART_BEAT_SIGNAL_CHECK");
-		if(bIsEnable)
-		{
-			if(cameraType != "mock" || bIsSend)
-			{
-				thread heartBeatThread(&XJAppServer::checkHeartBeat, &xjServer);
-				LogINFO << "Check heartbeat thread started...";
-				heartBeatThread.join();
-			}
-		}
-		const bool bIsUseMergeServer = CustomizedJsonConfig::instance().get<bool>("IS_USE_MERGE_SERVER");
-		if (bIsUseMergeServer)
-		{
-			thread updateMergeTotalThread(&XJAppServer::updateMergeTotal, &xjServer);
-			updateMergeTotalThread.join();
-		}
+		xjServer.startBackgroundTasks(bIsEnable && (cameraType != "mock" || bIsSend));
+		LogINFO << "Background tasks started...";
+
+		// stop the scheduler as soon as shutdown is requested or all detectors exited,
+		// a detector hanging on exit must not keep the heartbeat and reports running
+		AppRunState::instance().waitForShutdown([&numRunningDetectors]() { return numRunningDetectors <= 0; });
+		xjServer.stopBackgroundTasks();
+		LogINFO << "Background tasks stopped...";
 
 		// detector thread join, main thread is waiting for detector thread to finish
 		for (auto &itr : detectorThreads)
@@ -0,0 +1,85 @@
+#include "test_utils.h"
+#include "test_fixtures.h"
+#include <atomic>
+#include <thread>
+
+using namespace cv;
+using namespace std;
+
+#define STRESS_MODEL_PATH "stress_test_model.engine"
+#define STRESS_DETECT_THREADS 4
+#define STRESS_RECONFIG_TIMES 20
+
+//多个线程持续检测, 同时另一个线程反复热更新阈值和重新初始化; 每帧结果必须与某一组参数单独检测的结果一致
+ALGORITHM_TEST(testDetectDuringReconfig)
+{
+	const stInferenceModelParams modelParams = getSingleLensModelParams(STRESS_MODEL_PATH);
+	shared_ptr<ModelExecutor> pExecutor = make_shared<ModelExecutor>(modelParams, make_shared<FixedInferenceBackend>());
+	TEST_CHECK(InferenceService::instance().addExecutor(getExecutorKey(STRESS_MODEL_PATH, modelParams), pExecutor));
+
+	map<int, float> mapAutoUpdateParams;
+	XJAppAlgorithm algorithm(mapAutoUpdateParams);
+	const stConfigParamsA paramsA = getSingleLensBaseParams("stress");
+	const stConfigParamsB paramsNG = getSingleLensParams(STRESS_MODEL_PATH, 0.5f);
+	const stConfigParamsB paramsOK = getSingleLensParams(STRESS_MODEL_PATH, 0.95f);
+	const Mat image = makeSingleLensFrame();
+
+	//step1: 两组参数各自的参考结果
+	Mat processedImage;
+	TEST_CHECK(algorithm.init(paramsA, paramsNG));
+	const vector<vector<int>> vResultNG = algorithm.detectAnalyze(image, processedImage, 0, 1);
+	TEST_CHECK(algorithm.updateParams(paramsA, paramsOK));
+	const vector<vector<int>> vResultOK = algorithm.detectAnalyze(image, processedImage, 0, 1);
+	TEST_CHECK(vResultNG.size() == 1 && !vResultNG[0].empty());
+	TEST_CHECK(vResultOK.size() == 1 && vResultOK[0].empty());
+
+	//step2: 检测与参数替换并发
+	atomic<bool> bIsStop(false);
+	atomic<int> numDetected(0);
+	atomic<int> numMismatched(0);
+	vector<thread> vThreads;
+	for(int i = 0; i < STRESS_DETECT_THREADS; ++i)
+	{
+		vThreads.emplace_back([&, i]()
+		{
+			while(!bIsStop)
+			{
+				Mat result;
+				vector<stDefectInfo> vDefects;
+				const vector<vector<int>> vResult = algorithm.detectAnalyze(image, result, i, 1, vDefects);
+				if((vResult != vResultNG && vResult != vResultOK) || result.empty())
+				{
+					numMismatched++;
+				}
+				numDetected++;
+			}
+		});
+	}
+	bool bIsReconfigOK = true;
+	for(int i = 0; i < STRESS_RECONFIG_TIMES; ++i)
+	{
+		const stConfigParamsB &paramsB = (i % 2 == 0) ? paramsNG : paramsOK;
+		//每5次整体重新初始化一次, 其余为阈值热更新
+		bIsReconfigOK = ((i % 5 == 4) ? algorithm.init(paramsA, paramsB) : algorithm.updateParams(paramsA, paramsB)) && bIsReconfigOK;
+		this_thread::sleep_for(chrono::milliseconds(20));
+	}
+	//最后一组参数之后至少再检测一轮
+	const int numBeforeStop = numDetected;
+	while(numDetected < numBeforeStop + STRESS_DETECT_THREADS)
+	{
+		this_thread::sleep_for(chrono::milliseconds(5));
+	}
+	bIsStop = true;
+	for(auto &itr : vThreads)
+	{
+		itr.join();
+	}
+	cout << "detected " << numDetected << " frames during " << STRESS_RECONFIG_TIMES << " reconfigs" << endl;
+	TEST_CHECK(bIsReconfigOK);
+	TEST_CHECK(numDetected > STRESS_DETECT_THREADS);
+	TEST_CHECK(numMismatched == 0);
+
+	//step3: 替换完成后的检测使用最后一组参数
+	TEST_CHECK(algorithm.detectAnalyze(image, processedImage, 0, 1) == ((STRESS_RECONFIG_TIMES - 1) % 2 == 0 ? vResultNG : vResultOK));
+	return true;
+}
@@ -0,0 +1,124 @@
+#include "test_utils.h"
+#include "test_fixtures.h"
+#include "bayer_view.h"
+
+using namespace cv;
+using namespace std;
+
+//三个通道按不同方向缓变, 双线性插值在内部可以还原, 通道互换时差异明显
+static Mat makeGradientImage(const int width, const int height)
+{
+	Mat image(height, width, CV_8UC3);
+	for(int y = 0; y < height; ++y)
+	{
+		for(int x = 0; x < width; ++x)
+		{
+			image.at<Vec3b>(y, x) = Vec3b(saturate_cast<uchar>(40 + x / 2), saturate_cast<uchar>(60 + (x + y) / 4), saturate_cast<uchar>(200 - y / 2));
+		}
+	}
+	return image;
+}
+
+static double getMaxDiff(const Mat &image1, const Mat &image2)
+{
+	return norm(image1, image2, NORM_INF);
+}
+
+ALGORITHM_TEST(testBayerPixelFormat)
+{
+	TEST_CHECK(getBayerPattern("BayerRG8") == BayerPattern::RG);
+	TEST_CHECK(getBayerPattern("BayerGR8") == BayerPattern::GR);
+	TEST_CHECK(getBayerPattern("BayerGB8") == BayerPattern::GB);
+	TEST_CHECK(getBayerPattern("BayerBG8") == BayerPattern::BG);
+	TEST_CHECK(getBayerPattern("Mono8") == BayerPattern::NONE);
+	TEST_CHECK(getDemosaicCode(BayerPattern::RG) == COLOR_BayerBG2BGR);
+	TEST_CHECK(getDemosaicCode(BayerPattern::GR) == COLOR_BayerGB2BGR);
+	TEST_CHECK(getDemosaicCode(BayerPattern::GB) == COLOR_BayerGR2BGR);
+	TEST_CHECK(getDemosaicCode(BayerPattern::BG) == COLOR_BayerRG2BGR);
+	TEST_CHECK(getDemosaicCode(BayerPattern::NONE) < 0);
+	return true;
+}
+
+//合成mosaic再去马赛克, 内部应还原原图; 奇数坐标的局部去马赛克与整帧去马赛克后裁剪一致
+ALGORITHM_TEST(testBayerRoundTrip)
+{
+	const Mat bgrImage = makeGradientImage(256, 192);
+	const Rect innerRC(4, 4, bgrImage.cols - 8, bgrImage.rows - 8);
+	const Rect roiRC(33, 17, 101, 77);
+	const BayerPattern vPatterns[] = {BayerPattern::RG, BayerPattern::GR, BayerPattern::GB, BayerPattern::BG};
+	for(const auto pattern : vPatterns)
+	{
+		Mat rawImage;
+		mosaicBayer(bgrImage, pattern, rawImage);
+		TEST_CHECK(rawImage.type() == CV_8UC1 && rawImage.size() == bgrImage.size());
+
+		Mat fullImage;
+		TEST_CHECK(demosaicBayerROI(rawImage, Rect(0, 0, rawImage.cols, rawImage.rows), pattern, fullImage));
+		TEST_CHECK(getMaxDiff(fullImage(innerRC), bgrImage(innerRC)) <= 2);
+
+		Mat roiImage;
+		TEST_CHECK(demosaicBayerROI(rawImage, roiRC, pattern, roiImage));
+		TEST_CHECK(roiImage.size() == roiRC.size());
+		TEST_CHECK(getMaxDiff(roiImage, fullImage(roiRC)) == 0);
+
+		//与workflow整帧转彩色使用同一个code
+		Mat cvtImage;
+		cvtColor(rawImage, cvtImage, getDemosaicCode(pattern));
+		TEST_CHECK(getMaxDiff(cvtImage(innerRC), bgrImage(innerRC)) <= 2);
+	}
+
+	//排列不一致时红蓝通道互换
+	Mat rawImage, wrongImage;
+	mosaicBayer(bgrImage, BayerPattern::RG, rawImage);
+	TEST_CHECK(demosaicBayerROI(rawImage, Rect(0, 0, rawImage.cols, rawImage.rows), BayerPattern::BG, wrongImage));
+	TEST_CHECK(getMaxDiff(wrongImage(innerRC), bgrImage(innerRC)) > 50);
+
+	Mat unusedImage;
+	TEST_CHECK(!demosaicBayerROI(rawImage, roiRC, BayerPattern::NONE, unusedImage));
+	TEST_CHECK(!demosaicBayerROI(rawImage, Rect(-20, -20, 10, 10), BayerPattern::RG, unusedImage));
+	return true;
+}
+
+//分箱灰度图每个像素为2x2窗口的均值, 与Bayer相位无关
+ALGORITHM_TEST(testBayerBinnedGray)
+{
+	const Mat bgrImage = makeGradientImage(256, 192);
+	Mat rawRG, rawBG, grayRG, grayBG;
+	mosaicBayer(bgrImage, BayerPattern::RG, rawRG);
+	mosaicBayer(bgrImage, BayerPattern::BG, rawBG);
+	getBayerBinnedGray(rawRG, grayRG);
+	getBayerBinnedGray(rawBG, grayBG);
+	TEST_CHECK(grayRG.size() == Size(bgrImage.cols / 2, bgrImage.rows / 2));
+	TEST_CHECK(getMaxDiff(grayRG, grayBG) <= 2);
+	return true;
+}
+
+#define BAYER_MODEL_PATH "bayer_test_model.engine"
+
+//原始Bayer图在分箱灰度图上定位, 镜片尺寸范围按原图像素比较, 定位框放大回原图坐标
+ALGORITHM_TEST(testBayerLocateLens)
+{
+	const stInferenceModelParams modelParams = getSingleLensModelParams(BAYER_MODEL_PATH);
+	shared_ptr<ModelExecutor> pExecutor = make_shared<ModelExecutor>(modelParams, make_shared<FixedInferenceBackend>());
+	TEST_CHECK(InferenceService::instance().addExecutor(getExecutorKey(BAYER_MODEL_PATH, modelParams), pExecutor));
+
+	//阈值高于测试后端的置信度, 定位成功时判为良品, 定位失败时判为NG
+	stConfigParamsB paramsB = getSingleLensParams(BAYER_MODEL_PATH, 0.95f);
+	paramsB.strParams["RAW_BAYER_PIXEL_FORMAT"] = "BayerRG8";
+	map<int, float> mapAutoUpdateParams;
+	XJAppAlgorithm algorithm(mapAutoUpdateParams);
+	TEST_CHECK(algorithm.init(getSingleLensBaseParams("bayer"), paramsB));
+
+	Mat rawImage;
+	mosaicBayer(makeSingleLensFrame(), BayerPattern::RG, rawImage);
+	const vector<stLensResult> vLenses = algorithm.detectAnalyzeLenses(rawImage, 0, 1, 1);
+	TEST_CHECK(vLenses.size() == 1);
+	TEST_CHECK(vLenses[0].vResult.size() == 1 && vLenses[0].vResult[0].empty());
+
+	//镜片外接框约为(100, 100, 2401, 2401), 定位框再向外扩展
+	const Rect &box = vLenses[0].box;
+	TEST_CHECK(box.contains(Point(1300, 1300)));
+	TEST_CHECK(box.width > 2400 && box.width < 2600 && box.height > 2400 && box.height < 2600);
+	TEST_CHECK(vLenses[0].processedImage.type() == CV_8UC3);
+	return true;
+}
@@ -0,0 +1,98 @@
+#ifndef ALGORITHM_TEST_FIXTURES_H
+#define ALGORITHM_TEST_FIXTURES_H
+
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "xj_app_algorithm.h"
+#include "inference_service.h"
+
+//测试后端: 每张小图中心输出一个0类框, 置信度固定, 结果只由阈值决定
+class FixedInferenceBackend : public InferenceBackend
+{
+public:
+	virtual bool load() { return true; }
+
+	virtual bool detect(const std::vector<cv::Mat> &vBatchImage, std::vector<std::vector<YoloOutputDetect>> &vDetectOutput)
+	{
+		for(const auto &image : vBatchImage)
+		{
+			YoloOutputDetect detect;
+			detect.id = 0;
+			detect.confidence = 0.9f;
+			detect.box = cv::Rect(image.cols / 2 - 50, image.rows / 2 - 50, 100, 100);
+			vDetectOutput.emplace_back(1, detect);
+		}
+		return true;
+	}
+};
+
+//亮背景上的暗镜片, 第一次拍照取反二值化后可定位, 外接框约2400像素
+inline cv::Mat makeSingleLensFrame()
+{
+	cv::Mat image(2600, 2600, CV_8UC3, cv::Scalar(200, 200, 200));
+	cv::circle(image, cv::Point(1300, 1300), 1200, cv::Scalar(30, 30, 30), -1);
+	return image;
+}
+
+//与getSingleLensParams一致的模型参数, 用于以FixedInferenceBackend注册执行器
+inline stInferenceModelParams getSingleLensModelParams(const std::string &sModelPath)
+{
+	stInferenceModelParams modelParams;
+	modelParams.sModelPath = sModelPath;
+	modelParams.maxBatchSize = 8;
+	modelParams.numCategory = 2;
+	modelParams.confThreshold = 0.3f;
+	modelParams.nmsThreshold = 0.5f;
+	modelParams.maxWaitMs = 0;
+	return modelParams;
+}
+
+//单工位、一次拍照、2x2切图; minProb决定小图上的0类框是否判为瑕疵
+inline stConfigParamsB getSingleLensParams(const std::string &sModelPath, const float minProb)
+{
+	stConfigParamsB params;
+	params.fParams["INSPECT_FOREGROUND_RADIUS"] = 2000;
+	params.fParams["RAW_DETECTION_CACHE_SIZE"] = 0;
+	params.fParams["INFERENCE_MAX_WAIT_MS"] = 0;
+	params.strParams["MODEL_PATH_CAM1"] = sModelPath;
+	params.vCameraNames = {"CAM1"};
+	params.vecFParams["NUM_CATEGORY"] = {2};
+	params.vecFParams["ROI_OFFSET_X"] = {0};
+	params.vecFParams["ROI_OFFSET_Y"] = {0};
+	params.vecFParams["ROI_WIDTH"] = {2600};
+	params.vecFParams["ROI_HEIGHT"] = {2600};
+	params.vecFParams["IS_CHECK_WUXING"] = {0};
+	params.vecFParams["WUXING_X"] = {0};
+	params.vecFParams["WUXING_Y"] = {0};
+	params.vecFParams["MAX_BATCH_SIZE"] = {8};
+	params.vecFParams["MNS_THRESHOLD"] = {0.5f};
+	params.vecFParams["CONF_THRESHOLD"] = {0.3f};
+	params.vecFParams["MASK_THR"] = {0};
+	params.vecFParams["BOX_BINARY_THRESHOLD1"] = {100};
+	params.vecFParams["TILE_NUM_X1"] = {2};
+	params.vecFParams["TILE_NUM_Y1"] = {2};
+	for(const std::string sZone : {"C", "NC"})
+	{
+		params.vecFParams["DEFECT_MIN_PROB_CAM_" + sZone + "1"] = {minProb, minProb};
+		params.vecFParams["DEFECT_MIN_AREA_CAM_" + sZone + "1"] = {0, 0};
+		params.vecFParams["DEFECT_MIN_DIAG_CAM_" + sZone + "1"] = {0, 0};
+	}
+	return params;
+}
+
+inline stConfigParamsA getSingleLensBaseParams(const std::string &sProductName)
+{
+	stConfigParamsA params;
+	params.sProductName = sProductName;
+	params.sProductLot = "lot";
+	params.runStatus = 0;
+	params.phase = 0;
+	params.saveImageType = 0;
+	params.viewId = 0;
+	params.boardId = 0;
+	params.numTargetInView = 1;
+	return params;
+}
+
+#endif // ALGORITHM_TEST_FIXTURES_H
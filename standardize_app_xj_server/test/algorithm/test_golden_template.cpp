@@ -0,0 +1,140 @@
+#include "test_utils.h"
+#include "golden_template.h"
+#include "utils.h"
+#include <fstream>
+#include <unistd.h>
+
+using namespace cv;
+using namespace std;
+
+//小尺寸、不缩放不旋转, 建模在几十毫秒内完成
+static stGoldenTemplateParams getTestParams()
+{
+	stGoldenTemplateParams params;
+	params.sampleNum = 3;
+	params.rebuildInterval = 3;
+	params.scale = 1.0f;
+	params.size = 128;
+	params.pyramidLevels = 2;
+	params.bIsUseRotation = false;
+	params.maxDrift = 8.0f;
+	return params;
+}
+
+//暗背景上的亮环和偏心圆点, 配准有明确的特征
+static Mat makeLensImage(const int brightness)
+{
+	Mat image(128, 128, CV_8UC1, Scalar(30));
+	circle(image, Point(64, 64), 50, Scalar(120 + brightness), -1);
+	circle(image, Point(64, 64), 30, Scalar(60 + brightness), 6);
+	circle(image, Point(80, 50), 6, Scalar(200 + brightness), -1);
+	return image;
+}
+
+static string getTestDir()
+{
+	return "/tmp/xj_algorithm_test_" + to_string(getpid());
+}
+
+//等待后台重建出与pOld不同的模板, 超时返回pOld
+static shared_ptr<const GoldenTemplate> waitTemplate(const string &sKey, const string &sFilePath, const shared_ptr<const GoldenTemplate> &pOld, const stGoldenTemplateParams &params,
+		const Mat &sample)
+{
+	for(int i = 0; i < 200; ++i)
+	{
+		shared_ptr<const GoldenTemplate> pTemplate = GoldenTemplateManager::instance().get(sKey, sFilePath, params);
+		if(pTemplate != pOld)
+		{
+			return pTemplate;
+		}
+		if(!sample.empty())
+		{
+			GoldenTemplateManager::instance().addSample(sKey, sFilePath, sample, params);
+		}
+		this_thread::sleep_for(chrono::milliseconds(20));
+	}
+	return pOld;
+}
+
+ALGORITHM_TEST(testCreateDirectories)
+{
+	const string sDir = getTestDir() + "/golden/a/b";
+	TEST_CHECK(createDirectories(sDir));
+	TEST_CHECK(createDirectories(sDir));
+	TEST_CHECK(createDirectories(sDir + "/"));
+
+	//路径中间是文件时失败
+	const string sFile = sDir + "/file";
+	ofstream(sFile) << "x";
+	TEST_CHECK(!createDirectories(sFile + "/c"));
+	return true;
+}
+
+ALGORITHM_TEST(testGoldenTemplateDrift)
+{
+	const stGoldenTemplateParams params = getTestParams();
+	shared_ptr<GoldenTemplate> pAnchor = GoldenTemplate::build({makeLensImage(0)}, params);
+	shared_ptr<GoldenTemplate> pSimilar = GoldenTemplate::build({makeLensImage(3)}, params);
+	shared_ptr<GoldenTemplate> pDrifted = GoldenTemplate::build({makeLensImage(40)}, params);
+	TEST_CHECK(pAnchor && pSimilar && pDrifted);
+	TEST_CHECK(pAnchor->measureDrift(*pAnchor) < 0.5f);
+	TEST_CHECK(pAnchor->measureDrift(*pSimilar) < params.maxDrift);
+	TEST_CHECK(pAnchor->measureDrift(*pDrifted) > params.maxDrift);
+	return true;
+}
+
+//自训练重建: 小幅变化的良品可以更新模板, 与初始模板差异过大的不替换
+ALGORITHM_TEST(testGoldenTemplateRebuildBounded)
+{
+	const stGoldenTemplateParams params = getTestParams();
+	const string sDir = getTestDir() + "/golden";
+	TEST_CHECK(createDirectories(sDir));
+	const string sKey = "test_B0_P" + to_string(getpid());
+	const string sFilePath = sDir + "/" + sKey + ".yml.gz";
+	GoldenTemplateManager::instance().clear(sKey);
+	TEST_CHECK(GoldenTemplateManager::instance().get(sKey, sFilePath, params) == nullptr);
+
+	//step1: 初始模板, 同时保存为初始模板文件
+	for(int i = 0; i < params.sampleNum; ++i)
+	{
+		GoldenTemplateManager::instance().addSample(sKey, sFilePath, makeLensImage(0), params);
+	}
+	shared_ptr<const GoldenTemplate> pInitial = waitTemplate(sKey, sFilePath, nullptr, params, Mat());
+	TEST_CHECK(pInitial != nullptr);
+	TEST_CHECK(ifstream(sFilePath).good());
+	TEST_CHECK(ifstream(GoldenTemplateManager::getAnchorPath(sFilePath)).good());
+	TEST_CHECK(GoldenTemplateManager::getAnchorPath(sFilePath) == sDir + "/" + sKey + "_anchor.yml.gz");
+
+	//step2: 差异过大的良品重建后不替换
+	for(int i = 0; i < params.sampleNum; ++i)
+	{
+		GoldenTemplateManager::instance().addSample(sKey, sFilePath, makeLensImage(40), params);
+	}
+	//step3: 小幅变化的良品重建后替换, 替换后的模板不含step2的样本
+	shared_ptr<const GoldenTemplate> pUpdated = waitTemplate(sKey, sFilePath, pInitial, params, makeLensImage(3));
+	TEST_CHECK(pUpdated != pInitial);
+	TEST_CHECK(pInitial->measureDrift(*pUpdated) < params.maxDrift);
+	TEST_CHECK(norm(pUpdated->reference(), makeLensImage(3), NORM_L1) / pUpdated->reference().total() < 1.0);
+
+	//step4: 清除缓存后从文件加载; 参数变化后按新参数重新加载, 尺寸不符的模板文件不再使用
+	//后台可能还在保存step3之后排队的重建结果, 读到不完整的文件时重试
+	shared_ptr<const GoldenTemplate> pLoaded;
+	for(int i = 0; i < 50 && pLoaded == nullptr; ++i)
+	{
+		GoldenTemplateManager::instance().clear(sKey);
+		pLoaded = GoldenTemplateManager::instance().get(sKey, sFilePath, params);
+		if(pLoaded == nullptr)
+		{
+			this_thread::sleep_for(chrono::milliseconds(20));
+		}
+	}
+	TEST_CHECK(pLoaded != nullptr);
+	TEST_CHECK(pInitial->measureDrift(*pLoaded) < params.maxDrift);
+	TEST_CHECK(GoldenTemplateManager::instance().get(sKey, sFilePath, params) == pLoaded);
+	stGoldenTemplateParams resized = params;
+	resized.size = 96;
+	TEST_CHECK(GoldenTemplateManager::instance().get(sKey, sFilePath, resized) == nullptr);
+
+	GoldenTemplateManager::instance().clear(sKey);
+	return true;
+}
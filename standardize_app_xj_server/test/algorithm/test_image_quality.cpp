@@ -0,0 +1,68 @@
+#include "test_utils.h"
+#include "image_quality.h"
+
+using namespace cv;
+using namespace std;
+
+//暗背景上的亮镜片, 镜片内为同心环纹理, 降采样后仍可分辨
+static Mat makeLensFrame()
+{
+	Mat image(1200, 1200, CV_8UC1, Scalar(10));
+	const Point center(600, 600);
+	for(int r = 450; r > 0; r -= 12)
+	{
+		circle(image, center, r, Scalar(((r / 12) % 2) ? 180 : 120), -1);
+	}
+	return image;
+}
+
+static stImageQualityParams getTestParams()
+{
+	stImageQualityParams params;
+	params.bIsEnable = true;
+	params.sampleSize = 256;
+	params.binaryThreshold = 30;
+	params.binaryType = THRESH_BINARY;
+	params.minLensSize = 600;
+	params.maxLensSize = 1100;
+	return params;
+}
+
+//清晰度在降采样图上评估, 失焦图的拉普拉斯方差明显下降
+ALGORITHM_TEST(testImageQualityFocus)
+{
+	const Mat sharpImage = makeLensFrame();
+	Mat blurredImage;
+	GaussianBlur(sharpImage, blurredImage, Size(0, 0), 6);
+
+	stImageQualityParams params = getTestParams();
+	const stImageQuality sharp = evaluateImageQuality(sharpImage, params);
+	const stImageQuality blurred = evaluateImageQuality(blurredImage, params);
+	TEST_CHECK(sharp.reason == ImageQualityReason::OK);
+	TEST_CHECK(blurred.reason == ImageQualityReason::OK);
+	TEST_CHECK(sharp.focus > 2 * blurred.focus);
+
+	//阈值取两者之间, 只有失焦图判为BLURRED
+	params.minFocus = (sharp.focus + blurred.focus) / 2;
+	TEST_CHECK(evaluateImageQuality(sharpImage, params).reason == ImageQualityReason::OK);
+	TEST_CHECK(evaluateImageQuality(blurredImage, params).reason == ImageQualityReason::BLURRED);
+
+	//彩色输入与灰度输入结果一致
+	Mat colorImage;
+	cvtColor(sharpImage, colorImage, COLOR_GRAY2BGR);
+	TEST_CHECK(std::abs(evaluateImageQuality(colorImage, params).focus - sharp.focus) < 1e-3f * sharp.focus + 1);
+	return true;
+}
+
+ALGORITHM_TEST(testImageQualityLensPresence)
+{
+	const stImageQualityParams params = getTestParams();
+	TEST_CHECK(evaluateImageQuality(Mat(), params).reason == ImageQualityReason::INVALID_IMAGE);
+	TEST_CHECK(evaluateImageQuality(Mat(1200, 1200, CV_8UC1, Scalar(10)), params).reason == ImageQualityReason::NO_LENS);
+
+	//镜片移出画面一半
+	Mat shifted = Mat(1200, 1200, CV_8UC1, Scalar(10));
+	makeLensFrame()(Rect(0, 0, 600, 1200)).copyTo(shifted(Rect(600, 0, 600, 1200)));
+	TEST_CHECK(evaluateImageQuality(shifted, params).reason == ImageQualityReason::PARTIAL_LENS);
+	return true;
+}
@@ -0,0 +1,251 @@
+#include "test_utils.h"
+#include "inference_service.h"
+#include <atomic>
+#include <thread>
+#include <stdexcept>
+
+using namespace cv;
+using namespace std;
+
+//测试后端: 每张图输出一个框, 类别为图像第一个像素值, 用于核对结果顺序; 记录每批大小, 可按批次抛异常
+class FakeInferenceBackend : public InferenceBackend
+{
+public:
+	FakeInferenceBackend(const int delayMs = 0, const int throwAtBatch = -1) : m_delayMs(delayMs), m_throwAtBatch(throwAtBatch) {}
+
+	virtual bool load() { return true; }
+
+	virtual bool detect(const vector<Mat> &vBatchImage, vector<vector<YoloOutputDetect>> &vDetectOutput)
+	{
+		const int batchIdx = m_numBatches++;
+		{
+			lock_guard<mutex> lock(m_mutex);
+			m_vBatchSizes.emplace_back(vBatchImage.size());
+		}
+		if(m_delayMs > 0)
+		{
+			this_thread::sleep_for(chrono::milliseconds(m_delayMs));
+		}
+		if(batchIdx == m_throwAtBatch)
+		{
+			throw runtime_error("fake backend failure");
+		}
+		for(const auto &image : vBatchImage)
+		{
+			YoloOutputDetect detect;
+			detect.id = image.at<uchar>(0, 0);
+			detect.confidence = 1;
+			detect.box = Rect(0, 0, image.cols, image.rows);
+			vDetectOutput.emplace_back(1, detect);
+		}
+		return true;
+	}
+
+	vector<int> getBatchSizes()
+	{
+		lock_guard<mutex> lock(m_mutex);
+		return m_vBatchSizes;
+	}
+
+private:
+	int m_delayMs;
+	int m_throwAtBatch;
+	atomic<int> m_numBatches{0};
+	mutex m_mutex;
+	vector<int> m_vBatchSizes;
+};
+
+static vector<Mat> makeImages(const int first, const int num)
+{
+	vector<Mat> vImages;
+	for(int i = 0; i < num; ++i)
+	{
+		vImages.emplace_back(Mat(8, 8, CV_8UC1, Scalar(first + i)));
+	}
+	return vImages;
+}
+
+static bool isOutputMatched(const vector<vector<YoloOutputDetect>> &vDetectOutput, const int first, const int num)
+{
+	if((int)vDetectOutput.size() != num)
+	{
+		return false;
+	}
+	for(int i = 0; i < num; ++i)
+	{
+		if(vDetectOutput[i].size() != 1 || vDetectOutput[i][0].id != first + i)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+static double elapsedMs(const chrono::steady_clock::time_point &startTime)
+{
+	return chrono::duration<double, milli>(chrono::steady_clock::now() - startTime).count();
+}
+
+//多个工位同时提交, 在等待时间内合成一批, 结果按请求拆回
+ALGORITHM_TEST(testExecutorCrossBoardBatching)
+{
+	stInferenceModelParams params;
+	params.maxBatchSize = 8;
+	params.maxWaitMs = 200;
+	shared_ptr<FakeInferenceBackend> pBackend = make_shared<FakeInferenceBackend>();
+	ModelExecutor executor(params, pBackend);
+
+	const int numBoards = 4;
+	vector<thread> vThreads;
+	vector<int> vIsOK(numBoards, 0);
+	for(int boardId = 0; boardId < numBoards; ++boardId)
+	{
+		vThreads.emplace_back([&executor, &vIsOK, boardId]()
+		{
+			vector<vector<YoloOutputDetect>> vDetectOutput;
+			const bool bIsOK = executor.infer(boardId, makeImages(boardId * 10, 2), vDetectOutput);
+			vIsOK[boardId] = bIsOK && isOutputMatched(vDetectOutput, boardId * 10, 2);
+		});
+	}
+	for(auto &itr : vThreads)
+	{
+		itr.join();
+	}
+	for(int boardId = 0; boardId < numBoards; ++boardId)
+	{
+		TEST_CHECK(vIsOK[boardId]);
+	}
+
+	//凑满一批后立即推理, 不等到maxWaitMs
+	const stInferenceStats stats = executor.getStats();
+	TEST_CHECK(stats.numImages == numBoards * 2);
+	TEST_CHECK(stats.numBatches == 1);
+	TEST_CHECK(stats.numCrossBoardBatches == 1);
+	TEST_CHECK(stats.mapBoardImages.size() == numBoards);
+	TEST_CHECK(stats.queueDepth == 0);
+	return true;
+}
+
+//超过最大batch的请求整体取出, 推理时按最大batch分块, 结果顺序不变
+ALGORITHM_TEST(testExecutorSplitsLargeRequest)
+{
+	stInferenceModelParams params;
+	params.maxBatchSize = 4;
+	params.maxWaitMs = 0;
+	shared_ptr<FakeInferenceBackend> pBackend = make_shared<FakeInferenceBackend>();
+	ModelExecutor executor(params, pBackend);
+
+	vector<vector<YoloOutputDetect>> vDetectOutput;
+	TEST_CHECK(executor.infer(0, makeImages(1, 10), vDetectOutput));
+	TEST_CHECK(isOutputMatched(vDetectOutput, 1, 10));
+	TEST_CHECK(pBackend->getBatchSizes() == vector<int>({4, 4, 2}));
+
+	TEST_CHECK(executor.infer(0, vector<Mat>(), vDetectOutput));
+	TEST_CHECK(vDetectOutput.empty());
+	return true;
+}
+
+//不足一批时最多等待maxWaitMs, 之后按已有请求推理
+ALGORITHM_TEST(testExecutorWaitDeadline)
+{
+	stInferenceModelParams params;
+	params.maxBatchSize = 8;
+	params.maxWaitMs = 50;
+	ModelExecutor executor(params, make_shared<FakeInferenceBackend>());
+
+	vector<vector<YoloOutputDetect>> vDetectOutput;
+	auto startTime = chrono::steady_clock::now();
+	TEST_CHECK(executor.infer(0, makeImages(3, 1), vDetectOutput));
+	const double waitMs = elapsedMs(startTime);
+	TEST_CHECK(isOutputMatched(vDetectOutput, 3, 1));
+	TEST_CHECK(waitMs >= 40);
+	TEST_CHECK(waitMs < 1000);
+
+	//不等待时直接推理
+	stInferenceModelParams noWaitParams = params;
+	noWaitParams.maxWaitMs = 0;
+	ModelExecutor noWaitExecutor(noWaitParams, make_shared<FakeInferenceBackend>());
+	startTime = chrono::steady_clock::now();
+	TEST_CHECK(noWaitExecutor.infer(0, makeImages(3, 1), vDetectOutput));
+	TEST_CHECK(elapsedMs(startTime) < 40);
+	return true;
+}
+
+//后端抛异常时整批返回失败, 执行器线程继续工作
+ALGORITHM_TEST(testExecutorBackendException)
+{
+	stInferenceModelParams params;
+	params.maxBatchSize = 4;
+	params.maxWaitMs = 100;
+	ModelExecutor executor(params, make_shared<FakeInferenceBackend>(0, 0));
+
+	//同一批的两个请求都收到失败
+	vector<int> vIsFailed(2, 0);
+	vector<thread> vThreads;
+	for(int boardId = 0; boardId < 2; ++boardId)
+	{
+		vThreads.emplace_back([&executor, &vIsFailed, boardId]()
+		{
+			vector<vector<YoloOutputDetect>> vDetectOutput;
+			vIsFailed[boardId] = !executor.infer(boardId, makeImages(0, 2), vDetectOutput) && vDetectOutput.empty();
+		});
+	}
+	for(auto &itr : vThreads)
+	{
+		itr.join();
+	}
+	TEST_CHECK(vIsFailed[0] && vIsFailed[1]);
+
+	vector<vector<YoloOutputDetect>> vDetectOutput;
+	TEST_CHECK(executor.infer(0, makeImages(5, 4), vDetectOutput));
+	TEST_CHECK(isOutputMatched(vDetectOutput, 5, 4));
+	return true;
+}
+
+//模型加载失败返回空, 同一模型的并发调用都得到结果, 不会卡住
+ALGORITHM_TEST(testServiceLoadFailure)
+{
+	stInferenceModelParams params;
+	params.backendType = InferenceBackendType::CPU;
+	params.sModelPath = "/nonexistent/algorithm_test_model.onnx";
+	vector<thread> vThreads;
+	atomic<int> numNull(0);
+	for(int i = 0; i < 4; ++i)
+	{
+		vThreads.emplace_back([&params, &numNull]()
+		{
+			if(InferenceService::instance().getExecutor(params.sModelPath, params) == nullptr)
+			{
+				numNull++;
+			}
+		});
+	}
+	for(auto &itr : vThreads)
+	{
+		itr.join();
+	}
+	TEST_CHECK(numNull == 4);
+	return true;
+}
+
+//同一模型文件, 批大小、类别数或阈值不同的工位不共用执行器; 同一key下参数不一致时拒绝
+ALGORITHM_TEST(testServiceExecutorKey)
+{
+	stInferenceModelParams params;
+	params.sModelPath = "algorithm_test_shared_model.engine";
+	params.maxBatchSize = 4;
+	params.numCategory = 3;
+	stInferenceModelParams otherParams = params;
+	otherParams.confThreshold = params.confThreshold + 0.2f;
+	TEST_CHECK(getExecutorKey(params.sModelPath, params) != getExecutorKey(params.sModelPath, otherParams));
+	otherParams = params;
+	otherParams.numCategory = 5;
+	TEST_CHECK(getExecutorKey(params.sModelPath, params) != getExecutorKey(params.sModelPath, otherParams));
+
+	const string sKey = getExecutorKey(params.sModelPath, params);
+	shared_ptr<ModelExecutor> pExecutor = make_shared<ModelExecutor>(params, make_shared<FakeInferenceBackend>());
+	TEST_CHECK(InferenceService::instance().addExecutor(sKey, pExecutor));
+	TEST_CHECK(InferenceService::instance().getExecutor(sKey, params) == pExecutor);
+	TEST_CHECK(InferenceService::instance().getExecutor(sKey, otherParams) == nullptr);
+	return true;
+}
@@ -0,0 +1,106 @@
+#include "test_utils.h"
+#include "inspect_plan.h"
+
+using namespace std;
+
+//阈值表按[区域][类别]展开, 中心区与非中心区互不影响
+ALGORITHM_TEST(testThresholdTableLookup)
+{
+	stThresholdTable thresholds;
+	thresholds.init(3);
+	thresholds.set(InspectZone::CENTER, {0.5f, 0.6f, 0.7f}, {10, 20, 30}, {1, 2, 3});
+	thresholds.set(InspectZone::NON_CENTER, {0.8f, 0.9f}, {100, 200}, {});
+
+	TEST_CHECK(thresholds.vMinProb.size() == 6);
+	TEST_CHECK(thresholds.index(InspectZone::CENTER, 2) == 2);
+	TEST_CHECK(thresholds.index(InspectZone::NON_CENTER, 0) == 3);
+	TEST_CHECK(thresholds.vMinArea[thresholds.index(InspectZone::CENTER, 1)] == 20);
+	TEST_CHECK(thresholds.vMinArea[thresholds.index(InspectZone::NON_CENTER, 1)] == 200);
+	//配置个数少于类别数时缺少的类别为0
+	TEST_CHECK(thresholds.vMinProb[thresholds.index(InspectZone::NON_CENTER, 2)] == 0);
+	TEST_CHECK(thresholds.vMinDiag[thresholds.index(InspectZone::NON_CENTER, 0)] == 0);
+	return true;
+}
+
+//面积须大于阈值, 置信度和对角线不小于阈值
+ALGORITHM_TEST(testThresholdTableBoundary)
+{
+	stThresholdTable thresholds;
+	thresholds.init(2);
+	thresholds.set(InspectZone::CENTER, {0.5f, 0.5f}, {10, 10}, {4, 4});
+	thresholds.set(InspectZone::NON_CENTER, {0.9f, 0.9f}, {50, 50}, {8, 8});
+
+	TEST_CHECK(thresholds.isDefect(InspectZone::CENTER, 0, 0.5f, 11, 4));
+	TEST_CHECK(!thresholds.isDefect(InspectZone::CENTER, 0, 0.5f, 10, 4));
+	TEST_CHECK(!thresholds.isDefect(InspectZone::CENTER, 0, 0.49f, 11, 4));
+	TEST_CHECK(!thresholds.isDefect(InspectZone::CENTER, 0, 0.5f, 11, 3.9f));
+	//同一个框在非中心区达不到阈值
+	TEST_CHECK(!thresholds.isDefect(InspectZone::NON_CENTER, 0, 0.5f, 11, 4));
+	TEST_CHECK(thresholds.isDefect(InspectZone::NON_CENTER, 1, 0.95f, 51, 8));
+
+	TEST_CHECK(thresholds.isConfident(InspectZone::CENTER, 1, 0.5f));
+	TEST_CHECK(!thresholds.isConfident(InspectZone::NON_CENTER, 1, 0.5f));
+
+	//超出配置范围的类别不判为瑕疵
+	TEST_CHECK(!thresholds.isDefect(InspectZone::CENTER, -1, 1, 1000, 1000));
+	TEST_CHECK(!thresholds.isDefect(InspectZone::CENTER, 2, 1, 1000, 1000));
+	TEST_CHECK(!thresholds.isConfident(InspectZone::CENTER, 2, 1));
+	return true;
+}
+
+//方案按拍照次数取阈值表, 超出范围返回空
+ALGORITHM_TEST(testInspectPlanCaptureLookup)
+{
+	stInspectPlan plan;
+	plan.vThresholds.resize(2);
+	plan.vThresholds[0].init(1);
+	plan.vThresholds[1].init(4);
+	plan.vBoxBinaryThreshold = {30, 60};
+	plan.vDarkFieldRadius = {0, 500};
+
+	TEST_CHECK(plan.getThresholds(0) == nullptr);
+	TEST_CHECK(plan.getThresholds(1) == &plan.vThresholds[0]);
+	TEST_CHECK(plan.getThresholds(2)->numCategory == 4);
+	TEST_CHECK(plan.getThresholds(3) == nullptr);
+	TEST_CHECK(plan.getBoxBinaryThreshold(2) == 60);
+	TEST_CHECK(plan.getBoxBinaryThreshold(3) == 5);
+	TEST_CHECK(plan.getDarkFieldRadius(1) == 0);
+	TEST_CHECK(plan.getDarkFieldRadius(2) == 500);
+	TEST_CHECK(plan.getDarkFieldRadius(5) == 0);
+	return true;
+}
+
+//禁用类别按位存放, 超出位数的类别视为开启
+ALGORITHM_TEST(testInspectPlanDisabledCategories)
+{
+	stInspectPlan plan;
+	TEST_CHECK(plan.disabledCategories.none());
+	plan.disabledCategories.set(0);
+	plan.disabledCategories.set(MAX_DEFECT_CATEGORY - 1);
+
+	TEST_CHECK(plan.isDisabled(0));
+	TEST_CHECK(!plan.isDisabled(1));
+	TEST_CHECK(plan.isDisabled(MAX_DEFECT_CATEGORY - 1));
+	TEST_CHECK(!plan.isDisabled(-1));
+	TEST_CHECK(!plan.isDisabled(MAX_DEFECT_CATEGORY));
+	TEST_CHECK(plan.disabledCategories.count() == 2);
+
+	plan.disabledCategories.reset(0);
+	TEST_CHECK(!plan.isDisabled(0));
+	return true;
+}
+
+ALGORITHM_TEST(testInspectPlanClusterAndSave)
+{
+	stInspectPlan plan;
+	plan.vClusterParams.resize(3);
+	plan.vClusterParams[XIANSHANG_CATEGORY].linkDistance = 20;
+	TEST_CHECK(plan.isClustered(XIANSHANG_CATEGORY));
+	TEST_CHECK(!plan.isClustered(0));
+	TEST_CHECK(!plan.isClustered(3));
+
+	plan.bIsSaveTileNG = true;
+	TEST_CHECK(plan.isSaveTile(false));
+	TEST_CHECK(!plan.isSaveTile(true));
+	return true;
+}
@@ -0,0 +1,41 @@
+#include "test_utils.h"
+#include <chrono>
+
+using namespace std;
+
+vector<pair<string, TestCase>> &getTestCases()
+{
+	static vector<pair<string, TestCase>> vTestCases;
+	return vTestCases;
+}
+
+//不带参数时执行所有用例, 带参数时只执行名称包含该参数的用例; 返回失败用例数
+int main(int argc, char const *argv[])
+{
+	const string sFilter = (argc > 1) ? argv[1] : "";
+	int numRun = 0;
+	int numFailed = 0;
+	for(const auto &testCase : getTestCases())
+	{
+		if(!sFilter.empty() && testCase.first.find(sFilter) == string::npos)
+		{
+			continue;
+		}
+		const auto startTime = chrono::steady_clock::now();
+		bool bIsPassed = false;
+		try
+		{
+			bIsPassed = testCase.second();
+		}
+		catch (const exception &e)
+		{
+			cout << "[FAILED] " << testCase.first << " exception: " << e.what() << endl;
+		}
+		const double elapsedMs = chrono::duration<double, milli>(chrono::steady_clock::now() - startTime).count();
+		cout << (bIsPassed ? "[PASSED] " : "[FAILED] ") << testCase.first << " (" << elapsedMs << "ms)" << endl;
+		numRun++;
+		numFailed += bIsPassed ? 0 : 1;
+	}
+	cout << "Algorithm test end, run = " << numRun << ", failed = " << numFailed << endl;
+	return numFailed;
+}
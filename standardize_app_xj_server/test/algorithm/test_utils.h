@@ -0,0 +1,40 @@
+#ifndef ALGORITHM_TEST_UTILS_H
+#define ALGORITHM_TEST_UTILS_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <iostream>
+#include <functional>
+
+//算法单元测试: 每个用例返回是否通过, 由test_main.cpp依次执行
+typedef std::function<bool()> TestCase;
+
+std::vector<std::pair<std::string, TestCase>> &getTestCases();
+
+struct TestRegistrar
+{
+	TestRegistrar(const std::string &sName, const TestCase &testCase)
+	{
+		getTestCases().emplace_back(sName, testCase);
+	}
+};
+
+//定义并注册一个用例
+#define ALGORITHM_TEST(name) \
+	static bool name(); \
+	static TestRegistrar name##Registrar(#name, name); \
+	static bool name()
+
+//条件不满足时打印位置并使当前用例失败
+#define TEST_CHECK(cond) \
+	do \
+	{ \
+		if(!(cond)) \
+		{ \
+			std::cout << "[FAILED] " << __FILE__ << ":" << __LINE__ << ": " << #cond << std::endl; \
+			return false; \
+		} \
+	} while(0)
+
+#endif // ALGORITHM_TEST_UTILS_H
@@ -0,0 +1,125 @@
+#include "test_utils.h"
+#include "xj_app_inspection_pipeline.h"
+#include <mutex>
+#include <future>
+#include <thread>
+
+using namespace std;
+
+//多个线程记录的帧序号
+class OrderRecorder
+{
+public:
+	void add(const int seq)
+	{
+		lock_guard<mutex> lock(m_mutex);
+		m_vSeqs.emplace_back(seq);
+	}
+
+	vector<int> get()
+	{
+		lock_guard<mutex> lock(m_mutex);
+		return m_vSeqs;
+	}
+
+private:
+	mutex m_mutex;
+	vector<int> m_vSeqs;
+};
+
+static vector<int> getSequence(const int num)
+{
+	vector<int> vSeqs;
+	for(int i = 0; i < num; i++)
+	{
+		vSeqs.emplace_back(i);
+	}
+	return vSeqs;
+}
+
+//每组第一帧检测最慢, 后面的帧先完成; 判定和渲染仍按提交顺序执行
+SERVER_TEST(testPipelineInOrderCommit)
+{
+	const int numFrames = 16;
+	const int numWorkers = 4;
+	OrderRecorder inspected;
+	OrderRecorder committed;
+	OrderRecorder rendered;
+	stPipelineStats stats;
+	{
+		stPipelineConfig config;
+		config.numWorkers = numWorkers;
+		config.pRenderWorker = make_shared<AppRenderWorker>(0, 4, StageQueuePolicy::BLOCK);
+		AppInspectionPipeline pipeline(0, config);
+		for(int seq = 0; seq < numFrames; seq++)
+		{
+			const bool bIsAccepted = pipeline.submit([&inspected, seq]()
+			{
+				this_thread::sleep_for(chrono::milliseconds(seq % 4 == 0 ? 30 : 1));
+				inspected.add(seq);
+			},
+			[&committed, seq]()
+			{
+				committed.add(seq);
+			},
+			[&rendered, seq]()
+			{
+				rendered.add(seq);
+			});
+			TEST_CHECK(bIsAccepted);
+		}
+		pipeline.flush();
+		stats = pipeline.getStats();
+	}
+
+	TEST_CHECK(committed.get() == getSequence(numFrames));
+	TEST_CHECK(rendered.get() == getSequence(numFrames));
+	TEST_CHECK((int)inspected.get().size() == numFrames);
+	TEST_CHECK(inspected.get() != getSequence(numFrames));
+	TEST_CHECK(stats.numCommitted == numFrames);
+	TEST_CHECK(stats.numRejected == 0);
+	TEST_CHECK(stats.maxInFlight <= numWorkers * 2);
+	TEST_CHECK(stats.maxReorderWaitMs > 0);
+	return true;
+}
+
+//在途帧满且配置过载拒绝时, 新帧不检测, 但仍按顺序判定
+SERVER_TEST(testPipelineRejectOnOverload)
+{
+	promise<void> release;
+	shared_future<void> released = release.get_future().share();
+	OrderRecorder inspected;
+	OrderRecorder committed;
+	stPipelineStats stats;
+	{
+		stPipelineConfig config;
+		config.numWorkers = 1;
+		config.bIsRejectOnOverload = true;
+		AppInspectionPipeline pipeline(0, config);
+		//先放行被阻塞的检测再检查结果, 否则析构时等待在途帧不会返回
+		vector<bool> vIsAccepted;
+		for(int seq = 0; seq < 3; seq++)
+		{
+			vIsAccepted.emplace_back(pipeline.submit([&inspected, released, seq]()
+			{
+				released.wait();
+				inspected.add(seq);
+			},
+			[&committed, seq]()
+			{
+				committed.add(seq);
+			},
+			function<void()>()));
+		}
+		release.set_value();
+		pipeline.flush();
+		stats = pipeline.getStats();
+		TEST_CHECK(vIsAccepted == vector<bool>({true, true, false}));
+	}
+
+	TEST_CHECK(inspected.get() == vector<int>({0, 1}));
+	TEST_CHECK(committed.get() == getSequence(3));
+	TEST_CHECK(stats.numCommitted == 3);
+	TEST_CHECK(stats.numRejected == 1);
+	return true;
+}
@@ -0,0 +1,79 @@
+#include "test_utils.h"
+#include "xj_app_json_config.h"
+#include <fstream>
+#include <cstdio>
+#include <unistd.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+static string getJsonPath()
+{
+	return "/tmp/xj_server_test_" + to_string(getpid()) + "_params.json";
+}
+
+static bool writeText(const string &sPath, const string &sContent)
+{
+	ofstream ofs(sPath, ios_base::out | ios_base::trunc);
+	ofs << sContent;
+	return (bool)ofs;
+}
+
+//重新指定路径, 下次读取时从文件重新解析
+static float readFromFile(const string &sPath, const string &sNodeName)
+{
+	AppJsonConfig::instance().setJsonPath(sPath);
+	return AppJsonConfig::instance().get<float>(sNodeName);
+}
+
+//一组修改一次写盘, 同一节点以最后一次为准; 写盘失败时文件和内存中的树都保持修改前的内容
+SERVER_TEST(testJsonConfigTransactionRollback)
+{
+	const string sPath = getJsonPath();
+	const string sTmpPath = sPath + ".tmp";
+	TEST_CHECK(writeText(sPath, "{\"cameraParams-0\": {\"exposure\": 100, \"gain\": 1}}"));
+	AppJsonConfig &config = AppJsonConfig::instance();
+	config.setCheckInterval(0);
+	config.setJsonPath(sPath);
+	TEST_CHECK(config.get<float>("cameraParams-0.exposure") == 100);
+
+	AppJsonConfig::Transaction transaction;
+	transaction.set<float>("cameraParams-0.exposure", 500);
+	transaction.set<float>("cameraParams-0.gain", 2.5f);
+	transaction.set<float>("cameraParams-0.exposure", 600);
+	config.commit(transaction);
+	TEST_CHECK(config.get<float>("cameraParams-0.exposure") == 600);
+	TEST_CHECK(config.get<float>("cameraParams-0.gain") == 2.5f);
+	TEST_CHECK(readFromFile(sPath, "cameraParams-0.exposure") == 600);
+	TEST_CHECK(readFromFile(sPath, "cameraParams-0.gain") == 2.5f);
+
+	//临时文件位置被目录占用, 写临时文件失败
+	TEST_CHECK(mkdir(sTmpPath.c_str(), 0755) == 0);
+	AppJsonConfig::Transaction failed;
+	failed.set<float>("cameraParams-0.exposure", 700);
+	failed.set<float>("cameraParams-0.gain", 3);
+	bool bIsThrown = false;
+	try
+	{
+		config.commit(failed);
+	}
+	catch (const exception &e)
+	{
+		bIsThrown = true;
+	}
+	rmdir(sTmpPath.c_str());
+	TEST_CHECK(bIsThrown);
+	TEST_CHECK(config.get<float>("cameraParams-0.exposure") == 600);
+	TEST_CHECK(config.get<float>("cameraParams-0.gain") == 2.5f);
+	TEST_CHECK(readFromFile(sPath, "cameraParams-0.exposure") == 600);
+	TEST_CHECK(readFromFile(sPath, "cameraParams-0.gain") == 2.5f);
+
+	//空事务不写盘; 故障排除后可以继续提交
+	config.commit(AppJsonConfig::Transaction());
+	config.set<float>("cameraParams-0.exposure", 800);
+	TEST_CHECK(readFromFile(sPath, "cameraParams-0.exposure") == 800);
+	TEST_CHECK(readFromFile(sPath, "cameraParams-0.gain") == 2.5f);
+
+	remove(sPath.c_str());
+	return true;
+}
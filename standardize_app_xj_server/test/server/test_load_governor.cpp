@@ -0,0 +1,144 @@
+#include "test_utils.h"
+#include "xj_app_load_governor.h"
+#include <thread>
+
+using namespace std;
+
+//各用例使用不同工位, 互不影响
+#define GOVERNOR_QUEUE_BOARD 100
+#define GOVERNOR_SLACK_BOARD 101
+#define GOVERNOR_DISABLED_BOARD 102
+
+//只按存图队列占用降级, 连续3帧满足条件后恢复一级
+static stLoadGovernorConfig getQueueConfig()
+{
+	stLoadGovernorConfig config;
+	config.bIsEnable = true;
+	config.maxLevel = (int)LoadLevel::NUM - 1;
+	config.vQueueThresholds = {0.5, 0.7, 0.8, 0.9};
+	config.hysteresis = 0.05;
+	config.recoverFrames = 3;
+	config.okSaveInterval = 4;
+	config.renderScale = 0.5;
+	return config;
+}
+
+//连续调用n帧, 返回最后一帧后的级别
+static LoadLevel updateFrames(const int boardId, const double queueFill, const int n)
+{
+	LoadLevel level = LoadLevel::NORMAL;
+	for(int i = 0; i < n; i++)
+	{
+		level = AppLoadGovernor::instance().update(boardId, queueFill);
+	}
+	return level;
+}
+
+//降级每帧一级直到目标级别; 恢复需连续recoverFrames帧越过阈值加滞回, 每次一级
+SERVER_TEST(testLoadGovernorLevelTransitions)
+{
+	AppLoadGovernor &governor = AppLoadGovernor::instance();
+	governor.reset(GOVERNOR_QUEUE_BOARD, 1, getQueueConfig());
+	TEST_CHECK(governor.update(GOVERNOR_QUEUE_BOARD, 0) == LoadLevel::NORMAL);
+
+	TEST_CHECK(governor.update(GOVERNOR_QUEUE_BOARD, 0.95) == LoadLevel::REDUCE_OK_SAVES);
+	TEST_CHECK(governor.update(GOVERNOR_QUEUE_BOARD, 0.95) == LoadLevel::LOW_RES_RENDER);
+	TEST_CHECK(governor.update(GOVERNOR_QUEUE_BOARD, 0.95) == LoadLevel::NO_PROCESS_IMAGES);
+	TEST_CHECK(governor.update(GOVERNOR_QUEUE_BOARD, 0.95) == LoadLevel::DEFER_DB_WRITES);
+	TEST_CHECK(governor.update(GOVERNOR_QUEUE_BOARD, 0.95) == LoadLevel::DEFER_DB_WRITES);
+	TEST_CHECK(governor.isDegraded(GOVERNOR_QUEUE_BOARD, LoadLevel::NO_PROCESS_IMAGES));
+
+	//目标级别为LOW_RES_RENDER, 每满3帧恢复一级, 到达目标后保持
+	TEST_CHECK(updateFrames(GOVERNOR_QUEUE_BOARD, 0.72, 2) == LoadLevel::DEFER_DB_WRITES);
+	TEST_CHECK(updateFrames(GOVERNOR_QUEUE_BOARD, 0.72, 1) == LoadLevel::NO_PROCESS_IMAGES);
+	TEST_CHECK(updateFrames(GOVERNOR_QUEUE_BOARD, 0.72, 3) == LoadLevel::LOW_RES_RENDER);
+	TEST_CHECK(updateFrames(GOVERNOR_QUEUE_BOARD, 0.72, 10) == LoadLevel::LOW_RES_RENDER);
+
+	//低于阈值但未越过滞回时不恢复
+	TEST_CHECK(updateFrames(GOVERNOR_QUEUE_BOARD, 0.68, 10) == LoadLevel::LOW_RES_RENDER);
+	//恢复计数被超过阈值的帧打断后重新计数
+	TEST_CHECK(updateFrames(GOVERNOR_QUEUE_BOARD, 0.6, 2) == LoadLevel::LOW_RES_RENDER);
+	TEST_CHECK(updateFrames(GOVERNOR_QUEUE_BOARD, 0.68, 1) == LoadLevel::LOW_RES_RENDER);
+	TEST_CHECK(updateFrames(GOVERNOR_QUEUE_BOARD, 0.6, 2) == LoadLevel::LOW_RES_RENDER);
+	TEST_CHECK(updateFrames(GOVERNOR_QUEUE_BOARD, 0.6, 1) == LoadLevel::REDUCE_OK_SAVES);
+	TEST_CHECK(updateFrames(GOVERNOR_QUEUE_BOARD, 0, 3) == LoadLevel::NORMAL);
+
+	bool bIsFound = false;
+	for(const auto &report : governor.getReports())
+	{
+		if(report.boardId == GOVERNOR_QUEUE_BOARD)
+		{
+			bIsFound = true;
+			TEST_CHECK(report.numTransitions == 8);
+			TEST_CHECK(report.level == 0);
+			TEST_CHECK(report.sLevelName == "normal");
+		}
+	}
+	TEST_CHECK(bIsFound);
+
+	//重新开始检测时回到正常级别
+	TEST_CHECK(governor.update(GOVERNOR_QUEUE_BOARD, 0.95) == LoadLevel::REDUCE_OK_SAVES);
+	governor.reset(GOVERNOR_QUEUE_BOARD, 1, getQueueConfig());
+	TEST_CHECK(governor.level(GOVERNOR_QUEUE_BOARD) == LoadLevel::NORMAL);
+	return true;
+}
+
+//各级别下的可选工作: OK图按间隔保存, 结果图按比例绘制
+SERVER_TEST(testLoadGovernorDegradedWork)
+{
+	AppLoadGovernor &governor = AppLoadGovernor::instance();
+	governor.reset(GOVERNOR_QUEUE_BOARD, 1, getQueueConfig());
+	TEST_CHECK(governor.shouldSaveOK(GOVERNOR_QUEUE_BOARD));
+	TEST_CHECK(governor.shouldSaveOK(GOVERNOR_QUEUE_BOARD));
+	TEST_CHECK(governor.getRenderScale(GOVERNOR_QUEUE_BOARD) == 1.0);
+
+	TEST_CHECK(governor.update(GOVERNOR_QUEUE_BOARD, 0.95) == LoadLevel::REDUCE_OK_SAVES);
+	vector<bool> vIsSaved;
+	for(int i = 0; i < 8; i++)
+	{
+		vIsSaved.emplace_back(governor.shouldSaveOK(GOVERNOR_QUEUE_BOARD));
+	}
+	TEST_CHECK(vIsSaved == vector<bool>({true, false, false, false, true, false, false, false}));
+	TEST_CHECK(governor.getRenderScale(GOVERNOR_QUEUE_BOARD) == 1.0);
+
+	TEST_CHECK(governor.update(GOVERNOR_QUEUE_BOARD, 0.95) == LoadLevel::LOW_RES_RENDER);
+	TEST_CHECK(governor.getRenderScale(GOVERNOR_QUEUE_BOARD) == 0.5);
+	return true;
+}
+
+//检测耗时超过取像周期时按时间余量降级
+SERVER_TEST(testLoadGovernorSlack)
+{
+	stLoadGovernorConfig config = getQueueConfig();
+	config.vSlackThresholds = {0.3, 0.2, 0.1, 0.05};
+	config.ewmaAlpha = 1;
+	AppLoadGovernor &governor = AppLoadGovernor::instance();
+	governor.reset(GOVERNOR_SLACK_BOARD, 2, config);
+	governor.addInspection(GOVERNOR_SLACK_BOARD, 1000);
+	//第一帧没有取像周期, 不计算余量
+	TEST_CHECK(governor.update(GOVERNOR_SLACK_BOARD, 0) == LoadLevel::NORMAL);
+	this_thread::sleep_for(chrono::milliseconds(5));
+	TEST_CHECK(governor.update(GOVERNOR_SLACK_BOARD, 0) == LoadLevel::REDUCE_OK_SAVES);
+
+	for(const auto &report : governor.getReports())
+	{
+		if(report.boardId == GOVERNOR_SLACK_BOARD)
+		{
+			TEST_CHECK(report.cycleMs >= 5);
+			TEST_CHECK(report.slack < 0);
+		}
+	}
+	return true;
+}
+
+//未启用时不降级
+SERVER_TEST(testLoadGovernorDisabled)
+{
+	stLoadGovernorConfig config = getQueueConfig();
+	config.bIsEnable = false;
+	AppLoadGovernor &governor = AppLoadGovernor::instance();
+	governor.reset(GOVERNOR_DISABLED_BOARD, 1, config);
+	TEST_CHECK(updateFrames(GOVERNOR_DISABLED_BOARD, 1.0, 10) == LoadLevel::NORMAL);
+	TEST_CHECK(governor.shouldSaveOK(GOVERNOR_DISABLED_BOARD));
+	return true;
+}
@@ -0,0 +1,172 @@
+#include "test_utils.h"
+#include "xj_app_product_cache.h"
+#include <atomic>
+#include <future>
+#include <thread>
+
+using namespace std;
+
+//测试读取方式: 不读数据库, 第几次读取记录在第一个PLC寄存器的值中, 可阻塞到放行
+class FakeProductLoader
+{
+public:
+	FakeProductLoader() : m_numLoads(0), m_bIsFail(false), m_released(m_release.get_future().share())
+	{
+		m_release.set_value();
+	}
+
+	//之后的读取阻塞到release()
+	void block()
+	{
+		m_release = promise<void>();
+		m_released = m_release.get_future().share();
+	}
+	void release() { m_release.set_value(); }
+	void setFail(const bool bIsFail) { m_bIsFail = bIsFail; }
+	int numLoads() const { return m_numLoads.load(); }
+
+	AppProductCache::Loader getLoader()
+	{
+		return [this](const string &sProd) -> shared_ptr<const stProductSettings>
+		{
+			const int loadIdx = ++m_numLoads;
+			m_released.wait();
+			if(m_bIsFail)
+			{
+				return nullptr;
+			}
+			shared_ptr<stProductSettings> pSettings = make_shared<stProductSettings>();
+			pSettings->sProductName = sProd;
+			stPlcRegister reg;
+			reg.value = loadIdx;
+			pSettings->vPlcRegisters.emplace_back(reg);
+			return pSettings;
+		};
+	}
+
+private:
+	atomic<int> m_numLoads;
+	atomic<bool> m_bIsFail;
+	promise<void> m_release;
+	shared_future<void> m_released;
+};
+
+//等待条件成立, 超时返回false
+static bool waitUntil(const function<bool()> &condition, const int timeoutMs)
+{
+	const auto deadline = chrono::steady_clock::now() + chrono::milliseconds(timeoutMs);
+	while(!condition())
+	{
+		if(chrono::steady_clock::now() >= deadline)
+		{
+			return false;
+		}
+		this_thread::sleep_for(chrono::milliseconds(1));
+	}
+	return true;
+}
+
+static int getLoadIdx(const shared_ptr<const stProductSettings> &pSettings)
+{
+	return (pSettings == nullptr || pSettings->vPlcRegisters.empty()) ? -1 : pSettings->vPlcRegisters[0].value;
+}
+
+//同一产品的并发读取只加载一次, 之后直接返回缓存
+SERVER_TEST(testProductCacheSharedLoad)
+{
+	FakeProductLoader loader;
+	AppProductCache::instance().setLoader(loader.getLoader());
+	loader.block();
+	vector<shared_ptr<const stProductSettings>> vSettings(4);
+	vector<thread> vThreads;
+	for(size_t i = 0; i < vSettings.size(); i++)
+	{
+		vThreads.emplace_back([&vSettings, i]()
+		{
+			vSettings[i] = AppProductCache::instance().get("shared");
+		});
+	}
+	waitUntil([&loader]() { return loader.numLoads() > 0; }, 2000);
+	this_thread::sleep_for(chrono::milliseconds(20));
+	loader.release();
+	for(auto &itr : vThreads)
+	{
+		itr.join();
+	}
+	AppProductCache::instance().setLoader(nullptr);
+
+	TEST_CHECK(loader.numLoads() == 1);
+	for(const auto &pSettings : vSettings)
+	{
+		TEST_CHECK(pSettings != nullptr && pSettings == vSettings[0]);
+	}
+	TEST_CHECK(vSettings[0]->sProductName == "shared");
+	return true;
+}
+
+//加载期间被invalidate时, 本次结果返回给调用方但不进入缓存, 下次读取重新加载
+SERVER_TEST(testProductCacheInvalidateDuringLoad)
+{
+	FakeProductLoader loader;
+	AppProductCache &cache = AppProductCache::instance();
+	cache.setLoader(loader.getLoader());
+	loader.block();
+	shared_ptr<const stProductSettings> pStale;
+	thread reader([&pStale]()
+	{
+		pStale = AppProductCache::instance().get("race");
+	});
+	const bool bIsLoading = waitUntil([&loader]() { return loader.numLoads() == 1; }, 2000);
+	cache.invalidate("race");
+	loader.release();
+	reader.join();
+	TEST_CHECK(bIsLoading);
+	TEST_CHECK(getLoadIdx(pStale) == 1);
+
+	shared_ptr<const stProductSettings> pFresh = cache.get("race");
+	TEST_CHECK(getLoadIdx(pFresh) == 2);
+	TEST_CHECK(cache.get("race") == pFresh);
+	TEST_CHECK(loader.numLoads() == 2);
+
+	//已缓存的产品invalidate后重新加载, invalidateAll同样
+	cache.invalidate("race");
+	TEST_CHECK(getLoadIdx(cache.get("race")) == 3);
+	cache.invalidateAll();
+	TEST_CHECK(getLoadIdx(cache.get("race")) == 4);
+	TEST_CHECK(cache.get("race") == cache.get("race"));
+	TEST_CHECK(loader.numLoads() == 4);
+	cache.setLoader(nullptr);
+	return true;
+}
+
+//读取失败时不缓存, 下次读取重试
+SERVER_TEST(testProductCacheLoadFailure)
+{
+	FakeProductLoader loader;
+	AppProductCache &cache = AppProductCache::instance();
+	cache.setLoader(loader.getLoader());
+	loader.setFail(true);
+	TEST_CHECK(cache.get("failed") == nullptr);
+	loader.setFail(false);
+	const shared_ptr<const stProductSettings> pSettings = cache.get("failed");
+	cache.setLoader(nullptr);
+	TEST_CHECK(getLoadIdx(pSettings) == 2);
+	return true;
+}
+
+//预取在后台线程中加载, 之后的读取直接返回缓存
+SERVER_TEST(testProductCachePrefetch)
+{
+	FakeProductLoader loader;
+	AppProductCache &cache = AppProductCache::instance();
+	cache.setLoader(loader.getLoader());
+	cache.prefetch("prefetched");
+	const bool bIsLoaded = waitUntil([&loader]() { return loader.numLoads() == 1; }, 2000);
+	//加载中的读取等待预取结果, 不重复加载
+	const shared_ptr<const stProductSettings> pSettings = cache.get("prefetched");
+	cache.setLoader(nullptr);
+	TEST_CHECK(bIsLoaded);
+	TEST_CHECK(getLoadIdx(pSettings) == 1);
+	TEST_CHECK(loader.numLoads() == 1);
+	return true;
+}
@@ -0,0 +1,119 @@
+#include "test_utils.h"
+#include "xj_app_product_fusion.h"
+
+using namespace cv;
+using namespace std;
+
+//两次拍照, 交并比0.1或中心距离50像素以内为同一处, 最多缓存2个未完成产品
+#define FUSION_CAPTURE_TIMES 2
+#define FUSION_IOU_THRESHOLD 0.1f
+#define FUSION_DISTANCE 50
+#define FUSION_MAX_PENDING_PRODUCTS 2
+
+static stDefectInfo makeDefect(const int type, const Rect &box, const float confidence, const int nCaptureTimes)
+{
+	stDefectInfo defect;
+	defect.type = type;
+	defect.box = box;
+	defect.confidence = confidence;
+	defect.nCaptureTimes = nCaptureTimes;
+	return defect;
+}
+
+//各次拍照的同一处瑕疵只保留置信度最高的一个, 无位置信息的同类瑕疵只计一次
+SERVER_TEST(testProductFusionDeduplicate)
+{
+	AppProductFusion fusion(0, FUSION_CAPTURE_TIMES, FUSION_IOU_THRESHOLD, FUSION_DISTANCE, FUSION_MAX_PENDING_PRODUCTS);
+	fusion.addDefects(1, 1, {makeDefect(3, Rect(100, 100, 20, 20), 0.9f, 1), makeDefect(5, Rect(), 0.5f, 1), makeDefect(6, Rect(200, 200, 4, 4), 0.8f, 1)});
+	TEST_CHECK(!fusion.isDefectsComplete(1));
+	fusion.addDefects(1, 2, {makeDefect(3, Rect(105, 102, 20, 20), 0.95f, 2),   //交并比大于阈值
+							 makeDefect(3, Rect(400, 400, 20, 20), 0.6f, 2),    //同类别不同位置
+							 makeDefect(5, Rect(), 0.7f, 2),                    //无位置信息
+							 makeDefect(4, Rect(100, 100, 20, 20), 0.4f, 2),    //同位置不同类别
+							 makeDefect(6, Rect(230, 200, 4, 4), 0.3f, 2)});    //不相交, 中心距离小于阈值
+	TEST_CHECK(fusion.isDefectsComplete(1));
+
+	vector<stDefectInfo> vDefects;
+	TEST_CHECK(!fusion.fuse(1, vDefects));
+	TEST_CHECK(vDefects.size() == 5);
+	//按置信度从高到低保留
+	TEST_CHECK(vDefects[0].type == 3 && vDefects[0].nCaptureTimes == 2 && vDefects[0].box == Rect(105, 102, 20, 20));
+	TEST_CHECK(vDefects[1].type == 6 && vDefects[1].nCaptureTimes == 1);
+	TEST_CHECK(vDefects[2].type == 5 && vDefects[2].nCaptureTimes == 2);
+	TEST_CHECK(vDefects[3].type == 3 && vDefects[3].box == Rect(400, 400, 20, 20));
+	TEST_CHECK(vDefects[4].type == 4);
+	return true;
+}
+
+//所有拍照都没有瑕疵时判定OK, 未加入的产品同样为OK且没有瑕疵
+SERVER_TEST(testProductFusionOK)
+{
+	AppProductFusion fusion(0, FUSION_CAPTURE_TIMES, FUSION_IOU_THRESHOLD, FUSION_DISTANCE, FUSION_MAX_PENDING_PRODUCTS);
+	fusion.addDefects(1, 1, {});
+	fusion.addDefects(1, 2, {});
+	TEST_CHECK(fusion.isDefectsComplete(1));
+	vector<stDefectInfo> vDefects = {makeDefect(3, Rect(), 1, 1)};
+	TEST_CHECK(fusion.fuse(1, vDefects));
+	TEST_CHECK(vDefects.empty());
+	TEST_CHECK(fusion.fuse(2, vDefects));
+	TEST_CHECK(vDefects.empty());
+	return true;
+}
+
+//结果图按拍照顺序横向拼接, 高度统一为最小高度, 灰度图转为彩色
+SERVER_TEST(testProductFusionComposeImage)
+{
+	AppProductFusion fusion(0, FUSION_CAPTURE_TIMES, FUSION_IOU_THRESHOLD, FUSION_DISTANCE, FUSION_MAX_PENDING_PRODUCTS);
+	const Mat source1(50, 100, CV_8UC1, Scalar(1));
+	const Mat source2(100, 100, CV_8UC3, Scalar(2, 2, 2));
+	fusion.addImage(1, 2, source2.clone(), source2);
+	fusion.addImage(1, 1, source1.clone(), source1);
+	fusion.addDefects(1, 1, {makeDefect(4, Rect(10, 10, 5, 5), 0.9f, 1)});
+	fusion.addDefects(1, 2, {});
+
+	vector<Mat> vSourceImages;
+	int resultType = -1;
+	Mat composed = fusion.composeImage(1, vSourceImages, resultType);
+	//融合前没有结果类别
+	TEST_CHECK(resultType == 0);
+
+	vector<stDefectInfo> vDefects;
+	TEST_CHECK(!fusion.fuse(1, vDefects));
+	composed = fusion.composeImage(1, vSourceImages, resultType);
+	TEST_CHECK(resultType == 4);
+	TEST_CHECK(composed.rows == 50 && composed.cols == 150);
+	TEST_CHECK(composed.type() == CV_8UC3);
+	TEST_CHECK(composed.at<Vec3b>(0, 0) == Vec3b(1, 1, 1));
+	TEST_CHECK(composed.at<Vec3b>(0, 149) == Vec3b(2, 2, 2));
+	TEST_CHECK(vSourceImages.size() == 2);
+	TEST_CHECK(vSourceImages[0].data == source1.data && vSourceImages[1].data == source2.data);
+
+	fusion.erase(1);
+	composed = fusion.composeImage(1, vSourceImages, resultType);
+	TEST_CHECK(composed.empty() && vSourceImages.empty() && resultType == 0);
+	return true;
+}
+
+//未完成产品超过缓存数量时丢弃最早的, 其瑕疵不会带到之后的判定
+SERVER_TEST(testProductFusionDropIncomplete)
+{
+	AppProductFusion fusion(0, FUSION_CAPTURE_TIMES, FUSION_IOU_THRESHOLD, FUSION_DISTANCE, FUSION_MAX_PENDING_PRODUCTS);
+	fusion.addDefects(10, 1, {makeDefect(3, Rect(), 0.9f, 1)});
+	fusion.addDefects(11, 1, {makeDefect(3, Rect(), 0.9f, 1)});
+	fusion.addDefects(12, 1, {});
+	fusion.addDefects(12, 2, {});
+	TEST_CHECK(fusion.isDefectsComplete(12));
+
+	vector<stDefectInfo> vDefects;
+	TEST_CHECK(fusion.fuse(10, vDefects));
+	TEST_CHECK(vDefects.empty());
+	TEST_CHECK(!fusion.fuse(11, vDefects));
+	TEST_CHECK(vDefects.size() == 1);
+	TEST_CHECK(fusion.fuse(12, vDefects));
+
+	//给出判定后删除的产品不再视为到齐
+	fusion.erase(11);
+	fusion.erase(12);
+	TEST_CHECK(!fusion.isDefectsComplete(11));
+	return true;
+}
@@ -0,0 +1,119 @@
+#include "test_utils.h"
+#include "xj_app_stage_queue.h"
+#include <thread>
+
+using namespace std;
+
+//依次取出n项, 队列提前取空时返回已取出的部分
+static vector<int> popItems(AppStageQueue<int> &queue, const int n)
+{
+	vector<int> vItems;
+	int item = 0;
+	while((int)vItems.size() < n && queue.pop(item))
+	{
+		vItems.emplace_back(item);
+	}
+	return vItems;
+}
+
+//环形缓冲区回绕后仍按放入顺序取出
+SERVER_TEST(testStageQueueWraparound)
+{
+	AppStageQueue<int> queue(3, StageQueuePolicy::BLOCK);
+	for(int round = 0; round < 4; round++)
+	{
+		//每轮放入3项、取出2项, 起始位置每轮后移, 多次越过缓冲区末尾
+		for(int i = 0; i < 3; i++)
+		{
+			if(round == 0 || i < 2)
+			{
+				TEST_CHECK(queue.push(round * 10 + i));
+			}
+		}
+		const vector<int> vItems = popItems(queue, 2);
+		TEST_CHECK(vItems.size() == 2);
+		if(round == 0)
+		{
+			TEST_CHECK(vItems[0] == 0 && vItems[1] == 1);
+		}
+		else
+		{
+			//上一轮剩下的一项在前
+			TEST_CHECK(vItems[0] == (round == 1 ? 2 : (round - 1) * 10 + 1));
+			TEST_CHECK(vItems[1] == round * 10);
+		}
+	}
+
+	queue.close();
+	const vector<int> vRest = popItems(queue, 10);
+	TEST_CHECK(vRest.size() == 1 && vRest[0] == 31);
+
+	const stStageQueueStats stats = queue.getStats();
+	TEST_CHECK(stats.numPushed == 9);
+	TEST_CHECK(stats.numPopped == 9);
+	TEST_CHECK(stats.numDropped == 0);
+	TEST_CHECK(stats.depth == 0);
+	TEST_CHECK(stats.maxDepth == 3);
+	return true;
+}
+
+//回绕后队列满时丢弃最早一项, 其余按顺序保留
+SERVER_TEST(testStageQueueDropOldestWraparound)
+{
+	AppStageQueue<int> queue(3, StageQueuePolicy::DROP_OLDEST);
+	TEST_CHECK(queue.push(1));
+	TEST_CHECK(queue.push(2));
+	TEST_CHECK(queue.push(3));
+	TEST_CHECK(popItems(queue, 1) == vector<int>({1}));
+	TEST_CHECK(queue.push(4));
+	TEST_CHECK(!queue.push(5));
+	TEST_CHECK(!queue.push(6));
+	TEST_CHECK(popItems(queue, 3) == vector<int>({4, 5, 6}));
+
+	const stStageQueueStats stats = queue.getStats();
+	TEST_CHECK(stats.numPushed == 6);
+	TEST_CHECK(stats.numDropped == 2);
+	TEST_CHECK(stats.depth == 0);
+	return true;
+}
+
+//队列满时丢弃新放入的一项, 已放入的不受影响
+SERVER_TEST(testStageQueueDropNewest)
+{
+	AppStageQueue<int> queue(2, StageQueuePolicy::DROP_NEWEST);
+	TEST_CHECK(queue.push(1));
+	TEST_CHECK(queue.push(2));
+	TEST_CHECK(!queue.push(3));
+	TEST_CHECK(popItems(queue, 2) == vector<int>({1, 2}));
+	TEST_CHECK(queue.push(4));
+	TEST_CHECK(popItems(queue, 1) == vector<int>({4}));
+	TEST_CHECK(queue.getStats().numDropped == 1);
+	return true;
+}
+
+//BLOCK方式下队列满时上游等待下游取走; 关闭后唤醒等待方, 已放入的项仍可取出
+SERVER_TEST(testStageQueueBlockAndClose)
+{
+	AppStageQueue<int> queue(1, StageQueuePolicy::BLOCK);
+	TEST_CHECK(queue.push(1));
+	thread producer([&queue]()
+	{
+		queue.push(2);
+	});
+	this_thread::sleep_for(chrono::milliseconds(20));
+	TEST_CHECK(queue.getStats().depth == 1);
+	TEST_CHECK(popItems(queue, 1) == vector<int>({1}));
+	producer.join();
+	TEST_CHECK(queue.getStats().maxBlockMs > 0);
+
+	thread blocked([&queue]()
+	{
+		queue.push(3);
+	});
+	this_thread::sleep_for(chrono::milliseconds(20));
+	queue.close();
+	blocked.join();
+	TEST_CHECK(!queue.push(4));
+	TEST_CHECK(popItems(queue, 10) == vector<int>({2}));
+	return true;
+}
@@ -0,0 +1,88 @@
+#include "test_utils.h"
+#include "xj_app_verdict_deadline.h"
+#include <atomic>
+#include <thread>
+
+using namespace std;
+
+//等待条件成立, 超时返回false
+static bool waitUntil(const function<bool()> &condition, const int timeoutMs)
+{
+	const auto deadline = chrono::steady_clock::now() + chrono::milliseconds(timeoutMs);
+	while(!condition())
+	{
+		if(chrono::steady_clock::now() >= deadline)
+		{
+			return false;
+		}
+		this_thread::sleep_for(chrono::milliseconds(1));
+	}
+	return true;
+}
+
+//时限内给出判定时不发兜底判定
+SERVER_TEST(testVerdictDeadlineOnTime)
+{
+	atomic<int> numFallbacks(0);
+	AppVerdictDeadline deadline(0, 50, 10, [&numFallbacks]() { numFallbacks++; });
+	const long ticket = deadline.arm(chrono::steady_clock::now());
+	TEST_CHECK(ticket >= 0);
+	TEST_CHECK(deadline.resolve(ticket, true));
+	//同一帧后续镜片的判定照常发出
+	TEST_CHECK(deadline.resolve(ticket, false));
+	//未计时的帧直接发出
+	TEST_CHECK(deadline.resolve(-1, true));
+	this_thread::sleep_for(chrono::milliseconds(80));
+
+	const stVerdictDeadlineStats stats = deadline.getStats();
+	TEST_CHECK(numFallbacks == 0);
+	TEST_CHECK(stats.numArmed == 1);
+	TEST_CHECK(stats.numOnTime == 1);
+	TEST_CHECK(stats.numMissed == 0);
+	TEST_CHECK(stats.numLate == 0);
+	return true;
+}
+
+//超过时限减余量时在监视线程中发出兜底判定, 之后的判定不再发出, 只计入迟到统计
+SERVER_TEST(testVerdictDeadlineFallback)
+{
+	atomic<int> numFallbacks(0);
+	AppVerdictDeadline deadline(0, 50, 10, [&numFallbacks]() { numFallbacks++; });
+	const auto armTime = chrono::steady_clock::now();
+	const long ticket = deadline.arm(armTime);
+	deadline.setStage(ticket, VerdictStage::COMMIT);
+	TEST_CHECK(waitUntil([&numFallbacks]() { return numFallbacks > 0; }, 2000));
+	TEST_CHECK(chrono::steady_clock::now() - armTime >= chrono::milliseconds(40));
+	TEST_CHECK(!deadline.resolve(ticket, true));
+
+	const stVerdictDeadlineStats stats = deadline.getStats();
+	TEST_CHECK(numFallbacks == 1);
+	TEST_CHECK(stats.numMissed == 1);
+	TEST_CHECK(stats.vMissedByStage[(int)VerdictStage::COMMIT] == 1);
+	TEST_CHECK(stats.numOnTime == 0);
+	TEST_CHECK(stats.numLate == 1);
+	TEST_CHECK(stats.numLateOK == 1);
+	TEST_CHECK(stats.maxLateMs >= 40);
+	return true;
+}
+
+//读取帧信息后已经超时的帧计入读取帧信息阶段, 按取像顺序依次发出兜底判定
+SERVER_TEST(testVerdictDeadlineExpiredOnArm)
+{
+	atomic<int> numFallbacks(0);
+	AppVerdictDeadline deadline(0, 50, 10, [&numFallbacks]() { numFallbacks++; });
+	const auto now = chrono::steady_clock::now();
+	const long expired = deadline.arm(now - chrono::milliseconds(100));
+	const long timed = deadline.arm(now);
+	TEST_CHECK(waitUntil([&numFallbacks]() { return numFallbacks > 0; }, 2000));
+	TEST_CHECK(!deadline.resolve(expired, false));
+	TEST_CHECK(deadline.resolve(timed, true));
+
+	const stVerdictDeadlineStats stats = deadline.getStats();
+	TEST_CHECK(numFallbacks == 1);
+	TEST_CHECK(stats.vMissedByStage[(int)VerdictStage::CONTEXT] == 1);
+	TEST_CHECK(stats.numOnTime == 1);
+	TEST_CHECK(stats.numLate == 1);
+	TEST_CHECK(stats.numLateOK == 0);
+	return true;
+}
@@ -106,6 +106,12 @@ void MultiThreadImageSaveBase::AddImageData(const cv::Mat &image, const std::str
     m_qImageData.enqueue(data);
 }
 
+double MultiThreadImageSaveBase::GetQueueFill()
+{
+    //存图线程写文件期间持有m_mtx, 这里只用队列自身的锁, 不等待写文件
+    return (m_MaxQueueSize > 0) ? (double)m_qImageData.size() / m_MaxQueueSize : 0;
+}
+
 void MultiThreadImageSaveBase::HangUpSaveThread()
 {
     unique_lock<std::mutex> lck(m_mtx);
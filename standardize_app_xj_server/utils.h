@@ -44,6 +44,9 @@ public:
     void HangUpSaveThread();
     void WakeUpSaveThread();
 
+    //队列中待保存图像数占最大缓存数的比例, 用于负载调节
+    double GetQueueFill();
+
 private:
     void init();
     bool runSaveImage();
@@ -38,6 +38,102 @@ struct stConfigParamsB
     std::vector<std::string> vCameraNames;
 };
 
+//图像质量检查结果类型
+enum class ImageQualityReason : int
+{
+    OK              = 0,
+    INVALID_IMAGE   = 1,    //空图或格式错误
+    UNDER_EXPOSED   = 2,    //欠曝
+    OVER_EXPOSED    = 3,    //过曝
+    BLURRED         = 4,    //失焦
+    NO_LENS         = 5,    //无镜片
+    PARTIAL_LENS    = 6     //镜片不完整
+};
+
+//图像质量检查结果
+struct stImageQuality
+{
+    ImageQualityReason reason = ImageQualityReason::OK;
+    float meanGray = 0;     //平均灰度
+    float lowGray = 0;      //低分位灰度
+    float highGray = 0;     //高分位灰度
+    float focus = 0;        //拉普拉斯方差
+    float coverage = 0;     //镜片面积占比
+    double elapsedMs = 0;
+};
+
+std::string getImageQualityReasonName(const ImageQualityReason reason);
+
+//单个瑕疵信息, 用于多次拍照结果融合
+struct stDefectInfo
+{
+    int type = 0;           //结果类别, 与detectAnalyze返回值一致(瑕疵索引+2)
+    cv::Rect box;           //镜片坐标(定位框左上角为原点), 无位置信息时为空
+    float confidence = 0;
+    int nCaptureTimes = 0;
+};
+
+//一帧多片镜片时单片镜片的检测结果, 每片镜片作为独立产品判定
+struct stLensResult
+{
+    cv::Rect box;                           //镜片在原图中的位置
+    cv::Mat processedImage;                 //镜片结果图
+    std::vector<std::vector<int>> vResult;  //与detectAnalyze返回值相同
+    std::vector<stDefectInfo> vDefects;
+};
+
+//阈值扫描请求: 对目录中带标签的图像, 按阈值缩放网格离线评估过杀/漏检, 推理结果按图像缓存
+struct stSweepRequest
+{
+    std::string sImagePath;                 //样本目录, 其下OK、NG子目录分别为良品、不良品
+    int nCaptureTimes = 1;                  //按第几次拍照的模型和阈值检测
+    int maxLenses = 1;                      //每帧最多镜片数
+    int category = -1;                      //只缩放该类别的阈值, -1为全部类别
+    std::vector<float> vProbScales = {1};   //置信度阈值缩放
+    std::vector<float> vAreaScales = {1};   //面积阈值缩放
+    std::vector<float> vDiagScales = {1};   //对角线阈值缩放
+};
+
+//单组阈值的扫描结果
+struct stSweepResult
+{
+    float probScale = 1;
+    float areaScale = 1;
+    float diagScale = 1;
+    int numNG = 0;          //判为NG的样本数
+    int numOverkill = 0;    //良品判NG
+    int numEscape = 0;      //不良品判OK
+};
+
+struct stSweepReport
+{
+    int numSamples = 0;     //有推理结果的样本数
+    int numLabelNG = 0;
+    int numCached = 0;      //命中缓存、未重新推理的样本数
+    double inferSeconds = 0;
+    double sweepSeconds = 0;
+    std::vector<stSweepResult> vResults;
+};
+
+//影子评估统计: 候选模型在抽样的线上帧上检测, 判定只与生产结果比较并记录, 不输出到PLC
+struct stShadowReport
+{
+    int boardId = 0;
+    std::string sModelPath;     //候选模型(第一次拍照)
+    long numSampled = 0;        //抽中的帧数, 含丢弃
+    long numDropped = 0;        //队列满丢弃的帧数
+    long numEvaluated = 0;
+    long numAgree = 0;
+    long numCandidateNG = 0;    //生产OK、候选NG
+    long numCandidateOK = 0;    //生产NG、候选OK
+    int queueDepth = 0;
+    double avgEvalMs = 0;       //单帧评估CPU时间
+};
+
+//所有工位的影子评估统计, 按工位排列
+std::vector<stShadowReport> getShadowReports();
+
+//init与检测可在不同线程调用; 初始化后detectAnalyze/checkImageQuality可多线程并发调用
 class XJAppAlgorithm
 {
 public:
@@ -45,7 +141,18 @@ public:
     ~XJAppAlgorithm();
 
     bool init(const stConfigParamsA &stParamsA, const stConfigParamsB &stParamsB);
+    //只改阈值类参数或换产时热更新: 重新编译检测方案后整体替换, 不重新加载模型; 正在进行的检测用旧参数完成, 下一帧生效.
+    //未初始化或阈值、产品名以外的参数有变化时返回false, 需调用init
+    bool updateParams(const stConfigParamsA &stParamsA, const stConfigParamsB &stParamsB);
     std::vector<std::vector<int>> detectAnalyze(const cv:: Mat &image, cv::Mat &processedImage, const int productCount, const int nCaptureTimes = 1);
+    std::vector<std::vector<int>> detectAnalyze(const cv:: Mat &image, cv::Mat &processedImage, const int productCount, const int nCaptureTimes, std::vector<stDefectInfo> &vDefects);
+    //定位一帧中所有镜片(最多maxLenses片, 从左到右)并分别检测, 各镜片小图合并推理; 定位失败时返回一片整帧结果
+    std::vector<stLensResult> detectAnalyzeLenses(const cv::Mat &image, const int productCount, const int nCaptureTimes, const int maxLenses);
+    stImageQuality checkImageQuality(const cv::Mat &image, const int nCaptureTimes = 1);
+    //阈值扫描: 样本只在缓存未命中时推理一次, 各组阈值在缓存结果上并行判定; 未初始化或样本目录无效时返回false
+    bool sweepThresholds(const stSweepRequest &request, stSweepReport &report);
+    //负载过高时关闭过程小图(IS_SAVE_PROCESS_IMAGE)保存, 下一帧生效, 重新初始化后保持
+    void setProcessImageSaveEnabled(const bool bIsEnable);
 
 private:
     void *m_pBase;
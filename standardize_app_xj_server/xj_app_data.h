@@ -81,5 +81,13 @@ enum class CaptureImageTimes : int
 	THIRD_TIMES   = 3,
 };
 
+//图像质量不合格处理方式：0-判NG  1-重拍(仅软触发相机)  2-跳过检测, 按图像质量瑕疵剔除并单独计数, 不判OK
+enum class ImageQualityAction : int
+{
+	NG    = 0,
+	RETRY = 1,
+	SKIP  = 2
+};
+
 
 #endif
\ No newline at end of file
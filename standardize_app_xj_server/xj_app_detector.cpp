@@ -1,8 +1,13 @@
+#include <set>
+#include <atomic>
 #include "xj_app_detector.h"
 #include "xj_app_io_manager.h"
 #include "xj_app_tracker.h"
 #include "xj_app_data.h"
 #include "xj_app_running_result.h"
+#include "xj_app_runtime_config.h"
+#include "xj_app_product_cache.h"
+#include "xj_app_load_governor.h"
 
 #include "customized_json_config.h"
 #include "running_status.h"
@@ -11,12 +16,23 @@
 using namespace std;
 using namespace boost::property_tree;
 
+//所有工位写PLC寄存器失败的次数, 变化时PLC参数缓存失效
+static atomic<long> s_numPlcWriteFailures(0);
+
 AppDetector::AppDetector(const std::shared_ptr<AppDetectorConfig> &pConfig, const std::shared_ptr<BaseTracker> &pTracker,
 		const std::shared_ptr<Board> &pBoard) : BaseDetector(pConfig, pTracker, pBoard), m_iCaptureTimes(0), m_iTotalCaptureTimes(0)
 {
 		initWorkflows<AppWorkflow>();
 		// set expose target result flag here if defined
 		pConfig->exposeTargetResults(true);
+		//乱序检测或一帧多片镜片时产品结果由workflow的提交流程按产品顺序给出
+		for (const auto &itr : m_workflows)
+		{
+			dynamic_pointer_cast<AppWorkflow>(itr)->setProductResultHandler([this](const vector<ClassificationResult> &vTotalResult, const int productNumber, const int lensIdx, const long verdictTicket)
+			{
+				commitProductResult(vTotalResult, true, productNumber, lensIdx, verdictTicket);
+			});
+		}
 		m_iTotalCaptureTimes  = CustomizedJsonConfig::instance().getVector<int>("CAMERA_TOTAL_IMAGES")[pBoard->boardId()];
 		//cout << "m_iTotalCaptureTimes=" << m_iTotalCaptureTimes << endl;
 }
@@ -82,27 +98,33 @@ int AppDetector::getSignalByPurgeMode(const bool bIsResultOK)
 }
 
 //往PLC发送剔除信号
-bool AppDetector::sendResultSignalToPLC(const bool bIsResultOK)
+bool AppDetector::sendResultSignalToPLC(const bool bIsResultOK, const int lensIdx)
 {
+	const shared_ptr<const stRuntimeConfig> pConfig = AppRuntimeConfig::instance().get();
 	//mock视频默认不发信号，如果要发信号，可以在配置文件开启
 	if (m_pBoard->getViewCamera(0)->deviceName().substr(0, 4) == "Mock")
 	{
-		const bool bIsSend = CustomizedJsonConfig::instance().get<bool>("IS_ENABLE_SEND_SIGNAL_IN_MOCK_VIDEO");
-		if(!bIsSend)
+		if(!pConfig->bIsSendSignalInMock)
 		{
 			return true;
 		}
 	}
 	
-	const bool bIsUseIoCard = CustomizedJsonConfig::instance().get<bool>("IS_USE_IO_CARD");
 	const int boardID = m_pBoard->boardId();
+	const stBoardRuntimeConfig *pBoardConfig = pConfig->board(boardID);
+	if(pBoardConfig == nullptr)
+	{
+		LogERROR << "extern: Board[" << boardID << "] runtime config is not loaded, result signal is not sent";
+		return false;
+	}
 	int purgeSignal = getSignalByPurgeMode(bIsResultOK);
-	if(bIsUseIoCard)
+	//一帧多片镜片时, 各镜片结果依次写到结果地址之后的地址
+	const int addressOffset = lensIdx * pConfig->lensAddressStride;
+	if(pConfig->bIsUseIoCard)
 	{
-		const vector<int> vAddress = CustomizedJsonConfig::instance().getVector<int>("IO_CARD_CAMERA_RESULT_BIT_ADDRESS");//发送结果信号IO点位
-		const int signalTime = CustomizedJsonConfig::instance().get<int>("IO_CARD_SIGNAL_TIME_MS");//信号持续时间
+		const int signalTime = pConfig->ioSignalTimeMs;//信号持续时间
 		const int channel = 0;//通道： 0-对应0-7点, 1-对应8-15点
-		const int address = vAddress[boardID];//io点(数值：0-7)
+		const int address = pBoardConfig->ioResultBit + addressOffset;//io点(数值：0-7), 来自IO_CARD_CAMERA_RESULT_BIT_ADDRESS
 		if(purgeSignal == (int)PLCSinal::OK)
 		{
 			dynamic_pointer_cast<AppIoManagerIOCard>(ioManager())->writeBit(channel, address, 1);
@@ -113,8 +135,8 @@ bool AppDetector::sendResultSignalToPLC(const bool bIsResultOK)
 	}
 	else
 	{
-		const int iOKData = CustomizedJsonConfig::instance().get<int>("PLC_MODBUS_TCP_OK_RESULT_VALUE");//OK信号数值
-		const int iNGData = CustomizedJsonConfig::instance().get<int>("PLC_MODBUS_TCP_NG_RESULT_VALUE");//NG信号数值
+		const int iOKData = pConfig->plcOKValue;//OK信号数值
+		const int iNGData = pConfig->plcNGValue;//NG信号数值
 		int data;
 		if(bIs_PLC){
 			data =  PLC_result;
@@ -122,10 +144,10 @@ bool AppDetector::sendResultSignalToPLC(const bool bIsResultOK)
 			data = (purgeSignal == (int)PLCSinal::OK) ? iOKData : iNGData;//发送数据	
 		// const int data = (purgeSignal == (int)PLCSinal::OK) ? iOKData : iNGData;//发送数据	
 		}		
-		const vector<int> vAddress = CustomizedJsonConfig::instance().getVector<int>("PLC_MODBUS_TCP_CAMERA_RESULT_REGISTER_ADDRESS");//发送结果信号PLC寄存器地址
-		const int address = vAddress[boardID];//PLC寄存器器地址（根据实际信号分配填写）
+		const int address = pBoardConfig->plcResultAddress + addressOffset;//PLC寄存器器地址（根据实际信号分配填写）, 来自PLC_MODBUS_TCP_CAMERA_RESULT_REGISTER_ADDRESS
 		if(!dynamic_pointer_cast<AppIoManagerPLC>(ioManager())->writeRegister(address, data))
 		{
+			notifyPlcWriteFailed();
 			LogERROR << "extern: Board[" << boardID << "] failed to send result data:" << data << " to PLC register address:" << address;
 			return false;
 		}
@@ -134,18 +156,19 @@ bool AppDetector::sendResultSignalToPLC(const bool bIsResultOK)
 	return true;
 }
 
-bool AppDetector::recordProductResultData(const std::vector<ClassificationResult>& vDefectResults)
+bool AppDetector::recordProductResultData(const std::vector<ClassificationResult>& vDefectResults, const int productNumber)
 {
     int valueTotalNum = 0;
 	int valueTotalDefect = 0;
 	const int boardID = m_pBoard->boardId();
-	const bool bIsMesEnable = CustomizedJsonConfig::instance().get<bool>("IS_USE_MES_SYSTEM");
+	const shared_ptr<const stRuntimeConfig> pConfig = AppRuntimeConfig::instance().get();
+	const bool bIsMesEnable = pConfig->bIsUseMes;
 	if (false == bIsMesEnable && 0 == vDefectResults.size())
 	{
 		return true;
 	}
 
-	const bool bIsUseIoCard = CustomizedJsonConfig::instance().get<bool>("IS_USE_IO_CARD");
+	const bool bIsUseIoCard = pConfig->bIsUseIoCard;
 	const bool bIsMockCamera = (m_pBoard->getViewCamera(0)->deviceName().substr(0, 4) == "Mock");
 	if (bIsMockCamera || bIsUseIoCard || nullptr == ioManager())
 	{
@@ -156,10 +179,10 @@ bool AppDetector::recordProductResultData(const std::vector<ClassificationResult
 	}
 	else
 	{
-		// Get total number
-		valueTotalNum = getRealProductCount();
+		// Get total number, 一帧多片镜片时使用镜片的产品序号
+		valueTotalNum = (productNumber >= 0) ? productNumber : getRealProductCount();
 		// Get total defect
-		const int addressTotalDefect = CustomizedJsonConfig::instance().get<int>("PLC_MODBUS_TCP_TOTAL_DEFECT_COUNT_ADDRESS");
+		const int addressTotalDefect = pConfig->plcTotalDefectAddress;
 		if (!dynamic_pointer_cast<AppIoManagerPLC>(m_pIoManager)->readRegister(addressTotalDefect, valueTotalDefect))
 		{
 			LogINFO << "extern: Board[" << boardID << "]: read total defect register failed!";
@@ -170,14 +193,16 @@ bool AppDetector::recordProductResultData(const std::vector<ClassificationResult
 	// 瑕疵品需记录到db.defect表格中
 	string product = RunningInfo::instance().GetProductionInfo().GetCurrentProd();
 	string lot = RunningInfo::instance().GetProductionInfo().GetCurrentLot();
+	// 负载调节最高级别时写库延后到后台线程, 记录内容和时间戳在此时生成
+	const bool bIsDeferred = AppLoadGovernor::instance().isDegraded(boardID, LoadLevel::DEFER_DB_WRITES);
 	if (0 != vDefectResults.size())
 	{
-		AppRunningResult::instance().recordDefectData(product, boardID, lot, valueTotalNum, vDefectResults);
+		AppRunningResult::instance().recordDefectData(product, boardID, lot, valueTotalNum, vDefectResults, bIsDeferred);
 	}
 	if (bIsMesEnable && !bIsMockCamera)
 	{
 		// 不管OK/NG都需要记录到MES系统中 (此处用产品序号作为index)
-		AppRunningResult::instance().recordMesData(product, boardID, lot, valueTotalNum, valueTotalNum, valueTotalDefect, vDefectResults);
+		AppRunningResult::instance().recordMesData(product, boardID, lot, valueTotalNum, valueTotalNum, valueTotalDefect, vDefectResults, bIsDeferred);
 	}
 
 	return true;
@@ -185,6 +210,24 @@ bool AppDetector::recordProductResultData(const std::vector<ClassificationResult
 
 bool AppDetector::purgeBoardResult(const std::vector<std::vector<ClassificationResult>> &result, const bool needCalculateResult)
 {
+	shared_ptr<AppWorkflow> pWorkflow = dynamic_pointer_cast<AppWorkflow>(m_workflows[0]);
+	if(m_pVerdictDeadline != nullptr)
+	{
+		m_pVerdictDeadline->setStage(m_verdictTicket, VerdictStage::COMMIT);
+	}
+	//多次拍照并发检测, 中间拍照不发信号, 结果在最后一次拍照汇总
+	if(pWorkflow->isResultPending())
+	{
+		return true;
+	}
+
+	//产品级融合: 中间拍照只收集瑕疵, 最后一次拍照去重后统一判定、记录、发信号
+	const bool bIsFusion = pWorkflow->isProductFusionEnabled() && m_iCaptureTimes >= (int)CaptureImageTimes::FIRST_TIMES && m_iCaptureTimes <= m_iTotalCaptureTimes;
+	if(bIsFusion && m_iCaptureTimes < m_iTotalCaptureTimes)
+	{
+		return true;
+	}
+
 	// if(m_iCaptureTimes == (int)CaptureImageTimes::FIRST_TIMES)
 	if(1)
 	{
@@ -192,8 +235,32 @@ bool AppDetector::purgeBoardResult(const std::vector<std::vector<ClassificationR
 	}
 	
 	//step0:merge all target result
-	const bool bIsEnable =  CustomizedJsonConfig::instance().get<bool>("IS_COUNT_MULTI_DEFECTS_PER_TARGET");
-	if(!bIsEnable)
+	const bool bIsEnable = AppRuntimeConfig::instance().get()->bIsCountMultiDefects;
+	if(bIsFusion)
+	{
+		const int productSeq = pWorkflow->getProductNumber();
+		if(!pWorkflow->getProductFusion()->isDefectsComplete(productSeq))
+		{
+			LogERROR << "extern: Board[" << m_pBoard->boardId() << "] product " << productSeq << " captures not complete, fuse available captures";
+		}
+		vector<stDefectInfo> vDefects;
+		pWorkflow->getProductFusion()->fuse(productSeq, vDefects);
+		set<int> setDefectTypes;
+		for(const auto &defect : vDefects)
+		{
+			setDefectTypes.insert(defect.type);
+		}
+		for(const auto &type : setDefectTypes)
+		{
+			m_vTotalResult.emplace_back(type);
+		}
+
+		if(m_vTotalResult.size() == 0)
+		{
+			m_vTotalResult.emplace_back((int)ClassifierResultConstant::Good);
+		}
+	}
+	else if(!bIsEnable)
 	{
 		const int viewNum = result.size();
 		for(int i = 0; i != viewNum; ++ i)
@@ -224,33 +291,9 @@ bool AppDetector::purgeBoardResult(const std::vector<std::vector<ClassificationR
 	// if(m_iCaptureTimes == m_iTotalCaptureTimes)
 	if(1)
 	{
-		//step1: send data to UI
-		if(needCalculateResult)
-		{
-			const int boardID = m_pBoard->boardId();
-			RunningInfo::instance().GetRunningData().ProcessClassifyResult(boardID, m_vTotalResult, getRealProductCount());
-		}
-
-		// vector中只留下Defect Result
-		m_vTotalResult.erase(std::remove(m_vTotalResult.begin(), m_vTotalResult.end(), (int)ClassifierResultConstant::Good), m_vTotalResult.end());
-		bool bIsOK = (0 == m_vTotalResult.size());
-
-		//发瑕疵类别给PLC统计计数
-		if (bIs_PLC)
-		{			
-			auto max_it = max_element(m_vTotalResult.begin(), m_vTotalResult.end());
-			if(max_it != m_vTotalResult.end()){
-				PLC_result = *max_it;
-			}
-		}		
-
-		// 记录生产信息
-		recordProductResultData(m_vTotalResult);
-		
+		const bool bIsSent = commitProductResult(m_vTotalResult, needCalculateResult, -1, 0, m_verdictTicket);
 		m_vTotalResult.clear();
-		
-		//step3:send signal to PLC
-		return sendResultSignalToPLC(bIsOK);
+		return bIsSent;
 	}
 	else if(m_iCaptureTimes == (int)CaptureImageTimes::UNKNOWN_TIMES)
 	{
@@ -259,6 +302,91 @@ bool AppDetector::purgeBoardResult(const std::vector<std::vector<ClassificationR
 	return true;
 }
 
+bool AppDetector::commitProductResult(std::vector<ClassificationResult> vTotalResult, const bool needCalculateResult, const int productNumber, const int lensIdx, const long verdictTicket)
+{
+	//step1: send data to UI
+	if(needCalculateResult)
+	{
+		const int boardID = m_pBoard->boardId();
+		RunningInfo::instance().GetRunningData().ProcessClassifyResult(boardID, vTotalResult, (productNumber >= 0) ? productNumber : getRealProductCount());
+	}
+
+	// vector中只留下Defect Result
+	vTotalResult.erase(std::remove(vTotalResult.begin(), vTotalResult.end(), (int)ClassifierResultConstant::Good), vTotalResult.end());
+	bool bIsOK = (0 == vTotalResult.size());
+
+	//发瑕疵类别给PLC统计计数
+	if (bIs_PLC)
+	{			
+		auto max_it = max_element(vTotalResult.begin(), vTotalResult.end());
+		if(max_it != vTotalResult.end()){
+			PLC_result = *max_it;
+		}
+	}		
+
+	// 记录生产信息
+	recordProductResultData(vTotalResult, productNumber);
+
+	//step3:send signal to PLC, 超过判定时限时已发出兜底判定, 本次结果只记录
+	if(m_pVerdictDeadline != nullptr && !m_pVerdictDeadline->resolve(verdictTicket, bIsOK))
+	{
+		return true;
+	}
+	return sendResultSignalToPLC(bIsOK, lensIdx);
+}
+
+void AppDetector::armVerdictDeadline(const chrono::steady_clock::time_point &acquireTime)
+{
+	shared_ptr<AppWorkflow> pWorkflow = dynamic_pointer_cast<AppWorkflow>(m_workflows[0]);
+	m_verdictTicket = (m_pVerdictDeadline != nullptr && pWorkflow->isVerdictExpected(m_iCaptureTimes)) ? m_pVerdictDeadline->arm(acquireTime) : -1;
+	for (const auto &itr : m_workflows)
+	{
+		dynamic_pointer_cast<AppWorkflow>(itr)->setVerdictTicket(m_verdictTicket);
+	}
+}
+
+bool AppDetector::sendFailedResultSignal()
+{
+	shared_ptr<AppWorkflow> pWorkflow = dynamic_pointer_cast<AppWorkflow>(m_workflows[0]);
+	//本帧已交给提交流程时结果由提交流程给出
+	if(pWorkflow->isFrameDispatched())
+	{
+		return true;
+	}
+
+	//本帧镜片数未知, 与兜底判定一样写到所有镜片的结果地址, PLC不会等待其余镜片
+	const int numLenses = pWorkflow->getMaxLensesPerFrame();
+	auto sendFailed = [this, numLenses]()
+	{
+		bool bIsSent = true;
+		for(int lensIdx = 0; lensIdx < numLenses; lensIdx++)
+		{
+			bIsSent = sendResultSignalToPLC(false, lensIdx) && bIsSent;
+		}
+		return bIsSent;
+	};
+
+	//乱序检测时排在在途产品之后发NG信号
+	const long verdictTicket = m_verdictTicket;
+	shared_ptr<AppInspectionPipeline> pPipeline = pWorkflow->getInspectionPipeline();
+	if(pPipeline != nullptr)
+	{
+		pPipeline->submit([](){}, [this, verdictTicket, sendFailed]()
+		{
+			if(m_pVerdictDeadline == nullptr || m_pVerdictDeadline->resolve(verdictTicket, false))
+			{
+				sendFailed();
+			}
+		}, function<void()>());
+		return true;
+	}
+	if(m_pVerdictDeadline != nullptr && !m_pVerdictDeadline->resolve(verdictTicket, false))
+	{
+		return true;
+	}
+	return sendFailed();
+}
+
 //参数重置
 bool AppDetector::reconfigParameters(const int currentRunStatus)
 {
@@ -286,9 +414,47 @@ bool AppDetector::reconfigParameters(const int currentRunStatus)
 		dynamic_pointer_cast<AppWorkflow>(iter)->setCaptureImageTimes((int)CaptureImageTimes::UNKNOWN_TIMES);
 	}
 
+	//判定时限, 在workflow重置(等待在途帧提交完成)之后替换
+	const int boardID = m_pBoard->boardId();
+	const vector<int> vDeadline = CustomizedJsonConfig::instance().getVector<int>("VERDICT_DEADLINE_MS");
+	const vector<int> vMargin = CustomizedJsonConfig::instance().getVector<int>("VERDICT_DEADLINE_MARGIN_MS");
+	const vector<bool> vFallbackOK = CustomizedJsonConfig::instance().getVector<bool>("VERDICT_DEADLINE_FALLBACK_OK");
+	const int deadlineMs = boardID < (int)vDeadline.size() ? vDeadline[boardID] : 0;
+	m_pVerdictDeadline.reset();
+	m_verdictTicket = -1;
+	if(deadlineMs > 0 && currentRunStatus == (int)RunStatus::PRODUCT_RUN)
+	{
+		const int marginMs = boardID < (int)vMargin.size() ? vMargin[boardID] : 0;
+		const bool bIsFallbackOK = boardID < (int)vFallbackOK.size() && vFallbackOK[boardID];
+		//本帧镜片数在检测后才知道, 兜底判定写到所有镜片的结果地址
+		const int numLenses = dynamic_pointer_cast<AppWorkflow>(m_workflows[0])->getMaxLensesPerFrame();
+		m_pVerdictDeadline = make_shared<AppVerdictDeadline>(boardID, deadlineMs, marginMs, [this, bIsFallbackOK, numLenses]()
+		{
+			for(int lensIdx = 0; lensIdx < numLenses; lensIdx++)
+			{
+				sendResultSignalToPLC(bIsFallbackOK, lensIdx);
+			}
+		});
+	}
+	for(const auto &iter : m_workflows)
+	{
+		dynamic_pointer_cast<AppWorkflow>(iter)->setVerdictDeadline(m_pVerdictDeadline);
+		dynamic_pointer_cast<AppWorkflow>(iter)->setVerdictTicket(m_verdictTicket);
+	}
+
 	return true;
 }
 
+bool AppDetector::updateParameters(const int currentRunStatus)
+{
+	bool bIsUpdated = true;
+	for(const auto &iter : m_workflows)
+	{
+		bIsUpdated = dynamic_pointer_cast<AppWorkflow>(iter)->updateParameters(currentRunStatus) && bIsUpdated;
+	}
+	return bIsUpdated;
+}
+
 void AppDetector::setImageSave(const shared_ptr<MultiThreadImageSaveBase> &pSave)
 {
 	for (const auto &itr : m_workflows)
@@ -297,6 +463,11 @@ void AppDetector::setImageSave(const shared_ptr<MultiThreadImageSaveBase> &pSave
 	}
 }
 
+void AppDetector::notifyPlcWriteFailed()
+{
+	s_numPlcWriteFailures++;
+}
+
 void AppDetector::setPlcParameters()
 {
 	const int boardID = m_pBoard->boardId();
@@ -305,27 +476,46 @@ void AppDetector::setPlcParameters()
 		return;
 	}
 
-	ptree params;
-	string sNodeName = ("UISetting.setup.plcParams");
-	std::stringstream ss = CustomizedJsonConfig::instance().getJsonStream(sNodeName);
-	read_json(ss, params);
-	for(const auto &param:params)
+	const string sProd = RunningInfo::instance().GetProductionInfo().GetCurrentProd();
+	shared_ptr<const stProductSettings> pSettings = AppProductCache::instance().get(sProd);
+	if(pSettings == nullptr)
+	{
+		LogERROR << "Read " << sProd << " plc params failed";
+		return;
+	}
+	//换产品后PLC侧的参数可能已被修改; 任一工位写PLC失败说明连接断开过, 重连后的值未知
+	const long numFailures = s_numPlcWriteFailures;
+	if(sProd != m_sPlcRegistersProduct || numFailures != m_plcWriteFailures)
 	{
-		if(!param.second.get_child_optional("index") || !param.second.get_child_optional("id"))
+		m_mapPlcRegisters.clear();
+		m_sPlcRegistersProduct = sProd;
+		m_plcWriteFailures = numFailures;
+	}
+	int numWritten = 0;
+	int numFailed = 0;
+	for(const auto &reg : pSettings->vPlcRegisters)
+	{
+		auto itr = m_mapPlcRegisters.find(reg.address);
+		if(itr != m_mapPlcRegisters.end() && itr->second == reg.value)
 		{
-			LogERROR << "UISetting.setup.plcParams sub params is less";
 			continue;
 		}
-
-		const int index = param.second.get<float>("index");
-		const string sId = param.second.get<string>("id");
-		if(param.second.get_child_optional("address"))
+		if(!dynamic_pointer_cast<AppIoManagerPLC>(ioManager())->writeRegister(reg.address, reg.value))
 		{
-			const int address = param.second.get<float>("address");
-			const int value = (const int)RunningInfo::instance().GetProductSetting().GetFloatSetting(index);
-			dynamic_pointer_cast<AppIoManagerPLC>(ioManager())->writeRegister(address, value);
+			//写入失败的地址不记录, 下次重新写入
+			m_mapPlcRegisters.erase(reg.address);
+			notifyPlcWriteFailed();
+			numFailed++;
+			continue;
 		}
+		m_mapPlcRegisters[reg.address] = reg.value;
+		numWritten++;
+	}
+	if(numFailed > 0)
+	{
+		LogERROR << "extern: Product " << sProd << " plc params: " << numFailed << " registers failed to write";
 	}
+	LogINFO << "Product " << sProd << " plc params: " << numWritten << " of " << pSettings->vPlcRegisters.size() << " registers written";
 }
 
 void AppDetector::setCaptueImageTimesBySignal()
@@ -359,7 +549,8 @@ void AppDetector::setCaptueImageTimesBySignal()
 		}
 		*/
 		int value = 0;
-		const int address = CustomizedJsonConfig::instance().getVector<int>("PLC_MODBUS_TCP_CAMERA_INPUT_REGISTER_ADDRESS")[boardID];			
+		const stBoardRuntimeConfig *pBoardConfig = AppRuntimeConfig::instance().get()->board(boardID);
+		const int address = (pBoardConfig != nullptr) ? pBoardConfig->plcInputAddress : -1;
 		dynamic_pointer_cast<AppIoManagerPLC>(ioManager())->readRegister(address, value);
 		if(value == 1)
 		{
@@ -427,7 +618,7 @@ void AppDetector::updateProductCountofWorkflow(const int iProductCount)
 int AppDetector::getRealProductCount()
 {
 	int iResult = 0;
-	const bool bIsUseIoCard = CustomizedJsonConfig::instance().get<bool>("IS_USE_IO_CARD");
+	const bool bIsUseIoCard = AppRuntimeConfig::instance().get()->bIsUseIoCard;
 	if (m_pBoard->getViewCamera(0)->deviceName().substr(0, 4) == "Mock" || bIsUseIoCard)
 	{
 		iResult = productCount();
@@ -13,7 +13,13 @@ public:
 	virtual bool createBoardTrackingHistory(const int plcDistance);
 
 	bool reconfigParameters(const int currentRunStatus);
-	bool sendResultSignalToPLC(const bool bIsResultOK);
+	//阈值类参数热更新, 在帧间调用, 不停止检测
+	bool updateParameters(const int currentRunStatus);
+	bool sendResultSignalToPLC(const bool bIsResultOK, const int lensIdx = 0);
+	//检测失败时发NG信号, 乱序检测时按产品顺序发送
+	bool sendFailedResultSignal();
+	//写PLC寄存器失败(连接断开)时调用, 之后设置PLC参数时全部重新写入
+	static void notifyPlcWriteFailed();
 
 	void updateProductCountofWorkflow();
 	void updateProductCountofWorkflow(const int iProductCount);
@@ -29,7 +35,13 @@ public:
 	void setCaptueImageTimesByProductCount();
 
 	// 记录生产信息 以便存储到数据库或者上传MES系统
-	bool recordProductResultData(const std::vector<ClassificationResult>& vDefectResults);
+	bool recordProductResultData(const std::vector<ClassificationResult>& vDefectResults, const int productNumber = -1);
+
+	// 产品结果: 发送UI统计、记录生产信息、给PLC发信号; productNumber为-1时使用实际产品计数, lensIdx为一帧多片镜片时的镜片序号
+	bool commitProductResult(std::vector<ClassificationResult> vTotalResult, const bool needCalculateResult, const int productNumber = -1, const int lensIdx = 0, const long verdictTicket = -1);
+
+	//判定时限: 取像完成后开始计时, 超时未判定时按时发出兜底判定
+	void armVerdictDeadline(const std::chrono::steady_clock::time_point &acquireTime);
 
 protected:
 	virtual bool addToTrackingHistory();
@@ -40,8 +52,15 @@ private:
 	//根据不同剔除模式获取剔除信号
 	int getSignalByPurgeMode(const bool bIsResultOK);
 
-	//设置PLC参数
+	//设置PLC参数, 只写入与上次写入值不同的寄存器; 换产品或写PLC失败(断线、重连后PLC侧的值未知)后全部重新写入
 	void setPlcParameters();
+	std::map<int, int> m_mapPlcRegisters;//<寄存器地址, 上次写入成功的值>
+	std::string m_sPlcRegistersProduct;//m_mapPlcRegisters所属产品
+	long m_plcWriteFailures = 0;//m_mapPlcRegisters写入时已知的PLC写入失败次数
+
+	//生产运行且配置了VERDICT_DEADLINE_MS时创建, 否则为nullptr
+	std::shared_ptr<AppVerdictDeadline> m_pVerdictDeadline;
+	long m_verdictTicket = -1;//当前帧的计时编号
 
 	std::vector<ClassificationResult> m_vTotalResult;
 	int m_purgeMode;//0-正常剔除， 1-全部OK， 2-全部NG, 3-OK-NG交替
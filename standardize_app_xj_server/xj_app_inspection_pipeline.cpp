@@ -0,0 +1,232 @@
+#include "xj_app_inspection_pipeline.h"
+#include "logger.h"
+
+using namespace std;
+
+//每提交多少帧打印一次统计
+#define PIPELINE_STATS_INTERVAL 500
+
+static double elapsedMs(const chrono::steady_clock::time_point &start)
+{
+	return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+AppInspectionPipeline::AppInspectionPipeline(const int boardId, const stPipelineConfig &config) :
+			m_boardId(boardId),
+			m_config(config),
+			m_maxInFlight(std::max(1, config.numWorkers) * 2),
+			m_seq(0),
+			m_bIsStop(false)
+{
+	for(int i = 0; i < std::max(1, m_config.numWorkers); i++)
+	{
+		m_vWorkers.emplace_back(&AppInspectionPipeline::runWorker, this);
+	}
+	m_commitThread = thread(&AppInspectionPipeline::runCommit, this);
+	LogINFO << "Board[" << m_boardId << "] inspection pipeline started, workers = " << m_vWorkers.size() << ", deadline = " << m_config.deadlineMs
+			<< "ms, reject on overload = " << m_config.bIsRejectOnOverload << ", render worker = " << (m_config.pRenderWorker != nullptr);
+}
+
+AppInspectionPipeline::~AppInspectionPipeline()
+{
+	flush();
+	{
+		lock_guard<mutex> lock(m_mutex);
+		m_bIsStop = true;
+	}
+	m_condWorker.notify_all();
+	m_condCommit.notify_all();
+	for(auto &worker : m_vWorkers)
+	{
+		worker.join();
+	}
+	m_commitThread.join();
+
+	logStats("stopped");
+}
+
+bool AppInspectionPipeline::submit(const function<void()> &inspect, const function<void()> &commit, const function<void()> &render)
+{
+	shared_ptr<stFrame> pFrame = make_shared<stFrame>();
+	pFrame->inspect = inspect;
+	pFrame->commit = commit;
+	pFrame->render = render;
+
+	//过载拒绝时在途帧最多为正常上限的两倍, 再多时同样阻塞, 避免判定阶段过慢时无限堆积
+	const int maxQueued = m_config.bIsRejectOnOverload ? m_maxInFlight * 2 : m_maxInFlight;
+	unique_lock<mutex> lock(m_mutex);
+	m_condSubmit.wait(lock, [this, maxQueued](){ return (int)m_dqInFlight.size() < maxQueued; });
+	const bool bIsRejected = (int)m_dqInFlight.size() >= m_maxInFlight;
+	pFrame->seq = m_seq++;
+	pFrame->submitTime = chrono::steady_clock::now();
+	if(bIsRejected)
+	{
+		pFrame->bIsDone = true;
+		pFrame->doneTime = pFrame->submitTime;
+		m_stats.numRejected++;
+	}
+	else
+	{
+		m_dqJobs.emplace_back(pFrame);
+	}
+	m_dqInFlight.emplace_back(pFrame);
+	m_stats.maxInFlight = std::max(m_stats.maxInFlight, (int)m_dqInFlight.size());
+	const long numRejected = m_stats.numRejected;
+	lock.unlock();
+
+	if(bIsRejected)
+	{
+		LogWARNING << "extern: Board[" << m_boardId << "] pipeline overloaded, frame " << pFrame->seq << " rejected without inspection, rejected total = " << numRejected;
+		m_condCommit.notify_one();
+		return false;
+	}
+	m_condWorker.notify_one();
+	return true;
+}
+
+void AppInspectionPipeline::flush()
+{
+	unique_lock<mutex> lock(m_mutex);
+	m_condSubmit.wait(lock, [this](){ return m_dqInFlight.empty(); });
+}
+
+stPipelineStats AppInspectionPipeline::getStats()
+{
+	stPipelineStats stats;
+	{
+		lock_guard<mutex> lock(m_mutex);
+		stats = m_stats;
+	}
+	if(m_config.pRenderWorker != nullptr)
+	{
+		stats.render = m_config.pRenderWorker->getStats();
+		stats.renderQueue = m_config.pRenderWorker->getQueueStats();
+	}
+	return stats;
+}
+
+void AppInspectionPipeline::logStats(const string &sTitle)
+{
+	const stPipelineStats stats = getStats();
+	LogINFO << "Board[" << m_boardId << "] inspection pipeline " << sTitle << ", committed = " << stats.numCommitted << ", missed deadline = " << stats.numMissedDeadline
+			<< ", rejected = " << stats.numRejected << ", max latency = " << stats.maxLatencyMs << "ms, max reorder wait = " << stats.maxReorderWaitMs << "ms, max in flight = " << stats.maxInFlight;
+	LogINFO << "Board[" << m_boardId << "] inspection pipeline stages avg/max ms: inspect " << stats.inspect.avgMs() << "/" << stats.inspect.maxMs
+			<< ", commit " << stats.commit.avgMs() << "/" << stats.commit.maxMs << ", render " << stats.render.avgMs() << "/" << stats.render.maxMs
+			<< "; render queue depth = " << stats.renderQueue.depth << ", max depth = " << stats.renderQueue.maxDepth << ", dropped = " << stats.renderQueue.numDropped
+			<< ", max block = " << stats.renderQueue.maxBlockMs << "ms";
+}
+
+void AppInspectionPipeline::runWorker()
+{
+	while(true)
+	{
+		shared_ptr<stFrame> pFrame;
+		{
+			unique_lock<mutex> lock(m_mutex);
+			m_condWorker.wait(lock, [this](){ return m_bIsStop || !m_dqJobs.empty(); });
+			if(m_dqJobs.empty())
+			{
+				return;
+			}
+			pFrame = m_dqJobs.front();
+			m_dqJobs.pop_front();
+		}
+
+		const auto start = chrono::steady_clock::now();
+		try
+		{
+			pFrame->inspect();
+		}
+		catch (const exception &e)
+		{
+			LogERROR << "extern: Board[" << m_boardId << "] pipeline frame " << pFrame->seq << " inspection failed: " << e.what();
+		}
+		const double inspectMs = elapsedMs(start);
+
+		{
+			lock_guard<mutex> lock(m_mutex);
+			pFrame->bIsDone = true;
+			pFrame->doneTime = chrono::steady_clock::now();
+			m_stats.inspect.add(inspectMs);
+		}
+		m_condCommit.notify_one();
+	}
+}
+
+void AppInspectionPipeline::runCommit()
+{
+	while(true)
+	{
+		shared_ptr<stFrame> pFrame;
+		{
+			unique_lock<mutex> lock(m_mutex);
+			m_condCommit.wait(lock, [this](){ return (m_bIsStop && m_dqInFlight.empty()) || (!m_dqInFlight.empty() && m_dqInFlight.front()->bIsDone); });
+			if(m_dqInFlight.empty())
+			{
+				return;
+			}
+			pFrame = m_dqInFlight.front();
+		}
+
+		//后面的帧先完成时在这里等待, 保证结果按产品顺序给出
+		const auto commitTime = chrono::steady_clock::now();
+		const double latencyMs = chrono::duration<double, milli>(commitTime - pFrame->submitTime).count();
+		const double reorderWaitMs = chrono::duration<double, milli>(commitTime - pFrame->doneTime).count();
+		try
+		{
+			pFrame->commit();
+		}
+		catch (const exception &e)
+		{
+			LogERROR << "extern: Board[" << m_boardId << "] pipeline frame " << pFrame->seq << " commit failed: " << e.what();
+		}
+		const double commitMs = elapsedMs(commitTime);
+
+		//判定完成即释放在途名额, 渲染在队列中排队或在本线程执行
+		bool bIsPrintStats = false;
+		{
+			lock_guard<mutex> lock(m_mutex);
+			m_dqInFlight.pop_front();
+			m_stats.numCommitted++;
+			m_stats.commit.add(commitMs);
+			m_stats.maxLatencyMs = std::max(m_stats.maxLatencyMs, latencyMs);
+			m_stats.maxReorderWaitMs = std::max(m_stats.maxReorderWaitMs, reorderWaitMs);
+			if(m_config.deadlineMs > 0 && latencyMs > m_config.deadlineMs)
+			{
+				m_stats.numMissedDeadline++;
+				LogWARNING << "extern: Board[" << m_boardId << "] pipeline frame " << pFrame->seq << " missed deadline " << m_config.deadlineMs << "ms, latency = " << latencyMs
+						   << "ms, reorder wait = " << reorderWaitMs << "ms, missed total = " << m_stats.numMissedDeadline;
+			}
+			bIsPrintStats = (m_stats.numCommitted % PIPELINE_STATS_INTERVAL == 0);
+		}
+		m_condSubmit.notify_all();
+
+		if(pFrame->render)
+		{
+			if(m_config.pRenderWorker != nullptr)
+			{
+				m_config.pRenderWorker->submit(std::move(pFrame->render));
+			}
+			else
+			{
+				const auto start = chrono::steady_clock::now();
+				try
+				{
+					pFrame->render();
+				}
+				catch (const exception &e)
+				{
+					LogERROR << "extern: Board[" << m_boardId << "] pipeline frame " << pFrame->seq << " render failed: " << e.what();
+				}
+				const double renderMs = elapsedMs(start);
+				lock_guard<mutex> lock(m_mutex);
+				m_stats.render.add(renderMs);
+			}
+		}
+
+		if(bIsPrintStats)
+		{
+			logStats("running");
+		}
+	}
+}
@@ -0,0 +1,104 @@
+#ifndef XJ_APP_INSPECTION_PIPELINE_H
+#define XJ_APP_INSPECTION_PIPELINE_H
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <functional>
+#include <condition_variable>
+#include "xj_app_render_worker.h"
+
+//流水线配置, 按工位读取DETECTOR_PIPELINE_*
+struct stPipelineConfig
+{
+	int numWorkers = 1;
+	double deadlineMs = 0;                          //给出结果晚于提交后此时间的帧计为超时, 0表示不统计
+	bool bIsRejectOnOverload = false;               //在途帧满时: false-阻塞取像, true-本帧不检测, 按顺序给出NG
+	std::shared_ptr<AppRenderWorker> pRenderWorker; //工位的渲染存图线程, nullptr表示在提交线程中直接渲染
+};
+
+//流水线统计
+struct stPipelineStats
+{
+	long numCommitted = 0;
+	long numMissedDeadline = 0;		//给出结果时已超过截止时间的帧数
+	long numRejected = 0;			//过载时未检测直接判NG的帧数
+	double maxLatencyMs = 0;		//从提交检测到给出结果的最长时间
+	double maxReorderWaitMs = 0;	//检测完成后等待前面帧给出结果的最长时间
+	int maxInFlight = 0;			//在途帧数峰值
+	stStageStats inspect;			//检测阶段
+	stStageStats commit;			//判定、发信号阶段
+	stStageStats render;			//绘制、存图、UI显示阶段
+	stStageQueueStats renderQueue;	//判定到渲染之间的队列
+};
+
+/*==================================================================================================
+    乱序检测、顺序提交: 连续帧分发给多个检测线程并发执行, 判定结果严格按提交顺序给出;
+    绘制存图可交给工位的渲染存图线程, 由有界队列与判定阶段相连, 不占用发信号的时间
+===================================================================================================*/
+class AppInspectionPipeline
+{
+public:
+	/**
+	 * @brief start inspection workers and the commit thread of one board
+	 * @param boardId <input> board id, used for logging
+	 * @param config <input> workers, deadline, overload and render worker settings
+	 */
+	AppInspectionPipeline(const int boardId, const stPipelineConfig &config);
+	//等待所有在途帧给出结果后退出, 渲染任务已交给渲染线程
+	~AppInspectionPipeline();
+
+	/**
+	 * @brief submit one frame. while in-flight frames reach twice the number of workers the call blocks,
+	 *        or with reject-on-overload the frame skips inspection and only commit/render run, still in order.
+	 * @param inspect <input> run on an inspection worker, frames may finish out of order
+	 * @param commit <input> run on the commit thread strictly in submission order, after inspect finished
+	 * @param render <input> run after commit in submission order, on the render worker if configured; may be empty
+	 * @return false if the frame was rejected and inspect will not run
+	 */
+	bool submit(const std::function<void()> &inspect, const std::function<void()> &commit, const std::function<void()> &render);
+
+	//等待所有在途帧给出结果
+	void flush();
+
+	stPipelineStats getStats();
+
+private:
+	struct stFrame
+	{
+		long seq = 0;
+		std::function<void()> inspect;
+		std::function<void()> commit;
+		std::function<void()> render;
+		bool bIsDone = false;
+		std::chrono::steady_clock::time_point submitTime;
+		std::chrono::steady_clock::time_point doneTime;
+	};
+
+	void runWorker();
+	void runCommit();
+	void logStats(const std::string &sTitle);
+
+	int m_boardId;
+	stPipelineConfig m_config;
+	int m_maxInFlight;
+	long m_seq;
+
+	std::mutex m_mutex;
+	std::condition_variable m_condWorker;	//有待检测帧
+	std::condition_variable m_condCommit;	//最早一帧检测完成
+	std::condition_variable m_condSubmit;	//在途帧减少
+	std::deque<std::shared_ptr<stFrame>> m_dqJobs;		//待检测帧
+	std::deque<std::shared_ptr<stFrame>> m_dqInFlight;	//已提交未给出结果的帧, 按提交顺序
+	stPipelineStats m_stats;
+	bool m_bIsStop;
+
+	std::vector<std::thread> m_vWorkers;
+	std::thread m_commitThread;
+};
+
+#endif // XJ_APP_INSPECTION_PIPELINE_H
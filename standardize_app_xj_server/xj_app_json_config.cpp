@@ -1,9 +1,90 @@
 #include <mutex>
+#include <chrono>
+#include <cstdio>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#include <libgen.h>
+#endif
 #include "xj_app_json_config.h"
 
 AppJsonConfig* AppJsonConfig::m_instance = nullptr;
 std::mutex AppJsonConfig::m_mutex;
 
+//文件修改时间(纳秒)和大小, 文件不存在时返回false
+static bool getFileStat(const std::string &path, long long &mtimeNs, long long &size)
+{
+	struct stat st;
+	if (stat(path.c_str(), &st) != 0)
+	{
+		return false;
+	}
+#ifdef __linux__
+	mtimeNs = (long long)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+#else
+	mtimeNs = (long long)st.st_mtime * 1000000000LL;
+#endif
+	size = (long long)st.st_size;
+	return true;
+}
+
+//先写临时文件并落盘, 再重命名替换原文件
+static bool writeFileAtomic(const std::string &path, const std::string &content)
+{
+	const std::string tmpPath = path + ".tmp";
+#ifdef __linux__
+	const int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+	{
+		return false;
+	}
+	size_t written = 0;
+	while (written < content.size())
+	{
+		const ssize_t n = write(fd, content.data() + written, content.size() - written);
+		if (n <= 0)
+		{
+			close(fd);
+			unlink(tmpPath.c_str());
+			return false;
+		}
+		written += n;
+	}
+	if (fsync(fd) != 0 || close(fd) != 0 || rename(tmpPath.c_str(), path.c_str()) != 0)
+	{
+		unlink(tmpPath.c_str());
+		return false;
+	}
+	//目录项落盘, 重命名在掉电后仍然有效
+	std::string dir = path;
+	const int dirFd = open(dirname(&dir[0]), O_RDONLY);
+	if (dirFd >= 0)
+	{
+		fsync(dirFd);
+		close(dirFd);
+	}
+	return true;
+#else
+	{
+		std::ofstream ofs(tmpPath, std::ios_base::out | std::ios_base::binary);
+		ofs << content;
+		ofs.flush();
+		if (!ofs)
+		{
+			return false;
+		}
+	}
+	std::remove(path.c_str());
+	return std::rename(tmpPath.c_str(), path.c_str()) == 0;
+#endif
+}
+
+static long long getSteadyMs()
+{
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 AppJsonConfig &AppJsonConfig::instance()
 {
     std::unique_lock<std::mutex> lock(m_mutex);
@@ -14,7 +95,8 @@ AppJsonConfig &AppJsonConfig::instance()
     return *m_instance;
 }
 
-AppJsonConfig::AppJsonConfig():m_sJsonPath(""), m_bIsLoaded(false)
+AppJsonConfig::AppJsonConfig():m_pRoot(std::make_shared<const boost::property_tree::ptree>()), m_sJsonPath(""), m_bIsLoaded(false),
+	m_checkIntervalMs(1000), m_nextCheckMs(0), m_fileMtimeNs(-1), m_fileSize(-1)
 {
 
 }
@@ -29,7 +111,30 @@ AppJsonConfig::~AppJsonConfig()
     }
 }
 
-void AppJsonConfig::loadJson()
+void AppJsonConfig::setJsonPath(const std::string &path)
+{
+	std::unique_lock<std::mutex> lock(m_writeMutex);
+	m_sJsonPath = path;
+	//路径变化后下次读取时重新加载
+	m_fileMtimeNs = -1;
+	m_fileSize = -1;
+	m_bIsLoaded = false;
+}
+
+std::shared_ptr<const boost::property_tree::ptree> AppJsonConfig::getRoot()
+{
+	//未加载时每次都尝试加载; 已加载时每个检查间隔只有一个线程检查文件, 其余线程直接读取当前树
+	long long nextCheckMs = m_nextCheckMs.load();
+	const long long nowMs = getSteadyMs();
+	if (!m_bIsLoaded || (nowMs >= nextCheckMs && m_nextCheckMs.compare_exchange_strong(nextCheckMs, nowMs + m_checkIntervalMs.load())))
+	{
+		std::unique_lock<std::mutex> lock(m_writeMutex);
+		reloadIfChanged();
+	}
+	return std::atomic_load(&m_pRoot);
+}
+
+void AppJsonConfig::reloadIfChanged()
 {	
 	try
 	{
@@ -38,16 +143,35 @@ void AppJsonConfig::loadJson()
 			LogERROR << "The path name of the json file is empty!";
 			return;
 		}
+		long long mtimeNs = 0;
+		long long size = 0;
+		if (!getFileStat(m_sJsonPath, mtimeNs, size))
+		{
+			LogERROR << "Failed to open file with path name: " << m_sJsonPath <<  ", please check if the file exists!";
+			return;
+		}
+		if (m_bIsLoaded && mtimeNs == m_fileMtimeNs && size == m_fileSize)
+		{
+			return;
+		}
+
 		std::ifstream file(m_sJsonPath, std::ios_base::in);
 		if (!file.is_open())
 		{
 			LogERROR << "Failed to open file with path name: " << m_sJsonPath <<  ", please check if the file exists!";
 			return;
 		}
-		std::unique_lock<std::mutex> lock(m_mutex);
-		read_json(file, m_root); // 将json文件读入根节点
+		std::shared_ptr<boost::property_tree::ptree> pRoot = std::make_shared<boost::property_tree::ptree>();
+		read_json(file, *pRoot); // 将json文件读入根节点
 		file.close();
-		
+
+		std::atomic_store(&m_pRoot, std::shared_ptr<const boost::property_tree::ptree>(pRoot));
+		m_fileMtimeNs = mtimeNs;
+		m_fileSize = size;
+		if (m_bIsLoaded)
+		{
+			LogINFO << "json file " << m_sJsonPath << " changed, reloaded";
+		}
 		m_bIsLoaded = true;
 	}
 	catch (boost::property_tree::ptree_bad_path const &e)
@@ -63,7 +187,26 @@ void AppJsonConfig::loadJson()
 }
 
 
-void AppJsonConfig::saveJson()
+void AppJsonConfig::commit(const Transaction &transaction)
+{
+	if (transaction.empty())
+	{
+		return;
+	}
+
+	//写操作串行执行: 复制当前树修改后写盘, 再替换内存中的树, 读取方不受影响
+	std::unique_lock<std::mutex> lock(m_writeMutex);
+	reloadIfChanged();
+	std::shared_ptr<boost::property_tree::ptree> pRoot = std::make_shared<boost::property_tree::ptree>(*std::atomic_load(&m_pRoot));
+	for (const auto &nodeName : transaction.m_vNodeNames)
+	{
+		pRoot->put(nodeName, transaction.m_staged.get<std::string>(nodeName));
+	}
+	saveJson(pRoot);
+	LogDEBUG << "commit " << transaction.m_vNodeNames.size() << " changes to " << m_sJsonPath;
+}
+
+void AppJsonConfig::saveJson(const std::shared_ptr<boost::property_tree::ptree> &pRoot)
 {
 	try
 	{
@@ -73,10 +216,20 @@ void AppJsonConfig::saveJson()
 			return;
 		}
 		
-		std::unique_lock<std::mutex> lock(m_mutex);
-		std::ofstream ofs(m_sJsonPath, std::ios_base::out);
-		write_json(ofs, m_root);
-		ofs.close();
+		std::stringstream ss;
+		write_json(ss, *pRoot);
+		if (!writeFileAtomic(m_sJsonPath, ss.str()))
+		{
+			LogERROR << "Failed to write file with path name: " << m_sJsonPath << ", file is not changed";
+			throw std::runtime_error("write " + m_sJsonPath + " failed");
+		}
+
+		//写盘后的文件状态作为已加载状态, 自身写入不触发重新解析
+		std::atomic_store(&m_pRoot, std::shared_ptr<const boost::property_tree::ptree>(pRoot));
+		if (getFileStat(m_sJsonPath, m_fileMtimeNs, m_fileSize))
+		{
+			m_bIsLoaded = true;
+		}
 	}
 	catch (boost::property_tree::ptree_bad_path const &e)
 	{
@@ -6,12 +6,43 @@
 
 #include <vector>
 #include <sstream>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
 
 #include "logger.h"
 
+/*==================================================================================================
+    参数json配置: 解析后的树常驻内存, 读取方共享只读树, 不加锁;
+    文件按间隔检查修改时间和大小, 只有文件变化时才重新解析
+===================================================================================================*/
 class AppJsonConfig
 {
 public:
+	/*
+		暂存一组修改, commit时一次写盘: 先写临时文件并fsync, 再原子替换原文件, 掉电时文件为修改前或修改后的完整内容
+		AppJsonConfig::Transaction transaction;
+		transaction.set<float>("cameraParams-0.exposure", 500);
+		AppJsonConfig::instance().commit(transaction);
+	*/
+	class Transaction
+	{
+	public:
+		template <typename T>
+		void set(const std::string &nodeName, const T &value)
+		{
+			m_staged.put(nodeName, value);
+			m_vNodeNames.emplace_back(nodeName);
+		};
+		bool empty() const { return m_vNodeNames.empty(); };
+
+	private:
+		friend class AppJsonConfig;
+		boost::property_tree::ptree m_staged;
+		std::vector<std::string> m_vNodeNames;      //修改顺序, 同一节点以最后一次为准
+	};
+
 	static AppJsonConfig &instance();
 
 	template <typename T>
@@ -20,8 +51,7 @@ public:
 		// you need to try ... catch (const std::exception &e), if anything is wrong
 		try
 		{
-			loadJson();
-			return m_root.get<T>(nodeName);
+			return getRoot()->get<T>(nodeName);
 		}
 		catch (boost::property_tree::ptree_bad_path const &e)
 		{
@@ -43,8 +73,8 @@ public:
 		{
 			std::vector<T> value{};
 
-			loadJson();
-			for (const auto &itr : m_root.get_child(nodeName))
+			const std::shared_ptr<const boost::property_tree::ptree> pRoot = getRoot();
+			for (const auto &itr : pRoot->get_child(nodeName))
 			{
 				value.emplace_back(itr.second.get_value<T>());
 			}
@@ -68,9 +98,10 @@ public:
 		// you need to try ... catch (const std::exception &e), if anything is wrong
 		try
 		{
-			loadJson();
-			m_root.put(nodeName, value);
-			saveJson();
+			// a single change is a transaction of one key, several changes should be committed together
+			Transaction transaction;
+			transaction.set<T>(nodeName, value);
+			commit(transaction);
 		}
 		catch (boost::property_tree::ptree_bad_path const &e)
 		{
@@ -84,22 +115,39 @@ public:
 		}
 	};
 
+	/**
+	 * @brief apply all staged changes to the file with one atomic write, readers see either none or all of them
+	 * @param transaction <input> staged changes, nothing is written if it is empty
+	 */
+	void commit(const Transaction &transaction);
+
 	// This method is used to load json configuration from use defined file path
-	void setJsonPath(const std::string &path) { m_sJsonPath = path; };
+	void setJsonPath(const std::string &path);
 	std::string setJsonPath(const std::string &path) const { return m_sJsonPath; };
 
+	// interval in milliseconds to check whether the file is modified, 0 means checking on every call
+	void setCheckInterval(const int intervalMs) { m_checkIntervalMs = std::max(0, intervalMs); };
+
 private:
 	AppJsonConfig();
 	virtual ~AppJsonConfig();
-	void loadJson();
-	void saveJson();
+	//当前树, 检查间隔到期时先检查文件是否变化
+	std::shared_ptr<const boost::property_tree::ptree> getRoot();
+	//文件修改时间和大小与已加载的一致时不重新解析, 调用方需持有m_writeMutex
+	void reloadIfChanged();
+	void saveJson(const std::shared_ptr<boost::property_tree::ptree> &pRoot);
 
 	static std::mutex m_mutex;
 	static AppJsonConfig *m_instance;
-	boost::property_tree::ptree m_root;
+	std::shared_ptr<const boost::property_tree::ptree> m_pRoot;    //只通过std::atomic_load/atomic_store访问
 
+	std::mutex m_writeMutex;            //加载、写盘串行执行
 	std::string m_sJsonPath;
-	bool m_bIsLoaded;
+	std::atomic<bool> m_bIsLoaded;
+	std::atomic<int> m_checkIntervalMs;
+	std::atomic<long long> m_nextCheckMs;   //下次检查文件的时间(steady clock, 毫秒)
+	long long m_fileMtimeNs;            //已加载文件的修改时间和大小
+	long long m_fileSize;
 };
 
 #endif
@@ -0,0 +1,201 @@
+#include "xj_app_load_governor.h"
+#include "customized_json_config.h"
+#include "running_status.h"
+#include "logger.h"
+#include <limits>
+#include <algorithm>
+
+using namespace std;
+
+static const char *getLoadLevelName(const int level)
+{
+	static const char *vNames[(int)LoadLevel::NUM] = {"normal", "reduce-ok-saves", "low-res-render", "no-process-images", "defer-db-writes"};
+	return (level >= 0 && level < (int)LoadLevel::NUM) ? vNames[level] : "unknown";
+}
+
+AppLoadGovernor &AppLoadGovernor::instance()
+{
+	static AppLoadGovernor governor;
+	return governor;
+}
+
+void AppLoadGovernor::reset(const int boardId, const int parallelism)
+{
+	stLoadGovernorConfig config;
+	try
+	{
+		config.bIsEnable = CustomizedJsonConfig::instance().get<bool>("LOAD_GOVERNOR_ENABLE");
+		config.maxLevel = std::min(std::max(0, CustomizedJsonConfig::instance().get<int>("LOAD_GOVERNOR_MAX_LEVEL")), (int)LoadLevel::NUM - 1);
+		config.vSlackThresholds = CustomizedJsonConfig::instance().getVector<double>("LOAD_GOVERNOR_SLACK_THRESHOLDS");
+		config.vQueueThresholds = CustomizedJsonConfig::instance().getVector<double>("LOAD_GOVERNOR_SAVE_QUEUE_THRESHOLDS");
+		config.hysteresis = CustomizedJsonConfig::instance().get<double>("LOAD_GOVERNOR_HYSTERESIS");
+		config.recoverFrames = std::max(1, CustomizedJsonConfig::instance().get<int>("LOAD_GOVERNOR_RECOVER_FRAMES"));
+		config.ewmaAlpha = std::min(std::max(0.01, CustomizedJsonConfig::instance().get<double>("LOAD_GOVERNOR_EWMA_ALPHA")), 1.0);
+		config.okSaveInterval = std::max(1, CustomizedJsonConfig::instance().get<int>("LOAD_GOVERNOR_OK_SAVE_INTERVAL"));
+		config.renderScale = std::min(std::max(0.1, CustomizedJsonConfig::instance().get<double>("LOAD_GOVERNOR_RENDER_SCALE")), 1.0);
+	}
+	catch (const exception &e)
+	{
+		LogERROR << "json config: LOAD_GOVERNOR_*, load governor disabled: " << e.what();
+		config = stLoadGovernorConfig();
+	}
+	reset(boardId, parallelism, config);
+}
+
+void AppLoadGovernor::reset(const int boardId, const int parallelism, const stLoadGovernorConfig &config)
+{
+	lock_guard<mutex> lock(m_mutex);
+	m_config = config;
+	stBoardState &state = m_mapBoards[boardId];
+	state = stBoardState();
+	state.parallelism = std::max(1, parallelism);
+	state.report.boardId = boardId;
+	state.report.sLevelName = getLoadLevelName(0);
+	RunningInfo::instance().GetRunningData().setCustomerDataByName("load-" + to_string(boardId), state.report.sLevelName);
+	LogINFO << "Board[" << boardId << "] load governor " << (m_config.bIsEnable ? "enabled" : "disabled") << ", max level = " << m_config.maxLevel << ", parallelism = " << state.parallelism;
+}
+
+void AppLoadGovernor::addInspection(const int boardId, const double inspectMs)
+{
+	lock_guard<mutex> lock(m_mutex);
+	auto itr = m_mapBoards.find(boardId);
+	if(itr == m_mapBoards.end())
+	{
+		return;
+	}
+	double &ewma = itr->second.report.inspectMs;
+	ewma = (ewma <= 0) ? inspectMs : m_config.ewmaAlpha * inspectMs + (1 - m_config.ewmaAlpha) * ewma;
+}
+
+LoadLevel AppLoadGovernor::update(const int boardId, const double queueFill)
+{
+	lock_guard<mutex> lock(m_mutex);
+	auto itr = m_mapBoards.find(boardId);
+	if(itr == m_mapBoards.end())
+	{
+		return LoadLevel::NORMAL;
+	}
+	stBoardState &state = itr->second;
+	stLoadGovernorReport &report = state.report;
+
+	const auto now = chrono::steady_clock::now();
+	if(!state.bIsFirstFrame)
+	{
+		const double cycleMs = chrono::duration<double, milli>(now - state.lastFrameTime).count();
+		report.cycleMs = (report.cycleMs <= 0) ? cycleMs : m_config.ewmaAlpha * cycleMs + (1 - m_config.ewmaAlpha) * report.cycleMs;
+	}
+	state.bIsFirstFrame = false;
+	state.lastFrameTime = now;
+	report.queueFill = queueFill;
+	report.slack = (report.cycleMs > 0 && report.inspectMs > 0) ? 1 - report.inspectMs / (report.cycleMs * state.parallelism) : 1;
+	if(!m_config.bIsEnable)
+	{
+		return LoadLevel::NORMAL;
+	}
+
+	//第i级阈值没有配置时该条件不触发
+	auto getSlackThreshold = [this](const int idx)
+	{
+		return idx < (int)m_config.vSlackThresholds.size() ? m_config.vSlackThresholds[idx] : -numeric_limits<double>::max();
+	};
+	auto getQueueThreshold = [this](const int idx)
+	{
+		return idx < (int)m_config.vQueueThresholds.size() ? m_config.vQueueThresholds[idx] : numeric_limits<double>::max();
+	};
+	int targetLevel = 0;
+	for(int idx = 0; idx < m_config.maxLevel; idx++)
+	{
+		if(report.slack < getSlackThreshold(idx) || queueFill > getQueueThreshold(idx))
+		{
+			targetLevel = idx + 1;
+		}
+	}
+
+	//降级立即执行, 每帧一级; 恢复需连续recoverFrames帧越过当前级别阈值加滞回
+	if(targetLevel > report.level)
+	{
+		setLevel(state, report.level + 1);
+	}
+	else if(targetLevel < report.level)
+	{
+		const int idx = report.level - 1;
+		const bool bIsRecovered = report.slack >= getSlackThreshold(idx) + m_config.hysteresis && queueFill <= getQueueThreshold(idx) - m_config.hysteresis;
+		state.recoverCount = bIsRecovered ? state.recoverCount + 1 : 0;
+		if(state.recoverCount >= m_config.recoverFrames)
+		{
+			setLevel(state, report.level - 1);
+		}
+	}
+	else
+	{
+		state.recoverCount = 0;
+	}
+	if(report.level > 0)
+	{
+		report.numDegradedFrames++;
+	}
+	return (LoadLevel)report.level;
+}
+
+void AppLoadGovernor::setLevel(stBoardState &state, const int level)
+{
+	stLoadGovernorReport &report = state.report;
+	const int oldLevel = report.level;
+	report.level = level;
+	report.sLevelName = getLoadLevelName(level);
+	report.numTransitions++;
+	state.recoverCount = 0;
+	RunningInfo::instance().GetRunningData().setCustomerDataByName("load-" + to_string(report.boardId), report.sLevelName);
+	if(level > oldLevel)
+	{
+		LogWARNING << "extern: Board[" << report.boardId << "] load level " << getLoadLevelName(oldLevel) << " -> " << report.sLevelName << ", slack = " << report.slack
+				   << ", cycle = " << report.cycleMs << "ms, inspect = " << report.inspectMs << "ms, save queue = " << report.queueFill;
+	}
+	else
+	{
+		LogINFO << "extern: Board[" << report.boardId << "] load level " << getLoadLevelName(oldLevel) << " -> " << report.sLevelName << ", slack = " << report.slack
+				<< ", cycle = " << report.cycleMs << "ms, inspect = " << report.inspectMs << "ms, save queue = " << report.queueFill << ", degraded frames = " << report.numDegradedFrames;
+	}
+}
+
+LoadLevel AppLoadGovernor::level(const int boardId)
+{
+	lock_guard<mutex> lock(m_mutex);
+	auto itr = m_mapBoards.find(boardId);
+	return (itr == m_mapBoards.end()) ? LoadLevel::NORMAL : (LoadLevel)itr->second.report.level;
+}
+
+bool AppLoadGovernor::shouldSaveOK(const int boardId)
+{
+	lock_guard<mutex> lock(m_mutex);
+	auto itr = m_mapBoards.find(boardId);
+	if(itr == m_mapBoards.end() || itr->second.report.level < (int)LoadLevel::REDUCE_OK_SAVES)
+	{
+		return true;
+	}
+	stBoardState &state = itr->second;
+	if(state.okSaveCount++ % m_config.okSaveInterval == 0)
+	{
+		return true;
+	}
+	state.report.numSkippedOKSaves++;
+	return false;
+}
+
+double AppLoadGovernor::getRenderScale(const int boardId)
+{
+	lock_guard<mutex> lock(m_mutex);
+	auto itr = m_mapBoards.find(boardId);
+	return (itr != m_mapBoards.end() && itr->second.report.level >= (int)LoadLevel::LOW_RES_RENDER) ? m_config.renderScale : 1.0;
+}
+
+vector<stLoadGovernorReport> AppLoadGovernor::getReports()
+{
+	vector<stLoadGovernorReport> vReports;
+	lock_guard<mutex> lock(m_mutex);
+	for(const auto &itr : m_mapBoards)
+	{
+		vReports.emplace_back(itr.second.report);
+	}
+	return vReports;
+}
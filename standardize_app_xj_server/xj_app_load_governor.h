@@ -0,0 +1,112 @@
+#ifndef XJ_APP_LOAD_GOVERNOR_H
+#define XJ_APP_LOAD_GOVERNOR_H
+
+#include <map>
+#include <mutex>
+#include <chrono>
+#include <string>
+#include <vector>
+
+//降级级别, 高级别包含低级别的全部降级
+enum class LoadLevel : int
+{
+	NORMAL = 0,
+	REDUCE_OK_SAVES = 1,    //OK原图、结果图按间隔保存
+	LOW_RES_RENDER = 2,     //结果图按更低分辨率绘制、保存
+	NO_PROCESS_IMAGES = 3,  //不保存算法过程小图
+	DEFER_DB_WRITES = 4,    //瑕疵、MES记录延后到后台写入数据库
+	NUM = 5
+};
+
+//负载调节配置, 各工位相同
+struct stLoadGovernorConfig
+{
+	bool bIsEnable = false;                 //LOAD_GOVERNOR_ENABLE
+	int maxLevel = 0;                       //LOAD_GOVERNOR_MAX_LEVEL
+	std::vector<double> vSlackThresholds;   //LOAD_GOVERNOR_SLACK_THRESHOLDS, 第i项为进入第i+1级的余量下限
+	std::vector<double> vQueueThresholds;   //LOAD_GOVERNOR_SAVE_QUEUE_THRESHOLDS, 第i项为进入第i+1级的存图队列占用上限
+	double hysteresis = 0.05;               //LOAD_GOVERNOR_HYSTERESIS, 恢复时需超过阈值的幅度
+	int recoverFrames = 50;                 //LOAD_GOVERNOR_RECOVER_FRAMES, 连续多少帧满足条件后恢复一级
+	double ewmaAlpha = 0.1;                 //LOAD_GOVERNOR_EWMA_ALPHA
+	int okSaveInterval = 10;                //LOAD_GOVERNOR_OK_SAVE_INTERVAL, 降级时每多少张OK图保存一张
+	double renderScale = 0.5;               //LOAD_GOVERNOR_RENDER_SCALE, 降级时结果图的绘制比例
+};
+
+//单个工位的负载状态, 用于web查询
+struct stLoadGovernorReport
+{
+	int boardId = 0;
+	int level = 0;
+	std::string sLevelName;
+	double cycleMs = 0;         //取像周期EWMA
+	double inspectMs = 0;       //检测耗时EWMA
+	double slack = 1;           //1 - 检测耗时 / (取像周期 * 并行检测数)
+	double queueFill = 0;       //存图队列占用比例
+	long numTransitions = 0;
+	long numDegradedFrames = 0; //处于降级状态的帧数
+	long numSkippedOKSaves = 0;
+};
+
+/*==================================================================================================
+    负载调节: 按各工位的时间余量(取像周期与检测耗时EWMA之比)和存图队列占用, 在必需的判定流程之外
+    逐级关闭可选工作(OK存图、结果图分辨率、过程小图、数据库写入); 余量恢复后逐级恢复.
+    每次级别变化打印日志, 并通过运行数据"load-工位"和/load_governor导出
+===================================================================================================*/
+class AppLoadGovernor
+{
+public:
+	static AppLoadGovernor &instance();
+
+	/**
+	 * @brief reload the configuration and reset the state of one board, called when detection starts
+	 * @param boardId <input> board id
+	 * @param parallelism <input> number of frames inspected in parallel on the board
+	 */
+	void reset(const int boardId, const int parallelism);
+	//同上, 使用给定的配置, 不读取json配置
+	void reset(const int boardId, const int parallelism, const stLoadGovernorConfig &config);
+
+	//检测完成后调用, 可在多个检测线程
+	void addInspection(const int boardId, const double inspectMs);
+
+	/**
+	 * @brief called by the detector thread once per frame, updates the cycle time and adjusts the level
+	 * @param boardId <input> board id
+	 * @param queueFill <input> fill ratio of the image save queue
+	 * @return level of the board after the update
+	 */
+	LoadLevel update(const int boardId, const double queueFill);
+
+	LoadLevel level(const int boardId);
+	bool isDegraded(const int boardId, const LoadLevel level) { return (int)this->level(boardId) >= (int)level; }
+	//OK图是否保存, REDUCE_OK_SAVES及以上时每okSaveInterval张保存一张
+	bool shouldSaveOK(const int boardId);
+	//结果图绘制比例, LOW_RES_RENDER以下为1
+	double getRenderScale(const int boardId);
+
+	std::vector<stLoadGovernorReport> getReports();
+
+private:
+	AppLoadGovernor() {}
+	~AppLoadGovernor() {}
+	AppLoadGovernor(const AppLoadGovernor &) = delete;
+	AppLoadGovernor &operator=(const AppLoadGovernor &) = delete;
+
+	struct stBoardState
+	{
+		int parallelism = 1;
+		int recoverCount = 0;
+		long okSaveCount = 0;
+		bool bIsFirstFrame = true;
+		std::chrono::steady_clock::time_point lastFrameTime;
+		stLoadGovernorReport report;
+	};
+
+	void setLevel(stBoardState &state, const int level);
+
+	std::mutex m_mutex;
+	stLoadGovernorConfig m_config;
+	std::map<int, stBoardState> m_mapBoards;
+};
+
+#endif // XJ_APP_LOAD_GOVERNOR_H
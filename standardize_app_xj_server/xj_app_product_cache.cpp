@@ -0,0 +1,267 @@
+#include "xj_app_product_cache.h"
+#include "xj_app_json_config.h"
+#include "customized_json_config.h"
+#include "logger.h"
+#include "database.h"
+#include "shared_utils.h"
+#include <boost/property_tree/json_parser.hpp>
+
+using namespace boost::property_tree;
+using namespace std;
+
+//UI参数项在数据库float_settings中的位置, 不记录到数据库时从参数json读取
+struct stParamLayout
+{
+	string sId;
+	int index = -1;
+	bool bIsRecordToDB = true;
+	int address = -1;           //PLC寄存器地址, 相机参数不使用
+};
+
+//UISetting布局在运行期间不变, 只解析一次
+struct stSettingLayouts
+{
+	vector<vector<stParamLayout>> vCameraParams;    //按工位排列
+	vector<stParamLayout> vPlcParams;
+};
+
+static vector<stParamLayout> parseLayout(const string &sNodeName)
+{
+	vector<stParamLayout> vLayout;
+	ptree pt;
+	std::stringstream ss = CustomizedJsonConfig::instance().getJsonStream(sNodeName);
+	read_json(ss, pt);
+	for(const auto &param : pt)
+	{
+		if(!param.second.get_child_optional("index") || !param.second.get_child_optional("id"))
+		{
+			LogERROR << "no complete child node[index, id] in parent node [" << sNodeName << "]";
+			continue;
+		}
+		stParamLayout layout;
+		layout.sId = param.second.get<string>("id");
+		layout.index = (int)param.second.get<float>("index");
+		layout.bIsRecordToDB = param.second.get<bool>("isRecordToDB", true);
+		layout.address = (int)param.second.get<float>("address", -1);
+		vLayout.push_back(layout);
+	}
+	return vLayout;
+}
+
+static const stSettingLayouts &getSettingLayouts()
+{
+	static const stSettingLayouts layouts = []()
+	{
+		stSettingLayouts layouts;
+		const int numBoards = CustomizedJsonConfig::instance().getVector<string>("CAMERA_TYPE").size();
+		for(int boardIdx = 0; boardIdx < numBoards; boardIdx++)
+		{
+			layouts.vCameraParams.push_back(parseLayout("UISetting.setup.cameraParams-" + to_string(boardIdx)));
+		}
+		layouts.vPlcParams = parseLayout("UISetting.setup.plcParams");
+		return layouts;
+	}();
+	return layouts;
+}
+
+AppProductCache &AppProductCache::instance()
+{
+	static AppProductCache cache;
+	return cache;
+}
+
+AppProductCache::AppProductCache() : m_generation(0), m_cameraVersion(0), m_bIsStop(false)
+{
+	m_prefetchThread = thread(&AppProductCache::runPrefetch, this);
+}
+
+AppProductCache::~AppProductCache()
+{
+	{
+		lock_guard<mutex> lock(m_prefetchMutex);
+		m_bIsStop = true;
+	}
+	m_prefetchCondition.notify_all();
+	if(m_prefetchThread.joinable())
+	{
+		m_prefetchThread.join();
+	}
+}
+
+shared_ptr<const stProductSettings> AppProductCache::load(const string &sProd)
+{
+	shared_ptr<stProductSettings> pSettings = make_shared<stProductSettings>();
+	pSettings->sProductName = sProd;
+	pSettings->setting = RunningInfo::instance().GetProductSetting().GetSettings();
+	{
+		Database db;
+		if(db.prod_setting_read(sProd, pSettings->setting))
+		{
+			LogERROR << "Read product " << sProd << " setting in database failed";
+			return nullptr;
+		}
+	}
+	const vector<float> &vValues = pSettings->setting.float_settings;
+	auto getValue = [&vValues, &sProd](const stParamLayout &layout, const string &sJsonPrefix, float &value)
+	{
+		if(!layout.bIsRecordToDB && !sJsonPrefix.empty())
+		{
+			value = AppJsonConfig::instance().get<float>(sJsonPrefix + layout.sId);
+			return true;
+		}
+		if(layout.index < 0 || layout.index >= (int)vValues.size())
+		{
+			LogERROR << "Product " << sProd << " param " << layout.sId << " index:" << layout.index << " is out of range of floot_setting size";
+			return false;
+		}
+		value = vValues[layout.index];
+		return true;
+	};
+
+	const stSettingLayouts &layouts = getSettingLayouts();
+	try
+	{
+		for(size_t boardIdx = 0; boardIdx < layouts.vCameraParams.size(); boardIdx++)
+		{
+			map<string, float> mapCameraParams;
+			for(const auto &layout : layouts.vCameraParams[boardIdx])
+			{
+				float value = 0;
+				if(!getValue(layout, "cameraParams-" + to_string(boardIdx) + ".", value))
+				{
+					return nullptr;
+				}
+				mapCameraParams[layout.sId] = value;
+			}
+			stCameraSettings camera;
+			camera.exposure = int(mapCameraParams["exposure"]);
+			camera.gain = mapCameraParams["gain"];
+			camera.bIsGammaEnable = is_double_equal(mapCameraParams["gammaEnable"], 1., 10e-3);
+			camera.gammaValue = camera.bIsGammaEnable ? mapCameraParams["gammaValue"] : -1;
+			pSettings->vCameras.push_back(camera);
+		}
+
+		for(const auto &layout : layouts.vPlcParams)
+		{
+			float value = 0;
+			if(layout.address < 0 || !getValue(layout, "", value))
+			{
+				continue;
+			}
+			stPlcRegister reg;
+			reg.sId = layout.sId;
+			reg.address = layout.address;
+			reg.value = (int)value;
+			pSettings->vPlcRegisters.push_back(reg);
+		}
+	}
+	catch(const exception &e)
+	{
+		LogERROR << "Parse product " << sProd << " setting failed: " << e.what();
+		return nullptr;
+	}
+	LogINFO << "Product " << sProd << " setting loaded into cache";
+	return pSettings;
+}
+
+shared_ptr<const stProductSettings> AppProductCache::get(const string &sProd)
+{
+	unique_lock<mutex> lock(m_mutex);
+	while(true)
+	{
+		stEntry &entry = m_mapEntries[sProd];
+		if(entry.pSettings != nullptr)
+		{
+			return entry.pSettings;
+		}
+		if(!entry.bIsLoading)
+		{
+			break;
+		}
+		//同一产品正在加载, 等待其结果
+		m_loadedCondition.wait(lock);
+	}
+
+	m_mapEntries[sProd].bIsLoading = true;
+	const long generation = m_mapEntries[sProd].generation;
+	const Loader loader = m_loader;
+	lock.unlock();
+	shared_ptr<const stProductSettings> pSettings = loader ? loader(sProd) : load(sProd);
+	lock.lock();
+
+	stEntry &entry = m_mapEntries[sProd];
+	entry.bIsLoading = false;
+	if(pSettings != nullptr && entry.generation == generation)
+	{
+		entry.pSettings = pSettings;
+	}
+	m_loadedCondition.notify_all();
+	return pSettings;
+}
+
+void AppProductCache::prefetch(const string &sProd)
+{
+	if(sProd.empty())
+	{
+		return;
+	}
+	{
+		lock_guard<mutex> lock(m_prefetchMutex);
+		m_prefetchQueue.push_back(sProd);
+	}
+	m_prefetchCondition.notify_one();
+}
+
+void AppProductCache::invalidate(const string &sProd)
+{
+	lock_guard<mutex> lock(m_mutex);
+	auto itr = m_mapEntries.find(sProd);
+	if(itr != m_mapEntries.end())
+	{
+		itr->second.pSettings = nullptr;
+		itr->second.generation = ++m_generation;
+	}
+}
+
+void AppProductCache::invalidateAll()
+{
+	lock_guard<mutex> lock(m_mutex);
+	for(auto &itr : m_mapEntries)
+	{
+		itr.second.pSettings = nullptr;
+		itr.second.generation = ++m_generation;
+	}
+}
+
+void AppProductCache::setLoader(const Loader &loader)
+{
+	lock_guard<mutex> lock(m_mutex);
+	m_loader = loader;
+	for(auto &itr : m_mapEntries)
+	{
+		itr.second.pSettings = nullptr;
+		itr.second.generation = ++m_generation;
+	}
+}
+
+void AppProductCache::runPrefetch()
+{
+	while(true)
+	{
+		string sProd;
+		{
+			unique_lock<mutex> lock(m_prefetchMutex);
+			m_prefetchCondition.wait(lock, [this]() { return m_bIsStop || !m_prefetchQueue.empty(); });
+			if(m_bIsStop)
+			{
+				return;
+			}
+			sProd = m_prefetchQueue.front();
+			m_prefetchQueue.pop_front();
+		}
+		if(get(sProd) != nullptr)
+		{
+			LogDEBUG << "Product " << sProd << " setting prefetched";
+		}
+	}
+}
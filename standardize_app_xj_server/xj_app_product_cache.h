@@ -0,0 +1,114 @@
+#ifndef XJ_APP_PRODUCT_CACHE_H
+#define XJ_APP_PRODUCT_CACHE_H
+
+#include "running_status.h"
+#include <map>
+#include <deque>
+#include <mutex>
+#include <memory>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <thread>
+#include <functional>
+#include <condition_variable>
+
+//单个工位的相机参数, 已按UISetting.setup.cameraParams-N解析
+struct stCameraSettings
+{
+	int exposure = 0;
+	float gain = 0;
+	bool bIsGammaEnable = false;
+	float gammaValue = -1;      //关闭gamma时为-1
+
+	bool operator==(const stCameraSettings &other) const
+	{
+		return exposure == other.exposure && gain == other.gain && bIsGammaEnable == other.bIsGammaEnable && gammaValue == other.gammaValue;
+	}
+	bool operator!=(const stCameraSettings &other) const
+	{
+		return !(*this == other);
+	}
+};
+
+//PLC寄存器参数, 来自UISetting.setup.plcParams中配置了address的项
+struct stPlcRegister
+{
+	std::string sId;
+	int address = -1;
+	int value = 0;
+};
+
+/*==================================================================================================
+    产品参数快照: 每个产品只读一次数据库, 并解析为相机、PLC等结构化参数, 发布后不再修改;
+    参数写入数据库后需调用invalidate, 下次读取时重新加载
+===================================================================================================*/
+struct stProductSettings
+{
+	std::string sProductName;
+	ProductSetting::PRODUCT_SETTING setting;
+	std::vector<stCameraSettings> vCameras;         //按工位排列
+	std::vector<stPlcRegister> vPlcRegisters;
+};
+
+class AppProductCache
+{
+public:
+	//读取一个产品的参数, 失败时返回nullptr; 在调用get()的线程中执行, 不持有缓存锁
+	typedef std::function<std::shared_ptr<const stProductSettings>(const std::string &)> Loader;
+
+	static AppProductCache &instance();
+
+	/**
+	 * @brief settings of the product, loaded from database on the first call and cached afterwards.
+	 *        concurrent calls for the same product share one database read.
+	 * @param sProd <input> product name
+	 * @return nullptr if the product could not be read
+	 */
+	std::shared_ptr<const stProductSettings> get(const std::string &sProd);
+
+	//后台加载产品参数, 用于换产前预取下一个产品, 已缓存时不重复读取
+	void prefetch(const std::string &sProd);
+
+	//产品参数写入数据库或参数json后调用, 丢弃对应缓存
+	void invalidate(const std::string &sProd);
+	void invalidateAll();
+
+	//替换产品参数的读取方式并丢弃所有缓存, nullptr时从数据库读取
+	void setLoader(const Loader &loader);
+
+	//相机参数被直接下发(参数调试)后调用, 换产时不再按上次下发的参数跳过
+	void touchCameras() { m_cameraVersion++; }
+	long cameraVersion() const { return m_cameraVersion.load(); }
+
+private:
+	AppProductCache();
+	~AppProductCache();
+	AppProductCache(const AppProductCache &) = delete;
+	AppProductCache &operator=(const AppProductCache &) = delete;
+
+	struct stEntry
+	{
+		std::shared_ptr<const stProductSettings> pSettings;
+		bool bIsLoading = false;
+		long generation = 0;        //加载期间被invalidate时丢弃加载结果
+	};
+
+	std::shared_ptr<const stProductSettings> load(const std::string &sProd);
+	void runPrefetch();
+
+	std::mutex m_mutex;
+	std::condition_variable m_loadedCondition;
+	std::map<std::string, stEntry> m_mapEntries;
+	long m_generation;
+	Loader m_loader;
+	std::atomic<long> m_cameraVersion;
+
+	std::mutex m_prefetchMutex;
+	std::condition_variable m_prefetchCondition;
+	std::deque<std::string> m_prefetchQueue;
+	bool m_bIsStop;
+	std::thread m_prefetchThread;
+};
+
+#endif // XJ_APP_PRODUCT_CACHE_H
@@ -0,0 +1,213 @@
+#include <climits>
+#include "xj_app_product_fusion.h"
+#include "customized_json_config.h"
+#include "logger.h"
+
+using namespace std;
+using namespace cv;
+
+AppProductFusion::AppProductFusion(const int boardId, const int totalCaptureTimes) :
+			m_boardId(boardId),
+			m_totalCaptureTimes(totalCaptureTimes),
+			m_iouThreshold(0.1f),
+			m_distanceThreshold(50),
+			m_maxPendingProducts(4),
+			m_order(0)
+{
+	reset(totalCaptureTimes);
+}
+
+AppProductFusion::AppProductFusion(const int boardId, const int totalCaptureTimes, const float iouThreshold, const float distanceThreshold, const int maxPendingProducts) :
+			m_boardId(boardId),
+			m_totalCaptureTimes(totalCaptureTimes),
+			m_iouThreshold(iouThreshold),
+			m_distanceThreshold(distanceThreshold),
+			m_maxPendingProducts(std::max(1, maxPendingProducts)),
+			m_order(0)
+{
+}
+
+void AppProductFusion::reset(const int totalCaptureTimes)
+{
+	unique_lock<mutex> lock(m_mutex);
+	m_totalCaptureTimes = totalCaptureTimes;
+	m_iouThreshold = CustomizedJsonConfig::instance().get<float>("PRODUCT_FUSION_IOU_THRESHOLD");
+	m_distanceThreshold = CustomizedJsonConfig::instance().get<float>("PRODUCT_FUSION_DISTANCE");
+	m_maxPendingProducts = std::max(1, CustomizedJsonConfig::instance().get<int>("PRODUCT_FUSION_MAX_PENDING_PRODUCTS"));
+	m_mapProducts.clear();
+}
+
+AppProductFusion::stProductEntry &AppProductFusion::getEntry(const int productSeq)
+{
+	auto itr = m_mapProducts.find(productSeq);
+	if(itr != m_mapProducts.end())
+	{
+		return itr->second;
+	}
+
+	//拍照缺失的产品永远不会到齐, 超过缓存数量时丢弃最早的
+	while(!m_mapProducts.empty() && (int)m_mapProducts.size() >= m_maxPendingProducts)
+	{
+		auto oldest = m_mapProducts.begin();
+		for(auto it = m_mapProducts.begin(); it != m_mapProducts.end(); ++it)
+		{
+			if(it->second.order < oldest->second.order)
+			{
+				oldest = it;
+			}
+		}
+		LogERROR << "extern: Board[" << m_boardId << "] product " << oldest->first << " dropped, captures not complete: " << oldest->second.mapDefects.size() << "/" << m_totalCaptureTimes;
+		m_mapProducts.erase(oldest);
+	}
+
+	stProductEntry &entry = m_mapProducts[productSeq];
+	entry.order = m_order++;
+	return entry;
+}
+
+void AppProductFusion::addDefects(const int productSeq, const int nCaptureTimes, const vector<stDefectInfo> &vDefects)
+{
+	unique_lock<mutex> lock(m_mutex);
+	getEntry(productSeq).mapDefects[nCaptureTimes] = vDefects;
+}
+
+void AppProductFusion::addImage(const int productSeq, const int nCaptureTimes, const Mat &resultImage, const Mat &sourceImage)
+{
+	unique_lock<mutex> lock(m_mutex);
+	stProductEntry &entry = getEntry(productSeq);
+	entry.mapResultImages[nCaptureTimes] = resultImage;
+	entry.mapSourceImages[nCaptureTimes] = sourceImage;
+}
+
+bool AppProductFusion::isDefectsComplete(const int productSeq)
+{
+	unique_lock<mutex> lock(m_mutex);
+	auto itr = m_mapProducts.find(productSeq);
+	return itr != m_mapProducts.end() && (int)itr->second.mapDefects.size() >= m_totalCaptureTimes;
+}
+
+bool AppProductFusion::isSameDefect(const stDefectInfo &defect1, const stDefectInfo &defect2) const
+{
+	if(defect1.type != defect2.type)
+	{
+		return false;
+	}
+	//无位置信息的瑕疵(定位失败、印刷不良等)每个产品只计一次
+	if(defect1.box.area() <= 0 || defect2.box.area() <= 0)
+	{
+		return defect1.box.area() <= 0 && defect2.box.area() <= 0;
+	}
+
+	const float intersection = (defect1.box & defect2.box).area();
+	const float iou = intersection / (defect1.box.area() + defect2.box.area() - intersection);
+	if(iou > m_iouThreshold)
+	{
+		return true;
+	}
+	const Point2f center1(defect1.box.x + defect1.box.width / 2.0f, defect1.box.y + defect1.box.height / 2.0f);
+	const Point2f center2(defect2.box.x + defect2.box.width / 2.0f, defect2.box.y + defect2.box.height / 2.0f);
+	return norm(center1 - center2) < m_distanceThreshold;
+}
+
+bool AppProductFusion::fuse(const int productSeq, vector<stDefectInfo> &vDefects)
+{
+	unique_lock<mutex> lock(m_mutex);
+	vDefects.clear();
+	auto itr = m_mapProducts.find(productSeq);
+	if(itr == m_mapProducts.end())
+	{
+		return true;
+	}
+
+	//按置信度从高到低保留, 与已保留瑕疵重合的丢弃
+	vector<stDefectInfo> vAllDefects;
+	for(const auto &iter : itr->second.mapDefects)
+	{
+		vAllDefects.insert(vAllDefects.end(), iter.second.begin(), iter.second.end());
+	}
+	stable_sort(vAllDefects.begin(), vAllDefects.end(), [](const stDefectInfo &a, const stDefectInfo &b)
+	{
+		return a.confidence > b.confidence;
+	});
+	for(const auto &defect : vAllDefects)
+	{
+		bool bIsDuplicate = false;
+		for(const auto &kept : vDefects)
+		{
+			if(isSameDefect(defect, kept))
+			{
+				bIsDuplicate = true;
+				break;
+			}
+		}
+		if(!bIsDuplicate)
+		{
+			vDefects.emplace_back(defect);
+		}
+	}
+
+	itr->second.bIsFused = true;
+	itr->second.resultType = vDefects.empty() ? 0 : vDefects[0].type;
+	LogINFO << "Board[" << m_boardId << "] product " << productSeq << " fused defects: " << vAllDefects.size() << " -> " << vDefects.size();
+	return vDefects.empty();
+}
+
+Mat AppProductFusion::composeImage(const int productSeq, vector<Mat> &vSourceImages, int &resultType)
+{
+	unique_lock<mutex> lock(m_mutex);
+	vSourceImages.clear();
+	resultType = 0;
+	auto itr = m_mapProducts.find(productSeq);
+	if(itr == m_mapProducts.end() || itr->second.mapResultImages.empty())
+	{
+		return Mat();
+	}
+	resultType = itr->second.resultType;
+
+	//各次拍照结果图按拍照顺序横向拼接, 高度统一为最小高度
+	int height = INT_MAX;
+	for(const auto &iter : itr->second.mapResultImages)
+	{
+		height = std::min(height, iter.second.rows);
+	}
+	vector<Mat> vImages;
+	for(const auto &iter : itr->second.mapResultImages)
+	{
+		const Mat &image = iter.second;
+		if(image.empty() || height <= 0)
+		{
+			continue;
+		}
+		Mat resized;
+		if(image.rows == height)
+		{
+			resized = image;
+		}
+		else
+		{
+			resize(image, resized, Size(cvRound(image.cols * height / (double)image.rows), height), 0, 0, INTER_AREA);
+		}
+		if(resized.channels() == 1)
+		{
+			cvtColor(resized, resized, COLOR_GRAY2BGR);
+		}
+		vImages.emplace_back(resized);
+	}
+	for(const auto &iter : itr->second.mapSourceImages)
+	{
+		vSourceImages.emplace_back(iter.second);
+	}
+
+	Mat composed;
+	if(!vImages.empty())
+	{
+		hconcat(vImages, composed);
+	}
+	return composed;
+}
+
+void AppProductFusion::erase(const int productSeq)
+{
+	unique_lock<mutex> lock(m_mutex);
+	m_mapProducts.erase(productSeq);
+}
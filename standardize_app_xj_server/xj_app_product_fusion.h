@@ -0,0 +1,89 @@
+#ifndef XJ_APP_PRODUCT_FUSION_H
+#define XJ_APP_PRODUCT_FUSION_H
+
+#include <map>
+#include <mutex>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "xj_app_algorithm.h"
+
+/*==================================================================================================
+                    产品级融合: 按产品序号收集每次拍照的瑕疵和结果图, 全部拍照到齐后只判定一次
+===================================================================================================*/
+class AppProductFusion
+{
+public:
+	AppProductFusion(const int boardId, const int totalCaptureTimes);
+	//融合参数由调用方给出, 不读取json配置; 之后调用reset()时仍按json配置重新加载
+	AppProductFusion(const int boardId, const int totalCaptureTimes, const float iouThreshold, const float distanceThreshold, const int maxPendingProducts);
+	~AppProductFusion() {}
+
+	/**
+	 * @brief reload fusion params and drop all pending products
+	 */
+	void reset(const int totalCaptureTimes);
+
+	/**
+	 * @brief add defects of one capture, defect boxes are in lens coordinates
+	 * @param productSeq <input> product sequence, same for all captures of a product
+	 * @param nCaptureTimes <input> capture index, start from 1
+	 * @param vDefects <input> defects of the capture
+	 * @return none
+	 */
+	void addDefects(const int productSeq, const int nCaptureTimes, const std::vector<stDefectInfo> &vDefects);
+
+	/**
+	 * @brief add drawn result image and source image of one capture
+	 */
+	void addImage(const int productSeq, const int nCaptureTimes, const cv::Mat &resultImage, const cv::Mat &sourceImage);
+
+	//所有拍照的瑕疵是否到齐
+	bool isDefectsComplete(const int productSeq);
+
+	/**
+	 * @brief de-duplicate defects of all captures and decide the product verdict once
+	 * @param productSeq <input> product sequence
+	 * @param vDefects <output> fused defects
+	 * @return true-OK, false-NG
+	 */
+	bool fuse(const int productSeq, std::vector<stDefectInfo> &vDefects);
+
+	/**
+	 * @brief compose result images of all captures side by side
+	 * @param productSeq <input> product sequence
+	 * @param vSourceImages <output> source images by capture order
+	 * @param resultType <output> first fused defect type, 0 if product is OK or fuse() is not called
+	 * @return composed image, empty if no image added
+	 */
+	cv::Mat composeImage(const int productSeq, std::vector<cv::Mat> &vSourceImages, int &resultType);
+
+	void erase(const int productSeq);
+
+private:
+	struct stProductEntry
+	{
+		std::map<int, std::vector<stDefectInfo>> mapDefects;	//<拍照次数, 瑕疵>
+		std::map<int, cv::Mat> mapResultImages;					//<拍照次数, 结果图>
+		std::map<int, cv::Mat> mapSourceImages;					//<拍照次数, 原图>
+		bool bIsFused = false;
+		int resultType = 0;										//融合后首个瑕疵类别, 0-OK
+		long order = 0;											//创建顺序, 用于淘汰
+	};
+
+	//两个瑕疵是否为同一处
+	bool isSameDefect(const stDefectInfo &defect1, const stDefectInfo &defect2) const;
+	//取产品融合数据, 新产品时丢弃过旧的未完成产品
+	stProductEntry &getEntry(const int productSeq);
+
+	int m_boardId;
+	int m_totalCaptureTimes;
+	float m_iouThreshold;		//同类瑕疵框交并比大于该值视为同一处
+	float m_distanceThreshold;	//同类瑕疵框中心距离小于该值(像素)视为同一处
+	int m_maxPendingProducts;	//最多缓存的未完成产品数
+	long m_order;
+
+	std::mutex m_mutex;
+	std::map<int, stProductEntry> m_mapProducts;	//<产品序号, 融合数据>
+};
+
+#endif // XJ_APP_PRODUCT_FUSION_H
@@ -0,0 +1,67 @@
+#include "xj_app_render_worker.h"
+#include "logger.h"
+#include <chrono>
+
+using namespace std;
+
+AppRenderWorker::AppRenderWorker(const int boardId, const int queueSize, const StageQueuePolicy policy, const string &sName) :
+			m_boardId(boardId),
+			m_sName(sName),
+			m_queue(queueSize, policy)
+{
+	m_thread = thread(&AppRenderWorker::run, this);
+	LogINFO << "Board[" << m_boardId << "] " << m_sName << " worker started, queue = " << queueSize << ", policy = " << (int)policy;
+}
+
+AppRenderWorker::~AppRenderWorker()
+{
+	m_queue.close();
+	m_thread.join();
+
+	const stStageStats stats = getStats();
+	const stStageQueueStats queueStats = m_queue.getStats();
+	LogINFO << "Board[" << m_boardId << "] " << m_sName << " worker stopped, executed = " << stats.count << ", avg = " << stats.avgMs() << "ms, max = " << stats.maxMs
+			<< "ms, max depth = " << queueStats.maxDepth << ", dropped = " << queueStats.numDropped << ", max block = " << queueStats.maxBlockMs << "ms";
+}
+
+bool AppRenderWorker::submit(function<void()> &&render)
+{
+	if(!m_queue.push(std::move(render)))
+	{
+		LogWARNING << "extern: Board[" << m_boardId << "] " << m_sName << " queue full, a task is dropped";
+		return false;
+	}
+	return true;
+}
+
+stStageStats AppRenderWorker::getStats()
+{
+	lock_guard<mutex> lock(m_mutex);
+	return m_stats;
+}
+
+stStageQueueStats AppRenderWorker::getQueueStats()
+{
+	return m_queue.getStats();
+}
+
+void AppRenderWorker::run()
+{
+	function<void()> render;
+	while(m_queue.pop(render))
+	{
+		const auto start = chrono::steady_clock::now();
+		try
+		{
+			render();
+		}
+		catch (const exception &e)
+		{
+			LogERROR << "extern: Board[" << m_boardId << "] " << m_sName << " failed: " << e.what();
+		}
+		render = nullptr;
+		const double renderMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+		lock_guard<mutex> lock(m_mutex);
+		m_stats.add(renderMs);
+	}
+}
@@ -0,0 +1,47 @@
+#ifndef XJ_APP_RENDER_WORKER_H
+#define XJ_APP_RENDER_WORKER_H
+
+#include <mutex>
+#include <memory>
+#include <string>
+#include <thread>
+#include <functional>
+#include "xj_app_stage_queue.h"
+
+/*==================================================================================================
+    结果渲染存图线程: 每个工位一个, 绘制结果图、存图入队、更新UI显示按提交顺序在此执行,
+    检测线程发出PLC信号后只提交不等待; 队列满时按配置阻塞或丢弃.
+    多次拍照时非最后一次拍照的异步检测也用同样的有界单线程执行
+===================================================================================================*/
+class AppRenderWorker
+{
+public:
+	/**
+	 * @brief start the render thread of one board
+	 * @param boardId <input> board id, used for logging
+	 * @param queueSize <input> capacity of the render queue
+	 * @param policy <input> behaviour when the queue is full
+	 * @param sName <input> worker name, used for logging
+	 */
+	AppRenderWorker(const int boardId, const int queueSize, const StageQueuePolicy policy, const std::string &sName = "render");
+	//已提交的任务全部执行完后退出
+	~AppRenderWorker();
+
+	//提交一个渲染任务, 被丢弃时返回false
+	bool submit(std::function<void()> &&render);
+
+	stStageStats getStats();
+	stStageQueueStats getQueueStats();
+
+private:
+	void run();
+
+	int m_boardId;
+	std::string m_sName;
+	AppStageQueue<std::function<void()>> m_queue;
+	std::mutex m_mutex;
+	stStageStats m_stats;
+	std::thread m_thread;
+};
+
+#endif // XJ_APP_RENDER_WORKER_H
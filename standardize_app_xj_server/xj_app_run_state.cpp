@@ -0,0 +1,178 @@
+#include "xj_app_run_state.h"
+#include "running_status.h"
+#include "logger.h"
+#include <algorithm>
+
+using namespace std;
+
+AppRunState &AppRunState::instance()
+{
+	static AppRunState runState;
+	return runState;
+}
+
+AppRunState::AppRunState() :
+			m_generation(0),
+			m_changeTime(chrono::steady_clock::now()),
+			m_lastStatus(0),
+			m_pollInterval(20),
+			m_reader(nullptr),
+			m_bIsShutdown(false),
+			m_bIsStop(false)
+{
+}
+
+AppRunState::~AppRunState()
+{
+	stop();
+}
+
+void AppRunState::start(const int pollMs, const StatusReader &reader)
+{
+	if(m_thread.joinable())
+	{
+		return;
+	}
+	m_pollInterval = chrono::milliseconds(std::max(1, pollMs));
+	m_reader = reader;
+	refresh();
+	m_bIsStop = false;
+	m_thread = thread(&AppRunState::run, this);
+	LogINFO << "Run state watcher started, poll interval = " << m_pollInterval.count() << "ms";
+}
+
+void AppRunState::stop()
+{
+	{
+		lock_guard<mutex> lock(m_mutex);
+		m_bIsStop = true;
+	}
+	m_condWatcher.notify_all();
+	if(m_thread.joinable())
+	{
+		m_thread.join();
+	}
+}
+
+void AppRunState::notify(const string &sReason)
+{
+	//先更新缓存, 避免监视线程对同一变化再唤醒一次
+	refresh();
+	bump(sReason);
+}
+
+long AppRunState::generation()
+{
+	lock_guard<mutex> lock(m_mutex);
+	return m_generation;
+}
+
+bool AppRunState::waitForChange(const long generation, const chrono::steady_clock::time_point &deadline)
+{
+	unique_lock<mutex> lock(m_mutex);
+	return m_condition.wait_until(lock, deadline, [this, generation](){ return m_generation != generation; });
+}
+
+bool AppRunState::waitForChange(const long generation)
+{
+	unique_lock<mutex> lock(m_mutex);
+	m_condition.wait(lock, [this, generation](){ return m_generation != generation; });
+	return true;
+}
+
+void AppRunState::waitForShutdown(const function<bool()> &predicate)
+{
+	unique_lock<mutex> lock(m_mutex);
+	m_condition.wait(lock, [this, &predicate](){ return m_bIsShutdown || predicate(); });
+}
+
+chrono::steady_clock::time_point AppRunState::changeTime()
+{
+	lock_guard<mutex> lock(m_mutex);
+	return m_changeTime;
+}
+
+void AppRunState::addTransition(const int boardId, const int status, const double wakeMs)
+{
+	lock_guard<mutex> lock(m_mutex);
+	stRunStateStats &stats = m_mapStats[boardId];
+	stats.boardId = boardId;
+	stats.status = status;
+	stats.numTransitions++;
+	stats.lastWakeMs = wakeMs;
+	stats.maxWakeMs = std::max(stats.maxWakeMs, wakeMs);
+}
+
+void AppRunState::addReady(const int boardId, const double readyMs)
+{
+	lock_guard<mutex> lock(m_mutex);
+	stRunStateStats &stats = m_mapStats[boardId];
+	stats.boardId = boardId;
+	stats.lastReadyMs = readyMs;
+	stats.maxReadyMs = std::max(stats.maxReadyMs, readyMs);
+}
+
+void AppRunState::addWakeup(const int boardId)
+{
+	lock_guard<mutex> lock(m_mutex);
+	stRunStateStats &stats = m_mapStats[boardId];
+	stats.boardId = boardId;
+	stats.numWakeups++;
+}
+
+vector<stRunStateStats> AppRunState::getStats()
+{
+	vector<stRunStateStats> vStats;
+	lock_guard<mutex> lock(m_mutex);
+	for(const auto &itr : m_mapStats)
+	{
+		vStats.emplace_back(itr.second);
+	}
+	return vStats;
+}
+
+void AppRunState::run()
+{
+	bool bIsShutdownNotified = false;
+	unique_lock<mutex> lock(m_mutex);
+	while(!m_bIsStop)
+	{
+		m_condWatcher.wait_for(lock, m_pollInterval);
+		if(m_bIsStop)
+		{
+			break;
+		}
+		lock.unlock();
+
+		const bool bIsShutdown = m_bIsShutdown && !bIsShutdownNotified;
+		bIsShutdownNotified = bIsShutdownNotified || bIsShutdown;
+		if(refresh() || bIsShutdown)
+		{
+			bump(bIsShutdown ? "shutdown" : "poll");
+		}
+		lock.lock();
+	}
+}
+
+void AppRunState::bump(const string &sReason)
+{
+	long generation = 0;
+	{
+		lock_guard<mutex> lock(m_mutex);
+		generation = ++m_generation;
+		m_changeTime = chrono::steady_clock::now();
+	}
+	m_condition.notify_all();
+	LogDEBUG << "Run state changed by " << sReason << ", generation = " << generation;
+}
+
+bool AppRunState::refresh()
+{
+	const int status = m_reader ? m_reader() : 0;
+	const string sProduct = RunningInfo::instance().GetProductionInfo().GetCurrentProd();
+	lock_guard<mutex> lock(m_mutex);
+	const bool bIsChanged = (status != m_lastStatus || sProduct != m_sLastProduct);
+	m_lastStatus = status;
+	m_sLastProduct = sProduct;
+	return bIsChanged;
+}
@@ -0,0 +1,104 @@
+#ifndef XJ_APP_RUN_STATE_H
+#define XJ_APP_RUN_STATE_H
+
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+
+//单个工位的运行状态切换统计, 用于web查询
+struct stRunStateStats
+{
+	int boardId = 0;
+	int status = 0;             //当前运行状态, 同XJAppServer::DetectorRunStatus::Status
+	long numTransitions = 0;
+	long numWakeups = 0;        //空闲等待被唤醒次数
+	double lastWakeMs = 0;      //状态变化到检测线程发现变化的时间
+	double maxWakeMs = 0;
+	double lastReadyMs = 0;     //开始检测(含换产后参数初始化)到可以取像的时间
+	double maxReadyMs = 0;
+};
+
+/*==================================================================================================
+    运行状态通知: 开始/停止、换产、测试、退出时唤醒空闲的检测线程, 代替各工位每5ms轮询.
+    web端的POST请求完成后调用notify()立即唤醒; 其它途径的变化(框架内部修改运行状态)由
+    一个监视线程按RUN_STATE_POLL_MS检查兜底, 所有工位共用
+===================================================================================================*/
+class AppRunState
+{
+public:
+	//读取当前运行状态, 在调用线程中执行
+	typedef std::function<int()> StatusReader;
+
+	static AppRunState &instance();
+
+	/**
+	 * @brief start the watcher thread
+	 * @param pollMs <input> interval of the fallback check
+	 * @param reader <input> reads the current run status
+	 */
+	void start(const int pollMs, const StatusReader &reader);
+	void stop();
+
+	//运行状态或当前产品可能已变化, 唤醒所有等待的检测线程
+	void notify(const std::string &sReason);
+	//退出请求, 只写原子变量, 可在信号处理函数中调用, 由监视线程唤醒等待的检测线程
+	void requestShutdown() { m_bIsShutdown = true; }
+	bool isShutdownRequested() const { return m_bIsShutdown; }
+
+	//读取运行状态之前调用, 之后的变化一定会使版本号增加, 不会错过唤醒
+	long generation();
+	/**
+	 * @brief wait until the generation changes or the deadline passes
+	 * @param generation <input> generation read before the run status
+	 * @param deadline <input> latest time to return
+	 * @return true-changed, false-timeout
+	 */
+	bool waitForChange(const long generation, const std::chrono::steady_clock::time_point &deadline);
+	bool waitForChange(const long generation);
+	/**
+	 * @brief wait until shutdown is requested or the predicate holds, re-checked on every change
+	 * @param predicate <input> evaluated under the state lock, the caller must notify() after making it true
+	 */
+	void waitForShutdown(const std::function<bool()> &predicate);
+	//最近一次变化的时间, 用于计算切换延迟
+	std::chrono::steady_clock::time_point changeTime();
+
+	void addTransition(const int boardId, const int status, const double wakeMs);
+	void addReady(const int boardId, const double readyMs);
+	void addWakeup(const int boardId);
+	std::vector<stRunStateStats> getStats();
+
+private:
+	AppRunState();
+	~AppRunState();
+	AppRunState(const AppRunState &) = delete;
+	AppRunState &operator=(const AppRunState &) = delete;
+
+	void run();
+	void bump(const std::string &sReason);
+	//读取运行状态和当前产品, 返回是否与上次不同
+	bool refresh();
+
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	std::condition_variable m_condWatcher;
+	long m_generation;
+	std::chrono::steady_clock::time_point m_changeTime;
+	int m_lastStatus;
+	std::string m_sLastProduct;
+	std::map<int, stRunStateStats> m_mapStats;
+
+	std::chrono::milliseconds m_pollInterval;
+	StatusReader m_reader;
+	std::atomic<bool> m_bIsShutdown;
+	bool m_bIsStop;
+	std::thread m_thread;
+};
+
+#endif // XJ_APP_RUN_STATE_H
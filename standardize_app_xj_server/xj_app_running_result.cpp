@@ -34,13 +34,29 @@ void AppRunningResult::Exit()
     }
 }
 
-AppRunningResult::AppRunningResult():m_iDisplayTotalNumber(0), m_iDisplayTotalDefect(0)
-{
+//延后写入队列上限, 超过时直接写入
+#define MAX_DEFERRED_DB_WRITES 10000
 
+AppRunningResult::AppRunningResult():m_iDisplayTotalNumber(0), m_iDisplayTotalDefect(0), m_lastResultReadMs(0), m_paramsVersion(0), m_bIsDeferStop(false)
+{
+    m_deferThread = thread(&AppRunningResult::runDeferredWrites, this);
 }
 
 AppRunningResult::~AppRunningResult()
 {
+    {
+        lock_guard<mutex> lock(m_mutex_defer);
+        m_bIsDeferStop = true;
+    }
+    m_condDefer.notify_all();
+    if(m_deferThread.joinable())
+    {
+        m_deferThread.join();
+    }
+    if(m_sweepThread.joinable())
+    {
+        m_sweepThread.join();
+    }
     Exit();
 }
 
@@ -50,8 +66,14 @@ void AppRunningResult::setCurrentResultMap(const cv::Mat &frame, const Classific
     m_mapCurrentProcessedFrameResult[sCamID][captureTimes] = std::make_pair(frame, result);
 }
 	
+static long long getSteadyMs()
+{
+    return chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 void AppRunningResult::getCurrentResult(cv::Mat &frame, ClassificationResult &result, const string sCamID, const int captureTimes, const bool checkCameraStataus)
 {
+    m_lastResultReadMs = getSteadyMs();
     unique_lock<mutex> lock(m_mutex_map);
     if(m_mapCurrentProcessedFrameResult.find(sCamID) != m_mapCurrentProcessedFrameResult.end())
     {
@@ -63,6 +85,18 @@ void AppRunningResult::getCurrentResult(cv::Mat &frame, ClassificationResult &re
     }		
 }
 
+bool AppRunningResult::isResultViewerNeeded(const string &sCamID, const int captureTimes, const int idleMs)
+{
+    if(idleMs <= 0 || getSteadyMs() - m_lastResultReadMs.load() <= idleMs)
+    {
+        return true;
+    }
+    //UI重新连接时至少能读到一张结果图
+    unique_lock<mutex> lock(m_mutex_map);
+    auto itr = m_mapCurrentProcessedFrameResult.find(sCamID);
+    return itr == m_mapCurrentProcessedFrameResult.end() || itr->second.find(captureTimes) == itr->second.end();
+}
+
 void AppRunningResult::updateDisplayTotalInfo(const int iTotalNumber, const int iTotalDefect)
 {
     if (0 == iTotalNumber && 0 == iTotalDefect) 
@@ -91,7 +125,8 @@ void AppRunningResult::getNGProductCountList(std::vector<int>& vTotalDefectIndic
    iTotalDefect = m_iDisplayTotalDefect;
 }
 
-void AppRunningResult::recordDefectData(const std::string &prod, const int boardId, const std::string &lotNumber, const int product_no, const vector<ClassificationResult>& defects)
+void AppRunningResult::recordDefectData(const std::string &prod, const int boardId, const std::string &lotNumber, const int product_no, const vector<ClassificationResult>& defects, 
+        const bool bIsDeferred)
 {
     try
     {
@@ -108,8 +143,11 @@ void AppRunningResult::recordDefectData(const std::string &prod, const int board
                 newReport.defects.insert(std::make_pair(sDefectName, 1));
             }        
         }
-	    AppDatabase db;
-        db.defectAdd(newReport);
+        writeDatabase([newReport]()
+        {
+	        AppDatabase db;
+            db.defectAdd(newReport);
+        }, bIsDeferred);
 
         // 更新 m_vTotalDefectIndices
         if (m_vTotalDefectIndices.end() == std::find(m_vTotalDefectIndices.begin(), m_vTotalDefectIndices.end(), product_no))
@@ -126,11 +164,10 @@ void AppRunningResult::recordDefectData(const std::string &prod, const int board
 }
 
 bool AppRunningResult::recordMesData(const std::string &prod, const int boardId, const std::string &lotNumber, 
-        const int product_no, const int iTotalNum, const int iNgNum, const vector<ClassificationResult>& defects)
+        const int product_no, const int iTotalNum, const int iNgNum, const vector<ClassificationResult>& defects, const bool bIsDeferred)
 {
     try
     {
-        unique_lock<mutex> lock(m_mutex_mes);
         AppDatabase::MesData newMesData(shared_utils::getTime(0), prod, lotNumber, to_string(boardId), to_string(product_no), 
                                         "F205-T", to_string(iTotalNum), to_string(iNgNum));
         newMesData.getShiftTypeFromDate();
@@ -143,8 +180,13 @@ bool AppRunningResult::recordMesData(const std::string &prod, const int boardId,
             newMesData.defects.insert(std::make_pair(ClassifierResult::getName(iDefect), 1));
         }
 
-        AppDatabase db;
-        db.mesAdd(newMesData);
+        writeDatabase([newMesData]()
+        {
+            unique_lock<mutex> lock(m_mutex_mes);
+            AppDatabase::MesData mesData = newMesData;
+            AppDatabase db;
+            db.mesAdd(mesData);
+        }, bIsDeferred);
     }
     catch(const std::exception& e)
     {
@@ -153,3 +195,120 @@ bool AppRunningResult::recordMesData(const std::string &prod, const int boardId,
 
     return true;
 }
+
+void AppRunningResult::writeDatabase(const function<void()> &write, const bool bIsDeferred)
+{
+    if(bIsDeferred)
+    {
+        unique_lock<mutex> lock(m_mutex_defer);
+        if(m_dqDeferredWrites.size() < MAX_DEFERRED_DB_WRITES)
+        {
+            m_dqDeferredWrites.emplace_back(write);
+            lock.unlock();
+            m_condDefer.notify_one();
+            return;
+        }
+    }
+    write();
+}
+
+int AppRunningResult::getDeferredWriteCount()
+{
+    lock_guard<mutex> lock(m_mutex_defer);
+    return m_dqDeferredWrites.size();
+}
+
+void AppRunningResult::runDeferredWrites()
+{
+    while(true)
+    {
+        function<void()> write;
+        {
+            unique_lock<mutex> lock(m_mutex_defer);
+            m_condDefer.wait(lock, [this](){ return m_bIsDeferStop || !m_dqDeferredWrites.empty(); });
+            if(m_dqDeferredWrites.empty())
+            {
+                return;
+            }
+            write = std::move(m_dqDeferredWrites.front());
+            m_dqDeferredWrites.pop_front();
+        }
+        try
+        {
+            write();
+        }
+        catch(const std::exception& e)
+        {
+            LogERROR << "extern: deferred database write failed: " << e.what();
+        }
+    }
+}
+
+void AppRunningResult::requestParamsUpdate()
+{
+    const long version = ++m_paramsVersion;
+    LogINFO << "request parameters hot update, version = " << version;
+}
+
+long AppRunningResult::getParamsVersion() const
+{
+    return m_paramsVersion.load();
+}
+
+void AppRunningResult::setThresholdSweepHandler(const int boardId, const ThresholdSweepHandler &handler)
+{
+    lock_guard<mutex> lock(m_mutex_sweep);
+    m_mapSweepHandlers[boardId] = handler;
+}
+
+long AppRunningResult::startThresholdSweep(const int boardId, const stSweepRequest &request)
+{
+    lock_guard<mutex> lock(m_mutex_sweep);
+    auto itr = m_mapSweepHandlers.find(boardId);
+    if(itr == m_mapSweepHandlers.end() || !itr->second)
+    {
+        LogERROR << "extern: Board[" << boardId << "] algorithm not initialized, can not sweep thresholds";
+        return -1;
+    }
+    if(m_sweepJob.status == SweepJobStatus::RUNNING)
+    {
+        LogERROR << "extern: Board[" << boardId << "] another threshold sweep is running";
+        return -1;
+    }
+    //上一个任务已结束, 回收其线程
+    if(m_sweepThread.joinable())
+    {
+        m_sweepThread.join();
+    }
+
+    m_sweepJob.id++;
+    m_sweepJob.boardId = boardId;
+    m_sweepJob.status = SweepJobStatus::RUNNING;
+    m_sweepJob.request = request;
+    m_sweepJob.report = stSweepReport();
+    const long jobId = m_sweepJob.id;
+    const ThresholdSweepHandler handler = itr->second;
+    m_sweepThread = thread([this, handler, request, jobId]()
+    {
+        stSweepReport report;
+        bool bIsOK = false;
+        try
+        {
+            bIsOK = handler(request, report);
+        }
+        catch(const exception &e)
+        {
+            LogERROR << "extern: threshold sweep " << jobId << " failed: " << e.what();
+        }
+        lock_guard<mutex> lock(m_mutex_sweep);
+        m_sweepJob.status = bIsOK ? SweepJobStatus::DONE : SweepJobStatus::FAILED;
+        m_sweepJob.report = report;
+    });
+    return jobId;
+}
+
+AppRunningResult::stSweepJob AppRunningResult::getThresholdSweepJob()
+{
+    lock_guard<mutex> lock(m_mutex_sweep);
+    return m_sweepJob;
+}
@@ -9,12 +9,18 @@
 #include <array>
 #include <ostream>
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <condition_variable>
 
 #include <string>
 #include <mutex>
 #include <opencv2/opencv.hpp>
 #include "classifier_result.h"
 #include "xj_app_database.h"
+#include "xj_app_algorithm.h"
 
 class AppRunningResult
 {
@@ -24,6 +30,8 @@ public:
 public:
     void setCurrentResultMap(const cv::Mat &frame, const ClassificationResult result, const std::string sCamId, const int captureTimes);
 	void getCurrentResult(cv::Mat &frame, ClassificationResult &result, const std::string sCamId, const int captureTimes, const bool checkCameraStataus = true);
+	//UI最近idleMs内读取过结果图, 或该相机该次拍照还没有结果图时返回true; idleMs<=0时总是返回true
+	bool isResultViewerNeeded(const std::string &sCamId, const int captureTimes, const int idleMs);
 	/**
 	 * @brief Get the product index of defective products and count of total products
 	 * @param vTotalDefectIndices <output> the product index of defective products
@@ -42,9 +50,11 @@ public:
 	 * @param lotNumber <input> lot number
 	 * @param prod_no <input> product count
 	 * @param defects <input> defect type list
+	 * @param bIsDeferred <input> true-queue the database write to the background writer (load shedding)
 	 * @return none
 	 */
-	void recordDefectData(const std::string &prod, const int boardId, const std::string &lotNumber, const int product_no, const vector<ClassificationResult>& defects);
+	void recordDefectData(const std::string &prod, const int boardId, const std::string &lotNumber, const int product_no, const vector<ClassificationResult>& defects, 
+			const bool bIsDeferred = false);
 
 	/******* MES SYSTEM***********/
 	/**
@@ -55,10 +65,49 @@ public:
 	 * @param iNgNum <input> counting of defective products
 	 * @param sDate <input> record date
 	 * @param defects <input> defect type list
+	 * @param bIsDeferred <input> true-queue the database write to the background writer (load shedding)
 	 * @return true-sucessful, false-failed
 	 */
 	bool recordMesData(const std::string &prod, const int boardId, const std::string &lotNumber, const int product_no, 
-			const int iTotalNum, const int iNgNum, const vector<ClassificationResult>& defects);
+			const int iTotalNum, const int iNgNum, const vector<ClassificationResult>& defects, const bool bIsDeferred = false);
+	//延后写入队列中的记录数
+	int getDeferredWriteCount();
+
+	/******* 参数热更新***********/
+	//web端修改阈值类参数后递增版本号, 检测线程在帧间发现版本变化后热更新, 不重新初始化算法
+	void requestParamsUpdate();
+	long getParamsVersion() const;
+
+	/******* 阈值扫描***********/
+	//扫描任务状态
+	enum class SweepJobStatus : int
+	{
+		NONE    = 0,
+		RUNNING = 1,
+		DONE    = 2,
+		FAILED  = 3
+	};
+	struct stSweepJob
+	{
+		long id = 0;
+		int boardId = -1;
+		SweepJobStatus status = SweepJobStatus::NONE;
+		stSweepRequest request;
+		stSweepReport report;
+	};
+
+	//各工位初始化算法后登记扫描接口, web端按工位启动扫描; 扫描在后台线程执行, 不占用web线程, 不影响检测
+	typedef std::function<bool(const stSweepRequest &, stSweepReport &)> ThresholdSweepHandler;
+	void setThresholdSweepHandler(const int boardId, const ThresholdSweepHandler &handler);
+	/**
+	 * @brief start a threshold sweep in the background, only one sweep runs at a time
+	 * @param boardId <input> board whose algorithm is used
+	 * @param request <input> sample path and threshold grid
+	 * @return job id, -1 if the board is not initialized or another sweep is running
+	 */
+	long startThresholdSweep(const int boardId, const stSweepRequest &request);
+	//最近一次扫描任务, 运行中时report为空
+	stSweepJob getThresholdSweepJob();
 protected:
 	static AppRunningResult* m_instance;
 
@@ -77,6 +126,23 @@ private:
 	//记录寄存器中的产品总数和NG总数
 	int m_iDisplayTotalNumber = 0;
 	int m_iDisplayTotalDefect = 0;
+
+	std::atomic<long long> m_lastResultReadMs;	//UI最近一次读取结果图的时间
+	std::atomic<long> m_paramsVersion;
+
+	std::mutex m_mutex_sweep;
+	std::map<int, ThresholdSweepHandler> m_mapSweepHandlers;
+	stSweepJob m_sweepJob;
+	std::thread m_sweepThread;
+
+	//数据库延后写入: 记录在调用时生成(时间戳不变), 写库在后台线程执行
+	void writeDatabase(const std::function<void()> &write, const bool bIsDeferred);
+	void runDeferredWrites();
+	std::mutex m_mutex_defer;
+	std::condition_variable m_condDefer;
+	std::deque<std::function<void()>> m_dqDeferredWrites;
+	bool m_bIsDeferStop;
+	std::thread m_deferThread;
 };
 
 
@@ -0,0 +1,181 @@
+#include "xj_app_runtime_config.h"
+#include "customized_json_config.h"
+#include "logger.h"
+#include <algorithm>
+
+using namespace std;
+
+//可选配置, 缺失时使用默认值
+template <typename T>
+static T getOptional(const string &sKey, const T &defaultValue)
+{
+	try
+	{
+		return CustomizedJsonConfig::instance().get<T>(sKey);
+	}
+	catch (const exception &)
+	{
+		return defaultValue;
+	}
+}
+
+//必需配置, 缺失或类型错误时抛出异常, 本次重新加载失败
+template <typename T>
+static T getRequired(const string &sKey)
+{
+	try
+	{
+		return CustomizedJsonConfig::instance().get<T>(sKey);
+	}
+	catch (const exception &)
+	{
+		LogERROR << "json config: required key " << sKey << " is missing or invalid";
+		throw;
+	}
+}
+
+template <typename T>
+static vector<T> getOptionalVector(const string &sKey)
+{
+	try
+	{
+		return CustomizedJsonConfig::instance().getVector<T>(sKey);
+	}
+	catch (const exception &)
+	{
+		return vector<T>();
+	}
+}
+
+//按工位取数组配置, 越界时使用默认值
+template <typename T>
+static T getBoardValue(const vector<T> &vValues, const int boardId, const T &defaultValue)
+{
+	return (boardId >= 0 && boardId < (int)vValues.size()) ? vValues[boardId] : defaultValue;
+}
+
+//必需的按工位数组配置, 长度不足时返回false
+template <typename T>
+static bool getBoardVector(const string &sKey, const int numBoards, vector<T> &vValues)
+{
+	vValues = getOptionalVector<T>(sKey);
+	if ((int)vValues.size() < numBoards)
+	{
+		LogERROR << "json config: " << sKey << " has " << vValues.size() << " values, less than " << numBoards << " boards";
+		return false;
+	}
+	return true;
+}
+
+AppRuntimeConfig &AppRuntimeConfig::instance()
+{
+	static AppRuntimeConfig config;
+	return config;
+}
+
+AppRuntimeConfig::AppRuntimeConfig() : m_pConfig(make_shared<const stRuntimeConfig>()), m_version(0), m_numBoards(0)
+{
+}
+
+bool AppRuntimeConfig::reload(const int numBoards)
+{
+	lock_guard<mutex> lock(m_reloadMutex);
+	if (numBoards > 0)
+	{
+		m_numBoards = numBoards;
+	}
+
+	shared_ptr<stRuntimeConfig> pConfig = make_shared<stRuntimeConfig>();
+	try
+	{
+		//结果信号相关配置缺失时不能用默认值代替, 否则发给PLC的值或地址会改变, 作为必需配置
+		pConfig->bIsUseIoCard = getRequired<bool>("IS_USE_IO_CARD");
+		pConfig->bIsUseMes = getOptional<bool>("IS_USE_MES_SYSTEM", false);
+		pConfig->bIsSendSignalInMock = getRequired<bool>("IS_ENABLE_SEND_SIGNAL_IN_MOCK_VIDEO");
+		pConfig->bIsCountMultiDefects = getOptional<bool>("IS_COUNT_MULTI_DEFECTS_PER_TARGET", false);
+		pConfig->bIsHangUpSaveThread = getOptional<bool>("IS_NEED_HANGUP_IMAGE_SAVE_THREAD_BEFORE_IMAGE_PROCESS", false);
+		pConfig->bIsConcurrentCapture = getOptional<bool>("IS_CONCURRENT_CAPTURE_INSPECTION", false);
+		pConfig->bIsSaveResizeResult = getOptional<bool>("IS_SAVE_RESIZE_RESULT_IMAGE", false);
+		pConfig->bIsSaveSource = getOptional<bool>("IS_NEED_SAVE_SOURCE_IMAGE_IN_APP", false);
+		pConfig->bIsSaveOKResult = getOptional<bool>("IS_NEED_SAVE_OK_RESULT_IMAGE", false);
+
+		pConfig->debugCaptureTimes = getOptional<int>("CAPTUREIMAGETIMES", 0);
+		pConfig->mockFrameIntervalMs = getOptional<int>("MOCK_VIDEO_FRAME_TIME_INTERVAL_MS", 0);
+		pConfig->lensAddressStride = getOptional<int>("LENS_RESULT_ADDRESS_STRIDE", 1);
+		pConfig->ioSignalTimeMs = getRequired<int>("IO_CARD_SIGNAL_TIME_MS");
+		pConfig->plcOKValue = getRequired<int>("PLC_MODBUS_TCP_OK_RESULT_VALUE");
+		pConfig->plcNGValue = getRequired<int>("PLC_MODBUS_TCP_NG_RESULT_VALUE");
+		pConfig->plcTotalDefectAddress = getOptional<int>("PLC_MODBUS_TCP_TOTAL_DEFECT_COUNT_ADDRESS", -1);
+		pConfig->historyNGNum = std::max(1, getOptional<int>("UISetting.operation.historyNg.num", 1));
+		pConfig->qualityRetryTimes = getOptional<int>("IMAGE_QUALITY_RETRY_TIMES", 0);
+		pConfig->qualityDefectType = getOptional<int>("IMAGE_QUALITY_DEFECT_TYPE", 0);
+		pConfig->heartBeatIntervalMs = std::max(1, getOptional<int>("HEART_BEAT_SIGNAL_TIME_INTERVAL_MS", 500));
+		pConfig->ioHeartBeatBit = getOptional<int>("IO_CARD_HEART_BEAT_BIT_ADDRESS", -1);
+		pConfig->plcHeartBeatAddress = getOptional<int>("PLC_MODBUS_TCP_HEART_BEAT_ADDRESS", -1);
+		pConfig->resultViewerIdleMs = getOptional<int>("RESULT_RENDER_VIEWER_IDLE_MS", 0);
+		pConfig->vQualityRejectAction = getOptionalVector<int>("IMAGE_QUALITY_REJECT_ACTION");
+
+		//绘制参数缺失时结果图无法绘制, 作为必需配置
+		vector<double> vScale;
+		vector<int> vThickness, vPosX, vPosY, vFontScale;
+		if (!getBoardVector("CAMERA_IMAGE_DRAW_SCALE", m_numBoards, vScale) || !getBoardVector("CAMERA_IMAGE_DRAW_THICKNESS", m_numBoards, vThickness)
+			|| !getBoardVector("CAMERA_IMAGE_DRAW_TEXT_POS_X", m_numBoards, vPosX) || !getBoardVector("CAMERA_IMAGE_DRAW_TEXT_POS_Y", m_numBoards, vPosY)
+			|| !getBoardVector("CAMERA_IMAGE_DRAW_TEXT_FONT_SCALE", m_numBoards, vFontScale))
+		{
+			LogERROR << "extern: runtime config reload failed, keep version " << m_version.load();
+			return false;
+		}
+		const vector<string> vCameraName = getOptionalVector<string>("CAMERA_NAME");
+		const vector<bool> vIsSoftTrigger = getOptionalVector<bool>("CAMERA_SOFT_TRIGGER_ENABLE");
+		//当前使用的信号设备(IO卡或PLC)的结果地址必须每个工位都有
+		vector<int> vIoResultBit, vPlcResultAddress, vPlcInputAddress;
+		const bool bIsSignalAddressOK = pConfig->bIsUseIoCard ? getBoardVector("IO_CARD_CAMERA_RESULT_BIT_ADDRESS", m_numBoards, vIoResultBit)
+				: (getBoardVector("PLC_MODBUS_TCP_CAMERA_RESULT_REGISTER_ADDRESS", m_numBoards, vPlcResultAddress)
+					&& getBoardVector("PLC_MODBUS_TCP_CAMERA_INPUT_REGISTER_ADDRESS", m_numBoards, vPlcInputAddress));
+		if (!bIsSignalAddressOK)
+		{
+			LogERROR << "extern: runtime config reload failed, keep version " << m_version.load();
+			return false;
+		}
+		const vector<int> vPlcCountAddress = getOptionalVector<int>("PLC_MODBUS_TCP_TOTAL_NUM_COUNT_ADDRESS_LIST");
+		const vector<int> vBoardAppToReal = getOptionalVector<int>("BOARD_APP_TO_REAL");
+
+		pConfig->vBoards.resize(m_numBoards);
+		for (int boardIdx = 0; boardIdx < m_numBoards; boardIdx++)
+		{
+			stBoardRuntimeConfig &board = pConfig->vBoards[boardIdx];
+			board.sCameraName = getBoardValue<string>(vCameraName, boardIdx, "CAM" + to_string(boardIdx + 1));
+			board.drawScale = vScale[boardIdx];
+			board.drawThickness = vThickness[boardIdx];
+			board.textPosX = vPosX[boardIdx];
+			board.textPosY = vPosY[boardIdx];
+			board.textFontScale = vFontScale[boardIdx];
+			board.bIsSoftTrigger = getBoardValue<bool>(vIsSoftTrigger, boardIdx, false);
+			board.ioResultBit = getBoardValue<int>(vIoResultBit, boardIdx, -1);
+			board.plcResultAddress = getBoardValue<int>(vPlcResultAddress, boardIdx, -1);
+			board.plcInputAddress = getBoardValue<int>(vPlcInputAddress, boardIdx, -1);
+			board.plcCountAddress = getBoardValue<int>(vPlcCountAddress, getBoardValue<int>(vBoardAppToReal, boardIdx, -1), -1);
+		}
+	}
+	catch (const exception &e)
+	{
+		LogERROR << "extern: runtime config reload failed, keep version " << m_version.load() << ": " << e.what();
+		return false;
+	}
+
+	pConfig->version = m_version.load() + 1;
+	std::atomic_store(&m_pConfig, shared_ptr<const stRuntimeConfig>(pConfig));
+	m_version.store(pConfig->version);
+	LogINFO << "extern: runtime config version " << pConfig->version << " published for " << m_numBoards << " boards";
+	return true;
+}
+
+shared_ptr<const stRuntimeConfig> AppRuntimeConfig::get() const
+{
+	return std::atomic_load(&m_pConfig);
+}
+
+long AppRuntimeConfig::version() const
+{
+	return m_version.load();
+}
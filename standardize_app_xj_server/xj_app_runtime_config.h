@@ -0,0 +1,98 @@
+#ifndef XJ_APP_RUNTIME_CONFIG_H
+#define XJ_APP_RUNTIME_CONFIG_H
+
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <vector>
+
+//单个工位的检测热路径配置, 数组类配置已按工位取值
+struct stBoardRuntimeConfig
+{
+	std::string sCameraName;
+	double drawScale = 1.0;             //CAMERA_IMAGE_DRAW_SCALE
+	int drawThickness = 1;              //CAMERA_IMAGE_DRAW_THICKNESS
+	int textPosX = 0;                   //CAMERA_IMAGE_DRAW_TEXT_POS_X
+	int textPosY = 0;                   //CAMERA_IMAGE_DRAW_TEXT_POS_Y
+	int textFontScale = 1;              //CAMERA_IMAGE_DRAW_TEXT_FONT_SCALE
+	bool bIsSoftTrigger = false;        //CAMERA_SOFT_TRIGGER_ENABLE
+	int ioResultBit = -1;               //IO_CARD_CAMERA_RESULT_BIT_ADDRESS, -1表示未配置
+	int plcResultAddress = -1;          //PLC_MODBUS_TCP_CAMERA_RESULT_REGISTER_ADDRESS
+	int plcInputAddress = -1;           //PLC_MODBUS_TCP_CAMERA_INPUT_REGISTER_ADDRESS
+	int plcCountAddress = -1;           //PLC_MODBUS_TCP_TOTAL_NUM_COUNT_ADDRESS_LIST[BOARD_APP_TO_REAL[board]]
+};
+
+/*==================================================================================================
+    检测热路径配置快照: 从json一次性解析为普通字段, 发布后不再修改;
+    重新加载时整体替换, 读取方持有的旧快照在用完前保持有效, 同一快照内各字段属于同一配置版本
+===================================================================================================*/
+struct stRuntimeConfig
+{
+	long version = 0;
+
+	bool bIsUseIoCard = false;                  //IS_USE_IO_CARD
+	bool bIsUseMes = false;                     //IS_USE_MES_SYSTEM
+	bool bIsSendSignalInMock = false;           //IS_ENABLE_SEND_SIGNAL_IN_MOCK_VIDEO
+	bool bIsCountMultiDefects = false;          //IS_COUNT_MULTI_DEFECTS_PER_TARGET
+	bool bIsHangUpSaveThread = false;           //IS_NEED_HANGUP_IMAGE_SAVE_THREAD_BEFORE_IMAGE_PROCESS
+	bool bIsConcurrentCapture = false;          //IS_CONCURRENT_CAPTURE_INSPECTION
+	bool bIsSaveResizeResult = false;           //IS_SAVE_RESIZE_RESULT_IMAGE
+	bool bIsSaveSource = false;                 //IS_NEED_SAVE_SOURCE_IMAGE_IN_APP
+	bool bIsSaveOKResult = false;               //IS_NEED_SAVE_OK_RESULT_IMAGE
+
+	int debugCaptureTimes = 0;                  //CAPTUREIMAGETIMES, 0表示按信号
+	int mockFrameIntervalMs = 0;                //MOCK_VIDEO_FRAME_TIME_INTERVAL_MS
+	int lensAddressStride = 1;                  //LENS_RESULT_ADDRESS_STRIDE
+	int ioSignalTimeMs = 0;                     //IO_CARD_SIGNAL_TIME_MS
+	int plcOKValue = 1;                         //PLC_MODBUS_TCP_OK_RESULT_VALUE
+	int plcNGValue = 2;                         //PLC_MODBUS_TCP_NG_RESULT_VALUE
+	int plcTotalDefectAddress = -1;             //PLC_MODBUS_TCP_TOTAL_DEFECT_COUNT_ADDRESS
+	int historyNGNum = 1;                       //UISetting.operation.historyNg.num
+	int qualityRetryTimes = 0;                  //IMAGE_QUALITY_RETRY_TIMES
+	int qualityDefectType = 0;                  //IMAGE_QUALITY_DEFECT_TYPE
+	int heartBeatIntervalMs = 500;              //HEART_BEAT_SIGNAL_TIME_INTERVAL_MS
+	int ioHeartBeatBit = -1;                    //IO_CARD_HEART_BEAT_BIT_ADDRESS, -1表示未配置
+	int plcHeartBeatAddress = -1;               //PLC_MODBUS_TCP_HEART_BEAT_ADDRESS
+	int resultViewerIdleMs = 0;                 //RESULT_RENDER_VIEWER_IDLE_MS, UI超过该时间未读取结果图时不再生成显示图, 0表示总是生成
+	std::vector<int> vQualityRejectAction;      //IMAGE_QUALITY_REJECT_ACTION, 按原因下标
+
+	std::vector<stBoardRuntimeConfig> vBoards;
+
+	//工位下标越界时返回nullptr
+	const stBoardRuntimeConfig *board(const int boardId) const
+	{
+		return (boardId >= 0 && boardId < (int)vBoards.size()) ? &vBoards[boardId] : nullptr;
+	}
+};
+
+class AppRuntimeConfig
+{
+public:
+	static AppRuntimeConfig &instance();
+
+	/**
+	 * @brief parse the json configuration into a new snapshot and publish it, version increases by one.
+	 *        the previous snapshot stays published if any required key is missing or invalid.
+	 * @param numBoards <input> number of boards, <= 0 means the value of the last call
+	 * @return true-published, false-failed
+	 */
+	bool reload(const int numBoards = 0);
+
+	//当前快照, 每帧开始时取一次并在本帧内使用; 未加载时返回空快照, 不会返回nullptr
+	std::shared_ptr<const stRuntimeConfig> get() const;
+	long version() const;
+
+private:
+	AppRuntimeConfig();
+	~AppRuntimeConfig() {}
+	AppRuntimeConfig(const AppRuntimeConfig &) = delete;
+	AppRuntimeConfig &operator=(const AppRuntimeConfig &) = delete;
+
+	std::mutex m_reloadMutex;                       //重新加载串行执行, 读取不加锁
+	std::shared_ptr<const stRuntimeConfig> m_pConfig;   //只通过std::atomic_load/atomic_store访问
+	std::atomic<long> m_version;
+	int m_numBoards;
+};
+
+#endif // XJ_APP_RUNTIME_CONFIG_H
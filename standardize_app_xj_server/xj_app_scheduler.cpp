@@ -0,0 +1,154 @@
+#include "xj_app_scheduler.h"
+#include "logger.h"
+#include <algorithm>
+
+using namespace std;
+
+//同一任务每超时多少次打印一次警告
+#define SCHEDULER_OVERRUN_LOG_INTERVAL 100
+
+static double elapsedMs(const chrono::steady_clock::time_point &start, const chrono::steady_clock::time_point &end)
+{
+	return chrono::duration<double, milli>(end - start).count();
+}
+
+AppScheduler &AppScheduler::instance()
+{
+	static AppScheduler scheduler;
+	return scheduler;
+}
+
+bool AppScheduler::addTask(const string &sName, const int periodMs, const Task &task, const int firstDelayMs)
+{
+	lock_guard<mutex> lock(m_mutex);
+	if(periodMs <= 0 || !task || m_thread.joinable())
+	{
+		LogERROR << "Add scheduled task " << sName << " failed, period = " << periodMs << "ms";
+		return false;
+	}
+	stTask item;
+	item.period = chrono::milliseconds(periodMs);
+	item.firstDelay = chrono::milliseconds(firstDelayMs < 0 ? periodMs : firstDelayMs);
+	item.task = task;
+	item.stats.sName = sName;
+	item.stats.periodMs = periodMs;
+	m_vTasks.emplace_back(item);
+	LogINFO << "Scheduled task " << sName << " added, period = " << periodMs << "ms";
+	return true;
+}
+
+void AppScheduler::start()
+{
+	lock_guard<mutex> lock(m_mutex);
+	if(m_thread.joinable())
+	{
+		return;
+	}
+	const auto now = chrono::steady_clock::now();
+	for(int i = 0; i < (int)m_vTasks.size(); i++)
+	{
+		m_queue.emplace(now + m_vTasks[i].firstDelay, i);
+	}
+	m_bIsStop = false;
+	m_thread = thread(&AppScheduler::run, this);
+	LogINFO << "Scheduler started, tasks = " << m_vTasks.size();
+}
+
+void AppScheduler::stop()
+{
+	{
+		lock_guard<mutex> lock(m_mutex);
+		if(!m_thread.joinable())
+		{
+			return;
+		}
+		m_bIsStop = true;
+	}
+	m_condition.notify_all();
+	m_thread.join();
+
+	logStats("stopped");
+	lock_guard<mutex> lock(m_mutex);
+	m_vTasks.clear();
+	m_queue = decltype(m_queue)();
+}
+
+vector<stScheduledTaskStats> AppScheduler::getStats()
+{
+	vector<stScheduledTaskStats> vStats;
+	lock_guard<mutex> lock(m_mutex);
+	for(const auto &task : m_vTasks)
+	{
+		vStats.emplace_back(task.stats);
+	}
+	return vStats;
+}
+
+void AppScheduler::logStats(const string &sTitle)
+{
+	for(const auto &stats : getStats())
+	{
+		LogINFO << "Scheduler " << sTitle << ", task " << stats.sName << ": runs = " << stats.numRuns << ", overruns = " << stats.numOverruns << ", skipped = " << stats.numSkipped
+				<< ", jitter avg/max = " << stats.avgJitterMs() << "/" << stats.maxJitterMs << "ms, run avg/max = " << stats.avgRunMs() << "/" << stats.maxRunMs << "ms";
+	}
+}
+
+void AppScheduler::run()
+{
+	unique_lock<mutex> lock(m_mutex);
+	while(!m_bIsStop)
+	{
+		if(m_queue.empty())
+		{
+			m_condition.wait(lock);
+			continue;
+		}
+		const ScheduleItem item = m_queue.top();
+		if(chrono::steady_clock::now() < item.first)
+		{
+			m_condition.wait_until(lock, item.first);
+			continue;
+		}
+		m_queue.pop();
+
+		//执行期间不持有锁, 任务列表在运行期间不变
+		stTask &task = m_vTasks[item.second];
+		lock.unlock();
+		const auto startTime = chrono::steady_clock::now();
+		try
+		{
+			task.task();
+		}
+		catch (const exception &e)
+		{
+			LogERROR << "extern: scheduled task " << task.stats.sName << " failed: " << e.what();
+		}
+		const auto endTime = chrono::steady_clock::now();
+		lock.lock();
+
+		stScheduledTaskStats &stats = task.stats;
+		stats.numRuns++;
+		stats.lastJitterMs = elapsedMs(item.first, startTime);
+		stats.maxJitterMs = std::max(stats.maxJitterMs, stats.lastJitterMs);
+		stats.totalJitterMs += stats.lastJitterMs;
+		stats.lastRunMs = elapsedMs(startTime, endTime);
+		stats.maxRunMs = std::max(stats.maxRunMs, stats.lastRunMs);
+		stats.totalRunMs += stats.lastRunMs;
+
+		//按计划时间递推, 不累积漂移; 已错过的周期跳过, 不补执行
+		auto nextTime = item.first + task.period;
+		if(nextTime <= endTime)
+		{
+			const long numSkipped = (endTime - nextTime) / task.period + 1;
+			nextTime += task.period * numSkipped;
+			stats.numOverruns++;
+			stats.numSkipped += numSkipped;
+			if(stats.numOverruns % SCHEDULER_OVERRUN_LOG_INTERVAL == 1)
+			{
+				LogWARNING << "extern: scheduled task " << stats.sName << " overran its period " << stats.periodMs << "ms, jitter = " << stats.lastJitterMs << "ms, run = "
+						   << stats.lastRunMs << "ms, skipped " << numSkipped << " periods, overruns = " << stats.numOverruns;
+			}
+		}
+		m_queue.emplace(nextTime, item.second);
+	}
+}
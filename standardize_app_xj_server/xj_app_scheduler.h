@@ -0,0 +1,84 @@
+#ifndef XJ_APP_SCHEDULER_H
+#define XJ_APP_SCHEDULER_H
+
+#include <queue>
+#include <mutex>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+
+//单个周期任务的统计
+struct stScheduledTaskStats
+{
+	std::string sName;
+	int periodMs = 0;
+	long numRuns = 0;
+	long numOverruns = 0;       //执行完成时已错过下一次计划时间
+	long numSkipped = 0;        //超时跳过的周期数, 不补执行
+	double lastJitterMs = 0;    //实际开始时间与计划时间之差
+	double maxJitterMs = 0;
+	double totalJitterMs = 0;
+	double lastRunMs = 0;
+	double maxRunMs = 0;
+	double totalRunMs = 0;
+
+	double avgJitterMs() const { return numRuns > 0 ? totalJitterMs / numRuns : 0; }
+	double avgRunMs() const { return numRuns > 0 ? totalRunMs / numRuns : 0; }
+};
+
+/*==================================================================================================
+    周期任务调度: 心跳、合并计数、数据库报表、数据清理等后台周期任务共用一个线程, 按计划时间
+    排序(最小堆)依次执行; 记录每个任务的开始抖动、执行耗时和超时. 所有任务一起开始、一起停止
+===================================================================================================*/
+class AppScheduler
+{
+public:
+	typedef std::function<void()> Task;
+
+	static AppScheduler &instance();
+
+	/**
+	 * @brief add a periodic task, only before start()
+	 * @param sName <input> task name, used for logging and statistics
+	 * @param periodMs <input> period of the task
+	 * @param task <input> runs in the scheduler thread, should not block longer than its period
+	 * @param firstDelayMs <input> delay of the first run, < 0 means one period
+	 * @return true-added, false-invalid period or the scheduler is running
+	 */
+	bool addTask(const std::string &sName, const int periodMs, const Task &task, const int firstDelayMs = -1);
+	void start();
+	//等待正在执行的任务完成后退出, 清空任务
+	void stop();
+
+	std::vector<stScheduledTaskStats> getStats();
+
+private:
+	AppScheduler() : m_bIsStop(false) {}
+	~AppScheduler() { stop(); }
+	AppScheduler(const AppScheduler &) = delete;
+	AppScheduler &operator=(const AppScheduler &) = delete;
+
+	void run();
+	void logStats(const std::string &sTitle);
+
+	struct stTask
+	{
+		std::chrono::milliseconds period;
+		std::chrono::milliseconds firstDelay;
+		Task task;
+		stScheduledTaskStats stats;
+	};
+	typedef std::pair<std::chrono::steady_clock::time_point, int> ScheduleItem;
+
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	std::vector<stTask> m_vTasks;
+	std::priority_queue<ScheduleItem, std::vector<ScheduleItem>, std::greater<ScheduleItem>> m_queue;
+	bool m_bIsStop;
+	std::thread m_thread;
+};
+
+#endif // XJ_APP_SCHEDULER_H
@@ -3,6 +3,11 @@
 #include "xj_app_data.h"
 #include "xj_app_io_manager.h"
 #include "xj_app_running_result.h"
+#include "xj_app_runtime_config.h"
+#include "xj_app_product_cache.h"
+#include "xj_app_run_state.h"
+#include "xj_app_scheduler.h"
+#include "xj_app_database.h"
 
 #include "haikang_camera.h"
 #include "haikang_camera_config.h"
@@ -23,6 +28,7 @@
 #include <chrono>
 
 #define DATABASE_ELAPSE_MINUTE 60     // the minutes to update report in database
+#define DEFECT_RETENTION_HOURS 24     // the hours between two defect retention purges
 
 using namespace boost::property_tree;
 using namespace std;
@@ -37,6 +43,7 @@ XJAppServer::XJAppServer(const std::shared_ptr<CameraManager> &pCameraManager, c
 																										m_pSaveImageMultiThread(nullptr),
                                                                                                         m_pProductLine(nullptr),
                                                                                                         m_iPlcDistance(plcDistance),
+                                                                                                        m_heartBeatIndex(0),
                                                                                                         m_sProductName(RunningInfo::instance().GetProductionInfo().GetCurrentProd())
 {
 	m_pDetectors.clear();
@@ -85,6 +92,13 @@ bool XJAppServer::initXJApp(std::shared_ptr<BaseIoManager> &pPlcManager)
 		return false;
 	}
 
+	// parse configuration used in every frame once, detectors read fields from the published snapshot
+	if (!AppRuntimeConfig::instance().reload((int)m_pProductLine->boardsSize()))
+	{
+		LogERROR << "Initial runtime config failed";
+		return false;
+	}
+
 	//bIsMultiThread为false：所有detector共用一个存图线程， bIsMultiThread为true:每个workflow单独一个存图线程
 	const bool bIsMultiThread =  CustomizedJsonConfig::instance().get<bool>("IS_USE_MULTI_THREAD_PER_CAMERA");
 	if(!bIsMultiThread)
@@ -149,6 +163,13 @@ bool XJAppServer::initXJApp(std::shared_ptr<BaseIoManager> &pPlcManager)
 	// log default product name which has be initialed in constructor
 	LogDEBUG << "Default Product: " << m_sProductName;
 
+	// idle detectors wait for run state changes instead of polling, one watcher thread checks the status for all boards
+	AppRunState::instance().start(CustomizedJsonConfig::instance().get<int>("RUN_STATE_POLL_MS"), []()
+	{
+		DetectorRunStatus runStatus;
+		return (int)runStatus.getStatus();
+	});
+
 	return true;
 }
 
@@ -263,6 +284,7 @@ void XJAppServer::initProductCameras()
 	vector<string> vPixelFormat = CustomizedJsonConfig::instance().getVector<string>("CAMERA_PIXEL_FORMAT");
 	vector<int> vDebouncerTime = CustomizedJsonConfig::instance().getVector<int>("CAMERA_LINE_DEBOUNCER_TIME");
 	const vector<bool> vIsSoftTrigger = CustomizedJsonConfig::instance().getVector<bool>("CAMERA_SOFT_TRIGGER_ENABLE");
+	const vector<bool> vIsRawBayer = CustomizedJsonConfig::instance().getVector<bool>("CAMERA_RAW_BAYER");
 	
 	map<int, pair<string, string>> cameraNames;
 	for(int camIdx = 0; camIdx != numCam; camIdx ++)
@@ -282,6 +304,7 @@ void XJAppServer::initProductCameras()
 				pConfig->setSoftTriggerWaitTime(10);
 				pConfig->setSoftTriggerEnable(true);
 			}
+			pConfig->setRawBayerEnable(camIdx < (int)vIsRawBayer.size() && vIsRawBayer[camIdx]);
 
 			shared_ptr<ItekCamera> pCamera = make_shared<ItekCamera>(cameraNames[camIdx].first, cameraNames[camIdx].second, pConfig);	
 			m_pCameraManager->addCamera(pCamera);
@@ -294,6 +317,10 @@ void XJAppServer::initProductCameras()
 				LogERROR << "CAM" << camIdx << " pixel format not support in /opt/config/configuration.json file, right type such as: Mono8, BayerRG8, RGB8";
 				return;
 			}
+			if(camIdx < (int)vIsRawBayer.size() && vIsRawBayer[camIdx])
+			{
+				LogERROR << "CAM" << camIdx << " raw bayer is only supported by LineScan camera, AreaArray camera still outputs demosaiced image";
+			}
 			const int pixelFormat = mapPixelFormat[vPixelFormat[camIdx]];
 			shared_ptr<HaikangCameraConfig> pConfig = make_shared<HaikangCameraConfig>(vCamTimeOut[camIdx], "null.pb", vImageWidth[camIdx], vImageHeight[camIdx], vFps[camIdx], vOffsetX[camIdx], vOffsetY[camIdx], pixelFormat, vExposure[camIdx]);
 			pConfig->setBalanceAutoEnable(false);
@@ -418,26 +445,18 @@ bool XJAppServer::runDetector(const int boardId)
 		return false;
 	}
 
-	const vector<double> vScale = CustomizedJsonConfig::instance().getVector<double>("CAMERA_IMAGE_DRAW_SCALE");
-	const vector<int> vThickness = CustomizedJsonConfig::instance().getVector<int>("CAMERA_IMAGE_DRAW_THICKNESS");
-	const vector<int> boardCountAddressVec = CustomizedJsonConfig::instance().getVector<int>("PLC_MODBUS_TCP_TOTAL_NUM_COUNT_ADDRESS_LIST");
-	const vector<int> boardAppToReal = CustomizedJsonConfig::instance().getVector<int>("BOARD_APP_TO_REAL");
-
-	if(vScale.size() <= boardId)
-	{
-		LogERROR << "extern: json config: DRAW_SCALE";
-		return false;
-	}
-	if(vThickness.size() <= boardId)
+	// one configuration snapshot for the whole frame
+	const shared_ptr<const stRuntimeConfig> pConfig = AppRuntimeConfig::instance().get();
+	const stBoardRuntimeConfig *pBoardConfig = pConfig->board(boardId);
+	if(pBoardConfig == nullptr)
 	{
-		LogERROR << "extern: json config: DRAW_SCALE";
+		LogERROR << "extern: Board[" << boardId << "] runtime config is not loaded";
 		return false;
 	}
 
 	if(m_sCameraType == "mock")
 	{
-		const int timeInterval = CustomizedJsonConfig::instance().get<int>("MOCK_VIDEO_FRAME_TIME_INTERVAL_MS");
-		std::this_thread::sleep_for(std::chrono::milliseconds(timeInterval));
+		std::this_thread::sleep_for(std::chrono::milliseconds(pConfig->mockFrameIntervalMs));
 
 		//////////////////////////// STEP1: get next image ////////////////////////////
 		// product count will be increased if get next frame sucessfully, to make log//
@@ -449,12 +468,6 @@ bool XJAppServer::runDetector(const int boardId)
 			LogERROR << "extern: Board[" << boardId << "] get next image failed";
 			return false;
 		}
-		//set capture image times in detector
-		// m_pDetectors[boardId].m_pDetector->setCaptueImageTimesByProductCount();
-		m_pDetectors[boardId].m_pDetector->setCaptueImageTimesBySignal();	
-		const double t1 = m_vTimer[boardId]->elapsed();
-		LogDEBUG << "extern: Board[" << boardId << "] Time" << m_pDetectors[boardId].m_pDetector->getCaptureImageTimes() << " : get image time cost " << t1  << " seconds";
-		m_pDetectors[boardId].m_pDetector->updateProductCountofWorkflow();
 	}
 	else
 	{
@@ -481,10 +494,19 @@ bool XJAppServer::runDetector(const int boardId)
 			}
 			return false;
 		}
-		//set capture image times in detector
-		m_pDetectors[boardId].m_pDetector->setCaptueImageTimesBySignal();		
-		const double t1 = m_vTimer[boardId]->elapsed();
-		LogDEBUG << "extern: Board[" << boardId << "] Time" << m_pDetectors[boardId].m_pDetector->getCaptureImageTimes() << " : get image time cost " << t1  << " seconds";
+	}
+	const double t1 = m_vTimer[boardId]->elapsed();
+	const chrono::steady_clock::time_point acquireTime = chrono::steady_clock::now();//判定时限从取像完成开始计时
+	LogDEBUG << "extern: Board[" << boardId << "] get image time cost " << t1  << " seconds";
+
+	//////////////////////////// STEP1.5: frame context from PLC ////////////////////////////
+	// capture times signal and product count of the frame just acquired, both are PLC round trips
+	m_vTimer[boardId]->reset();
+	// m_pDetectors[boardId].m_pDetector->setCaptueImageTimesByProductCount();
+	m_pDetectors[boardId].m_pDetector->setCaptueImageTimesBySignal();
+	if(m_sCameraType == "mock")
+	{
+		m_pDetectors[boardId].m_pDetector->updateProductCountofWorkflow();
 	}
 
 	const int totalTimes = m_pDetectors[boardId].m_pDetector->getCaptureImageTotalTimes();
@@ -494,16 +516,15 @@ bool XJAppServer::runDetector(const int boardId)
 		m_pDetectors[boardId].m_pDetector->resetProductCount(m_pDetectors[boardId].m_pDetector->productCount() - 1);
 	}
 	//m_pDetectors[boardId].m_pDetector->updateProductCountofWorkflow();
-
-
-	//////////////////////////// STEP2: pre-process next image ////////////////////////////
-	m_vTimer[boardId]->reset();
-	LogDEBUG << "extern: Board[" << boardId << "] process image started. \t Product count: " << m_pDetectors[boardId].m_pDetector->productCount();
 	if (nullptr != m_pIoManager)
 	{
-		const int boardCountAddress = boardCountAddressVec.at(boardAppToReal.at(boardId));
+		const int boardCountAddress = pBoardConfig->plcCountAddress;
 		int boardProductCount = 0;
-		if (dynamic_pointer_cast<AppIoManagerPLC>(m_pIoManager)->readRegister(boardCountAddress, boardProductCount))
+		if (boardCountAddress < 0)
+		{
+			LogERROR << "extern: Board[" << boardId << "] json config: PLC_MODBUS_TCP_TOTAL_NUM_COUNT_ADDRESS_LIST or BOARD_APP_TO_REAL";
+		}
+		else if (dynamic_pointer_cast<AppIoManagerPLC>(m_pIoManager)->readRegister(boardCountAddress, boardProductCount))
 		{
 			m_pDetectors[boardId].m_pDetector->updateProductCountofWorkflow(boardProductCount);
 			LogDEBUG << "extern: Board[" << boardId << "] read product count from plc, address : " << boardCountAddress << ", value: " << boardProductCount;
@@ -513,13 +534,21 @@ bool XJAppServer::runDetector(const int boardId)
 			LogERROR << "extern: Board[" << boardId << "] read product count from plc failed! ";
 		}
 	}
-	
+	//拍照次数确定后才知道本帧是否给出判定
+	m_pDetectors[boardId].m_pDetector->armVerdictDeadline(acquireTime);
+	const double tContext = m_vTimer[boardId]->elapsed();
+	LogDEBUG << "extern: Board[" << boardId << "] Time" << m_pDetectors[boardId].m_pDetector->getCaptureImageTimes() << " : plc context time cost " << tContext << " seconds";
+
+	//////////////////////////// STEP2: pre-process next image ////////////////////////////
+	// with the inspection pipeline enabled this only copies the frame and submits it, 
+	// inspection, verdict and rendering run on the pipeline threads
+	m_vTimer[boardId]->reset();
+	LogDEBUG << "extern: Board[" << boardId << "] process image started. \t Product count: " << m_pDetectors[boardId].m_pDetector->productCount();
 	if (!m_pDetectors[boardId].m_pDetector->imagePreProcess())
 	{
 		LogERROR << "extern: Board[" << boardId << "] process next image failed";
 		//send NG signal to PLC
-		const bool bIsResultOK = false;
-		m_pDetectors[boardId].m_pDetector->sendResultSignalToPLC(bIsResultOK);
+		m_pDetectors[boardId].m_pDetector->sendFailedResultSignal();
 		m_pDetectors[boardId].m_pDetector->setCaptureImageTimes((int)CaptureImageTimes::UNKNOWN_TIMES);
 		//AppRunningResult::instance().setProductCountResult(boardId, m_pDetectors[boardId].m_pDetector->productCount(), false);
 		return false;
@@ -534,8 +563,7 @@ bool XJAppServer::runDetector(const int boardId)
 	{
 		LogERROR << "extern: Board[" << boardId << "] classify board failed";
 		//send NG signal to PLC
-		const bool bIsResultOK = false;
-		m_pDetectors[boardId].m_pDetector->sendResultSignalToPLC(bIsResultOK);
+		m_pDetectors[boardId].m_pDetector->sendFailedResultSignal();
 		m_pDetectors[boardId].m_pDetector->setCaptureImageTimes((int)CaptureImageTimes::UNKNOWN_TIMES);
 		//AppRunningResult::instance().setProductCountResult(boardId, m_pDetectors[boardId].m_pDetector->productCount(), false);
 		return false;
@@ -558,14 +586,14 @@ bool XJAppServer::runDetector(const int boardId)
 	//////////////////////////// STEP5: draw next image ////////////////////////////
 	m_vTimer[boardId]->reset();
 	LogDEBUG << "extern: Board[" << boardId << "] drawing started. \t Product count: " << m_pDetectors[boardId].m_pDetector->productCount();
-	if (!m_pDetectors[boardId].m_pDetector->drawBoard(vScale[boardId]))
+	if (!m_pDetectors[boardId].m_pDetector->drawBoard(pBoardConfig->drawScale))
 	{
 		LogERROR << "extern: Board[" << boardId << "] draw board failed";
 		return false;
 	}
 	const double t5 = m_vTimer[boardId]->elapsed();
 	LogDEBUG << "extern: Board[" << boardId << "] Time" << m_pDetectors[boardId].m_pDetector->getCaptureImageTimes() << " : draw board time cost " << t5 << " seconds";
-	LogINFO << "extern: Board[" << boardId << "] Time" << m_pDetectors[boardId].m_pDetector->getCaptureImageTimes() << " : total detect time cost except for getting image " << t2 + t3 + t4 + t5 << " seconds";
+	LogINFO << "extern: Board[" << boardId << "] Time" << m_pDetectors[boardId].m_pDetector->getCaptureImageTimes() << " : total detect time cost except for getting image " << tContext + t2 + t3 + t4 + t5 << " seconds";
 
 	return true;
 }
@@ -609,11 +637,13 @@ bool XJAppServer::parametersTest(const int boardId)
 		LogDEBUG << "extern: Board[" << boardId << "] process image started.";
 		if (nullptr != m_pIoManager)
 		{
-			const vector<int> boardCountAddressVec = CustomizedJsonConfig::instance().getVector<int>("PLC_MODBUS_TCP_TOTAL_NUM_COUNT_ADDRESS_LIST");
-			const vector<int> boardAppToReal = CustomizedJsonConfig::instance().getVector<int>("BOARD_APP_TO_REAL");
-			const int boardCountAddress = boardCountAddressVec.at(boardAppToReal.at(boardId));
+			const stBoardRuntimeConfig *pBoardConfig = AppRuntimeConfig::instance().get()->board(boardId);
+			const int boardCountAddress = (pBoardConfig != nullptr) ? pBoardConfig->plcCountAddress : -1;
 			int boardProductCount = 0;
-			dynamic_pointer_cast<AppIoManagerPLC>(m_pIoManager)->readRegister(boardCountAddress, boardProductCount);
+			if (boardCountAddress >= 0)
+			{
+				dynamic_pointer_cast<AppIoManagerPLC>(m_pIoManager)->readRegister(boardCountAddress, boardProductCount);
+			}
 			m_pDetectors[boardId].m_pDetector->updateProductCountofWorkflow(boardProductCount);
 			LogDEBUG << "extern: Board[" << boardId << "] read product count from plc, address : " << boardCountAddress << ", value: " << boardProductCount;
 		}
@@ -684,12 +714,13 @@ bool XJAppServer::saveCameraTriggeredTestImages(const int boardId)
 void XJAppServer::startDetector(const int boardId)
 {
 	bool areCamerasReady = false;
-	timer_utils::Timer<chrono::minutes> reportTimer;
 	DetectorRunStatus runStatus;
+	DetectorRunStatus::Status lastRunStatus = DetectorRunStatus::Status::NOT_RUN;
+	long lastGeneration = AppRunState::instance().generation();
+	chrono::steady_clock::time_point transitionTime = chrono::steady_clock::now();
 
 	try
 	{
-		reportTimer.Reset();
 		while (true)
 		{
 			if (m_bIsStop)
@@ -698,21 +729,35 @@ void XJAppServer::startDetector(const int boardId)
 				break;
 			}
 			//////////////////////////// PRESTEP0: get current running status ////////////////////////////
-			//  get current Run/Test/TriggerCameraImage status
+			//  get current Run/Test/TriggerCameraImage status, the generation is read first so no change is missed while waiting
+			const long stateGeneration = AppRunState::instance().generation();
 			DetectorRunStatus::Status currentRunStatus = runStatus.getStatus();
+			if (currentRunStatus != lastRunStatus)
+			{
+				//检测中自己先发现的变化还没有通知, 从现在开始计时
+				const auto now = chrono::steady_clock::now();
+				transitionTime = (stateGeneration != lastGeneration) ? AppRunState::instance().changeTime() : now;
+				const double wakeMs = chrono::duration<double, milli>(now - transitionTime).count();
+				AppRunState::instance().addTransition(boardId, (int)currentRunStatus, wakeMs);
+				LogINFO << "extern: Board[" << boardId << "] run status " << (int)lastRunStatus << " -> " << (int)currentRunStatus << ", wake latency = " << wakeMs << "ms";
+				lastRunStatus = currentRunStatus;
+			}
+			lastGeneration = stateGeneration;
 
 			//////////////////////////// PRESTEP1: running status check ////////////////////////////
-			//  if system is not running which is 0, sleep and continue
+			//  if system is not running which is 0, wait for the next run state change
 			if (currentRunStatus == DetectorRunStatus::Status::NOT_RUN)
 			{
-				std::this_thread::sleep_for(std::chrono::milliseconds(5));
 				if (isProductSwitched())
 				{
 					LogDEBUG << "extern: Board[" << boardId << "] current product: " << m_sProductName;
-					// add your product reconfiguration code here
+					//停机换产时提前读取新产品参数, 开始检测时直接使用缓存
+					AppProductCache::instance().prefetch(m_sProductName);
 				}
 				// set the first time start flag to true, wait for next time to initialize paramters
 				m_pDetectors[boardId].m_bIsFirstStart = true;
+				AppRunState::instance().waitForChange(stateGeneration);
+				AppRunState::instance().addWakeup(boardId);
 				continue;
 			}
 
@@ -725,7 +770,7 @@ void XJAppServer::startDetector(const int boardId)
 				{
 					if (!camerasAreReady(boardId))
 					{
-						std::this_thread::sleep_for(std::chrono::milliseconds(5));
+						AppRunState::instance().waitForChange(stateGeneration, chrono::steady_clock::now() + chrono::milliseconds(5));
 						continue;
 					}
 					areCamerasReady = true;
@@ -736,25 +781,28 @@ void XJAppServer::startDetector(const int boardId)
 			// if the system is restarted then at the first time we will reinitialize parameters
 			if (m_pDetectors[boardId].m_bIsFirstStart)
 			{
+				//先记录版本再初始化, 初始化期间的修改在下一帧热更新
+				const long paramsVersion = AppRunningResult::instance().getParamsVersion();
 				if (!initBoardParameters(boardId))
 				{
 					LogERROR << "extern: Board[" << boardId << "] initial parameters error, try again. ";
-					std::this_thread::sleep_for(std::chrono::milliseconds(500));
+					AppRunState::instance().waitForChange(stateGeneration, chrono::steady_clock::now() + chrono::milliseconds(500));
 					continue;
 				}
 				m_pDetectors[boardId].m_bIsFirstStart = false; // only initalize once when first time to start
+				m_pDetectors[boardId].m_paramsVersion = paramsVersion;
+				const double readyMs = chrono::duration<double, milli>(chrono::steady_clock::now() - transitionTime).count();
+				AppRunState::instance().addReady(boardId, readyMs);
+				LogINFO << "extern: Board[" << boardId << "] ready " << readyMs << "ms after run status changed";
 			}
 
-			//////////////////////////// PRESTEP4: update database report ////////////////////////////
-			//  update database report using report_add, it will update record with time, product, board...
-			if (reportTimer.Elapsed().count() >= DATABASE_ELAPSE_MINUTE)
+			//////////////////////////// PRESTEP3.1: thresholds hot update ////////////////////////////
+			// thresholds changed from web are applied between frames, without stopping detector or reloading models
+			const long paramsVersion = AppRunningResult::instance().getParamsVersion();
+			if (paramsVersion != m_pDetectors[boardId].m_paramsVersion)
 			{
-				reportTimer.Reset();
-				if (!updateDatabaseReport(boardId))
-				{
-					LogERROR << "extern: Board[" << boardId << "] update report in database failed";
-					continue;
-				}
+				m_pDetectors[boardId].m_paramsVersion = paramsVersion;
+				m_pDetectors[boardId].m_pDetector->updateParameters((int)currentRunStatus);
 			}
 
 			switch (currentRunStatus)
@@ -767,6 +815,12 @@ void XJAppServer::startDetector(const int boardId)
 					{
 						parametersTest(boardId);
 						RunningInfo::instance().GetTestProductionInfo().SetTestStatus(0);
+						AppRunState::instance().notify("test finished");
+					}
+					else
+					{
+						// other boards wait until the test finishes
+						AppRunState::instance().waitForChange(stateGeneration);
 					}
 					break;
 				case DetectorRunStatus::Status::TEST_RUN_WITH_CAMERA:
@@ -774,6 +828,10 @@ void XJAppServer::startDetector(const int boardId)
 					{
 						saveCameraTriggeredTestImages(boardId);
 					}
+					else
+					{
+						AppRunState::instance().waitForChange(stateGeneration);
+					}
 					break;
 				default:
 					LogERROR << "extern: Detector has invalid running status";
@@ -804,98 +862,129 @@ void XJAppServer::startDetector(const int boardId)
 	return;
 }
 
-void XJAppServer::checkHeartBeat()
+void XJAppServer::startBackgroundTasks(const bool bIsSendHeartBeat)
 {
-	const bool bIsUseIoCard = CustomizedJsonConfig::instance().get<bool>("IS_USE_IO_CARD");
-	const int signal_change_interval_ms = CustomizedJsonConfig::instance().get<int>("HEART_BEAT_SIGNAL_TIME_INTERVAL_MS");
-	const int iBit = CustomizedJsonConfig::instance().get<int>("IO_CARD_HEART_BEAT_BIT_ADDRESS");
-	const int iAddress = CustomizedJsonConfig::instance().get<int>("PLC_MODBUS_TCP_HEART_BEAT_ADDRESS");
-
-	int iSignalIndex = 0;
-	DetectorRunStatus runStatus;
-	timer_utils::Timer<std::chrono::milliseconds> checkTimer;
-	checkTimer.Reset();
-	while (true)
-	{
-		if (m_bIsStop)
+	// all periodic work shares one scheduler thread instead of a spinning thread per task
+	// heartbeat settings are read once from the runtime snapshot, not from the json on every tick
+	const shared_ptr<const stRuntimeConfig> pConfig = AppRuntimeConfig::instance().get();
+	const int signal_change_interval_ms = pConfig->heartBeatIntervalMs;
+	if (bIsSendHeartBeat)
+	{
+		const bool bIsUseIoCard = pConfig->bIsUseIoCard;
+		const int iBit = pConfig->ioHeartBeatBit;
+		const int iAddress = pConfig->plcHeartBeatAddress;
+		if ((bIsUseIoCard ? iBit : iAddress) < 0 || nullptr == m_pIoManager)
+		{
+			LogERROR << "extern: heart beat address is not configured or io manager is not ready, heart beat is not sent";
+		}
+		else
 		{
-			 LogDEBUG<< "check heartbeat exit...";
-			break;
+			AppScheduler::instance().addTask("heartbeat", signal_change_interval_ms, [this, bIsUseIoCard, iBit, iAddress]()
+			{
+				sendHeartBeat(bIsUseIoCard, iBit, iAddress);
+			});
 		}
+	}
+	if (CustomizedJsonConfig::instance().get<bool>("IS_USE_MERGE_SERVER"))
+	{
+		AppScheduler::instance().addTask("merge-total", signal_change_interval_ms, [this]() { updateMergeTotal(); });
+	}
+	AppScheduler::instance().addTask("database-report", DATABASE_ELAPSE_MINUTE * 60 * 1000, [this]() { updateDatabaseReports(); });
 
-		if(checkTimer.Elapsed().count() > signal_change_interval_ms)
+	// defect records older than the retention days are purged once a day, the first purge one minute after start
+	const int retentionDays = CustomizedJsonConfig::instance().get<int>("DEFECT_RETENTION_DAYS");
+	if (retentionDays > 0)
+	{
+		AppScheduler::instance().addTask("defect-retention", DEFECT_RETENTION_HOURS * 3600 * 1000, [retentionDays]()
 		{
-			checkTimer.Reset();
+			AppDatabase db;
+			db.defectDeleteDaysAgo(retentionDays);
+		}, 60 * 1000);
+	}
+	AppScheduler::instance().start();
+}
 
-			iSignalIndex++;
-			if(iSignalIndex == INT_MAX)
-			{
-				iSignalIndex = 0;
-			}
+void XJAppServer::stopBackgroundTasks()
+{
+	AppScheduler::instance().stop();
+}
 
-			const int data = iSignalIndex%2;
-			if(bIsUseIoCard)
-			{
-				dynamic_pointer_cast<AppIoManagerIOCard>(m_pIoManager)->writeBit(0, iBit, 1);
-				std::this_thread::sleep_for(std::chrono::milliseconds(20));
-				dynamic_pointer_cast<AppIoManagerIOCard>(m_pIoManager)->writeBit(0, iBit, 0);
-				LogINFO << "send heart beat data:" << 1 << " to IO bit address:" << iBit;
-			}
-			else
-			{
-				dynamic_pointer_cast<AppIoManagerPLC>(m_pIoManager)->writeRegister(iAddress, data);					
-				LogINFO << "send heart beat data:" << data << " to PLC register address:" << iAddress;		
-			}
+void XJAppServer::sendHeartBeat(const bool bIsUseIoCard, const int iBit, const int iAddress)
+{
+	m_heartBeatIndex++;
+	if(m_heartBeatIndex == INT_MAX)
+	{
+		m_heartBeatIndex = 0;
+	}
+
+	const int data = m_heartBeatIndex%2;
+	if(bIsUseIoCard)
+	{
+		dynamic_pointer_cast<AppIoManagerIOCard>(m_pIoManager)->writeBit(0, iBit, 1);
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		dynamic_pointer_cast<AppIoManagerIOCard>(m_pIoManager)->writeBit(0, iBit, 0);
+		LogINFO << "send heart beat data:" << 1 << " to IO bit address:" << iBit;
+	}
+	else
+	{
+		if(!dynamic_pointer_cast<AppIoManagerPLC>(m_pIoManager)->writeRegister(iAddress, data))
+		{
+			//心跳写入失败说明PLC连接断开过, 重连后重新写入产品PLC参数
+			AppDetector::notifyPlcWriteFailed();
+			LogERROR << "extern: failed to send heart beat data:" << data << " to PLC register address:" << iAddress;
+			return;
 		}
+		LogINFO << "send heart beat data:" << data << " to PLC register address:" << iAddress;		
 	}
 }
 
 void XJAppServer::updateMergeTotal()
 {
+	DetectorRunStatus runStatus;
+	if (runStatus.getStatus() == XJAppServer::DetectorRunStatus::Status::NOT_RUN)
+	{
+		return;
+	}
+
 	const bool bIsUseIoCard = CustomizedJsonConfig::instance().get<bool>("IS_USE_IO_CARD");
-	const int signal_change_interval_ms = CustomizedJsonConfig::instance().get<int>("HEART_BEAT_SIGNAL_TIME_INTERVAL_MS");
-	timer_utils::Timer<std::chrono::milliseconds> checkTimer;
-	checkTimer.Reset();
-	while (true)
+	int valueTotalNum = 0;
+	int valueTotalDefect = 0;
+	if (m_sCameraType == "mock" || bIsUseIoCard || nullptr == m_pIoManager)
 	{
-		if (m_bIsStop)
-		{
-			LogDEBUG<< "check heartbeat exit...";
-			break;
-		}
-		DetectorRunStatus runStatus;
-		if (runStatus.getStatus() == XJAppServer::DetectorRunStatus::Status::NOT_RUN)
-		{
-			checkTimer.Reset();
-			continue;
-		}
-		if(checkTimer.Elapsed().count() > signal_change_interval_ms)
-		{
-			checkTimer.Reset();
-			int valueTotalNum = 0;
-			int valueTotalDefect = 0;
-			if (m_sCameraType == "mock" || bIsUseIoCard || nullptr == m_pIoManager)
-			{
-				map<string, int> result;
-				RunningInfo::instance().GetRunningData().GetRunningData(result);
-				valueTotalNum = result["totalNum"];
-				valueTotalDefect = result["totalDefect"];
-			}
-			else
-			{
-				const int addressTotalNum = CustomizedJsonConfig::instance().get<int>("PLC_MODBUS_TCP_TOTAL_NUM_COUNT_ADDRESS");
-				dynamic_pointer_cast<AppIoManagerPLC>(m_pIoManager)->readRegister(addressTotalNum, valueTotalNum);
-				std::this_thread::sleep_for(std::chrono::milliseconds(10));
-			
-				const int addressTotalDefect = CustomizedJsonConfig::instance().get<int>("PLC_MODBUS_TCP_TOTAL_DEFECT_COUNT_ADDRESS");
-				dynamic_pointer_cast<AppIoManagerPLC>(m_pIoManager)->readRegister(addressTotalDefect, valueTotalDefect);
-			}
+		map<string, int> result;
+		RunningInfo::instance().GetRunningData().GetRunningData(result);
+		valueTotalNum = result["totalNum"];
+		valueTotalDefect = result["totalDefect"];
+	}
+	else
+	{
+		const int addressTotalNum = CustomizedJsonConfig::instance().get<int>("PLC_MODBUS_TCP_TOTAL_NUM_COUNT_ADDRESS");
+		dynamic_pointer_cast<AppIoManagerPLC>(m_pIoManager)->readRegister(addressTotalNum, valueTotalNum);
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	
+		const int addressTotalDefect = CustomizedJsonConfig::instance().get<int>("PLC_MODBUS_TCP_TOTAL_DEFECT_COUNT_ADDRESS");
+		dynamic_pointer_cast<AppIoManagerPLC>(m_pIoManager)->readRegister(addressTotalDefect, valueTotalDefect);
+	}
 
-			LogDEBUG << "update: valueTotalNum" << valueTotalNum << " valueTotalDefect:" << valueTotalDefect;
-			AppRunningResult::instance().updateDisplayTotalInfo(valueTotalNum, valueTotalDefect);			
+	LogDEBUG << "update: valueTotalNum" << valueTotalNum << " valueTotalDefect:" << valueTotalDefect;
+	AppRunningResult::instance().updateDisplayTotalInfo(valueTotalNum, valueTotalDefect);			
+}
+
+void XJAppServer::updateDatabaseReports()
+{
+	//  update database report using report_add while detecting, it will update record with time, product, board...
+	DetectorRunStatus runStatus;
+	if (runStatus.getStatus() == XJAppServer::DetectorRunStatus::Status::NOT_RUN)
+	{
+		return;
+	}
+	for (int boardId = 0; boardId < (int)m_pDetectors.size(); boardId++)
+	{
+		if (!updateDatabaseReport(boardId))
+		{
+			LogERROR << "extern: Board[" << boardId << "] update report in database failed";
 		}
 	}
-	return;
 }
 
 void XJAppServer::stopDetectors()
@@ -903,4 +992,5 @@ void XJAppServer::stopDetectors()
 	// TODO to set stop flag
 	LogDEBUG << "Detectors ask to stop...";
 	m_bIsStop = true;
+	AppRunState::instance().requestShutdown();
 }
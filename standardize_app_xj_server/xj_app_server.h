@@ -50,8 +50,9 @@ public:
 #endif
 
 	void startDetector(const int boardId);
-	void checkHeartBeat();
-	void updateMergeTotal();
+	//心跳、合并计数、数据库报表、数据清理等周期任务, 在一个调度线程中执行
+	void startBackgroundTasks(const bool bIsSendHeartBeat);
+	void stopBackgroundTasks();
 	
 	static void stopDetectors();
 private:
@@ -70,9 +71,10 @@ private:
 	struct ServerDetector
 	{
 		bool m_bIsFirstStart;
+		long m_paramsVersion;	//已生效的参数版本, 与AppRunningResult中的版本不同时热更新阈值
 		std::shared_ptr<AppDetector> m_pDetector;
 
-		ServerDetector(const std::shared_ptr<AppDetector> &pDetector) : m_bIsFirstStart(true), m_pDetector(pDetector) {}
+		ServerDetector(const std::shared_ptr<AppDetector> &pDetector) : m_bIsFirstStart(true), m_paramsVersion(0), m_pDetector(pDetector) {}
 	};
 	std::vector<ServerDetector> m_pDetectors;
 
@@ -82,8 +84,7 @@ private:
 	int m_iPlcDistance;
 
 	std::vector<std::shared_ptr<AppTimer>> m_vTimer;
-
-	std::shared_ptr<ThreadPool> m_pWorkerThread;
+	int m_heartBeatIndex;
 
 	bool initProductLine();
 	bool initTargetMarginInBoard(const int boardId);
@@ -94,6 +95,9 @@ private:
 
 	bool camerasAreReady(const int boardId);
 	bool updateDatabaseReport(const int boardId);
+	void updateDatabaseReports();
+	void sendHeartBeat(const bool bIsUseIoCard, const int iBit, const int iAddress);
+	void updateMergeTotal();
 
 	bool runDetector(const int boardId);
 	bool parametersTest(const int boardId);
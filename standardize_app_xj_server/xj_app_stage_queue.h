@@ -0,0 +1,152 @@
+#ifndef XJ_APP_STAGE_QUEUE_H
+#define XJ_APP_STAGE_QUEUE_H
+
+#include <mutex>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <condition_variable>
+
+//队列满时的处理方式
+enum class StageQueuePolicy : int
+{
+	BLOCK = 0,          //阻塞上游, 直到下游取走
+	DROP_NEWEST = 1,    //丢弃新放入的一项
+	DROP_OLDEST = 2     //丢弃队列中最早的一项
+};
+
+//队列统计
+struct stStageQueueStats
+{
+	long numPushed = 0;
+	long numPopped = 0;
+	long numDropped = 0;
+	int depth = 0;              //当前深度
+	int maxDepth = 0;           //深度峰值
+	double maxBlockMs = 0;      //BLOCK方式下上游等待的最长时间
+};
+
+//单个阶段的耗时统计
+struct stStageStats
+{
+	long count = 0;
+	double totalMs = 0;
+	double maxMs = 0;
+
+	void add(const double ms)
+	{
+		count++;
+		totalMs += ms;
+		maxMs = std::max(maxMs, ms);
+	}
+	double avgMs() const { return count > 0 ? totalMs / count : 0; }
+};
+
+/*==================================================================================================
+            流水线阶段之间的有界队列: 单生产者、单消费者, 环形缓冲区容量固定, 运行中不分配内存
+===================================================================================================*/
+template <typename T>
+class AppStageQueue
+{
+public:
+	AppStageQueue(const int capacity, const StageQueuePolicy policy) :
+				m_vItems(std::max(1, capacity)), m_head(0), m_size(0), m_policy(policy), m_bIsClosed(false)
+	{
+	}
+
+	/**
+	 * @brief put one item, behaviour on a full queue follows the policy
+	 * @param item <input> moved into the queue unless it is dropped
+	 * @return false if an item was dropped (the new one or the oldest) or the queue is closed
+	 */
+	bool push(T &&item)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		bool bIsDropped = false;
+		if(m_size == (int)m_vItems.size())
+		{
+			if(m_policy == StageQueuePolicy::DROP_NEWEST)
+			{
+				m_stats.numDropped++;
+				return false;
+			}
+			if(m_policy == StageQueuePolicy::DROP_OLDEST)
+			{
+				m_vItems[m_head] = T();
+				m_head = (m_head + 1) % m_vItems.size();
+				m_size--;
+				m_stats.numDropped++;
+				bIsDropped = true;
+			}
+			else
+			{
+				const auto start = std::chrono::steady_clock::now();
+				m_condNotFull.wait(lock, [this](){ return m_bIsClosed || m_size < (int)m_vItems.size(); });
+				m_stats.maxBlockMs = std::max(m_stats.maxBlockMs, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+			}
+		}
+		if(m_bIsClosed)
+		{
+			return false;
+		}
+		m_vItems[(m_head + m_size) % m_vItems.size()] = std::move(item);
+		m_size++;
+		m_stats.numPushed++;
+		m_stats.maxDepth = std::max(m_stats.maxDepth, m_size);
+		lock.unlock();
+		m_condNotEmpty.notify_one();
+		return !bIsDropped;
+	}
+
+	//取出一项, 队列为空时等待; 关闭且取完后返回false
+	bool pop(T &item)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_condNotEmpty.wait(lock, [this](){ return m_bIsClosed || m_size > 0; });
+		if(m_size == 0)
+		{
+			return false;
+		}
+		item = std::move(m_vItems[m_head]);
+		m_vItems[m_head] = T();
+		m_head = (m_head + 1) % m_vItems.size();
+		m_size--;
+		m_stats.numPopped++;
+		lock.unlock();
+		m_condNotFull.notify_one();
+		return true;
+	}
+
+	//不再接收新项, 已放入的项仍可取出
+	void close()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_bIsClosed = true;
+		}
+		m_condNotEmpty.notify_all();
+		m_condNotFull.notify_all();
+	}
+
+	stStageQueueStats getStats()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		stStageQueueStats stats = m_stats;
+		stats.depth = m_size;
+		return stats;
+	}
+
+private:
+	std::vector<T> m_vItems;
+	int m_head;
+	int m_size;
+	const StageQueuePolicy m_policy;
+	bool m_bIsClosed;
+	stStageQueueStats m_stats;
+
+	std::mutex m_mutex;
+	std::condition_variable m_condNotEmpty;
+	std::condition_variable m_condNotFull;
+};
+
+#endif // XJ_APP_STAGE_QUEUE_H
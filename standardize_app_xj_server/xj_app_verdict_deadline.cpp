@@ -0,0 +1,161 @@
+#include "xj_app_verdict_deadline.h"
+#include "logger.h"
+#include <algorithm>
+
+using namespace std;
+
+//已发出兜底判定的帧最多保留多少个, 更早的迟到判定按正常判定处理
+#define VERDICT_FIRED_HISTORY 256
+
+static const char *getStageName(const VerdictStage stage)
+{
+	static const char *vNames[(int)VerdictStage::NUM] = {"context", "inspect", "commit"};
+	return (stage >= VerdictStage::CONTEXT && stage < VerdictStage::NUM) ? vNames[(int)stage] : "unknown";
+}
+
+AppVerdictDeadline::AppVerdictDeadline(const int boardId, const int deadlineMs, const int marginMs, const FallbackHandler &fallback) :
+			m_boardId(boardId),
+			m_fireDelay(std::max(0, deadlineMs - std::max(0, marginMs))),
+			m_fallback(fallback),
+			m_nextTicket(0),
+			m_bIsStop(false)
+{
+	m_thread = thread(&AppVerdictDeadline::run, this);
+	LogINFO << "Board[" << m_boardId << "] verdict deadline started, deadline = " << deadlineMs << "ms, margin = " << marginMs << "ms";
+}
+
+AppVerdictDeadline::~AppVerdictDeadline()
+{
+	{
+		lock_guard<mutex> lock(m_mutex);
+		m_bIsStop = true;
+	}
+	m_condition.notify_all();
+	m_thread.join();
+
+	logStats("stopped");
+}
+
+long AppVerdictDeadline::arm(const chrono::steady_clock::time_point &acquireTime)
+{
+	stEntry entry;
+	entry.acquireTime = acquireTime;
+	entry.fireTime = acquireTime + m_fireDelay;
+	//读取帧信息后已经超时, 计入读取帧信息阶段
+	entry.stage = (chrono::steady_clock::now() >= entry.fireTime) ? VerdictStage::CONTEXT : VerdictStage::INSPECT;
+
+	long ticket = 0;
+	{
+		lock_guard<mutex> lock(m_mutex);
+		ticket = m_nextTicket++;
+		m_mapArmed[ticket] = entry;
+		m_stats.numArmed++;
+	}
+	m_condition.notify_one();
+	return ticket;
+}
+
+void AppVerdictDeadline::setStage(const long ticket, const VerdictStage stage)
+{
+	lock_guard<mutex> lock(m_mutex);
+	auto itr = m_mapArmed.find(ticket);
+	if(itr != m_mapArmed.end())
+	{
+		itr->second.stage = stage;
+	}
+}
+
+bool AppVerdictDeadline::resolve(const long ticket, const bool bIsOK)
+{
+	if(ticket < 0)
+	{
+		return true;
+	}
+
+	unique_lock<mutex> lock(m_mutex);
+	auto itr = m_mapArmed.find(ticket);
+	if(itr != m_mapArmed.end())
+	{
+		m_mapArmed.erase(itr);
+		m_stats.numOnTime++;
+		return true;
+	}
+	//一帧多片镜片时后续镜片的判定不在记录中, 随第一片镜片
+	auto fired = m_mapFired.find(ticket);
+	if(fired == m_mapFired.end())
+	{
+		return true;
+	}
+	const double lateMs = chrono::duration<double, milli>(chrono::steady_clock::now() - fired->second).count();
+	m_stats.numLate++;
+	m_stats.numLateOK += bIsOK ? 1 : 0;
+	m_stats.maxLateMs = std::max(m_stats.maxLateMs, lateMs);
+	const long numLate = m_stats.numLate;
+	const long numLateOK = m_stats.numLateOK;
+	lock.unlock();
+
+	LogWARNING << "extern: Board[" << m_boardId << "] verdict " << (bIsOK ? "ok" : "ng") << " arrived " << lateMs << "ms after acquisition, fallback already sent, late total = "
+			   << numLate << ", late ok = " << numLateOK;
+	return false;
+}
+
+stVerdictDeadlineStats AppVerdictDeadline::getStats()
+{
+	lock_guard<mutex> lock(m_mutex);
+	return m_stats;
+}
+
+void AppVerdictDeadline::logStats(const string &sTitle)
+{
+	const stVerdictDeadlineStats stats = getStats();
+	LogINFO << "Board[" << m_boardId << "] verdict deadline " << sTitle << ", armed = " << stats.numArmed << ", on time = " << stats.numOnTime << ", missed = " << stats.numMissed
+			<< " (context " << stats.vMissedByStage[(int)VerdictStage::CONTEXT] << ", inspect " << stats.vMissedByStage[(int)VerdictStage::INSPECT]
+			<< ", commit " << stats.vMissedByStage[(int)VerdictStage::COMMIT] << "), late = " << stats.numLate << ", late ok = " << stats.numLateOK
+			<< ", max late = " << stats.maxLateMs << "ms";
+}
+
+void AppVerdictDeadline::run()
+{
+	unique_lock<mutex> lock(m_mutex);
+	while(!m_bIsStop)
+	{
+		if(m_mapArmed.empty())
+		{
+			m_condition.wait(lock);
+			continue;
+		}
+		//取像时间递增, 第一项最先到期
+		auto itr = m_mapArmed.begin();
+		const chrono::steady_clock::time_point fireTime = itr->second.fireTime;
+		if(chrono::steady_clock::now() < fireTime)
+		{
+			m_condition.wait_until(lock, fireTime);
+			continue;
+		}
+
+		const long ticket = itr->first;
+		const VerdictStage stage = itr->second.stage;
+		m_mapFired[ticket] = itr->second.acquireTime;
+		m_mapArmed.erase(itr);
+		while(m_mapFired.size() > VERDICT_FIRED_HISTORY)
+		{
+			m_mapFired.erase(m_mapFired.begin());
+		}
+		m_stats.numMissed++;
+		m_stats.vMissedByStage[(int)stage]++;
+		const long numMissed = m_stats.numMissed;
+		lock.unlock();
+
+		//先发信号再打印日志
+		try
+		{
+			m_fallback();
+		}
+		catch (const exception &e)
+		{
+			LogERROR << "extern: Board[" << m_boardId << "] send fallback verdict failed: " << e.what();
+		}
+		LogWARNING << "extern: Board[" << m_boardId << "] verdict deadline missed in " << getStageName(stage) << " stage, fallback verdict sent, missed total = " << numMissed;
+		lock.lock();
+	}
+}
@@ -0,0 +1,96 @@
+#ifndef XJ_APP_VERDICT_DEADLINE_H
+#define XJ_APP_VERDICT_DEADLINE_H
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <functional>
+#include <condition_variable>
+
+//超时时产品所处的阶段
+enum class VerdictStage : int
+{
+	CONTEXT = 0,    //读取PLC帧信息(拍照次数、产品计数)
+	INSPECT = 1,    //预处理、检测
+	COMMIT = 2,     //判定、发信号
+	NUM = 3
+};
+
+//判定时限统计
+struct stVerdictDeadlineStats
+{
+	long numArmed = 0;
+	long numOnTime = 0;                                 //按时给出判定
+	long numMissed = 0;                                 //超时, 已发出兜底判定
+	long vMissedByStage[(int)VerdictStage::NUM] = {0};  //超时时所处阶段
+	long numLate = 0;                                   //超时后才给出的判定, 只记录统计, 不再发信号
+	long numLateOK = 0;                                 //其中判定为OK的数量
+	double maxLateMs = 0;                               //超时判定距取像的最长时间
+};
+
+/*==================================================================================================
+    判定时限: 每个工位一个, 从取像完成开始计时; 时限减去安全余量仍没有判定时,
+    在监视线程中按时发出兜底判定(通常为NG), 之后到达的判定只记录统计, 不再给PLC发信号
+===================================================================================================*/
+class AppVerdictDeadline
+{
+public:
+	//兜底判定, 在监视线程中调用
+	typedef std::function<void()> FallbackHandler;
+
+	/**
+	 * @brief start the deadline monitor of one board
+	 * @param boardId <input> board id, used for logging
+	 * @param deadlineMs <input> time allowed from frame acquisition to the verdict signal
+	 * @param marginMs <input> safety margin, the fallback verdict is sent at deadlineMs - marginMs
+	 * @param fallback <input> sends the fallback verdict
+	 */
+	AppVerdictDeadline(const int boardId, const int deadlineMs, const int marginMs, const FallbackHandler &fallback);
+	~AppVerdictDeadline();
+
+	/**
+	 * @brief start timing the verdict of one frame
+	 * @param acquireTime <input> time the frame was acquired
+	 * @return ticket of the frame, passed along with the frame to resolve()
+	 */
+	long arm(const std::chrono::steady_clock::time_point &acquireTime);
+	void setStage(const long ticket, const VerdictStage stage);
+
+	/**
+	 * @brief called before sending the verdict of the frame, may be called once per lens
+	 * @param ticket <input> ticket from arm(), < 0 means the frame was not timed
+	 * @param bIsOK <input> verdict of the frame, for statistics of late verdicts
+	 * @return true-send the verdict, false-the fallback verdict was already sent
+	 */
+	bool resolve(const long ticket, const bool bIsOK);
+
+	stVerdictDeadlineStats getStats();
+
+private:
+	void run();
+	void logStats(const std::string &sTitle);
+
+	struct stEntry
+	{
+		std::chrono::steady_clock::time_point acquireTime;
+		std::chrono::steady_clock::time_point fireTime;
+		VerdictStage stage = VerdictStage::INSPECT;
+	};
+
+	int m_boardId;
+	std::chrono::milliseconds m_fireDelay;
+	FallbackHandler m_fallback;
+
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	long m_nextTicket;
+	std::map<long, stEntry> m_mapArmed;                 //按取像顺序, 第一项最先到期
+	std::map<long, std::chrono::steady_clock::time_point> m_mapFired;   //已发出兜底判定的帧及其取像时间, 等待迟到的判定
+	stVerdictDeadlineStats m_stats;
+	bool m_bIsStop;
+	std::thread m_thread;
+};
+
+#endif // XJ_APP_VERDICT_DEADLINE_H
@@ -2,6 +2,11 @@
 #include "xj_app_io_manager.h"
 #include "xj_app_running_result.h"
 #include "xj_app_json_config.h"
+#include "xj_app_runtime_config.h"
+#include "xj_app_product_cache.h"
+#include "xj_app_load_governor.h"
+#include "xj_app_run_state.h"
+#include "xj_app_scheduler.h"
 #include "xj_app_data.h"
 
 #include "logger.h"
@@ -72,11 +77,14 @@ int AppWebServer::addWebCmds()
 	TestSettingWrite();
 
 	SetCurrentProd();
+	PrefetchProd();
 	CreateTestProduction();
 	SetDefaultAutoParams();
 
 	SetRect();
 	SetParams();
+	SetParamsBulk();
+	UpdateParams();
 	GetDetectingParams();
 	GetTestingParams();
 
@@ -92,6 +100,12 @@ int AppWebServer::addWebCmds()
 	TriggerCamera();
 
 	Preview();
+	SweepThresholds();
+	GetShadowReport();
+	ReloadRuntimeConfig();
+	GetLoadGovernor();
+	GetRunState();
+	GetScheduler();
 	ImageProcessed();
 	autoUpdateParams();
 
@@ -109,6 +123,32 @@ int AppWebServer::addWebCmds()
 	GetCameraResultImage();
 	GetCurrentResult();
 
+	//放在最后, 包括基类注册的开始/停止、换产、测试等请求
+	NotifyRunStateOnPost();
+
+	return 0;
+}
+
+int AppWebServer::NotifyRunStateOnPost()
+{
+	/*
+		所有POST请求处理完成后通知运行状态可能变化, 空闲的检测线程立即重新读取状态,
+		不再等待监视线程检查; 状态没有变化时检测线程继续等待
+	*/
+	for(auto &resource : m_server.resource)
+	{
+		auto itr = resource.second.find("POST");
+		if(itr == resource.second.end())
+		{
+			continue;
+		}
+		auto handler = itr->second;
+		itr->second = [handler](shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request)
+		{
+			handler(response, request);
+			AppRunState::instance().notify("web");
+		};
+	}
 	return 0;
 }
 
@@ -325,9 +365,11 @@ int AppWebServer::SetCurrentProd()
 			LogINFO << "Set product: " << sProd;
 			if(RunningInfo::instance().GetProductionInfo().SetCurrentProd(sProd)) 
 			{
-					// reset product setting in memory by new value
-					if(RunningInfo::instance().GetProductSetting().UpdateCurrentProductSettingFromDB(sProd)) 
+					// reset product setting in memory by new value, 预取过的产品不再读取数据库
+					shared_ptr<const stProductSettings> pSettings = AppProductCache::instance().get(sProd);
+					if(pSettings != nullptr) 
 					{
+						RunningInfo::instance().GetProductSetting().UpdateCurrentProductSetting(pSettings->setting);
 						string lot = RunningInfo::instance().GetProductSetting().GetStringSetting(0);
 						RunningInfo::instance().GetProductionInfo().SetCurrentLot(lot);
 						response->write("Success");
@@ -358,6 +400,36 @@ int AppWebServer::SetCurrentProd()
 	return 0;
 }
 
+int AppWebServer::PrefetchProd()
+{
+	/*
+	POST: http://localhost:8080/prefetch_prod
+	{"prod":"Product05"}
+	排产系统在换产前调用, 后台读取并解析下一个产品的参数, set_current_prod时直接使用缓存
+	Return: Success
+	*/
+	m_server.resource["^/prefetch_prod"]["POST"] = [](shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request) 
+	{
+		try 
+		{
+			ptree pt;
+			read_json(request->content, pt);
+			const string sProd = pt.get<string>("prod");
+			AppProductCache::instance().prefetch(sProd);
+			LogINFO << "Prefetch product: " << sProd;
+			response->write("Success");
+		}
+		catch(const exception &e) 
+		{
+			LogERROR << e.what();
+			response->write(SimpleWeb::StatusCode::client_error_bad_request, e.what());
+			return 1;
+		}
+		return 0;
+	};
+	return 0;
+}
+
 int AppWebServer::CreateTestProduction()
 {
 	/*
@@ -439,9 +511,11 @@ int AppWebServer::SettingWrite()
 				response->write(SimpleWeb::StatusCode::server_error_internal_server_error, "Update Product Setting " + prod + " Failed");
 				return 1;
 			}
+			AppProductCache::instance().invalidate(prod);
 
 			// update the memory each time setting is confirmed
 			RunningInfo::instance().GetProductSetting().UpdateCurrentProductSetting(setting);
+			AppRunningResult::instance().requestParamsUpdate();
 			LogINFO << "Update product setting " << prod << " success";
 			response->write("Success");
 			db_utils::ALARM("ModifyParameters");
@@ -498,6 +572,325 @@ int AppWebServer::Preview()
 	return 0;
 }
 
+int AppWebServer::SweepThresholds()
+{
+	/*
+		POST: http://localhost:8080/sweep_thresholds?board=0
+		{"image_path":"/opt/sweep/DGB", "capture":1, "max_lenses":1, "category":-1,
+		 "prob_scale":[0.8, 1.0, 1.2], "area_scale":[1.0], "diag_scale":[1.0]}
+		image_path下OK、NG子目录分别为良品、不良品; 每张图只推理一次, 再按网格中每组阈值统计过杀、漏检
+		扫描在后台执行, 立即返回任务号; 同时只运行一个扫描
+		Return: {"job":1, "status":"running"}
+	*/
+	m_server.resource["^/sweep_thresholds"]["POST"] = [this](shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request)
+	{
+		auto query_fields = request->parse_query_string();
+		try
+		{
+			const int boardId = stoi(SimpleWeb::getValue(query_fields, "board"));
+			ptree pt;
+			read_json(request->content, pt);
+			auto getScales = [&pt](const string &sKey)
+			{
+				vector<float> vScales;
+				if(pt.get_child_optional(sKey))
+				{
+					for(const auto &item : pt.get_child(sKey))
+					{
+						vScales.push_back(item.second.get_value<float>());
+					}
+				}
+				return vScales.empty() ? vector<float>(1, 1.0f) : vScales;
+			};
+
+			stSweepRequest sweepRequest;
+			sweepRequest.sImagePath = pt.get<string>("image_path");
+			sweepRequest.nCaptureTimes = pt.get<int>("capture", 1);
+			sweepRequest.maxLenses = pt.get<int>("max_lenses", 1);
+			sweepRequest.category = pt.get<int>("category", -1);
+			sweepRequest.vProbScales = getScales("prob_scale");
+			sweepRequest.vAreaScales = getScales("area_scale");
+			sweepRequest.vDiagScales = getScales("diag_scale");
+
+			const long jobId = AppRunningResult::instance().startThresholdSweep(boardId, sweepRequest);
+			if(jobId < 0)
+			{
+				response->write(SimpleWeb::StatusCode::client_error_bad_request, "Sweep Thresholds Not Started");
+				return 1;
+			}
+
+			LogINFO << "extern: Board[" << boardId << "] sweep thresholds " << sweepRequest.sImagePath << " started, job " << jobId;
+			ptree root;
+			root.put("job", jobId);
+			root.put("status", "running");
+			stringstream ss;
+			write_json(ss, root);
+			response->write(ss);
+		}
+		catch (const exception &e)
+		{
+			LogERROR << e.what();
+			response->write(SimpleWeb::StatusCode::client_error_bad_request, e.what());
+			return 1;
+		}
+		return 0;
+	};
+
+	/*
+		GET: http://localhost:8080/sweep_thresholds
+		最近一次扫描任务的状态, 完成后带结果
+		Return: {"job":1, "board":0, "image_path":"...", "status":"done",
+		 "samples":..., "label_ng":..., "cached":..., "infer_seconds":..., "sweep_seconds":..., "results":[{...}]}
+	*/
+	m_server.resource["^/sweep_thresholds"]["GET"] = [](shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request)
+	{
+		try
+		{
+			const AppRunningResult::stSweepJob job = AppRunningResult::instance().getThresholdSweepJob();
+			const map<AppRunningResult::SweepJobStatus, string> mapStatus = {{AppRunningResult::SweepJobStatus::NONE, "none"},
+					{AppRunningResult::SweepJobStatus::RUNNING, "running"}, {AppRunningResult::SweepJobStatus::DONE, "done"},
+					{AppRunningResult::SweepJobStatus::FAILED, "failed"}};
+			ptree root;
+			root.put("job", job.id);
+			root.put("board", job.boardId);
+			root.put("image_path", job.request.sImagePath);
+			root.put("status", mapStatus.at(job.status));
+			if(job.status == AppRunningResult::SweepJobStatus::DONE)
+			{
+				const stSweepReport &report = job.report;
+				root.put("samples", report.numSamples);
+				root.put("label_ng", report.numLabelNG);
+				root.put("cached", report.numCached);
+				root.put("infer_seconds", report.inferSeconds);
+				root.put("sweep_seconds", report.sweepSeconds);
+				ptree results;
+				for(const auto &result : report.vResults)
+				{
+					ptree cell;
+					cell.put("prob_scale", result.probScale);
+					cell.put("area_scale", result.areaScale);
+					cell.put("diag_scale", result.diagScale);
+					cell.put("ng", result.numNG);
+					cell.put("overkill", result.numOverkill);
+					cell.put("escape", result.numEscape);
+					results.push_back(make_pair("", cell));
+				}
+				root.put_child("results", results);
+			}
+			stringstream ss;
+			write_json(ss, root);
+			response->write(ss);
+		}
+		catch (const exception &e)
+		{
+			LogERROR << e.what();
+			response->write(SimpleWeb::StatusCode::client_error_bad_request, e.what());
+			return 1;
+		}
+		return 0;
+	};
+	return 0;
+}
+
+int AppWebServer::GetShadowReport()
+{
+	/*
+		GET: http://localhost:8080/shadow_report
+		候选模型(SHADOW_MODEL_PATH_CAM*)在抽样线上帧上的判定与生产判定的比较, 只统计不输出
+		Return: {"boards":[{"board":0, "model":..., "sampled":..., "dropped":..., "evaluated":..., "agree":...,
+				 "candidate_ng":..., "candidate_ok":..., "queue":..., "avg_eval_ms":...}]}
+	*/
+	m_server.resource["^/shadow_report"]["GET"] = [](shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request)
+	{
+		try
+		{
+			ptree boards;
+			for(const auto &report : getShadowReports())
+			{
+				ptree cell;
+				cell.put("board", report.boardId);
+				cell.put("model", report.sModelPath);
+				cell.put("sampled", report.numSampled);
+				cell.put("dropped", report.numDropped);
+				cell.put("evaluated", report.numEvaluated);
+				cell.put("agree", report.numAgree);
+				cell.put("candidate_ng", report.numCandidateNG);
+				cell.put("candidate_ok", report.numCandidateOK);
+				cell.put("queue", report.queueDepth);
+				cell.put("avg_eval_ms", report.avgEvalMs);
+				boards.push_back(make_pair("", cell));
+			}
+			ptree root;
+			root.put_child("boards", boards);
+			stringstream ss;
+			write_json(ss, root);
+			response->write(ss);
+		}
+		catch (const exception &e)
+		{
+			LogERROR << e.what();
+			response->write(SimpleWeb::StatusCode::client_error_bad_request, e.what());
+		}
+	};
+	return 0;
+}
+
+int AppWebServer::ReloadRuntimeConfig()
+{
+	/*
+		POST: http://localhost:8080/reload_runtime_config
+		重新解析检测热路径使用的配置并发布新快照, 检测线程从下一帧开始使用; 解析失败时保留原快照
+		Return: {"success": true, "version": 2}
+	*/
+	m_server.resource["^/reload_runtime_config"]["POST"] = [](shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request)
+	{
+		try
+		{
+			const bool bIsSuccess = AppRuntimeConfig::instance().reload();
+			ptree root;
+			root.put("success", bIsSuccess);
+			root.put("version", AppRuntimeConfig::instance().version());
+			stringstream ss;
+			write_json(ss, root);
+			response->write(ss);
+		}
+		catch (const exception &e)
+		{
+			LogERROR << e.what();
+			response->write(SimpleWeb::StatusCode::client_error_bad_request, e.what());
+		}
+	};
+	return 0;
+}
+
+int AppWebServer::GetLoadGovernor()
+{
+	/*
+		GET: http://localhost:8080/load_governor
+		各工位负载调节级别及时间余量、存图队列占用; 级别变化同时写入运行数据"load-工位"
+		Return: {"boards":[{"board":0, "level":0, "level_name":"normal", "cycle_ms":..., "inspect_ms":..., "slack":..., "save_queue":...,
+				 "transitions":..., "degraded_frames":..., "skipped_ok_saves":...}], "deferred_db_writes":...}
+	*/
+	m_server.resource["^/load_governor"]["GET"] = [](shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request)
+	{
+		try
+		{
+			const int numDeferred = AppRunningResult::instance().getDeferredWriteCount();
+			ptree boards;
+			for(const auto &report : AppLoadGovernor::instance().getReports())
+			{
+				ptree cell;
+				cell.put("board", report.boardId);
+				cell.put("level", report.level);
+				cell.put("level_name", report.sLevelName);
+				cell.put("cycle_ms", report.cycleMs);
+				cell.put("inspect_ms", report.inspectMs);
+				cell.put("slack", report.slack);
+				cell.put("save_queue", report.queueFill);
+				cell.put("transitions", report.numTransitions);
+				cell.put("degraded_frames", report.numDegradedFrames);
+				cell.put("skipped_ok_saves", report.numSkippedOKSaves);
+				boards.push_back(make_pair("", cell));
+			}
+			ptree root;
+			root.put_child("boards", boards);
+			root.put("deferred_db_writes", numDeferred);
+			stringstream ss;
+			write_json(ss, root);
+			response->write(ss);
+		}
+		catch (const exception &e)
+		{
+			LogERROR << e.what();
+			response->write(SimpleWeb::StatusCode::client_error_bad_request, e.what());
+		}
+	};
+	return 0;
+}
+
+int AppWebServer::GetRunState()
+{
+	/*
+		GET: http://localhost:8080/run_state
+		各工位运行状态切换次数及延迟: wake为状态变化到检测线程发现的时间, ready为开始检测到可以取像的时间(含参数初始化)
+		Return: {"boards":[{"board":0, "status":1, "transitions":..., "wakeups":..., "last_wake_ms":..., "max_wake_ms":...,
+				 "last_ready_ms":..., "max_ready_ms":...}]}
+	*/
+	m_server.resource["^/run_state"]["GET"] = [](shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request)
+	{
+		try
+		{
+			ptree boards;
+			for(const auto &stats : AppRunState::instance().getStats())
+			{
+				ptree cell;
+				cell.put("board", stats.boardId);
+				cell.put("status", stats.status);
+				cell.put("transitions", stats.numTransitions);
+				cell.put("wakeups", stats.numWakeups);
+				cell.put("last_wake_ms", stats.lastWakeMs);
+				cell.put("max_wake_ms", stats.maxWakeMs);
+				cell.put("last_ready_ms", stats.lastReadyMs);
+				cell.put("max_ready_ms", stats.maxReadyMs);
+				boards.push_back(make_pair("", cell));
+			}
+			ptree root;
+			root.put_child("boards", boards);
+			stringstream ss;
+			write_json(ss, root);
+			response->write(ss);
+		}
+		catch (const exception &e)
+		{
+			LogERROR << e.what();
+			response->write(SimpleWeb::StatusCode::client_error_bad_request, e.what());
+		}
+	};
+	return 0;
+}
+
+int AppWebServer::GetScheduler()
+{
+	/*
+		GET: http://localhost:8080/scheduler
+		后台周期任务(心跳、合并计数、数据库报表、数据清理)的执行次数、开始抖动、耗时和超时
+		Return: {"tasks":[{"name":"heartbeat", "period_ms":500, "runs":..., "overruns":..., "skipped":..., "avg_jitter_ms":..., "max_jitter_ms":...,
+				 "avg_run_ms":..., "max_run_ms":...}]}
+	*/
+	m_server.resource["^/scheduler"]["GET"] = [](shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request)
+	{
+		try
+		{
+			ptree tasks;
+			for(const auto &stats : AppScheduler::instance().getStats())
+			{
+				ptree cell;
+				cell.put("name", stats.sName);
+				cell.put("period_ms", stats.periodMs);
+				cell.put("runs", stats.numRuns);
+				cell.put("overruns", stats.numOverruns);
+				cell.put("skipped", stats.numSkipped);
+				cell.put("avg_jitter_ms", stats.avgJitterMs());
+				cell.put("max_jitter_ms", stats.maxJitterMs);
+				cell.put("avg_run_ms", stats.avgRunMs());
+				cell.put("max_run_ms", stats.maxRunMs);
+				tasks.push_back(make_pair("", cell));
+			}
+			ptree root;
+			root.put_child("tasks", tasks);
+			stringstream ss;
+			write_json(ss, root);
+			response->write(ss);
+		}
+		catch (const exception &e)
+		{
+			LogERROR << e.what();
+			response->write(SimpleWeb::StatusCode::client_error_bad_request, e.what());
+		}
+	};
+	return 0;
+}
+
 int AppWebServer::autoUpdateParams()
 {
 	/*
@@ -749,6 +1142,79 @@ int AppWebServer::SetRect()
 	return 0;
 }
 
+//按UISetting.setup.flawParams-<cam>中的定义更新一个检测功能的enable和参数值;
+//记录到数据库的写入setting, 不记录到数据库的暂存到transaction, 由调用方统一提交
+static bool applyFlawParams(const string &sCam, const string &sGroup, const string &sFunction, const ptree &pt,
+							ProductSetting::PRODUCT_SETTING &setting, AppJsonConfig::Transaction &transaction, string &sError)
+{
+	ptree parametersTree;
+	if(pt.get_child_optional("parameters"))
+	{
+		parametersTree = pt.get_child("parameters");
+	}
+
+	ptree ptCamGroups;
+	string sNodeName = ("UISetting.setup.flawParams-" + sCam);
+	std::stringstream ss1 = CustomizedJsonConfig::instance().getJsonStream(sNodeName);
+	read_json(ss1, ptCamGroups);
+	for(const auto &group:ptCamGroups)
+	{
+		string sGroupId = group.second.get<string>("id");
+		if(sGroupId == sGroup)
+		{
+			auto items = group.second.get_child("params");
+			for(const auto &item:items)
+			{
+				string sItemId = item.second.get<string>("id");
+				if(sItemId == sFunction)
+				{
+					//更新enable值
+					const int item_index = item.second.get<int>("index");
+					if (item_index >= setting.float_settings.size())
+					{
+						LogERROR << "item:" << sItemId << " index:" << item_index << " is out of range of float_settings size";
+						sError = to_string(item_index) + " index is out of range of float_settings size";
+						return false;
+					}
+					setting.float_settings[item_index] = pt.get<float>("enable");
+
+					//更新所有参数值
+					auto params = item.second.get_child("paramsList");
+					for(const auto &param:params)
+					{
+						const int param_index = param.second.get<int>("index");
+						string sParamId = param.second.get<string>("id");
+						if (param.second.get_child_optional("isRecordToDB"))
+						{
+							if (!param.second.get<bool>("isRecordToDB") && pt.get_child_optional("parameters"))
+							{
+								const string& sJsonNodeName = "flawParams-"+ sCam + "." + sGroupId + "." + sItemId + "." + sParamId;
+								transaction.set<float>(sJsonNodeName, parametersTree.get<float>(sParamId));
+								continue;
+							}
+						}
+
+						if (param_index >= setting.float_settings.size() ||  param_index < 0)
+						{
+							LogERROR << "param:" << sParamId << " index:" << param_index << " is out of range of floot_setting size";
+							sError = sParamId + " index is out of range of floot_setting size";
+							return false;
+						}
+						
+						if (pt.get_child_optional("parameters"))
+						{
+							setting.float_settings[param_index] = parametersTree.get<float>(sParamId);
+						}								
+					}
+					break;
+				}//if(sItemId == sFunction)
+			}
+			break;
+		}//if(sGroupId == sGroup)
+	}
+	return true;
+}
+
 int AppWebServer::SetParams()
 {
 	/*
@@ -790,78 +1256,22 @@ int AppWebServer::SetParams()
 
 			if (pt.get_child_optional("enable"))
 			{
-				ptree parametersTree;
-				if(pt.get_child_optional("parameters"))
-				{
-					parametersTree = pt.get_child("parameters");
-				}
-				
 				//step2:从数据库获取数据
 				ProductSetting::PRODUCT_SETTING setting = RunningInfo::instance().GetTestProductSetting().GetSettings();
 			
-				//step3:解析配置文件json和赋值给数据库数据
-				ptree ptCamGroups;
-				string sNodeName = ("UISetting.setup.flawParams-" + sCam);
-				std::stringstream ss1 = CustomizedJsonConfig::instance().getJsonStream(sNodeName);
-				read_json(ss1, ptCamGroups);
-				for(const auto &group:ptCamGroups)
-				{
-					string sGroupId = group.second.get<string>("id");
-					if(sGroupId == sGroup)
-					{
-						auto items = group.second.get_child("params");
-						for(const auto &item:items)
-						{
-							string sItemId = item.second.get<string>("id");
-							if(sItemId == sFunction)
-							{
-								//更新enable值
-								const int item_index = item.second.get<int>("index");
-								if (item_index >= setting.float_settings.size())
-								{
-									LogERROR << "item:" << sItemId << " index:" << item_index << " is out of range of float_settings size";
-									response->write(SimpleWeb::StatusCode::server_error_internal_server_error, item_index + " index is out of range of float_settings size");
-									return 1;
-								}
-								setting.float_settings[item_index] = pt.get<float>("enable");
-
-								//更新所有参数值
-								auto params = item.second.get_child("paramsList");
-								for(const auto &param:params)
-								{
-									const int param_index = param.second.get<int>("index");
-									string sParamId = param.second.get<string>("id");
-									if (param.second.get_child_optional("isRecordToDB"))
-									{
-										if (!param.second.get<bool>("isRecordToDB") && pt.get_child_optional("parameters"))
-										{
-											const string& sJsonNodeName = "flawParams-"+ sCam + "." + sGroupId + "." + sItemId + "." + sParamId;
-											AppJsonConfig::instance().set<float>(sJsonNodeName, parametersTree.get<float>(sParamId));
-											continue;
-										}
-									}
-
-									if (param_index >= setting.float_settings.size() ||  param_index < 0)
-									{
-										LogERROR << "param:" << sParamId << " index:" << param_index << " is out of range of floot_setting size";
-										response->write(SimpleWeb::StatusCode::server_error_internal_server_error, sParamId + " index is out of range of floot_setting size");
-										return 1;
-									}
-									
-									if (pt.get_child_optional("parameters"))
-									{
-										setting.float_settings[param_index] = parametersTree.get<float>(sParamId);
-									}								
-								}
-								break;
-							}//if(sItemId == sFunction)
-						}
-						break;
-					}//if(sGroupId == sGroup)
+				//step3:解析配置文件json和赋值给数据库数据, 不记录到数据库的参数暂存后一次写入配置文件
+				AppJsonConfig::Transaction transaction;
+				string sError;
+				if (!applyFlawParams(sCam, sGroup, sFunction, pt, setting, transaction, sError))
+				{
+					response->write(SimpleWeb::StatusCode::server_error_internal_server_error, sError);
+					return 1;
 				}
+				AppJsonConfig::instance().commit(transaction);
 					
 				//step4:更新内存数据，未保存数据
 				RunningInfo::instance().GetTestProductSetting().UpdateCurrentProductSetting(setting);
+				AppRunningResult::instance().requestParamsUpdate();
 			}
 
 			//step5:更新成功
@@ -877,6 +1287,121 @@ int AppWebServer::SetParams()
 	return 0;
 }
 
+int AppWebServer::SetParamsBulk()
+{
+	/*
+		POST: http://localhost:8080/set_params_bulk?prod=DGB&camera=0&save=1
+		{
+			"functions": [
+				{"group": "firstDet", "function": "dimension", "enable": 1, "parameters": {"baseDimension": 67.5, "upTolerance": 0.4}},
+				{"group": "firstDet", "function": "scratch", "camera": 1, "enable": 0}
+			]
+		}
+		一次请求设置整页参数: 全部校验通过后才生效, 配置文件只写一次, 内存设置只更新一次;
+		save=1且指定prod时同时写一次数据库, 等同于随后调用setting_write
+		Return: Success
+	*/
+	m_server.resource["^/set_params_bulk"]["POST"] = [this](shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request)
+	{
+		auto query_fields = request->parse_query_string();
+		try
+		{
+			ptree pt;
+			read_json(request->content, pt);
+			if (!pt.get_child_optional("functions"))
+			{
+				LogERROR << "find functions failed";
+				response->write(SimpleWeb::StatusCode::client_error_bad_request, "find functions failed");
+				return 1;
+			}
+			const string sCam = SimpleWeb::getValue(query_fields, "camera");
+			const string sProd = SimpleWeb::getValue(query_fields, "prod");
+			const string sSave = SimpleWeb::getValue(query_fields, "save");
+			const bool bIsSave = !sProd.empty() && (sSave == "1" || sSave == "true");
+
+			//step1:所有功能的修改先作用在副本上, 任一失败时不做任何修改
+			ProductSetting::PRODUCT_SETTING setting = RunningInfo::instance().GetTestProductSetting().GetSettings();
+			AppJsonConfig::Transaction transaction;
+			int numFunctions = 0;
+			for (const auto &function : pt.get_child("functions"))
+			{
+				const ptree &item = function.second;
+				if (!item.get_child_optional("enable"))
+				{
+					continue;
+				}
+				const string sItemCam = item.get<string>("camera", sCam);
+				string sError;
+				if (!applyFlawParams(sItemCam, item.get<string>("group"), item.get<string>("function"), item, setting, transaction, sError))
+				{
+					response->write(SimpleWeb::StatusCode::server_error_internal_server_error, sError);
+					return 1;
+				}
+				numFunctions++;
+			}
+
+			//step2:配置文件和内存设置各更新一次
+			AppJsonConfig::instance().commit(transaction);
+			RunningInfo::instance().GetTestProductSetting().UpdateCurrentProductSetting(setting);
+
+			//step3:需要保存时写一次数据库
+			if (bIsSave)
+			{
+				auto writeProdSetting = [](const string &prod, const ProductSetting::PRODUCT_SETTING &setting)
+				{
+					Database db;
+					return db.prod_setting_write(prod, setting);
+				};
+				if (writeProdSetting(sProd, setting))
+				{
+					LogERROR << "Update product setting " << sProd << " in database failed";
+					response->write(SimpleWeb::StatusCode::server_error_internal_server_error, "Update Product Setting " + sProd + " Failed");
+					return 1;
+				}
+				AppProductCache::instance().invalidate(sProd);
+				RunningInfo::instance().GetProductSetting().UpdateCurrentProductSetting(setting);
+				db_utils::ALARM("ModifyParameters");
+			}
+			AppRunningResult::instance().requestParamsUpdate();
+			LogINFO << "set_params_bulk: prod=" << sProd << " functions=" << numFunctions << " saved=" << bIsSave;
+			response->write("Success");
+		}
+		catch (const exception &e)
+		{
+			LogERROR << e.what();
+			response->write(SimpleWeb::StatusCode::client_error_bad_request, e.what());
+			return 1;
+		}
+		return 0;
+	};
+	return 0;
+}
+
+
+int AppWebServer::UpdateParams()
+{
+	/*
+		POST: http://localhost:8080/update_params
+		修改配置文件中的阈值(DEFECT_MIN_*、INSPECT_*等)后调用, 各工位在下一帧前热更新, 不停止检测
+		Return: Success
+	*/
+	m_server.resource["^/update_params"]["POST"] = [this](shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request)
+	{
+		try
+		{
+			AppRunningResult::instance().requestParamsUpdate();
+			response->write("Success");
+		}
+		catch (const exception &e)
+		{
+			LogERROR << e.what();
+			response->write(SimpleWeb::StatusCode::client_error_bad_request, e.what());
+			return 1;
+		}
+		return 0;
+	};
+	return 0;
+}
 
 int AppWebServer::GetDetectingParams()
 {
@@ -1531,6 +2056,7 @@ int AppWebServer::SetPlcParams()
 				response->write(SimpleWeb::StatusCode::server_error_internal_server_error, "Update Product Setting " + sProd + " Failed");
 				return 1;
 			}
+			AppProductCache::instance().invalidate(sProd);
 
 			// update the memory each time setting is confirmed
 			response->write("Success");
@@ -1619,6 +2145,7 @@ int AppWebServer::SetCommonParams()
 				response->write(SimpleWeb::StatusCode::server_error_internal_server_error, "Update Product Setting " + sProd + " Failed");
 				return 1;
 			}
+			AppProductCache::instance().invalidate(sProd);
 
 			// update the memory each time setting is confirmed
 			response->write("Success");
@@ -1833,7 +2360,8 @@ int AppWebServer::SetCameraParams()
 			bool gammaEnable = parametersTree.get<bool>("gammaEnable");
 			float gammaValue = parametersTree.get<float>("gammaValue");
 
-			//step3:解析配置json,更新数据
+			//step3:解析配置json,更新数据; 记录到配置文件的参数暂存后一次写入
+			AppJsonConfig::Transaction transaction;
 			ptree camConfigParams;
 			string sNodeName = "UISetting.setup.cameraParams-" + sCam;
 			std::stringstream ss1 = CustomizedJsonConfig::instance().getJsonStream(sNodeName);
@@ -1850,11 +2378,11 @@ int AppWebServer::SetCameraParams()
 						const string& sJsonNodeName = "cameraParams-"+ sCam + "." + sID;
 						if(sID == "gammaEnable")
 						{
-							AppJsonConfig::instance().set<float>(sJsonNodeName, (float)gammaEnable);
+							transaction.set<float>(sJsonNodeName, (float)gammaEnable);
 						}
 						else
 						{
-							AppJsonConfig::instance().set<float>(sJsonNodeName, parametersTree.get<float>(sID));
+							transaction.set<float>(sJsonNodeName, parametersTree.get<float>(sID));
 						}
 						continue;
 					}
@@ -1877,7 +2405,10 @@ int AppWebServer::SetCameraParams()
 				}
 				
 			}
+			AppJsonConfig::instance().commit(transaction);
 			RunningInfo::instance().GetTestProductSetting().UpdateCurrentProductSetting(setting);
+			//不记录到数据库的相机参数对所有产品生效
+			AppProductCache::instance().invalidateAll();
 
 			//step5:相机参数解析，相机设置
 			string cameraName = "CAM" + sCam;
@@ -1937,6 +2468,7 @@ int AppWebServer::SetCameraParams()
 				{
 
 				}
+				AppProductCache::instance().touchCameras();
 			}
 
 			db_utils::ALARM("ModifyParameters");
@@ -1981,6 +2513,7 @@ int AppWebServer::SaveCameraParams()
 				response->write(SimpleWeb::StatusCode::server_error_internal_server_error, "Update Product Setting " + prod + " Failed");
 				return 1;
 			}
+			AppProductCache::instance().invalidate(prod);
 			response->write("Success");
 		}
 		catch (const exception &e)
@@ -2013,7 +2546,8 @@ int AppWebServer::SetDefaultAutoParams()
 			setting.float_settings[int(ProductSettingFloatMapper::PURGE_SIGNAL_TYPE)] = (int)PurgeMode::NORMAL;//正常剔除
 			setting.float_settings[int(ProductSettingFloatMapper::RUN_MODE)]  = (int)RunMode::RUN_DETECT;//检测模式
 
-			//3) 设置相机参数：camera params
+			//3) 设置相机参数：camera params, 记录到配置文件的参数暂存后一次写入
+			AppJsonConfig::Transaction transaction;
 			const int numCamera = CustomizedJsonConfig::instance().get<int>("UISetting.common.cameraNumber");
 			for(int camIdx = 0; camIdx != numCamera; ++camIdx)
 			{
@@ -2033,7 +2567,7 @@ int AppWebServer::SetDefaultAutoParams()
 							if (!paramconfig.second.get<bool>("isRecordToDB"))
 							{
 								const string& sJsonNodeName = "cameraParams-"+ to_string(camIdx) + "." + sID;
-								AppJsonConfig::instance().set<float>(sJsonNodeName, defaultValue);
+								transaction.set<float>(sJsonNodeName, defaultValue);
 								continue;
 							}
 						}
@@ -2075,6 +2609,7 @@ int AppWebServer::SetDefaultAutoParams()
 
 
 
+			AppJsonConfig::instance().commit(transaction);
 			RunningInfo::instance().GetTestProductSetting().UpdateCurrentProductSetting(setting);
 			response->write("Success");
 		
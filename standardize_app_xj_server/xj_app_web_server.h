@@ -19,6 +19,7 @@ private:
     //产品
     int CreateTestProduction();
     int SetCurrentProd();
+    int PrefetchProd();//换产前后台预取下一个产品参数
     int SetDefaultAutoParams();
 
     //读写数据库
@@ -35,6 +36,8 @@ private:
     int GetTestingParams();//自动更新参数后刷新页面
     int SetRect();
     int SetParams();
+    int SetParamsBulk();//整页瑕疵参数一次设置、一次写盘
+    int UpdateParams();//阈值类参数热更新
 
     //相机参数
     int GetCameraParams();
@@ -52,6 +55,13 @@ private:
 
     int ImageProcessed();//图像处理
     int Preview();//测试预览
+    int SweepThresholds();//阈值扫描
+    int GetShadowReport();//影子评估统计
+    int ReloadRuntimeConfig();//重新加载检测配置快照
+    int GetLoadGovernor();//负载调节状态
+    int GetRunState();//运行状态切换延迟
+    int GetScheduler();//后台周期任务统计
+    int NotifyRunStateOnPost();//POST请求后唤醒空闲的检测线程
     int autoUpdateParams();//自动更新参数
     int GetDefect();   // Get defective data from database
     int GetRealReportWithLot();
@@ -10,11 +10,13 @@
 
 #include "shared_utils.h"
 #include "opencv_utils.h"
+#include "bayer_view.h"
 #include "running_status.h"
 #include <boost/foreach.hpp>
 #include "database.h"
 #include "db_utils.h"
 #include <numeric>
+#include <set>
 
 
 using namespace boost::property_tree;
@@ -30,10 +32,26 @@ AppWorkflow::AppWorkflow(const int workflowId, const std::shared_ptr<WorkflowCon
 			m_runMode((int)RunMode::RUN_DETECT),
 			m_sProductName("N/A"),
 			m_sProductLot("N/A"),
+			m_bIsCameraConfigured(false),
+			m_appliedCameraVersion(0),
 			m_numNGHistory(0),
 			m_iProductNumber(0),
 			m_nCaptureImageTimes(0),
-			m_nTotalCaptureTimes(0)
+			m_nTotalCaptureTimes(0),
+			m_lastQualityReason(ImageQualityReason::OK),
+			m_numQualitySkipped(0),
+			m_rawBayerCode(-1),
+			m_bIsResultPending(false),
+			m_bIsProductFusion(false),
+			m_pProductFusion(nullptr),
+			m_maxLensesPerFrame(1),
+			m_nextLensProductNumber(1),
+			m_lensProductBase(1),
+			m_bIsFrameDispatched(false),
+			m_pVerdictDeadline(nullptr),
+			m_verdictTicket(-1),
+			m_loadLevel(LoadLevel::NORMAL),
+			m_pPipeline(nullptr)
 {
 	const bool bIsMultiThread =  CustomizedJsonConfig::instance().get<bool>("IS_USE_MULTI_THREAD_PER_CAMERA");
 	if(bIsMultiThread)
@@ -55,6 +73,12 @@ int AppWorkflow::convertDefectType(const int defectIndex)
 	return m_mapDefectIndexToType[defectIndex];
 }
 
+string AppWorkflow::getCameraName(const stRuntimeConfig &config)
+{
+	const stBoardRuntimeConfig *pBoardConfig = config.board(boardId());
+	return (pBoardConfig != nullptr) ? pBoardConfig->sCameraName : "CAM" + to_string(boardId() + 1);
+}
+
 bool AppWorkflow::initParamsA(stConfigParamsA &stParamsA, const int currentRunStatus)
 {
 	stParamsA.fParams.clear();
@@ -76,12 +100,12 @@ bool AppWorkflow::initParamsA(stConfigParamsA &stParamsA, const int currentRunSt
 		setting = RunningInfo::instance().GetProductSetting().GetSettings();
 		if (!m_sProductName.empty())
 		{
-			Database db;
-			if (db.prod_setting_read(m_sProductName, setting))
+			if (m_pProductSettings == nullptr || m_pProductSettings->sProductName != m_sProductName)
 			{
 				LogERROR << "Board[" << boardId() <<  "] Read product setting in database failed";
 				return false;
 			}
+			setting = m_pProductSettings->setting;
 		}
 	}
 	else
@@ -218,6 +242,24 @@ bool AppWorkflow::initParamsB(stConfigParamsB &stParamsB, const int currentRunSt
 	}
 
 	stParamsB.vCameraNames = CustomizedJsonConfig::instance().getVector<string>("CAMERA_NAME");
+
+	//原始Bayer输入(仅线阵相机): 相机不去马赛克, 算法在分箱灰度图上定位, 只对镜片区域转彩色
+	m_rawBayerCode = -1;
+	const vector<bool> vIsRawBayer = CustomizedJsonConfig::instance().getVector<bool>("CAMERA_RAW_BAYER");
+	const vector<string> vCamType = CustomizedJsonConfig::instance().getVector<string>("CAMERA_TYPE");
+	const vector<string> vPixelFormat = CustomizedJsonConfig::instance().getVector<string>("CAMERA_PIXEL_FORMAT");
+	if(boardId() < (int)vIsRawBayer.size() && vIsRawBayer[boardId()] && vCamType.at(boardId()) == "LineScan")
+	{
+		m_rawBayerCode = getDemosaicCode(getBayerPattern(vPixelFormat.at(boardId())));
+		if(m_rawBayerCode < 0)
+		{
+			LogERROR << "extern: Board[" << boardId() << "] raw bayer not support pixel format " << vPixelFormat.at(boardId());
+		}
+		else
+		{
+			stParamsB.strParams["RAW_BAYER_PIXEL_FORMAT"] = vPixelFormat.at(boardId());
+		}
+	}
 	LogINFO << "Board[" << boardId() <<  "] initial parmsB successfully";
 	return true;
 }
@@ -237,18 +279,31 @@ bool AppWorkflow::initCameraParams(const int currentRunStatus)
 		return true;
 	}
 
-	//step2: 解析配置json和读取数据库参数
-	string sProd;
-	ProductSetting::PRODUCT_SETTING setting;
-	if(currentRunStatus == (int)RunStatus::PRODUCT_RUN)
+	//step2: 生产运行使用产品缓存中已解析的参数, 测试运行读取测试产品参数
+	stCameraSettings camera;
+	if(currentRunStatus == (int)RunStatus::PRODUCT_RUN && m_pProductSettings != nullptr)
 	{
-		setting = RunningInfo::instance().GetProductSetting().GetSettings();
-		sProd = RunningInfo::instance().GetProductionInfo().GetCurrentProd();
+		if(boardId() >= (int)m_pProductSettings->vCameras.size())
+		{
+			LogERROR << "cameraParams-" << sCam << " is not found in product " << m_pProductSettings->sProductName << " setting";
+			return false;
+		}
+		camera = m_pProductSettings->vCameras[boardId()];
 	}
-	else {
-		setting = RunningInfo::instance().GetTestProductSetting().GetSettings();
-		sProd = RunningInfo::instance().GetTestProductionInfo().GetCurrentProd();
+	else if(!readTestCameraParams(camera))
+	{
+		return false;
 	}
+
+	//step3: 相机参数设置
+	return applyCameraParams(camera);
+}
+
+bool AppWorkflow::readTestCameraParams(stCameraSettings &camera)
+{
+	const string sCam = to_string(boardId());
+	ProductSetting::PRODUCT_SETTING setting = RunningInfo::instance().GetTestProductSetting().GetSettings();
+	const string sProd = RunningInfo::instance().GetTestProductionInfo().GetCurrentProd();
 	if (!sProd.empty())
 	{
 		Database db;
@@ -271,7 +326,7 @@ bool AppWorkflow::initCameraParams(const int currentRunStatus)
 			LogERROR << "no complete child node[index, id] in parent node [" << sNodeName << "]";
 			return false;
 		}
-		// step3: 判断是从数据库读取还是从配置文件中读取 
+		// 判断是从数据库读取还是从配置文件中读取 
 		// tip: 如果从配置文件中获取，则所有工程的相机参数共用一个，此处与数据库中读取的情况不一致
 		if (paramconfig.second.get_child_optional("isRecordToDB"))
 		{
@@ -291,13 +346,17 @@ bool AppWorkflow::initCameraParams(const int currentRunStatus)
 		}
 		mapCameraParams.insert(make_pair(sID, setting.float_settings[index]));	
 	}
-	int exposure = int(mapCameraParams["exposure"]);
-	float gain = mapCameraParams["gain"];
-	bool gammaEnable = is_double_equal(mapCameraParams["gammaEnable"], 1., 10e-3);
-	float gammaValue = mapCameraParams["gammaValue"];
+	camera.exposure = int(mapCameraParams["exposure"]);
+	camera.gain = mapCameraParams["gain"];
+	camera.bIsGammaEnable = is_double_equal(mapCameraParams["gammaEnable"], 1., 10e-3);
+	camera.gammaValue = camera.bIsGammaEnable ? mapCameraParams["gammaValue"] : -1;
+	return true;
+}
 
-	//step4:相机参数解析，相机设置
-	vector<string> vCamType = CustomizedJsonConfig::instance().getVector<string>("CAMERA_TYPE");
+bool AppWorkflow::applyCameraParams(const stCameraSettings &camera)
+{
+	const string cameraName = "CAM" + to_string(boardId());
+	bool bIsStarted = false;
 	if (!getView()->getCamera()->cameraStarted())
 	{
 		if (!getView()->getCamera()->start())
@@ -305,52 +364,72 @@ bool AppWorkflow::initCameraParams(const int currentRunStatus)
 			LogERROR << "Start " << cameraName << " failed";
 			return false;
 		}
+		bIsStarted = true;
 	}
+	//相机重新启动或被直接调试过时全部下发, 否则与上次下发的参数相同时跳过
+	const long cameraVersion = AppProductCache::instance().cameraVersion();
+	if(!bIsStarted && m_bIsCameraConfigured && m_appliedCameraVersion == cameraVersion && camera == m_appliedCamera)
+	{
+		LogDEBUG << "Board[" << boardId() <<  "] camera parameters unchanged, skip";
+		return true;
+	}
+
+	vector<string> vCamType = CustomizedJsonConfig::instance().getVector<string>("CAMERA_TYPE");
 	shared_ptr<CameraConfig> config = getView()->getCamera()->config();
 	if ("AreaArray" == vCamType.at(boardId()))
 	{
-		dynamic_pointer_cast<HaikangCameraConfig>(config)->setExposure(exposure);
-		dynamic_pointer_cast<HaikangCameraConfig>(config)->setGain(gain);
-		if (gammaEnable)
-		{
-			dynamic_pointer_cast<HaikangCameraConfig>(config)->setGammaEnable(gammaEnable);
-			dynamic_pointer_cast<HaikangCameraConfig>(config)->setGamma(gammaValue);
-		}
-		else
-		{
-			dynamic_pointer_cast<HaikangCameraConfig>(config)->setGammaEnable(gammaEnable);
-			dynamic_pointer_cast<HaikangCameraConfig>(config)->setGamma(-1);
-		}
-		dynamic_pointer_cast<HaikangCameraConfig>(config)->setConfig();
+		shared_ptr<HaikangCameraConfig> pConfig = dynamic_pointer_cast<HaikangCameraConfig>(config);
+		pConfig->setExposure(camera.exposure);
+		pConfig->setGain(camera.gain);
+		pConfig->setGammaEnable(camera.bIsGammaEnable);
+		pConfig->setGamma(camera.gammaValue);
+		pConfig->setConfig();
 	}
 	else if ("LineScan" == vCamType.at(boardId()))
 	{
-		dynamic_pointer_cast<ItekCameraConfig>(config)->setExposure(exposure);
-		// dynamic_pointer_cast<ItekCameraConfig>(config)->setGain(gain);  // has no member named ‘setGain’
-		if (gammaEnable)
-		{
-			dynamic_pointer_cast<ItekCameraConfig>(config)->setGammaEnable(gammaEnable);
-			dynamic_pointer_cast<ItekCameraConfig>(config)->setGamma(gammaValue);
-		}
-		else
-		{
-			dynamic_pointer_cast<ItekCameraConfig>(config)->setGammaEnable(gammaEnable);
-			dynamic_pointer_cast<ItekCameraConfig>(config)->setGamma(-1);
-		}
-		dynamic_pointer_cast<ItekCameraConfig>(config)->setConfig();
+		shared_ptr<ItekCameraConfig> pConfig = dynamic_pointer_cast<ItekCameraConfig>(config);
+		pConfig->setExposure(camera.exposure);
+		// pConfig->setGain(camera.gain);  // has no member named ‘setGain’
+		pConfig->setGammaEnable(camera.bIsGammaEnable);
+		pConfig->setGamma(camera.gammaValue);
+		pConfig->setConfig();
 	}
 	else 
 	{
 	}
 
+	m_bIsCameraConfigured = true;
+	m_appliedCameraVersion = cameraVersion;
+	m_appliedCamera = camera;
 	return true;
 }
 
 bool AppWorkflow::reconfigParameters(const int currentRunStatus)
 {
+	//等待未完成的异步检测, 避免与算法重新初始化冲突; 流水线在途帧按旧参数给出结果
+	m_pPipeline.reset();
+	m_pRenderWorker.reset();
+	m_pCaptureWorker.reset();
+	m_mapPendingCaptures.clear();
+	m_bIsResultPending = false;
+
 	m_mapDefectIndexToType.clear();
 	m_mapDefectIndexToType[0] = (int)ClassifierResultConstant::Classifying;
 	m_mapDefectIndexToType[1] = (int)ClassifierResultConstant::Good;
+
+	//生产运行时产品参数从缓存读取, 每个产品只读一次数据库
+	m_pProductSettings = nullptr;
+	if(currentRunStatus == (int)RunStatus::PRODUCT_RUN)
+	{
+		const string sProd = RunningInfo::instance().GetProductionInfo().GetCurrentProd();
+		m_pProductSettings = AppProductCache::instance().get(sProd);
+		if(m_pProductSettings == nullptr)
+		{
+			LogERROR << "Board[" << boardId() <<  "] Read " << sProd << " setting from database failed!";
+			return false;
+		}
+	}
+
 	// init camera parameters
 	if (!initCameraParams(currentRunStatus))
 	{
@@ -381,15 +460,20 @@ bool AppWorkflow::reconfigParameters(const int currentRunStatus)
 
 	m_runStatus = currentRunStatus;
 	m_nTotalCaptureTimes = CustomizedJsonConfig::instance().getVector<int>("CAMERA_TOTAL_IMAGES")[boardId()];
+	m_bIsProductFusion = CustomizedJsonConfig::instance().get<bool>("IS_USE_PRODUCT_FUSION") && m_nTotalCaptureTimes > 1;
+	if(m_pProductFusion == nullptr)
+	{
+		m_pProductFusion = make_shared<AppProductFusion>(boardId(), m_nTotalCaptureTimes);
+	}
+	else
+	{
+		m_pProductFusion->reset(m_nTotalCaptureTimes);
+	}
 	if(currentRunStatus == (int)RunStatus::PRODUCT_RUN)
 	{
 		m_sProductName = RunningInfo::instance().GetProductionInfo().GetCurrentProd();
 		m_sProductLot = RunningInfo::instance().GetProductionInfo().GetCurrentLot();
-		if (!RunningInfo::instance().GetProductSetting().UpdateCurrentProductSettingFromDB(m_sProductName))
-		{
-			LogERROR << "Board[" << boardId() <<  "] Read " << m_sProductName << " setting from database failed!";
-			return false;
-		}
+		RunningInfo::instance().GetProductSetting().UpdateCurrentProductSetting(m_pProductSettings->setting);
 	}
 	else
     {
@@ -429,7 +513,7 @@ bool AppWorkflow::reconfigParameters(const int currentRunStatus)
 		m_purgeMode = (const int)RunningInfo::instance().GetTestProductSetting().GetFloatSetting((const int)ProductSettingFloatMapper::PURGE_SIGNAL_TYPE);
 		m_runMode = (const int)RunningInfo::instance().GetTestProductSetting().GetFloatSetting((const int)ProductSettingFloatMapper::RUN_MODE);
 	}
-	LogINFO << "Board[" << boardId() <<  "] software status: save image type = " << m_iSaveImageType << ", purge mode = " << m_purgeMode << ", run mode = " << m_runMode;
+	LogINFO << "Board[" << boardId() <<  "] software status: save image type = " << m_iSaveImageType.load() << ", purge mode = " << m_purgeMode << ", run mode = " << m_runMode;
 
 	stConfigParamsA stParamsA;
 	stConfigParamsB stParamsB;
@@ -439,19 +523,109 @@ bool AppWorkflow::reconfigParameters(const int currentRunStatus)
 		return false;
 	}
 	
-	if(!m_pAlgorithm || !m_pAlgorithm->init(stParamsA, stParamsB))
+	//模型相关参数未变化时(重新开始检测或换产)只重新编译检测方案, 否则重新加载模型
+	if(m_pAlgorithm && m_pAlgorithm->updateParams(stParamsA, stParamsB))
+	{
+		LogINFO << "Board[" << boardId() <<  "] algorithm models unchanged, only inspect plan updated";
+	}
+	else if(!m_pAlgorithm || !m_pAlgorithm->init(stParamsA, stParamsB))
 	{
 		LogERROR << "Board[" << boardId() <<  "] failed to initial agorithm params";
 		return false;
 	}
+	//阈值扫描使用本工位当前的算法实例, 与检测共享模型和原始结果缓存
+	shared_ptr<XJAppAlgorithm> pAlgorithm = m_pAlgorithm;
+	AppRunningResult::instance().setThresholdSweepHandler(boardId(), [pAlgorithm](const stSweepRequest &request, stSweepReport &report)
+	{
+		return pAlgorithm->sweepThresholds(request, report);
+	});
+
+	//一帧多片镜片, 每片镜片作为独立产品
+	const vector<int> vMaxLenses = CustomizedJsonConfig::instance().getVector<int>("MAX_LENSES_PER_FRAME");
+	m_maxLensesPerFrame = boardId() < (int)vMaxLenses.size() ? std::max(1, vMaxLenses[boardId()]) : 1;
+
+	//结果渲染存图移到独立线程, 队列长度为0时在检测线程中渲染
+	const vector<int> vRenderQueue = CustomizedJsonConfig::instance().getVector<int>("RESULT_RENDER_QUEUE_SIZE");
+	const vector<int> vRenderPolicy = CustomizedJsonConfig::instance().getVector<int>("RESULT_RENDER_QUEUE_POLICY");
+	const int renderQueueSize = boardId() < (int)vRenderQueue.size() ? vRenderQueue[boardId()] : 0;
+	if(renderQueueSize > 0)
+	{
+		const int renderPolicy = boardId() < (int)vRenderPolicy.size() ? vRenderPolicy[boardId()] : 0;
+		m_pRenderWorker = make_shared<AppRenderWorker>(boardId(), renderQueueSize, 
+				(renderPolicy >= (int)StageQueuePolicy::BLOCK && renderPolicy <= (int)StageQueuePolicy::DROP_OLDEST) ? (StageQueuePolicy)renderPolicy : StageQueuePolicy::BLOCK);
+	}
+
+	//乱序检测、顺序提交, 只在生产运行时开启, 1个检测线程时按原流程检测
+	const vector<int> vPipelineWorkers = CustomizedJsonConfig::instance().getVector<int>("DETECTOR_PIPELINE_WORKERS");
+	const vector<int> vPipelineDeadline = CustomizedJsonConfig::instance().getVector<int>("DETECTOR_PIPELINE_DEADLINE_MS");
+	const int numPipelineWorkers = boardId() < (int)vPipelineWorkers.size() ? vPipelineWorkers[boardId()] : 1;
+	if(numPipelineWorkers > 1 && currentRunStatus == (int)RunStatus::PRODUCT_RUN)
+	{
+		const vector<bool> vRejectOnOverload = CustomizedJsonConfig::instance().getVector<bool>("DETECTOR_PIPELINE_REJECT_ON_OVERLOAD");
+		stPipelineConfig config;
+		config.numWorkers = numPipelineWorkers;
+		config.deadlineMs = boardId() < (int)vPipelineDeadline.size() ? vPipelineDeadline[boardId()] : 0;
+		config.bIsRejectOnOverload = boardId() < (int)vRejectOnOverload.size() && vRejectOnOverload[boardId()];
+		config.pRenderWorker = m_pRenderWorker;
+		m_pPipeline = make_shared<AppInspectionPipeline>(boardId(), config);
+	}
+
+	//负载调节: 重新开始检测时恢复正常级别, 余量按并行检测数计算
+	AppLoadGovernor::instance().reset(boardId(), (m_pPipeline != nullptr) ? numPipelineWorkers : 1);
+	m_loadLevel = LoadLevel::NORMAL;
+	m_pAlgorithm->setProcessImageSaveEnabled(true);
 	
 	LogINFO << "Board[" << boardId() <<  "] load product " << m_sProductName << " parameters end!";
 	return true;
 }
 
+bool AppWorkflow::updateParameters(const int currentRunStatus)
+{
+	if(currentRunStatus != m_runStatus)
+	{
+		return false;
+	}
+
+	//保存方式随阈值一起更新, 其它软件状态(剔除、运行模式)需重新开始检测
+	if(currentRunStatus == (int)RunStatus::PRODUCT_RUN)
+	{
+		//参数写入数据库时缓存已失效, 此处重新读取一次
+		shared_ptr<const stProductSettings> pSettings = AppProductCache::instance().get(m_sProductName);
+		if(pSettings == nullptr)
+		{
+			LogERROR << "Board[" << boardId() <<  "] Read " << m_sProductName << " setting from database failed!";
+			return false;
+		}
+		m_pProductSettings = pSettings;
+		m_iSaveImageType = (const int)RunningInfo::instance().GetProductSetting().GetFloatSetting(int(ProductSettingFloatMapper::SAVE_IMAGE_TYPE));
+	}
+	else
+	{
+		m_iSaveImageType = (const int)RunningInfo::instance().GetTestProductSetting().GetFloatSetting(int(ProductSettingFloatMapper::SAVE_IMAGE_TYPE));
+	}
+
+	stConfigParamsA stParamsA;
+	stConfigParamsB stParamsB;
+	if(!initParamsA(stParamsA, currentRunStatus) || !initParamsB(stParamsB, currentRunStatus))
+	{
+		LogERROR << "Board[" << boardId() <<  "] failed to read app params for hot update";
+		return false;
+	}
+
+	if(!m_pAlgorithm || !m_pAlgorithm->updateParams(stParamsA, stParamsB))
+	{
+		LogWARNING << "Board[" << boardId() <<  "] parameters other than thresholds changed, take effect after detection restart";
+		return false;
+	}
+	LogINFO << "Board[" << boardId() <<  "] thresholds hot updated, save image type = " << m_iSaveImageType.load();
+	return true;
+}
+
 bool AppWorkflow::imagePreProcess()
 {
 	// extract frame into image in targets of the view
+	m_bIsResultPending = false;
+	m_bIsFrameDispatched = false;
 	shared_ptr<View> pView = getView();
 	if (pView == nullptr || !pView->isValid() || m_workflowImage.empty())
 	{
@@ -460,22 +634,22 @@ bool AppWorkflow::imagePreProcess()
 
 	try
 	{
-		if(m_workflowImage.channels() == 1)
+		//原始Bayer图保持单通道交给算法, 避免整帧转换
+		if(m_workflowImage.channels() == 1 && m_rawBayerCode < 0)
 		{
 			cvtColor(m_workflowImage, m_workflowImage, COLOR_GRAY2BGR);
 		}
 		
+		const shared_ptr<const stRuntimeConfig> pConfig = AppRuntimeConfig::instance().get();
 		//是否要挂起存图线程
-		const bool bIsHangUp =  CustomizedJsonConfig::instance().get<bool>("IS_NEED_HANGUP_IMAGE_SAVE_THREAD_BEFORE_IMAGE_PROCESS");
-		if(bIsHangUp)
+		if(pConfig->bIsHangUpSaveThread)
 		{
 			m_pSaveImageMultiThread->HangUpSaveThread();
 		}
 
 		//单target统计多瑕疵
-		const bool bIsEnable =  CustomizedJsonConfig::instance().get<bool>("IS_COUNT_MULTI_DEFECTS_PER_TARGET");
-		const int dubug_times =  CustomizedJsonConfig::instance().get<int>("CAPTUREIMAGETIMES");
-		if(bIsEnable)
+		const int dubug_times = pConfig->debugCaptureTimes;
+		if(pConfig->bIsCountMultiDefects)
 		{
 			m_mapDefects.clear();
 		}
@@ -487,7 +661,73 @@ bool AppWorkflow::imagePreProcess()
 			{
 				m_nCaptureImageTimes = dubug_times;
 			}					
-			vector<vector<int>> vTotalResultType = m_pAlgorithm->detectAnalyze(m_workflowImage, m_workflowProcessedImage, m_iProductNumber, m_nCaptureImageTimes);
+			//负载调节: 余量不足或存图队列积压时逐级关闭可选工作, 判定流程不受影响
+			const LoadLevel loadLevel = AppLoadGovernor::instance().update(boardId(), m_pSaveImageMultiThread ? m_pSaveImageMultiThread->GetQueueFill() : 0);
+			if((loadLevel >= LoadLevel::NO_PROCESS_IMAGES) != (m_loadLevel >= LoadLevel::NO_PROCESS_IMAGES))
+			{
+				m_pAlgorithm->setProcessImageSaveEnabled(loadLevel < LoadLevel::NO_PROCESS_IMAGES);
+			}
+			m_loadLevel = loadLevel;
+			//多次拍照并发检测: 非最后一次拍照在各自的推理上下文中异步执行, 最后一次拍照汇总结果
+			const bool bIsConcurrent = pConfig->bIsConcurrentCapture && m_nTotalCaptureTimes > 1
+					&& m_nCaptureImageTimes >= (int)CaptureImageTimes::FIRST_TIMES && m_nCaptureImageTimes <= m_nTotalCaptureTimes;
+
+			//图像质量不合格时不做推理, 直接给出结果
+			int qualityResult = (int)ClassifierResultConstant::Good;
+			const bool bIsQualityOK = checkImageQuality(qualityResult);
+			m_bIsFrameDispatched = (m_pPipeline != nullptr || m_maxLensesPerFrame > 1);
+			if(m_bIsFrameDispatched || (bIsConcurrent && m_nCaptureImageTimes < m_nTotalCaptureTimes))
+			{
+				//乱序检测或一帧多片镜片时, 每帧结果由提交流程给出
+				if(m_bIsFrameDispatched)
+				{
+					submitPipelineFrame(bIsQualityOK, qualityResult, numTargets);
+				}
+				else
+				{
+					launchPendingCapture(bIsQualityOK, qualityResult, numTargets);
+				}
+				m_bIsResultPending = true;
+				m_workflowProcessedImage.release();
+				for (int targetIdx = 0; targetIdx != numTargets; targetIdx++)
+				{
+					pView->getTarget(targetIdx)->setResult(ClassifierResultConstant::Good);
+				}
+				return true;
+			}
+
+			vector<vector<int>> vTotalResultType;
+			vector<stDefectInfo> vDefects;
+			if(!bIsQualityOK)
+			{
+				m_workflowProcessedImage.release();
+				vTotalResultType.assign(numTargets, vector<int>());
+				if(qualityResult != (int)ClassifierResultConstant::Good)
+				{
+					for(auto &vResult : vTotalResultType)
+					{
+						vResult.emplace_back(qualityResult);
+					}
+					stDefectInfo defect;
+					defect.type = qualityResult;
+					defect.nCaptureTimes = m_nCaptureImageTimes;
+					vDefects.emplace_back(defect);
+				}
+			}
+			else
+			{
+				AppTimer timer;
+				vTotalResultType = m_pAlgorithm->detectAnalyze(m_workflowImage, m_workflowProcessedImage, m_iProductNumber, m_nCaptureImageTimes, vDefects);
+				AppLoadGovernor::instance().addInspection(boardId(), timer.elapsed() * 1000);
+			}
+			if(m_bIsProductFusion && m_nCaptureImageTimes >= (int)CaptureImageTimes::FIRST_TIMES && m_nCaptureImageTimes <= m_nTotalCaptureTimes)
+			{
+				m_pProductFusion->addDefects(m_iProductNumber, m_nCaptureImageTimes, vDefects);
+			}
+			if(bIsConcurrent)
+			{
+				mergePendingCaptures(vTotalResultType);
+			}
 			if(vTotalResultType.size() != numTargets)
 			{
 				LogERROR << "Board[" << boardId() <<  "] result no match number of targets";
@@ -504,7 +744,7 @@ bool AppWorkflow::imagePreProcess()
 				else
 				{
 					//单target统计多瑕疵
-					if(bIsEnable)
+					if(pConfig->bIsCountMultiDefects)
 					{
 						for(const auto& result:vResult)
 						{
@@ -557,6 +797,453 @@ bool AppWorkflow::imagePreProcess()
 	return true;
 }
 
+bool AppWorkflow::checkImageQuality(int &resultType)
+{
+	const int boardID = boardId();
+	stImageQuality quality = m_pAlgorithm->checkImageQuality(m_workflowImage, m_nCaptureImageTimes);
+	if(quality.reason != ImageQualityReason::OK)
+	{
+		const shared_ptr<const stRuntimeConfig> pConfig = AppRuntimeConfig::instance().get();
+		const vector<int> &vAction = pConfig->vQualityRejectAction;
+		const int reasonIdx = (int)quality.reason;
+		int action = reasonIdx < (int)vAction.size() ? vAction[reasonIdx] : (int)ImageQualityAction::NG;
+
+		//重拍只对软触发相机有效, 硬触发相机无法再次取像, 按NG处理
+		if(action == (int)ImageQualityAction::RETRY)
+		{
+			const int retryTimes = pConfig->qualityRetryTimes;
+			const stBoardRuntimeConfig *pBoardConfig = pConfig->board(boardID);
+			if(pBoardConfig != nullptr && pBoardConfig->bIsSoftTrigger && getView()->getCamera() != nullptr)
+			{
+				for(int i = 0; i < retryTimes && quality.reason != ImageQualityReason::OK; i++)
+				{
+					Mat frame;
+					if(!getView()->getCamera()->read(frame) || frame.empty())
+					{
+						LogERROR << "extern: Board[" << boardID << "] image quality retry read camera failed";
+						break;
+					}
+					if(frame.channels() == 1 && m_rawBayerCode < 0)
+					{
+						cvtColor(frame, frame, COLOR_GRAY2BGR);
+					}
+					m_workflowImage = frame;
+					quality = m_pAlgorithm->checkImageQuality(m_workflowImage, m_nCaptureImageTimes);
+					LogINFO << "Board[" << boardID << "] image quality retry " << i + 1 << ": " << getImageQualityReasonName(quality.reason);
+				}
+			}
+			action = (int)ImageQualityAction::NG;
+		}
+
+		if(quality.reason != ImageQualityReason::OK)
+		{
+			LogERROR << "extern: Board[" << boardID << "] image quality " << getImageQualityReasonName(quality.reason) 
+					 << ", mean = " << quality.meanGray << ", low = " << quality.lowGray << ", high = " << quality.highGray 
+					 << ", focus = " << quality.focus << ", coverage = " << quality.coverage << ", time = " << quality.elapsedMs << "ms";
+			//跳过检测的帧没有检测结果, 不能判OK放行, 与NG一样按图像质量瑕疵类别剔除, 单独计数
+			resultType = pConfig->qualityDefectType + 2;
+			if(action == (int)ImageQualityAction::SKIP)
+			{
+				m_numQualitySkipped++;
+				RunningInfo::instance().GetRunningData().setCustomerDataByName("quality-skipped-" + to_string(boardID), to_string(m_numQualitySkipped));
+			}
+		}
+	}
+
+	if(quality.reason != m_lastQualityReason)
+	{
+		m_lastQualityReason = quality.reason;
+		RunningInfo::instance().GetRunningData().setCustomerDataByName("quality-" + to_string(boardID), getImageQualityReasonName(quality.reason));
+	}
+
+	return quality.reason == ImageQualityReason::OK;
+}
+
+void AppWorkflow::saveProductImages(const int productNumber)
+{
+	const int boardID = boardId();
+	vector<Mat> vSourceImages;
+	int fusedType = 0;
+	const Mat composedImage = m_pProductFusion->composeImage(productNumber, vSourceImages, fusedType);
+	const bool bIsOK = (fusedType == 0);
+	m_pProductFusion->erase(productNumber);
+	if(composedImage.empty() || !m_pSaveImageMultiThread)
+	{
+		return;
+	}
+
+	const bool bIsSaveOK = bIsOK && (m_iSaveImageType == (int)SaveImageType::ALL || (int)SaveImageType::BOARD_START + boardID == m_iSaveImageType)
+			&& AppLoadGovernor::instance().shouldSaveOK(boardID);
+	const bool bIsSaveNG = !bIsOK && (m_iSaveImageType != (int)SaveImageType::NO && (int)SaveImageType::BOARD_START + boardID != m_iSaveImageType);
+	if(!bIsSaveOK && !bIsSaveNG)
+	{
+		return;
+	}
+
+	const int resultType = convertDefectType(bIsOK ? (int)ClassifierResultConstant::Good : fusedType);
+	const shared_ptr<const stRuntimeConfig> pConfig = AppRuntimeConfig::instance().get();
+	const string sCameraName = getCameraName(*pConfig);
+	//1)保存原图
+	for(size_t i = 0; i != vSourceImages.size(); ++i)
+	{
+		if(vSourceImages[i].empty())
+		{
+			continue;
+		}
+		const string sCustomerEnd = "CNT" + to_string(productNumber) + "-PIC" + to_string(i + 1) + "_" + sCameraName;
+		const string sSavePath = bIsOK ? "/opt/history/good/" : "/opt/history/bad/";
+		const string sFileName = getAppFormatImageNameByCurrentTimeXJ(resultType, boardID, workflowId(), 0, m_sProductName, m_sProductLot, sCustomerEnd);
+		m_pSaveImageMultiThread->AddImageData(vSourceImages[i], sSavePath, sFileName);
+	}
+
+	//2)保存拼接结果图
+	const string sCustomerEnd = "CNT" + to_string(productNumber) + "-PICALL_" + sCameraName;
+	const string sFileName = getAppFormatImageNameByCurrentTimeXJ(resultType, boardID, workflowId(), 0, m_sProductName, m_sProductLot, sCustomerEnd);
+	if(bIsOK)
+	{
+		if(pConfig->bIsSaveOKResult)
+		{
+			m_pSaveImageMultiThread->AddImageData(composedImage, "/opt/history/resultImage/good/", sFileName, ".jpg");
+		}
+	}
+	else
+	{
+		const string sSavePath = "/opt/history/resultImage/bad/";
+		m_pSaveImageMultiThread->AddImageData(composedImage, sSavePath, sFileName, ".jpg");
+
+		//3)走马灯
+		m_numNGHistory ++;
+		m_numNGHistory = m_numNGHistory > pConfig->historyNGNum ? 1 : m_numNGHistory;
+		string sID = to_string(boardID) + "-" + to_string(m_numNGHistory);
+		RunningInfo::instance().GetRunningData().setCustomerDataByName(sID, sSavePath + sFileName + ".jpg");
+	}
+	m_pSaveImageMultiThread->WakeUpSaveThread();//唤醒存图线程
+}
+
+void AppWorkflow::launchPendingCapture(const bool bIsQualityOK, const int qualityResult, const int numTargets)
+{
+	//新产品第一次拍照, 丢弃上一个产品未汇总的结果; 已提交的检测仍在检测线程中执行完, 排在本次之前
+	if(m_nCaptureImageTimes == (int)CaptureImageTimes::FIRST_TIMES)
+	{
+		m_mapPendingCaptures.clear();
+	}
+	if(m_pCaptureWorker == nullptr)
+	{
+		m_pCaptureWorker = make_shared<AppRenderWorker>(boardId(), std::max(1, m_nTotalCaptureTimes), StageQueuePolicy::BLOCK, "capture");
+	}
+
+	stPendingCapture &capture = m_mapPendingCaptures[m_nCaptureImageTimes];
+	capture.pProcessedImage = make_shared<Mat>();
+	capture.pDefects = make_shared<vector<stDefectInfo>>();
+	capture.productNumber = m_iProductNumber;
+	if(bIsQualityOK)
+	{
+		//相机缓存会被下一次取像复用, 异步任务使用深拷贝
+		const Mat image = m_workflowImage.clone();
+		const shared_ptr<XJAppAlgorithm> pAlgorithm = m_pAlgorithm;
+		const shared_ptr<Mat> pProcessedImage = capture.pProcessedImage;
+		const shared_ptr<vector<stDefectInfo>> pDefects = capture.pDefects;
+		const int productNumber = m_iProductNumber;
+		const int nCaptureTimes = m_nCaptureImageTimes;
+		const int boardID = boardId();
+		shared_ptr<packaged_task<vector<vector<int>>()>> pTask = make_shared<packaged_task<vector<vector<int>>()>>(
+				[pAlgorithm, image, pProcessedImage, pDefects, productNumber, nCaptureTimes, boardID]()
+		{
+			AppTimer timer;
+			vector<vector<int>> vResult = pAlgorithm->detectAnalyze(image, *pProcessedImage, productNumber, nCaptureTimes, *pDefects);
+			AppLoadGovernor::instance().addInspection(boardID, timer.elapsed() * 1000);
+			return vResult;
+		});
+		capture.future = pTask->get_future();
+		if(!m_pCaptureWorker->submit([pTask]() { (*pTask)(); }))
+		{
+			//检测线程已停止, 在本线程中检测
+			(*pTask)();
+		}
+	}
+	else
+	{
+		vector<vector<int>> vResult(numTargets, vector<int>());
+		if(qualityResult != (int)ClassifierResultConstant::Good)
+		{
+			for(auto &vTargetResult : vResult)
+			{
+				vTargetResult.emplace_back(qualityResult);
+			}
+			stDefectInfo defect;
+			defect.type = qualityResult;
+			defect.nCaptureTimes = m_nCaptureImageTimes;
+			capture.pDefects->emplace_back(defect);
+		}
+		capture.future = async(launch::deferred, [vResult]()
+		{
+			return vResult;
+		});
+	}
+	LogINFO << "Board[" << boardId() << "] pic" << m_nCaptureImageTimes << " inspection launched, result pending";
+}
+
+void AppWorkflow::mergePendingCaptures(vector<vector<int>> &vTotalResultType)
+{
+	AppTimer timer;
+	const int boardID = boardId();
+	for(auto &iter : m_mapPendingCaptures)
+	{
+		const int nCaptureTimes = iter.first;
+		stPendingCapture &capture = iter.second;
+		if(nCaptureTimes >= m_nCaptureImageTimes || !capture.future.valid() || vTotalResultType.empty())
+		{
+			continue;
+		}
+
+		vector<vector<int>> vResult;
+		try
+		{
+			vResult = capture.future.get();
+		}
+		catch (const exception &e)
+		{
+			LogERROR << "extern: Board[" << boardID << "] pic" << nCaptureTimes << " inspection failed: " << e.what();
+		}
+		if(vResult.size() != vTotalResultType.size())
+		{
+			LogERROR << "extern: Board[" << boardID << "] pic" << nCaptureTimes << " result no match number of targets";
+			vResult.assign(vTotalResultType.size(), vector<int>());
+			vResult[0].emplace_back((int)ClassifierResultConstant::Good + 1);//defect1, 与算法库检测失败一致
+		}
+
+		if(m_bIsProductFusion)
+		{
+			m_pProductFusion->addDefects(capture.productNumber, nCaptureTimes, *capture.pDefects);
+		}
+
+		bool bIsOK = true;
+		for(size_t targetIdx = 0; targetIdx != vResult.size(); ++targetIdx)
+		{
+			bIsOK = bIsOK && vResult[targetIdx].empty();
+			vTotalResultType[targetIdx].insert(vTotalResultType[targetIdx].end(), vResult[targetIdx].begin(), vResult[targetIdx].end());
+		}
+
+		//之前拍照的NG结果图在汇总时保存, 显示仍为最后一次拍照; 产品级融合时由拼接图代替
+		if(!bIsOK && !m_bIsProductFusion && m_pSaveImageMultiThread && !capture.pProcessedImage->empty() && m_iSaveImageType != (int)SaveImageType::NO)
+		{
+			const string sCameraName = getCameraName(*AppRuntimeConfig::instance().get());
+			const string sCustomerEnd = "CNT" + to_string(capture.productNumber) + "-PIC" + to_string(nCaptureTimes) + "_" + sCameraName;
+			const string sSavePath = "/opt/history/resultImage/bad/";
+			const string sFileName = getAppFormatImageNameByCurrentTimeXJ(convertDefectType(vResult[0].empty() ? (int)ClassifierResultConstant::Good : vResult[0][0]), boardID, workflowId(), 0, m_sProductName, m_sProductLot, sCustomerEnd);
+			m_pSaveImageMultiThread->AddImageData(*capture.pProcessedImage, sSavePath, sFileName, ".jpg");
+		}
+		if(m_bIsProductFusion && !capture.pProcessedImage->empty())
+		{
+			m_pProductFusion->addImage(capture.productNumber, nCaptureTimes, *capture.pProcessedImage, Mat());
+		}
+	}
+	m_mapPendingCaptures.clear();
+	LogDEBUG << "Board[" << boardID << "] merge pending captures wait " << timer.elapsed() << " seconds";
+}
+
+void AppWorkflow::submitPipelineFrame(const bool bIsQualityOK, const int qualityResult, const int numTargets)
+{
+	//相机缓存会被下一次取像复用, 流水线使用深拷贝
+	shared_ptr<stPipelineFrame> pFrame = make_shared<stPipelineFrame>();
+	pFrame->image = (m_pPipeline != nullptr) ? m_workflowImage.clone() : m_workflowImage;
+	pFrame->productNumber = m_iProductNumber;
+	pFrame->nCaptureTimes = m_nCaptureImageTimes;
+	pFrame->numTargets = numTargets;
+	pFrame->verdictTicket = m_verdictTicket;
+	pFrame->vLenses.resize(1);
+	if(!bIsQualityOK)
+	{
+		stLensResult &lens = pFrame->vLenses[0];
+		lens.vResult.assign(numTargets, vector<int>());
+		if(qualityResult != (int)ClassifierResultConstant::Good)
+		{
+			for(auto &vResult : lens.vResult)
+			{
+				vResult.emplace_back(qualityResult);
+			}
+			stDefectInfo defect;
+			defect.type = qualityResult;
+			defect.nCaptureTimes = m_nCaptureImageTimes;
+			lens.vDefects.emplace_back(defect);
+		}
+	}
+
+	const shared_ptr<XJAppAlgorithm> pAlgorithm = m_pAlgorithm;
+	const int maxLenses = m_maxLensesPerFrame;
+	const int boardID = boardId();
+	auto inspect = [pAlgorithm, pFrame, bIsQualityOK, maxLenses, boardID]()
+	{
+		if(bIsQualityOK)
+		{
+			AppTimer timer;
+			pFrame->vLenses = pAlgorithm->detectAnalyzeLenses(pFrame->image, pFrame->productNumber, pFrame->nCaptureTimes, maxLenses);
+			AppLoadGovernor::instance().addInspection(boardID, timer.elapsed() * 1000);
+		}
+		pFrame->bIsInspected = true;
+	};
+	auto commit = [this, pFrame]()
+	{
+		commitPipelineFrame(*pFrame);
+	};
+	auto render = [this, pFrame]()
+	{
+		renderPipelineFrame(*pFrame);
+	};
+
+	if(m_pPipeline != nullptr)
+	{
+		m_pPipeline->submit(inspect, commit, render);
+	}
+	else
+	{
+		inspect();
+		commit();
+		render();
+	}
+}
+
+void AppWorkflow::commitPipelineFrame(stPipelineFrame &frame)
+{
+	if(m_pVerdictDeadline != nullptr)
+	{
+		m_pVerdictDeadline->setStage(frame.verdictTicket, VerdictStage::COMMIT);
+	}
+	//过载拒绝的帧没有检测, 与检测失败一样判NG
+	if(!frame.bIsInspected)
+	{
+		frame.vLenses.clear();
+	}
+	if(frame.vLenses.empty())
+	{
+		LogERROR << "extern: Board[" << boardId() << "] product " << frame.productNumber << " pic" << frame.nCaptureTimes << " inspection failed";
+		frame.vLenses.resize(1);
+	}
+
+	//多片镜片时每片镜片分配独立产品序号, 每帧预留MAX_LENSES_PER_FRAME个序号; 
+	//同一产品后续拍照沿用第一次拍照的序号, 镜片按从左到右对应
+	const int numLenses = frame.vLenses.size();
+	const bool bIsLaterCapture = frame.nCaptureTimes > (int)CaptureImageTimes::FIRST_TIMES && frame.nCaptureTimes <= m_nTotalCaptureTimes;
+	if(m_maxLensesPerFrame > 1 && !bIsLaterCapture)
+	{
+		m_lensProductBase = m_nextLensProductNumber;
+		m_nextLensProductNumber += m_maxLensesPerFrame;
+	}
+	if(numLenses > 1)
+	{
+		LogINFO << "Board[" << boardId() << "] pic" << frame.nCaptureTimes << " located " << numLenses << " lenses, first product " << m_lensProductBase;
+	}
+
+	frame.pConfig = AppRuntimeConfig::instance().get();
+	frame.vLensResults.clear();
+	frame.vProductNumbers.clear();
+	for(int lensIdx = 0; lensIdx != numLenses; ++lensIdx)
+	{
+		const int productNumber = (m_maxLensesPerFrame > 1) ? m_lensProductBase + lensIdx : frame.productNumber;
+		frame.vLensResults.emplace_back(commitLensResult(*frame.pConfig, frame.vLenses[lensIdx], productNumber, lensIdx, frame.nCaptureTimes, frame.numTargets, frame.verdictTicket));
+		frame.vProductNumbers.emplace_back(productNumber);
+	}
+}
+
+void AppWorkflow::renderPipelineFrame(stPipelineFrame &frame)
+{
+	if(frame.pConfig == nullptr)
+	{
+		return;
+	}
+	const Mat &image = frame.image;
+	const stBoardRuntimeConfig *pBoardConfig = frame.pConfig->board(boardId());
+	const double scale = (pBoardConfig != nullptr) ? pBoardConfig->drawScale : 1.0;
+	for(size_t lensIdx = 0; lensIdx < frame.vLensResults.size(); ++lensIdx)
+	{
+		stLensResult &lens = frame.vLenses[lensIdx];
+		if(lens.processedImage.empty())
+		{
+			if(m_rawBayerCode >= 0 && image.channels() == 1)
+			{
+				cvtColor(image, lens.processedImage, m_rawBayerCode);
+			}
+			else
+			{
+				lens.processedImage = image.clone();
+			}
+		}
+		//多片镜片时原图只保存镜片区域
+		const Mat sourceImage = (lens.box.area() > 0 && lens.box != Rect(0, 0, image.cols, image.rows)) ? image(lens.box) : image;
+		renderResult(*frame.pConfig, sourceImage, lens.processedImage, frame.vLensResults[lensIdx], frame.vProductNumbers[lensIdx], frame.nCaptureTimes, false, scale, 3);
+	}
+}
+
+ClassificationResult AppWorkflow::commitLensResult(const stRuntimeConfig &config, stLensResult &lens, const int productNumber, const int lensIdx, const int nCaptureTimes, const int numTargets,
+											   const long verdictTicket)
+{
+	const int boardID = boardId();
+	if(lens.vResult.size() != numTargets)
+	{
+		LogERROR << "extern: Board[" << boardID << "] product " << productNumber << " pic" << nCaptureTimes << " result no match number of targets";
+		lens.vResult.assign(std::max(numTargets, 1), vector<int>());
+		lens.vResult[0].emplace_back((int)ClassifierResultConstant::Good + 1);//defect1, 与算法库检测失败一致
+	}
+
+	//1.本帧结果
+	ClassificationResult result = ClassifierResultConstant::Good;
+	vector<ClassificationResult> vTotalResult;
+	set<int> setDefectTypes;
+	for(const auto &vResult : lens.vResult)
+	{
+		vTotalResult.emplace_back(vResult.empty() ? (int)ClassifierResultConstant::Good : vResult[0]);
+		setDefectTypes.insert(vResult.begin(), vResult.end());
+		if(result == ClassifierResultConstant::Good && !vResult.empty())
+		{
+			result = vResult[0];
+		}
+	}
+
+	//2.产品结果, 与purgeBoardResult一致; 产品级融合时只在最后一次拍照给出
+	const bool bIsFusion = m_bIsProductFusion && nCaptureTimes >= (int)CaptureImageTimes::FIRST_TIMES && nCaptureTimes <= m_nTotalCaptureTimes;
+	if(bIsFusion)
+	{
+		m_pProductFusion->addDefects(productNumber, nCaptureTimes, lens.vDefects);
+	}
+	if(!bIsFusion || nCaptureTimes == m_nTotalCaptureTimes)
+	{
+		if(bIsFusion)
+		{
+			if(!m_pProductFusion->isDefectsComplete(productNumber))
+			{
+				LogERROR << "extern: Board[" << boardID << "] product " << productNumber << " captures not complete, fuse available captures";
+			}
+			vector<stDefectInfo> vDefects;
+			m_pProductFusion->fuse(productNumber, vDefects);
+			setDefectTypes.clear();
+			for(const auto &defect : vDefects)
+			{
+				setDefectTypes.insert(defect.type);
+			}
+		}
+		if(bIsFusion || config.bIsCountMultiDefects)
+		{
+			vTotalResult.assign(setDefectTypes.begin(), setDefectTypes.end());
+			if(vTotalResult.empty())
+			{
+				vTotalResult.emplace_back((int)ClassifierResultConstant::Good);
+			}
+		}
+		if(m_productResultHandler)
+		{
+			m_productResultHandler(vTotalResult, (m_maxLensesPerFrame > 1) ? productNumber : -1, lensIdx, verdictTicket);
+		}
+	}
+
+	return result;
+}
+
+bool AppWorkflow::isVerdictExpected(const int nCaptureTimes) const
+{
+	const bool bIsMiddleCapture = nCaptureTimes >= (int)CaptureImageTimes::FIRST_TIMES && nCaptureTimes < m_nTotalCaptureTimes;
+	return !(bIsMiddleCapture && (m_bIsProductFusion || AppRuntimeConfig::instance().get()->bIsConcurrentCapture));
+}
+
 bool AppWorkflow::computerVisionProcess()
 {
 	// app need to write its own code to handle computer vision related process properly
@@ -572,123 +1259,180 @@ void AppWorkflow::drawDesignedTargets(const double scale, const int thickness)
 		return;
 	}
 
+	//乱序检测或一帧多片镜片时本帧结果图在提交流程中绘制、保存
+	if(m_bIsFrameDispatched)
+	{
+		return;
+	}
+
 	//1、获取结果
-	bool bIsOK = true;
 	ClassificationResult result = m_pView->getResult();
-	if(result != ClassifierResultConstant::Good)
+	shared_ptr<const stRuntimeConfig> pConfig = AppRuntimeConfig::instance().get();
+
+	//2、绘制图像
+	if(m_pRenderWorker == nullptr)
 	{
-		bIsOK = false;
+		if(m_workflowProcessedImage.empty() || m_runMode == (int)RunMode::RUN_EMPTY)
+		{
+			if(m_rawBayerCode >= 0 && m_workflowImage.channels() == 1)
+			{
+				cvtColor(m_workflowImage, m_workflowProcessedImage, m_rawBayerCode);
+			}
+			else
+			{
+				m_workflowProcessedImage = m_workflowImage.clone();
+			}
+		}
+		renderResult(*pConfig, m_workflowImage, m_workflowProcessedImage, result, m_iProductNumber, m_nCaptureImageTimes, m_bIsResultPending, scale, thickness);
+		return;
 	}
 
-	//2、绘制图像
+	//交给渲染线程: 相机缓存和结果图缓存会被下一帧复用, 渲染使用本帧的独立副本, 原图只在需要保存时复制
+	Mat processedImage;
 	if(m_workflowProcessedImage.empty() || m_runMode == (int)RunMode::RUN_EMPTY)
 	{
-		m_workflowProcessedImage = m_workflowImage.clone();
+		if(m_rawBayerCode >= 0 && m_workflowImage.channels() == 1)
+		{
+			cvtColor(m_workflowImage, processedImage, m_rawBayerCode);
+		}
+		else
+		{
+			processedImage = m_workflowImage.clone();
+		}
 	}
-	
-	const int boardID = boardId();
-	const vector<int> vPosX = CustomizedJsonConfig::instance().getVector<int>("CAMERA_IMAGE_DRAW_TEXT_POS_X");
-	if(vPosX.size() <= boardID)
+	else
 	{
-		LogERROR << "json config: CAMERA_IMAGE_DRAW_TEXT_POS_X";
-		return;
+		processedImage = m_workflowProcessedImage.clone();
 	}
-	const vector<int> vPosY = CustomizedJsonConfig::instance().getVector<int>("CAMERA_IMAGE_DRAW_TEXT_POS_Y");
-	if(vPosY.size() <= boardID)
+	const Mat sourceImage = pConfig->bIsSaveSource ? m_workflowImage.clone() : Mat();
+	const int productNumber = m_iProductNumber;
+	const int nCaptureTimes = m_nCaptureImageTimes;
+	const bool bIsPending = m_bIsResultPending;
+	m_pRenderWorker->submit([this, pConfig, sourceImage, processedImage, result, productNumber, nCaptureTimes, bIsPending, scale, thickness]() mutable
 	{
-		LogERROR << "json config: CAMERA_IMAGE_DRAW_TEXT_POS_Y";
-		return;
-	}
-	const vector<int> vFontScale = CustomizedJsonConfig::instance().getVector<int>("CAMERA_IMAGE_DRAW_TEXT_FONT_SCALE");
-	if(vFontScale.size() <= boardID)
+		renderResult(*pConfig, sourceImage, processedImage, result, productNumber, nCaptureTimes, bIsPending, scale, thickness);
+	});
+}
+
+void AppWorkflow::renderResult(const stRuntimeConfig &config, const Mat &sourceImage, Mat &processedImage, const ClassificationResult result, const int productNumber, const int nCaptureTimes, const bool bIsPending, const double scale, const int thickness)
+{
+	const bool bIsOK = (result == ClassifierResultConstant::Good);
+	const int boardID = boardId();
+	const stBoardRuntimeConfig *pBoardConfig = config.board(boardID);
+	if(pBoardConfig == nullptr)
 	{
-		LogERROR << "json config: CAMERA_IMAGE_DRAW_TEXT_FONT_SCALE";
+		LogERROR << "json config: CAMERA_IMAGE_DRAW_TEXT_POS_X/Y, CAMERA_IMAGE_DRAW_TEXT_FONT_SCALE";
 		return;
 	}
 
 	Scalar color = bIsOK ? Scalar(0, 255, 0) : Scalar(0, 0, 255);
-	// string sText = "pic" + to_string(m_nCaptureImageTimes) + "/"  + to_string(m_nTotalCaptureTimes);
-	string sText = "pic" + to_string(m_nCaptureImageTimes);
-	sText += bIsOK ? "-OK": "-NG";
-	if(m_nCaptureImageTimes == (int)CaptureImageTimes::UNKNOWN_TIMES || m_nCaptureImageTimes > m_nTotalCaptureTimes)
+	// string sText = "pic" + to_string(nCaptureTimes) + "/"  + to_string(m_nTotalCaptureTimes);
+	string sText = "pic" + to_string(nCaptureTimes);
+	sText += bIsPending ? "-WAIT" : (bIsOK ? "-OK": "-NG");
+	if(nCaptureTimes == (int)CaptureImageTimes::UNKNOWN_TIMES || nCaptureTimes > m_nTotalCaptureTimes || bIsPending)
 	{
 		color = Scalar(255, 255, 255);
 	}
-	putText(m_workflowProcessedImage, sText, Point(vPosX[boardID], vPosY[boardID]), FONT_HERSHEY_SIMPLEX, vFontScale[boardID], color, thickness);
+	//负载调节降级时先缩小再绘制、保存, 之后只缩放剩余比例; 产品级融合需各次拍照尺寸一致, 不降低分辨率
+	const double renderScale = m_bIsProductFusion ? 1.0 : AppLoadGovernor::instance().getRenderScale(boardID);
+	double resizeScale = scale;
+	if(renderScale < 1.0)
+	{
+		resize(processedImage, processedImage, cv::Size(0, 0), renderScale, renderScale, INTER_NEAREST);
+		resizeScale = std::min(1.0, scale / renderScale);
+	}
+	putText(processedImage, sText, Point(pBoardConfig->textPosX * renderScale, pBoardConfig->textPosY * renderScale), FONT_HERSHEY_SIMPLEX, pBoardConfig->textFontScale * renderScale, 
+			color, std::max(1, (int)(thickness * renderScale + 0.5)));
 
 	//3、缩放结果图
-	const bool bIsResize =  CustomizedJsonConfig::instance().get<bool>("IS_SAVE_RESIZE_RESULT_IMAGE");
+	const bool bIsResize = config.bIsSaveResizeResult;
 	if(bIsResize)
 	{
-		resize(m_workflowProcessedImage, m_workflowProcessedImage, cv::Size(0, 0), scale, scale, INTER_NEAREST);
+		resize(processedImage, processedImage, cv::Size(0, 0), resizeScale, resizeScale, INTER_NEAREST);
 	}
-	LogINFO << "extern: Board[" << boardId() <<  "] STEP 1, vPosX size: "<<vPosX.size()<< "vPosY size: "<<vPosY.size()<<" vFontScale size"<<vFontScale.size();
+	LogINFO << "extern: Board[" << boardID <<  "] STEP 1, config version: " << config.version;
 
-	//4、保存结果图
-	if(m_nCaptureImageTimes != (int)CaptureImageTimes::UNKNOWN_TIMES && m_nCaptureImageTimes <= m_nTotalCaptureTimes)
+	//4、保存结果图, 产品级融合时每个产品只保存一张拼接图
+	const bool bIsValidCapture = nCaptureTimes != (int)CaptureImageTimes::UNKNOWN_TIMES && nCaptureTimes <= m_nTotalCaptureTimes;
+	if(bIsValidCapture && m_bIsProductFusion)
+	{
+		if(!bIsPending)
+		{
+			m_pProductFusion->addImage(productNumber, nCaptureTimes, processedImage, config.bIsSaveSource ? sourceImage.clone() : Mat());
+		}
+		if(nCaptureTimes == m_nTotalCaptureTimes)
+		{
+			saveProductImages(productNumber);
+		}
+	}
+	else if(bIsValidCapture && !bIsPending)
 	{
 		if(m_pSaveImageMultiThread)
 		{
-			if(bIsOK && (m_iSaveImageType == (int)SaveImageType::ALL || (int)SaveImageType::BOARD_START + boardID == m_iSaveImageType))
+			if(bIsOK && (m_iSaveImageType == (int)SaveImageType::ALL || (int)SaveImageType::BOARD_START + boardID == m_iSaveImageType)
+					&& AppLoadGovernor::instance().shouldSaveOK(boardID))
 			{
 				//1)保存OK原图
-				const bool bIsSaveSource =  CustomizedJsonConfig::instance().get<bool>("IS_NEED_SAVE_SOURCE_IMAGE_IN_APP");
-				string sCameraName = CustomizedJsonConfig::instance().getVector<string>("CAMERA_NAME")[boardID];
-				string sCustomerEnd = "CNT" + to_string(m_iProductNumber) + "-PIC" + to_string(m_nCaptureImageTimes) + "_" + sCameraName;
+				const bool bIsSaveSource = config.bIsSaveSource;
+				const string &sCameraName = pBoardConfig->sCameraName;
+				string sCustomerEnd = "CNT" + to_string(productNumber) + "-PIC" + to_string(nCaptureTimes) + "_" + sCameraName;
 				if(bIsSaveSource)
 				{				
 					string sSavePath = "/opt/history/good/";
-					string sFileName = getAppFormatImageNameByCurrentTimeXJ(convertDefectType((int)result), boardId(), workflowId(), 0, m_sProductName, m_sProductLot, sCustomerEnd);
-					m_pSaveImageMultiThread->AddImageData(m_workflowImage, sSavePath, sFileName);
+					string sFileName = getAppFormatImageNameByCurrentTimeXJ(convertDefectType((int)result), boardID, workflowId(), 0, m_sProductName, m_sProductLot, sCustomerEnd);
+					m_pSaveImageMultiThread->AddImageData(sourceImage, sSavePath, sFileName);
 				}
 				
 				//2)保存OK结果图
-				const bool bIsSave =  CustomizedJsonConfig::instance().get<bool>("IS_NEED_SAVE_OK_RESULT_IMAGE");
-				if(bIsSave)
+				if(config.bIsSaveOKResult)
 				{
 					string sSavePath = "/opt/history/resultImage/good/";
-					string sFileName = getAppFormatImageNameByCurrentTimeXJ(convertDefectType((int)result), boardId(), workflowId(), 0, m_sProductName, m_sProductLot, sCustomerEnd);
-					m_pSaveImageMultiThread->AddImageData(m_workflowProcessedImage, sSavePath, sFileName, ".jpg");
+					string sFileName = getAppFormatImageNameByCurrentTimeXJ(convertDefectType((int)result), boardID, workflowId(), 0, m_sProductName, m_sProductLot, sCustomerEnd);
+					m_pSaveImageMultiThread->AddImageData(processedImage, sSavePath, sFileName, ".jpg");
 				}			
 			}	
 			else if(!bIsOK && (m_iSaveImageType != (int)SaveImageType::NO && (int)SaveImageType::BOARD_START + boardID != m_iSaveImageType))
 			{
 				//1)保存NG原图
-				const bool bIsSaveSource =  CustomizedJsonConfig::instance().get<bool>("IS_NEED_SAVE_SOURCE_IMAGE_IN_APP");
-				string sCameraName = CustomizedJsonConfig::instance().getVector<string>("CAMERA_NAME")[boardID];
-				string sCustomerEnd = "CNT" + to_string(m_iProductNumber) + "-PIC" + to_string(m_nCaptureImageTimes) + "_" + sCameraName;
+				const bool bIsSaveSource = config.bIsSaveSource;
+				const string &sCameraName = pBoardConfig->sCameraName;
+				string sCustomerEnd = "CNT" + to_string(productNumber) + "-PIC" + to_string(nCaptureTimes) + "_" + sCameraName;
 				if(bIsSaveSource)
 				{
 					string sSavePath = "/opt/history/bad/";
-					string sFileName = getAppFormatImageNameByCurrentTimeXJ(convertDefectType((int)result), boardId(), workflowId(), 0, m_sProductName, m_sProductLot, sCustomerEnd);
-					m_pSaveImageMultiThread->AddImageData(m_workflowImage, sSavePath, sFileName);
+					string sFileName = getAppFormatImageNameByCurrentTimeXJ(convertDefectType((int)result), boardID, workflowId(), 0, m_sProductName, m_sProductLot, sCustomerEnd);
+					m_pSaveImageMultiThread->AddImageData(sourceImage, sSavePath, sFileName);
 				}
 
 				//2)保存NG结果图
 				string sSavePath = "/opt/history/resultImage/bad/";
-				string sFileName = getAppFormatImageNameByCurrentTimeXJ(convertDefectType((int)result), boardId(), workflowId(), 0, m_sProductName, m_sProductLot, sCustomerEnd);
-				m_pSaveImageMultiThread->AddImageData(m_workflowProcessedImage, sSavePath, sFileName, ".jpg");
+				string sFileName = getAppFormatImageNameByCurrentTimeXJ(convertDefectType((int)result), boardID, workflowId(), 0, m_sProductName, m_sProductLot, sCustomerEnd);
+				m_pSaveImageMultiThread->AddImageData(processedImage, sSavePath, sFileName, ".jpg");
 
 				//3)走马灯
 				m_numNGHistory ++;
-				const int num = CustomizedJsonConfig::instance().get<int>("UISetting.operation.historyNg.num");
-				m_numNGHistory = m_numNGHistory > num ? 1 : m_numNGHistory;
-				string sID = to_string(boardId()) + "-" + to_string(m_numNGHistory);
+				m_numNGHistory = m_numNGHistory > config.historyNGNum ? 1 : m_numNGHistory;
+				string sID = to_string(boardID) + "-" + to_string(m_numNGHistory);
 				RunningInfo::instance().GetRunningData().setCustomerDataByName(sID, sSavePath + sFileName + ".jpg");
 			}	
 			m_pSaveImageMultiThread->WakeUpSaveThread();//唤醒存图线程
 		}
 	}
 
-	//5、缩放图像到UI显示结果图
+	//5、缩放图像到UI显示结果图, UI长时间未读取时跳过
+	const int nCaptureImageTimes = (nCaptureTimes == (int)CaptureImageTimes::UNKNOWN_TIMES) ? (int)CaptureImageTimes::FIRST_TIMES : nCaptureTimes;
+	const string sCamID = "CAM" + to_string(boardID);
+	if(!AppRunningResult::instance().isResultViewerNeeded(sCamID, nCaptureImageTimes, config.resultViewerIdleMs))
+	{
+		return;
+	}
 	if(!bIsResize)
 	{
-		resize(m_workflowProcessedImage, m_workflowProcessedImage, cv::Size(0, 0), scale, scale, INTER_NEAREST);
+		resize(processedImage, processedImage, cv::Size(0, 0), resizeScale, resizeScale, INTER_NEAREST);
 	}
-	LogINFO << "extern: Board[" << boardId() <<  "] STEP 2";
+	LogINFO << "extern: Board[" << boardID <<  "] STEP 2";
 	//6.设置结果
-	int nCaptureImageTimes = (m_nCaptureImageTimes == (int)CaptureImageTimes::UNKNOWN_TIMES) ? (int)CaptureImageTimes::FIRST_TIMES : m_nCaptureImageTimes;
-	AppRunningResult::instance().setCurrentResultMap(m_workflowProcessedImage, result, "CAM" + to_string(boardID),  nCaptureImageTimes);
-	LogINFO << "extern: Board[" << boardId() <<  "] STEP 3";
+	AppRunningResult::instance().setCurrentResultMap(processedImage, result, sCamID,  nCaptureImageTimes);
+	LogINFO << "extern: Board[" << boardID <<  "] STEP 3";
 }
 
@@ -1,9 +1,18 @@
 #ifndef XJ_APP_WORKFLOW_H
 #define XJ_APP_WORKFLOW_H
 
+#include <future>
+#include <atomic>
+#include <functional>
 #include <opencv2/opencv.hpp>
 #include "workflow.h"
 #include "xj_app_algorithm.h"
+#include "xj_app_product_fusion.h"
+#include "xj_app_inspection_pipeline.h"
+#include "xj_app_runtime_config.h"
+#include "xj_app_product_cache.h"
+#include "xj_app_verdict_deadline.h"
+#include "xj_app_load_governor.h"
 
 
 class AppWorkflow : public BaseWorkflow
@@ -17,6 +26,8 @@ public:
 
 	//重置参数
 	bool reconfigParameters(const int currentRunStatus);
+	//阈值类参数热更新: 不停止检测、不重新加载模型, 下一帧生效; 有其它参数变化时返回false, 需重新开始检测后生效
+	bool updateParameters(const int currentRunStatus);
 
 	//设置多线程存图指针
 	void setImageSave(const std::shared_ptr<MultiThreadImageSaveBase> &pSave){ m_pSaveImageMultiThread = pSave; }
@@ -28,6 +39,28 @@ public:
 	void setProductNumber(int iProductNumber){m_iProductNumber = iProductNumber;}
 	int getProductNumber(){return m_iProductNumber;}
 
+	//多次拍照并发检测时, 非最后一次拍照的结果延后到最后一次拍照一起给出
+	bool isResultPending() const {return m_bIsResultPending;}
+
+	//产品级融合
+	bool isProductFusionEnabled() const {return m_bIsProductFusion;}
+	std::shared_ptr<AppProductFusion> getProductFusion(){return m_pProductFusion;}
+
+	//乱序检测、顺序提交: 开启时产品结果由流水线提交线程按产品顺序交给handler
+	std::shared_ptr<AppInspectionPipeline> getInspectionPipeline(){return m_pPipeline;}
+	//一帧多片镜片或乱序检测时, 本帧结果已由提交流程给出, 框架流程不再剔除、绘制
+	bool isFrameDispatched() const {return m_bIsFrameDispatched;}
+	//产品结果, productNumber为-1时使用实际产品计数; lensIdx为镜片在帧中的序号, 对应PLC结果地址偏移; verdictTicket为判定时限计时编号
+	typedef std::function<void(const std::vector<ClassificationResult> &vTotalResult, const int productNumber, const int lensIdx, const long verdictTicket)> ProductResultHandler;
+	void setProductResultHandler(const ProductResultHandler &handler){m_productResultHandler = handler;}
+	int getMaxLensesPerFrame() const {return m_maxLensesPerFrame;}
+
+	//判定时限: 每帧的计时编号随帧进入提交流程, 提交开始时记录阶段
+	void setVerdictDeadline(const std::shared_ptr<AppVerdictDeadline> &pDeadline){m_pVerdictDeadline = pDeadline;}
+	void setVerdictTicket(const long ticket){m_verdictTicket = ticket;}
+	//本次拍照是否给出判定, 产品级融合、多次拍照并发检测时中间拍照不给出
+	bool isVerdictExpected(const int nCaptureTimes) const;
+
 protected:
 	virtual void drawDesignedTargets(const double scale, const int thickness = 3);
 
@@ -46,10 +79,16 @@ private:
 	int m_iProductNumber;//产品数
 	std::string m_sProductName;//产品名称
 	std::string m_sProductLot;//产品批号
+	std::shared_ptr<const stProductSettings> m_pProductSettings;//生产运行时当前产品的缓存参数
+
+	//换产时只下发有变化的相机参数
+	bool m_bIsCameraConfigured;
+	long m_appliedCameraVersion;
+	stCameraSettings m_appliedCamera;
 	
 	//存图
 	int m_numNGHistory;
-	int m_iSaveImageType; //0-保存全部， 1-保存NG， 2-不保存
+	std::atomic<int> m_iSaveImageType; //0-保存全部， 1-保存NG， 2-不保存; 热更新时在检测线程修改, 流水线提交线程读取
 	int m_purgeMode;//0-正常剔除， 1-全部OK， 2-全部NG, 3-OK-NG交替
 	int m_runMode;//0-检测  1-空跑
 
@@ -61,9 +100,82 @@ private:
 	std::map<int, int> m_mapDefects;//瑕疵映射表<瑕疵类别，个数>
 	std::map<int, int> m_mapDefectIndexToType; //<瑕疵索引, 瑕疵类别>
 
+	ImageQualityReason m_lastQualityReason;//上一张图像质量检查结果
+	long m_numQualitySkipped;//图像质量不合格跳过检测的帧数
+	int m_rawBayerCode;//原始Bayer输入时整帧转彩色的cvtColor code, -1表示相机已输出gray/bgr
+
+	//多次拍照并发检测: 非最后一次拍照异步检测, 最后一次拍照汇总
+	struct stPendingCapture
+	{
+		std::future<std::vector<std::vector<int>>> future;
+		std::shared_ptr<cv::Mat> pProcessedImage;
+		std::shared_ptr<std::vector<stDefectInfo>> pDefects;
+		int productNumber;
+	};
+	std::map<int, stPendingCapture> m_mapPendingCaptures;//<拍照次数, 检测任务>
+	//非最后一次拍照的检测在本工位一个线程中依次执行, 不为每次拍照新建线程; 队列长度为拍照次数, 满时阻塞
+	std::shared_ptr<AppRenderWorker> m_pCaptureWorker;
+	bool m_bIsResultPending;
+
+	//产品级融合: 多次拍照的瑕疵去重后只判定、记录、存图一次
+	bool m_bIsProductFusion;
+	std::shared_ptr<AppProductFusion> m_pProductFusion;
+
+	//乱序检测、顺序提交: 连续帧在多个检测线程中并发检测, 结果图、产品结果在提交线程中按顺序给出
+	//一帧多片镜片: 每片镜片作为独立产品, 分配各自的产品序号, 分别判定、记录、发信号
+	struct stPipelineFrame
+	{
+		cv::Mat image;
+		std::vector<stLensResult> vLenses;//单片镜片时为整帧结果
+		int productNumber;
+		int nCaptureTimes;
+		int numTargets;
+		bool bIsInspected = false;//流水线过载拒绝时为false, 按检测失败给出NG
+		long verdictTicket = -1;
+		//判定阶段填写, 渲染阶段使用
+		std::vector<ClassificationResult> vLensResults;
+		std::vector<int> vProductNumbers;
+		std::shared_ptr<const stRuntimeConfig> pConfig;
+	};
+	int m_maxLensesPerFrame;//每帧最多镜片数, 1为单片
+	int m_nextLensProductNumber;//多片镜片时下一片镜片的产品序号
+	int m_lensProductBase;//多片镜片时当前产品第一片镜片的序号, 同一产品的多次拍照沿用
+	bool m_bIsFrameDispatched;
+	ProductResultHandler m_productResultHandler;
+	std::shared_ptr<AppVerdictDeadline> m_pVerdictDeadline;
+	long m_verdictTicket;//当前帧的判定计时编号, -1表示不计时
+	LoadLevel m_loadLevel;//负载调节级别, 变化时切换过程小图保存
+	//结果渲染存图线程, 检测线程发出信号后即返回取像; nullptr时在检测线程中直接渲染
+	std::shared_ptr<AppRenderWorker> m_pRenderWorker;
+	std::shared_ptr<AppInspectionPipeline> m_pPipeline;//放在最后, 最先析构, 等待在途帧提交完成
+
+	//图像质量检查, 返回false表示本帧不做检测, resultType为本帧结果
+	bool checkImageQuality(int &resultType);
+
+	void launchPendingCapture(const bool bIsQualityOK, const int qualityResult, const int numTargets);
+	void mergePendingCaptures(std::vector<std::vector<int>> &vTotalResultType);
+	//产品级融合时, 最后一次拍照保存整个产品的拼接结果图
+	void saveProductImages(const int productNumber);
+
+	//交给流水线检测, 没有流水线时(一帧多片镜片)在检测线程中直接检测、提交
+	void submitPipelineFrame(const bool bIsQualityOK, const int qualityResult, const int numTargets);
+	//判定、发信号, 按产品顺序执行
+	void commitPipelineFrame(stPipelineFrame &frame);
+	ClassificationResult commitLensResult(const stRuntimeConfig &config, stLensResult &lens, const int productNumber, const int lensIdx, const int nCaptureTimes, const int numTargets,
+										  const long verdictTicket);
+	//绘制、存图、更新UI显示, 在判定之后按产品顺序执行, 可在独立的渲染线程中
+	void renderPipelineFrame(stPipelineFrame &frame);
+	//绘制结果文字、保存结果图并更新UI显示, 整个过程使用同一个配置快照
+	void renderResult(const stRuntimeConfig &config, const cv::Mat &sourceImage, cv::Mat &processedImage, const ClassificationResult result, const int productNumber, 
+					  const int nCaptureTimes, const bool bIsPending, const double scale, const int thickness);
+
 	int convertDefectType(const int defectIndex);
+	//本工位相机名, 用于结果图文件名
+	std::string getCameraName(const stRuntimeConfig &config);
 
 	bool initCameraParams(const int currentRunStatus);    // 从数据库/配置文件中初始化相机曝光、增益等设置
+	bool readTestCameraParams(stCameraSettings &camera); // 测试运行时读取测试产品的相机参数
+	bool applyCameraParams(const stCameraSettings &camera);
 	bool initParamsA(stConfigParamsA &stParamsA, const int currentRunStatus);
 	bool initParamsB(stConfigParamsB &stParamsB, const int currentRunStatus);
 };
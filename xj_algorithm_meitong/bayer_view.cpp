@@ -0,0 +1,95 @@
+#include "bayer_view.h"
+
+using namespace cv;
+using namespace std;
+
+//OpenCV按第二行第二、三个像素命名Bayer排列, 与GenICam命名相差一行一列
+int getDemosaicCode(const BayerPattern pattern)
+{
+    switch(pattern)
+    {
+    case BayerPattern::RG: return COLOR_BayerBG2BGR;
+    case BayerPattern::GR: return COLOR_BayerGB2BGR;
+    case BayerPattern::GB: return COLOR_BayerGR2BGR;
+    case BayerPattern::BG: return COLOR_BayerRG2BGR;
+    default: break;
+    }
+    return -1;
+}
+
+BayerPattern getBayerPattern(const string &sPixelFormat)
+{
+    if(sPixelFormat.compare(0, 7, "BayerRG") == 0)
+    {
+        return BayerPattern::RG;
+    }
+    if(sPixelFormat.compare(0, 7, "BayerGR") == 0)
+    {
+        return BayerPattern::GR;
+    }
+    if(sPixelFormat.compare(0, 7, "BayerGB") == 0)
+    {
+        return BayerPattern::GB;
+    }
+    if(sPixelFormat.compare(0, 7, "BayerBG") == 0)
+    {
+        return BayerPattern::BG;
+    }
+    return BayerPattern::NONE;
+}
+
+void getBayerBinnedGray(const Mat &rawImage, Mat &grayImage)
+{
+    //偶数尺寸下INTER_AREA缩小一半即2x2均值, 每个窗口正好含R、B各一个和G两个
+    const Mat evenImage = rawImage(Rect(0, 0, rawImage.cols & ~1, rawImage.rows & ~1));
+    if(evenImage.empty())
+    {
+        grayImage.release();
+        return;
+    }
+    resize(evenImage, grayImage, Size(evenImage.cols / 2, evenImage.rows / 2), 0, 0, INTER_AREA);
+}
+
+bool demosaicBayerROI(const Mat &rawImage, const Rect &roiRect, const BayerPattern pattern, Mat &bgrImage)
+{
+    const int code = getDemosaicCode(pattern);
+    const Rect globalRC(0, 0, rawImage.cols, rawImage.rows);
+    const Rect rc = roiRect & globalRC;
+    if(code < 0 || rawImage.channels() != 1 || rc.width <= 0 || rc.height <= 0)
+    {
+        return false;
+    }
+
+    //step1: 外扩插值邻域, 左上角对齐到偶数, 保证裁剪后Bayer相位不变
+    const int border = 2;
+    Rect extRC(rc.x - border, rc.y - border, rc.width + border * 2, rc.height + border * 2);
+    extRC &= globalRC;
+    extRC.width += extRC.x & 1;
+    extRC.height += extRC.y & 1;
+    extRC.x &= ~1;
+    extRC.y &= ~1;
+    extRC &= globalRC;
+
+    //step2: 只对外扩区域去马赛克, 再取回原区域
+    Mat extImage;
+    cvtColor(rawImage(extRC), extImage, code);
+    bgrImage = extImage(Rect(rc.x - extRC.x, rc.y - extRC.y, rc.width, rc.height));
+    return true;
+}
+
+void mosaicBayer(const Mat &bgrImage, const BayerPattern pattern, Mat &rawImage)
+{
+    //2x2窗口内各位置取的bgr通道, 顺序为(0,0) (0,1) (1,0) (1,1)
+    static const int channelTable[5][4] = {{1, 1, 1, 1}, {2, 1, 1, 0}, {1, 2, 0, 1}, {1, 0, 2, 1}, {0, 1, 1, 2}};
+    const int *pChannels = channelTable[(int)pattern];
+    rawImage.create(bgrImage.rows, bgrImage.cols, CV_8UC1);
+    for(int y = 0; y < bgrImage.rows; ++y)
+    {
+        const Vec3b *pSrc = bgrImage.ptr<Vec3b>(y);
+        uchar *pDst = rawImage.ptr<uchar>(y);
+        for(int x = 0; x < bgrImage.cols; ++x)
+        {
+            pDst[x] = pSrc[x][pChannels[(y & 1) * 2 + (x & 1)]];
+        }
+    }
+}
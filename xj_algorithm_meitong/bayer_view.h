@@ -0,0 +1,65 @@
+#ifndef BAYER_VIEW_H
+#define BAYER_VIEW_H
+
+#include <string>
+#include <opencv2/opencv.hpp>
+
+//Bayer排列, 按GenICam像素格式命名(首行前两个像素), 如BayerRG8为RGGB
+enum class BayerPattern : int
+{
+    NONE    = 0,    //非原始Bayer图, 已是gray或bgr
+    RG      = 1,
+    GR      = 2,
+    GB      = 3,
+    BG      = 4
+};
+
+/**
+ * @brief get bayer pattern from camera pixel format, such as "BayerRG8".
+ *
+ * @param sPixelFormat camera pixel format.
+ * @return bayer pattern, NONE if pixel format is not bayer.
+ */
+BayerPattern getBayerPattern(const std::string &sPixelFormat);
+
+/**
+ * @brief get cv::cvtColor code that demosaics a raw bayer frame to bgr.
+ *        OpenCV names bayer patterns by the second row, one row and column off from GenICam.
+ *
+ * @param pattern bayer pattern of the raw frame.
+ * @return cvtColor code, -1 if pattern is NONE.
+ */
+int getDemosaicCode(const BayerPattern pattern);
+
+/**
+ * @brief cheap gray view of a raw bayer frame for localization, 2x2 binned, half size.
+ *        each output pixel is (R + G + G + B) / 4, so it does not depend on the bayer phase.
+ *
+ * @param rawImage raw bayer frame, CV_8UC1.
+ * @param grayImage binned gray image, (cols / 2, rows / 2).
+ */
+void getBayerBinnedGray(const cv::Mat &rawImage, cv::Mat &grayImage);
+
+/**
+ * @brief demosaic only the given region of a raw bayer frame.
+ *        region is expanded by a small border and aligned to even coordinates before conversion,
+ *        so the result equals the same region cut from a full-frame demosaic.
+ *
+ * @param rawImage raw bayer frame, CV_8UC1.
+ * @param roiRect region in raw frame coordinates.
+ * @param pattern bayer pattern of the raw frame (not of the region).
+ * @param bgrImage bgr image of roiRect, a view into a buffer slightly larger than roiRect.
+ * @return false if pattern is NONE or roiRect is out of the frame.
+ */
+bool demosaicBayerROI(const cv::Mat &rawImage, const cv::Rect &roiRect, const BayerPattern pattern, cv::Mat &bgrImage);
+
+/**
+ * @brief sample a bgr image to a synthetic raw bayer frame, used to verify raw mode offline.
+ *
+ * @param bgrImage bgr image.
+ * @param pattern bayer pattern.
+ * @param rawImage synthetic raw bayer frame, CV_8UC1.
+ */
+void mosaicBayer(const cv::Mat &bgrImage, const BayerPattern pattern, cv::Mat &rawImage);
+
+#endif // BAYER_VIEW_H
@@ -21,6 +21,13 @@ enum class CaptureImageTimes : int
 	SECOND_TIMES  = 2,
 };
 
+//运行状态: 1-生产 2-测试, 与UI一致
+enum class RunStatus: int
+{
+	PRODUCT_RUN = 1,
+	TEST_RUN 	= 2
+};
+
 //图像保存方式： 0-保存所有 1-只存NG 2-不保存
 enum class SaveImageType: int
 {
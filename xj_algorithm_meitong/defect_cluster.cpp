@@ -0,0 +1,174 @@
+#include "defect_cluster.h"
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+
+using namespace cv;
+using namespace std;
+
+//并查集, 按大小合并并压缩路径
+class UnionFind
+{
+public:
+    explicit UnionFind(const int n) : m_vParent(n), m_vSize(n, 1)
+    {
+        for(int i = 0; i != n; ++i)
+        {
+            m_vParent[i] = i;
+        }
+    }
+
+    int find(int i)
+    {
+        while(m_vParent[i] != i)
+        {
+            m_vParent[i] = m_vParent[m_vParent[i]];
+            i = m_vParent[i];
+        }
+        return i;
+    }
+
+    void unite(int a, int b)
+    {
+        a = find(a);
+        b = find(b);
+        if(a == b)
+        {
+            return;
+        }
+        if(m_vSize[a] < m_vSize[b])
+        {
+            std::swap(a, b);
+        }
+        m_vParent[b] = a;
+        m_vSize[a] += m_vSize[b];
+    }
+
+private:
+    vector<int> m_vParent;
+    vector<int> m_vSize;
+};
+
+//两框最近边之间的距离, 相交时为0
+static float getBoxGap(const Rect &a, const Rect &b)
+{
+    const int dx = std::max(0, std::max(a.x - (b.x + b.width), b.x - (a.x + a.width)));
+    const int dy = std::max(0, std::max(a.y - (b.y + b.height), b.y - (a.y + a.height)));
+    return std::sqrt((float)(dx * dx + dy * dy));
+}
+
+//细长框的方向(度, [0, 90]), 不够细长时返回负数表示无方向
+static float getBoxAngle(const Rect &box, const float minAspect)
+{
+    const int longSide = std::max(box.width, box.height);
+    const int shortSide = std::max(1, std::min(box.width, box.height));
+    if(longSide < minAspect * shortSide)
+    {
+        return -1;
+    }
+    return std::atan2((float)box.height, (float)box.width) * 180.0f / (float)CV_PI;
+}
+
+static inline int64_t getCellKey(const int cx, const int cy)
+{
+    return ((int64_t)cx << 32) ^ (uint32_t)cy;
+}
+
+void clusterDefects(const vector<stClusterItem> &vItems, const stClusterParams &params, vector<stDefectCluster> &vClusters)
+{
+    vClusters.clear();
+    const int n = vItems.size();
+    UnionFind uf(n);
+
+    if(params.linkDistance > 0 && n > 1)
+    {
+        //网格边长取连接距离与平均框长边的较大值, 每个框只落在少数几个格子里
+        float meanSide = 0;
+        for(const auto &item : vItems)
+        {
+            meanSide += std::max(item.box.width, item.box.height);
+        }
+        const int cellSize = std::max(1, (int)std::ceil(std::max(params.linkDistance, meanSide / n)));
+        auto toCell = [cellSize](const int v) { return (v >= 0) ? v / cellSize : (v - cellSize + 1) / cellSize; };
+
+        //step1: 每个框登记到它覆盖的格子
+        unordered_map<int64_t, vector<int>> mapCells;
+        mapCells.reserve(n * 2);
+        for(int i = 0; i != n; ++i)
+        {
+            const Rect &box = vItems[i].box;
+            for(int cy = toCell(box.y); cy <= toCell(box.y + box.height); ++cy)
+            {
+                for(int cx = toCell(box.x); cx <= toCell(box.x + box.width); ++cx)
+                {
+                    mapCells[getCellKey(cx, cy)].push_back(i);
+                }
+            }
+        }
+
+        //step2: 在外扩连接距离后覆盖的格子里找近邻, 满足间隙和方向条件的合并
+        vector<float> vAngles(n);
+        for(int i = 0; i != n; ++i)
+        {
+            vAngles[i] = getBoxAngle(vItems[i].box, params.minAspect);
+        }
+        const int margin = std::ceil(params.linkDistance);
+        for(int i = 0; i != n; ++i)
+        {
+            const Rect &box = vItems[i].box;
+            for(int cy = toCell(box.y - margin); cy <= toCell(box.y + box.height + margin); ++cy)
+            {
+                for(int cx = toCell(box.x - margin); cx <= toCell(box.x + box.width + margin); ++cx)
+                {
+                    auto itr = mapCells.find(getCellKey(cx, cy));
+                    if(itr == mapCells.end())
+                    {
+                        continue;
+                    }
+                    for(const int j : itr->second)
+                    {
+                        //每对只在较小下标一侧比较一次
+                        if(j <= i || uf.find(i) == uf.find(j))
+                        {
+                            continue;
+                        }
+                        if(getBoxGap(box, vItems[j].box) > params.linkDistance)
+                        {
+                            continue;
+                        }
+                        if(vAngles[i] >= 0 && vAngles[j] >= 0 && std::fabs(vAngles[i] - vAngles[j]) > params.angleTolerance)
+                        {
+                            continue;
+                        }
+                        uf.unite(i, j);
+                    }
+                }
+            }
+        }
+    }
+
+    //step3: 按根节点汇总, 输出顺序为各簇第一个片段的顺序
+    vector<int> vClusterIndex(n, -1);
+    for(int i = 0; i != n; ++i)
+    {
+        const int root = uf.find(i);
+        if(vClusterIndex[root] < 0)
+        {
+            vClusterIndex[root] = vClusters.size();
+            vClusters.emplace_back();
+        }
+        stDefectCluster &cluster = vClusters[vClusterIndex[root]];
+        const stClusterItem &item = vItems[i];
+        cluster.box = (cluster.count == 0) ? item.box : (cluster.box | item.box);
+        cluster.width = std::max(cluster.width, (float)std::min(item.box.width, item.box.height));
+        cluster.area += item.box.area();
+        cluster.confidence = std::max(cluster.confidence, item.confidence);
+        cluster.bIsCenter = cluster.bIsCenter || item.bIsCenter;
+        cluster.count++;
+        cluster.vMembers.push_back(i);
+    }
+    for(auto &cluster : vClusters)
+    {
+        cluster.length = std::sqrt((float)(cluster.box.width * cluster.box.width + cluster.box.height * cluster.box.height));
+    }
+}
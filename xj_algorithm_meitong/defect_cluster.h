@@ -0,0 +1,45 @@
+#ifndef DEFECT_CLUSTER_H
+#define DEFECT_CLUSTER_H
+
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+//聚类参数, 按类别配置
+struct stClusterParams
+{
+    float linkDistance = 0;         //两框间隙(最近边距离)不超过此值时连接, <=0表示该类别不聚类
+    float angleTolerance = 180;     //两个细长框的方向夹角上限(度), 框轴对齐, 方向取对角线与水平方向的夹角
+    float minAspect = 2;            //长宽比不小于此值的框才有方向
+};
+
+//待聚类的框, 镜片坐标
+struct stClusterItem
+{
+    cv::Rect box;
+    float confidence = 0;
+    bool bIsCenter = false;         //框中心在中心区
+};
+
+//聚类结果: 单个框时各统计量与该框自身一致
+struct stDefectCluster
+{
+    cv::Rect box;                   //外接框
+    float length = 0;               //外接框对角线, 断续的划伤按整条长度计
+    float width = 0;                //片段短边的最大值
+    float area = 0;                 //片段面积之和
+    float confidence = 0;           //片段最高置信度
+    int count = 0;                  //片段数
+    bool bIsCenter = false;         //任一片段在中心区
+    std::vector<int> vMembers;      //片段在输入中的下标, 升序
+};
+
+/**
+ * @brief cluster boxes of one category, neighbours are found with a uniform grid spatial hash and merged with union-find,
+ *        cost is linear in the number of boxes for bounded density.
+ * @param vItems <input> boxes in lens coordinates
+ * @param params <input> linking distance and orientation tolerance of the category
+ * @param vClusters <output> clusters ordered by their first member
+ */
+void clusterDefects(const std::vector<stClusterItem> &vItems, const stClusterParams &params, std::vector<stDefectCluster> &vClusters);
+
+#endif // DEFECT_CLUSTER_H
@@ -0,0 +1,642 @@
+#include "golden_template.h"
+#include <algorithm>
+#include "utils.h"
+
+using namespace cv;
+using namespace std;
+
+#define GOLDEN_POLAR_ANGLE_BINS 360
+
+GoldenTemplate::GoldenTemplate(const Mat &reference, const Mat &tolerance, const stGoldenTemplateParams &params):
+    m_params(params),
+    m_reference(reference)
+{
+    m_tolerance = tolerance.empty() ? Mat::zeros(reference.size(), CV_32FC1) : tolerance;
+
+    //step1: min/max包络, 容差不低于diffThreshold
+    Mat floatRef;
+    m_reference.convertTo(floatRef, CV_32F);
+    Mat tol = cv::max(m_tolerance, (double)m_params.diffThreshold);
+    const int k = std::max(1, m_params.envelopeSize);
+    Mat kernel = getStructuringElement(MORPH_RECT, Size(k, k));
+    Mat dilated, eroded;
+    dilate(floatRef, dilated, kernel);
+    erode(floatRef, eroded, kernel);
+    m_upper = dilated + tol;
+    m_lower = eroded - tol;
+
+    //step2: 有效区域
+    m_mask = Mat(m_reference.size(), CV_8UC1, Scalar(255));
+    if(m_params.maskRadius > 0)
+    {
+        m_mask.setTo(0);
+        circle(m_mask, Point(m_reference.cols / 2, m_reference.rows / 2), m_params.maskRadius, Scalar(255), -1);
+    }
+
+    //step3: 金字塔及汉宁窗
+    const int levels = std::max(1, m_params.pyramidLevels);
+    m_vPyramid.emplace_back(floatRef);
+    for(int i = 1; i < levels; ++i)
+    {
+        Mat down;
+        pyrDown(m_vPyramid.back(), down);
+        m_vPyramid.emplace_back(down);
+    }
+    for(const auto &level : m_vPyramid)
+    {
+        Mat window;
+        createHanningWindow(window, level.size(), CV_32F);
+        m_vWindow.emplace_back(window);
+    }
+
+    //step4: 极坐标展开, 旋转在第1层估计(层数不足时用第0层)
+    if(m_params.bIsUseRotation)
+    {
+        const Mat &level = m_vPyramid[std::min(1, levels - 1)];
+        const Point2f center(level.cols / 2.0f, level.rows / 2.0f);
+        const double maxRadius = std::min(level.cols, level.rows) / 2.0;
+        warpPolar(level, m_polar, Size(cvRound(maxRadius), GOLDEN_POLAR_ANGLE_BINS), center, maxRadius, INTER_LINEAR + WARP_POLAR_LINEAR);
+    }
+}
+
+Mat GoldenTemplate::normalize(const Mat &image, const stGoldenTemplateParams &params)
+{
+    Mat gray;
+    if(image.channels() == 3)
+    {
+        cvtColor(image, gray, COLOR_BGR2GRAY);
+    }
+    else if(image.channels() == 4)
+    {
+        cvtColor(image, gray, COLOR_BGRA2GRAY);
+    }
+    else
+    {
+        gray = image;
+    }
+
+    Mat scaled;
+    if(params.scale > 0 && params.scale != 1.0f)
+    {
+        resize(gray, scaled, Size(0, 0), params.scale, params.scale, INTER_AREA);
+    }
+    else
+    {
+        scaled = gray;
+    }
+
+    //以中心对齐, 大于size裁剪, 小于size补零
+    Mat dst = Mat::zeros(params.size, params.size, CV_8UC1);
+    const int offsetX = (params.size - scaled.cols) / 2;
+    const int offsetY = (params.size - scaled.rows) / 2;
+    Rect srcRC(std::max(0, -offsetX), std::max(0, -offsetY), std::min(scaled.cols, params.size), std::min(scaled.rows, params.size));
+    Rect dstRC(std::max(0, offsetX), std::max(0, offsetY), srcRC.width, srcRC.height);
+    scaled(srcRC).copyTo(dst(dstRC));
+    return dst;
+}
+
+shared_ptr<GoldenTemplate> GoldenTemplate::build(const vector<Mat> &vSamples, const stGoldenTemplateParams &params)
+{
+    if(vSamples.empty())
+    {
+        return nullptr;
+    }
+    const Size size = vSamples[0].size();
+    for(const auto &sample : vSamples)
+    {
+        if(sample.size() != size || sample.type() != CV_8UC1)
+        {
+            cout << "[ERROR] golden template sample size or type mismatch" << endl;
+            return nullptr;
+        }
+    }
+
+    //step1: 以第一张样本为初始参考, 其余样本配准到该参考
+    stGoldenTemplateParams initParams = params;
+    initParams.maskRadius = 0;
+    shared_ptr<GoldenTemplate> pInit(new GoldenTemplate(vSamples[0], Mat(), initParams));
+    vector<Mat> vAligned{vSamples[0]};
+    for(size_t i = 1; i < vSamples.size(); ++i)
+    {
+        Mat aligned, warpMatrix;
+        if(pInit->registerImage(vSamples[i], aligned, warpMatrix))
+        {
+            vAligned.emplace_back(aligned);
+        }
+    }
+
+    //step2: 逐像素中值作为参考图, 中值绝对偏差(MAD)作为容差
+    const int n = vAligned.size();
+    const int mid = n / 2;
+    Mat median(size, CV_8UC1);
+    Mat tolerance(size, CV_32FC1);
+    vector<const uchar *> vRows(n);
+    vector<uchar> vValues(n);
+    vector<float> vDeviations(n);
+    for(int y = 0; y < size.height; ++y)
+    {
+        for(int i = 0; i < n; ++i)
+        {
+            vRows[i] = vAligned[i].ptr<uchar>(y);
+        }
+        uchar *pMedian = median.ptr<uchar>(y);
+        float *pTolerance = tolerance.ptr<float>(y);
+        for(int x = 0; x < size.width; ++x)
+        {
+            for(int i = 0; i < n; ++i)
+            {
+                vValues[i] = vRows[i][x];
+            }
+            nth_element(vValues.begin(), vValues.begin() + mid, vValues.end());
+            const uchar m = vValues[mid];
+            for(int i = 0; i < n; ++i)
+            {
+                vDeviations[i] = std::abs((float)vRows[i][x] - m);
+            }
+            nth_element(vDeviations.begin(), vDeviations.begin() + mid, vDeviations.end());
+            pMedian[x] = m;
+            pTolerance[x] = 1.4826f * vDeviations[mid] * params.toleranceScale;
+        }
+    }
+
+    return shared_ptr<GoldenTemplate>(new GoldenTemplate(median, tolerance, params));
+}
+
+shared_ptr<GoldenTemplate> GoldenTemplate::load(const string &sFilePath, const stGoldenTemplateParams &params)
+{
+    FileStorage fs(sFilePath, FileStorage::READ);
+    if(!fs.isOpened())
+    {
+        return nullptr;
+    }
+    Mat reference, tolerance;
+    fs["reference"] >> reference;
+    fs["tolerance"] >> tolerance;
+    if(reference.empty() || reference.type() != CV_8UC1 || reference.cols != params.size || reference.rows != params.size)
+    {
+        cout << "[ERROR] golden template " << sFilePath << " no match current params" << endl;
+        return nullptr;
+    }
+    if(!tolerance.empty() && tolerance.size() != reference.size())
+    {
+        tolerance.release();
+    }
+    return shared_ptr<GoldenTemplate>(new GoldenTemplate(reference, tolerance, params));
+}
+
+bool GoldenTemplate::save(const string &sFilePath) const
+{
+    try
+    {
+        FileStorage fs(sFilePath, FileStorage::WRITE);
+        if(!fs.isOpened())
+        {
+            return false;
+        }
+        fs << "reference" << m_reference << "tolerance" << m_tolerance;
+    }
+    catch(const cv::Exception &e)
+    {
+        cout << "[ERROR] save golden template " << sFilePath << ": " << e.what() << endl;
+        return false;
+    }
+    return true;
+}
+
+Point2d GoldenTemplate::estimateShift(const Mat &gray, const Mat &transform) const
+{
+    //由粗到细, 每层在上一层估计的基础上求残差平移
+    Mat floatImage;
+    gray.convertTo(floatImage, CV_32F);
+    vector<Mat> vImagePyramid{floatImage};
+    for(size_t i = 1; i < m_vPyramid.size(); ++i)
+    {
+        Mat down;
+        pyrDown(vImagePyramid.back(), down);
+        vImagePyramid.emplace_back(down);
+    }
+
+    Point2d shift(0, 0);
+    for(int level = (int)m_vPyramid.size() - 1; level >= 0; --level)
+    {
+        const double s = (double)(1 << level);
+        Mat levelTransform = transform.clone();
+        levelTransform.at<double>(0, 2) = (levelTransform.at<double>(0, 2) - shift.x) / s;
+        levelTransform.at<double>(1, 2) = (levelTransform.at<double>(1, 2) - shift.y) / s;
+        Mat warped;
+        warpAffine(vImagePyramid[level], warped, levelTransform, m_vPyramid[level].size());
+        const Point2d d = phaseCorrelate(m_vPyramid[level], warped, m_vWindow[level]);
+        shift += d * s;
+    }
+    return shift;
+}
+
+double GoldenTemplate::estimateRotation(const Mat &gray) const
+{
+    const int level = std::min(1, (int)m_vPyramid.size() - 1);
+    Mat floatImage;
+    gray.convertTo(floatImage, CV_32F);
+    for(int i = 0; i < level; ++i)
+    {
+        pyrDown(floatImage, floatImage);
+    }
+
+    const Point2f center(floatImage.cols / 2.0f, floatImage.rows / 2.0f);
+    const double maxRadius = std::min(floatImage.cols, floatImage.rows) / 2.0;
+    Mat polar;
+    warpPolar(floatImage, polar, m_polar.size(), center, maxRadius, INTER_LINEAR + WARP_POLAR_LINEAR);
+
+    //极坐标下旋转即角度方向的循环平移
+    const Point2d d = phaseCorrelate(m_polar, polar);
+    const double angle = d.y * 360.0 / GOLDEN_POLAR_ANGLE_BINS;
+
+    //正负方向各试一次, 取相关响应大的
+    double bestAngle = 0;
+    double bestResponse = -1;
+    for(const double candidate : {angle, -angle})
+    {
+        Mat rotation = getRotationMatrix2D(center, candidate, 1.0);
+        Mat rotated;
+        warpAffine(floatImage, rotated, rotation, floatImage.size());
+        double response = 0;
+        phaseCorrelate(m_vPyramid[level], rotated, m_vWindow[level], &response);
+        if(response > bestResponse)
+        {
+            bestResponse = response;
+            bestAngle = candidate;
+        }
+    }
+    return bestAngle;
+}
+
+bool GoldenTemplate::registerImage(const Mat &gray, Mat &aligned, Mat &transform) const
+{
+    if(gray.empty() || gray.size() != m_reference.size() || gray.type() != CV_8UC1)
+    {
+        return false;
+    }
+
+    //step1: 粗平移
+    transform = Mat::eye(2, 3, CV_64F);
+    Point2d shift = estimateShift(gray, transform);
+    transform.at<double>(0, 2) -= shift.x;
+    transform.at<double>(1, 2) -= shift.y;
+
+    //step2: 平移后估计绕中心的旋转, 旋转与平移合成
+    if(m_params.bIsUseRotation && !m_polar.empty())
+    {
+        Mat translated;
+        warpAffine(gray, translated, transform, gray.size());
+        const double angle = estimateRotation(translated);
+        const Point2f center(gray.cols / 2.0f, gray.rows / 2.0f);
+        Mat rotation = getRotationMatrix2D(center, angle, 1.0);
+        const double tx = transform.at<double>(0, 2);
+        const double ty = transform.at<double>(1, 2);
+        Mat composed = rotation.clone();
+        composed.at<double>(0, 2) = rotation.at<double>(0, 0) * tx + rotation.at<double>(0, 1) * ty + rotation.at<double>(0, 2);
+        composed.at<double>(1, 2) = rotation.at<double>(1, 0) * tx + rotation.at<double>(1, 1) * ty + rotation.at<double>(1, 2);
+        transform = composed;
+
+        //step3: 旋转后再精修平移
+        shift = estimateShift(gray, transform);
+        transform.at<double>(0, 2) -= shift.x;
+        transform.at<double>(1, 2) -= shift.y;
+    }
+
+    warpAffine(gray, aligned, transform, m_reference.size(), INTER_LINEAR, BORDER_CONSTANT, Scalar(0));
+    return true;
+}
+
+bool GoldenTemplate::compare(const Mat &image, vector<stGoldenBlob> &vBlobs, Mat *pDiff) const
+{
+    vBlobs.clear();
+    if(image.empty())
+    {
+        return false;
+    }
+
+    //step1: 归一化并配准
+    Mat gray = normalize(image, m_params);
+    Mat aligned, warpMatrix;
+    if(!registerImage(gray, aligned, warpMatrix))
+    {
+        return false;
+    }
+
+    //step2: 超出包络的部分为差分
+    Mat floatAligned;
+    aligned.convertTo(floatAligned, CV_32F);
+    Mat over = floatAligned - m_upper;
+    Mat under = m_lower - floatAligned;
+    Mat diff = cv::max(over, under);
+    diff = cv::max(diff, 0.0);
+
+    //配准后图像边界外的区域不参与比对
+    Mat valid;
+    warpAffine(Mat(gray.size(), CV_8UC1, Scalar(255)), valid, warpMatrix, m_reference.size(), INTER_NEAREST, BORDER_CONSTANT, Scalar(0));
+    erode(valid, valid, getStructuringElement(MORPH_RECT, Size(3, 3)));
+    bitwise_and(valid, m_mask, valid);
+
+    Mat binary = (diff > 0) & valid;
+    if(pDiff)
+    {
+        diff.copyTo(*pDiff, valid);
+    }
+
+    //step3: 斑块过滤
+    Mat labels, stats, centroids;
+    const int numLabels = connectedComponentsWithStats(binary, labels, stats, centroids, 8, CV_32S);
+    if(numLabels <= 1)
+    {
+        return true;
+    }
+
+    //参考坐标 -> 归一化坐标 -> 输入图像坐标
+    Mat inverse;
+    invertAffineTransform(warpMatrix, inverse);
+    const float scale = (m_params.scale > 0) ? m_params.scale : 1.0f;
+    const int offsetX = (m_params.size - cvRound(image.cols * scale)) / 2;
+    const int offsetY = (m_params.size - cvRound(image.rows * scale)) / 2;
+    const Rect imageRC(0, 0, image.cols, image.rows);
+    for(int i = 1; i < numLabels; ++i)
+    {
+        const int area = stats.at<int>(i, CC_STAT_AREA);
+        if(area < m_params.minBlobArea)
+        {
+            continue;
+        }
+        const Rect rc(stats.at<int>(i, CC_STAT_LEFT), stats.at<int>(i, CC_STAT_TOP), stats.at<int>(i, CC_STAT_WIDTH), stats.at<int>(i, CC_STAT_HEIGHT));
+
+        double maxDiff = 0;
+        minMaxLoc(diff(rc), nullptr, &maxDiff, nullptr, nullptr, labels(rc) == i);
+
+        vector<Point2f> vCorners{Point2f(rc.x, rc.y), Point2f(rc.x + rc.width, rc.y), Point2f(rc.x, rc.y + rc.height), Point2f(rc.x + rc.width, rc.y + rc.height)};
+        transform(vCorners, vCorners, inverse);
+        for(auto &pt : vCorners)
+        {
+            pt.x = (pt.x - offsetX) / scale;
+            pt.y = (pt.y - offsetY) / scale;
+        }
+
+        stGoldenBlob blob;
+        blob.box = boundingRect(vCorners) & imageRC;
+        blob.area = area / (scale * scale);
+        blob.maxDiff = maxDiff;
+        if(blob.box.area() > 0)
+        {
+            vBlobs.emplace_back(blob);
+        }
+    }
+    return true;
+}
+
+float GoldenTemplate::measureDrift(const GoldenTemplate &other) const
+{
+    Mat aligned, warpMatrix;
+    if(other.m_reference.size() != m_reference.size() || !registerImage(other.m_reference, aligned, warpMatrix))
+    {
+        return -1;
+    }
+    Mat valid;
+    warpAffine(Mat(m_reference.size(), CV_8UC1, Scalar(255)), valid, warpMatrix, m_reference.size(), INTER_NEAREST, BORDER_CONSTANT, Scalar(0));
+    erode(valid, valid, getStructuringElement(MORPH_RECT, Size(3, 3)));
+    bitwise_and(valid, m_mask, valid);
+    if(countNonZero(valid) == 0)
+    {
+        return -1;
+    }
+    Mat diff;
+    absdiff(aligned, m_reference, diff);
+    return mean(diff, valid)[0];
+}
+
+
+GoldenTemplateManager &GoldenTemplateManager::instance()
+{
+    static GoldenTemplateManager manager;
+    return manager;
+}
+
+GoldenTemplateManager::GoldenTemplateManager():
+    m_bIsStop(false)
+{
+    m_thread = thread(&GoldenTemplateManager::runBuild, this);
+}
+
+GoldenTemplateManager::~GoldenTemplateManager()
+{
+    {
+        unique_lock<mutex> lck(m_mutex);
+        m_bIsStop = true;
+    }
+    m_condV.notify_all();
+    if(m_thread.joinable())
+    {
+        m_thread.join();
+    }
+}
+
+//模板和样本都按参数建立, 任一参数不同时不能沿用
+static bool isSameParams(const stGoldenTemplateParams &params1, const stGoldenTemplateParams &params2)
+{
+    return params1.sampleNum == params2.sampleNum && params1.rebuildInterval == params2.rebuildInterval && params1.scale == params2.scale
+        && params1.size == params2.size && params1.pyramidLevels == params2.pyramidLevels && params1.bIsUseRotation == params2.bIsUseRotation
+        && params1.diffThreshold == params2.diffThreshold && params1.toleranceScale == params2.toleranceScale && params1.envelopeSize == params2.envelopeSize
+        && params1.minBlobArea == params2.minBlobArea && params1.maskRadius == params2.maskRadius && params1.maxDrift == params2.maxDrift;
+}
+
+void GoldenTemplateManager::updateEntry(const string &sKey, stEntry &entry, const string &sFilePath, const stGoldenTemplateParams &params)
+{
+    //参数变化后丢弃按旧参数建立的模板和样本, 下次get按新参数重新加载
+    if((entry.bIsLoaded || entry.bIsLoading || !entry.vSamples.empty()) && !isSameParams(entry.params, params))
+    {
+        cout << "golden template " << sKey << " params changed, reload" << endl;
+        const bool bIsBuilding = entry.bIsBuilding;
+        entry = stEntry();
+        entry.bIsBuilding = bIsBuilding;
+    }
+    entry.sFilePath = sFilePath;
+    entry.params = params;
+}
+
+shared_ptr<const GoldenTemplate> GoldenTemplateManager::get(const string &sKey, const string &sFilePath, const stGoldenTemplateParams &params)
+{
+    {
+        unique_lock<mutex> lck(m_mutex);
+        stEntry &entry = m_mapEntries[sKey];
+        updateEntry(sKey, entry, sFilePath, params);
+        if(entry.bIsLoaded || entry.bIsLoading)
+        {
+            return entry.pTemplate;
+        }
+        if(sFilePath.empty())
+        {
+            entry.bIsLoaded = true;
+            return entry.pTemplate;
+        }
+        entry.bIsLoading = true;
+    }
+
+    //首次使用时加载上次保存的模板, 读文件不持有锁, 其它工位取模板不等待磁盘
+    shared_ptr<const GoldenTemplate> pTemplate = GoldenTemplate::load(sFilePath, params);
+    shared_ptr<const GoldenTemplate> pAnchor = GoldenTemplate::load(getAnchorPath(sFilePath), params);
+
+    unique_lock<mutex> lck(m_mutex);
+    auto itr = m_mapEntries.find(sKey);
+    //加载期间被清除或参数已变化, 本次加载结果作废
+    if(itr == m_mapEntries.end() || !itr->second.bIsLoading || !isSameParams(itr->second.params, params))
+    {
+        return nullptr;
+    }
+    stEntry &entry = itr->second;
+    entry.bIsLoading = false;
+    entry.bIsLoaded = true;
+    //加载期间后台已建立的模板优先
+    if(entry.pTemplate == nullptr)
+    {
+        entry.pTemplate = pTemplate;
+    }
+    //升级前保存的模板没有初始模板, 以当前模板为准, 由后台线程另存
+    if(entry.pAnchor == nullptr)
+    {
+        entry.pAnchor = pAnchor;
+        if(entry.pAnchor == nullptr && entry.pTemplate != nullptr)
+        {
+            entry.pAnchor = entry.pTemplate;
+            m_dqSaves.emplace_back(entry.pAnchor, getAnchorPath(sFilePath));
+            m_condV.notify_one();
+        }
+    }
+    return entry.pTemplate;
+}
+
+string GoldenTemplateManager::getAnchorPath(const string &sFilePath)
+{
+    const size_t slash = sFilePath.find_last_of('/');
+    const size_t dot = sFilePath.find('.', (slash == string::npos) ? 0 : slash + 1);
+    if(dot == string::npos)
+    {
+        return sFilePath + "_anchor.yml.gz";
+    }
+    return sFilePath.substr(0, dot) + "_anchor" + sFilePath.substr(dot);
+}
+
+void GoldenTemplateManager::addSample(const string &sKey, const string &sFilePath, const Mat &image, const stGoldenTemplateParams &params)
+{
+    {
+        unique_lock<mutex> lck(m_mutex);
+        auto itr = m_mapEntries.find(sKey);
+        if(itr != m_mapEntries.end() && itr->second.pTemplate && params.rebuildInterval <= 0)
+        {
+            return;
+        }
+    }
+
+    Mat sample = GoldenTemplate::normalize(image, params);
+
+    unique_lock<mutex> lck(m_mutex);
+    stEntry &entry = m_mapEntries[sKey];
+    updateEntry(sKey, entry, sFilePath, params);
+    entry.vSamples.emplace_back(sample.clone());
+    if((int)entry.vSamples.size() > params.sampleNum)
+    {
+        entry.vSamples.erase(entry.vSamples.begin());
+    }
+    entry.numNewSamples++;
+
+    const bool bIsEnough = (int)entry.vSamples.size() >= params.sampleNum;
+    const bool bIsNeedBuild = entry.pTemplate ? (bIsEnough && entry.numNewSamples >= params.rebuildInterval) : bIsEnough;
+    if(bIsNeedBuild && !entry.bIsBuilding)
+    {
+        entry.bIsBuilding = true;
+        entry.numNewSamples = 0;
+        m_vBuildKeys.emplace_back(sKey);
+        m_condV.notify_one();
+    }
+}
+
+void GoldenTemplateManager::clear(const string &sKey)
+{
+    unique_lock<mutex> lck(m_mutex);
+    m_mapEntries.erase(sKey);
+}
+
+void GoldenTemplateManager::runBuild()
+{
+    while(true)
+    {
+        unique_lock<mutex> lck(m_mutex);
+        m_condV.wait(lck, [this]{ return m_bIsStop || !m_vBuildKeys.empty() || !m_dqSaves.empty(); });
+        if(m_bIsStop)
+        {
+            break;
+        }
+
+        //检测线程上产生的保存请求在本线程写文件
+        if(!m_dqSaves.empty())
+        {
+            const pair<shared_ptr<const GoldenTemplate>, string> save = m_dqSaves.front();
+            m_dqSaves.pop_front();
+            lck.unlock();
+            if(!save.first->save(save.second))
+            {
+                cout << "[ERROR] failed to save golden template " << save.second << endl;
+            }
+            continue;
+        }
+
+        const string sKey = m_vBuildKeys.front();
+        m_vBuildKeys.erase(m_vBuildKeys.begin());
+        auto itr = m_mapEntries.find(sKey);
+        if(itr == m_mapEntries.end())
+        {
+            continue;
+        }
+        const vector<Mat> vSamples = itr->second.vSamples;
+        const stGoldenTemplateParams params = itr->second.params;
+        const string sFilePath = itr->second.sFilePath;
+        shared_ptr<const GoldenTemplate> pAnchor = itr->second.pAnchor;
+        lck.unlock();
+
+        AppTimer timer;
+        shared_ptr<GoldenTemplate> pTemplate = GoldenTemplate::build(vSamples, params);
+        //重建的模板与初始模板差异过大时不替换, 保留当前模板
+        if(pTemplate && pAnchor && params.maxDrift > 0)
+        {
+            const float drift = pAnchor->measureDrift(*pTemplate);
+            if(drift < 0 || drift > params.maxDrift)
+            {
+                cout << "[ERROR] golden template " << sKey << " rebuild rejected, drift " << drift << " exceeds " << params.maxDrift << endl;
+                pTemplate = nullptr;
+            }
+        }
+        if(pTemplate && !sFilePath.empty())
+        {
+            if(!pTemplate->save(sFilePath))
+            {
+                cout << "[ERROR] failed to save golden template " << sFilePath << endl;
+            }
+            if(pAnchor == nullptr && !pTemplate->save(getAnchorPath(sFilePath)))
+            {
+                cout << "[ERROR] failed to save golden template " << getAnchorPath(sFilePath) << endl;
+            }
+        }
+        cout << "golden template " << sKey << " build " << (pTemplate ? "success" : "failed") << " with " << vSamples.size() << " samples, cost " << timer.elapsed() << "s" << endl;
+
+        lck.lock();
+        itr = m_mapEntries.find(sKey);
+        if(itr != m_mapEntries.end())
+        {
+            //建模期间参数已变化, 按旧参数建立的模板不再使用
+            if(pTemplate && isSameParams(itr->second.params, params))
+            {
+                itr->second.pTemplate = pTemplate;
+                if(itr->second.pAnchor == nullptr)
+                {
+                    itr->second.pAnchor = pTemplate;
+                }
+            }
+            itr->second.bIsBuilding = false;
+        }
+    }
+}
@@ -0,0 +1,168 @@
+#ifndef GOLDEN_TEMPLATE_H
+#define GOLDEN_TEMPLATE_H
+
+#include <string>
+#include <map>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <opencv2/opencv.hpp>
+
+//金样模板比对参数
+struct stGoldenTemplateParams
+{
+    int sampleNum = 10;             //建模所需良品数量
+    int rebuildInterval = 0;        //建模后每累计多少良品重建一次, 0-不重建
+    float scale = 0.25f;            //比对前的缩放比例
+    int size = 768;                 //缩放后居中裁剪的正方形边长
+    int pyramidLevels = 3;          //相位相关金字塔层数
+    bool bIsUseRotation = true;     //圆形镜片是否估计旋转角度
+    float diffThreshold = 25.0f;    //差分灰度阈值(最小容差)
+    float toleranceScale = 3.0f;    //逐像素容差 = toleranceScale * 样本MAD
+    int envelopeSize = 3;           //min/max包络核大小, 抵消亚像素配准误差
+    float minBlobArea = 6.0f;       //最小斑块面积(缩放后像素)
+    int maskRadius = 0;             //比对有效半径(缩放后像素), 0-不限
+    float maxDrift = 8.0f;          //自训练重建的参考图与初始模板的最大平均灰度差, 超出不替换, 0-不限
+};
+
+//差分斑块, box为比对输入图像坐标
+struct stGoldenBlob
+{
+    cv::Rect box;
+    float area;
+    float maxDiff;
+};
+
+/*==================================================================================================
+                    金样模板: 由N张良品中值合成, 构建后只读, 可多线程共享
+===================================================================================================*/
+class GoldenTemplate
+{
+public:
+    /**
+     * @brief build reference from good samples, samples are registered to the first one before
+     *        per-pixel median and MAD are computed.
+     *
+     * @param vSamples normalized samples, see normalize().
+     * @param params template params.
+     * @return nullptr if samples are empty or size mismatch.
+     */
+    static std::shared_ptr<GoldenTemplate> build(const std::vector<cv::Mat> &vSamples, const stGoldenTemplateParams &params);
+
+    /**
+     * @brief load reference and tolerance written by save().
+     */
+    static std::shared_ptr<GoldenTemplate> load(const std::string &sFilePath, const stGoldenTemplateParams &params);
+    bool save(const std::string &sFilePath) const;
+
+    /**
+     * @brief convert roi image to gray, scale it and crop / pad it around the center to a fixed size square.
+     */
+    static cv::Mat normalize(const cv::Mat &image, const stGoldenTemplateParams &params);
+
+    /**
+     * @brief register image to reference with coarse-to-fine phase correlation.
+     *
+     * @param gray normalized image.
+     * @param aligned image warped into reference frame.
+     * @param transform 2x3 affine transform from image to reference.
+     */
+    bool registerImage(const cv::Mat &gray, cv::Mat &aligned, cv::Mat &transform) const;
+
+    /**
+     * @brief compare image with reference and return blobs larger than minBlobArea.
+     *
+     * @param image roi image, color or gray.
+     * @param vBlobs blobs in roi image coordinates.
+     * @param pDiff optional difference image in reference frame.
+     */
+    bool compare(const cv::Mat &image, std::vector<stGoldenBlob> &vBlobs, cv::Mat *pDiff = nullptr) const;
+
+    /**
+     * @brief register the reference of another template to this one and measure their difference.
+     *
+     * @return mean absolute gray difference in the valid region, < 0 if registration failed.
+     */
+    float measureDrift(const GoldenTemplate &other) const;
+
+    const cv::Mat &reference() const { return m_reference; }
+
+private:
+    GoldenTemplate(const cv::Mat &reference, const cv::Mat &tolerance, const stGoldenTemplateParams &params);
+
+    cv::Point2d estimateShift(const cv::Mat &gray, const cv::Mat &transform) const;
+    double estimateRotation(const cv::Mat &gray) const;
+
+    stGoldenTemplateParams m_params;
+    cv::Mat m_reference;                    //CV_8UC1 中值参考图
+    cv::Mat m_tolerance;                    //CV_32FC1 逐像素容差
+    cv::Mat m_upper;                        //CV_32FC1 上包络 = dilate(ref) + tol
+    cv::Mat m_lower;                        //CV_32FC1 下包络 = erode(ref) - tol
+    cv::Mat m_mask;                         //CV_8UC1 比对有效区域
+    std::vector<cv::Mat> m_vPyramid;        //CV_32FC1 参考图金字塔
+    std::vector<cv::Mat> m_vWindow;         //汉宁窗, 与金字塔各层对应
+    cv::Mat m_polar;                        //CV_32FC1 参考图极坐标展开, 用于估计旋转
+};
+
+/*==================================================================================================
+                    金样模板缓存: 按产品缓存, 良品累计满N张后后台线程重建.
+    第一次建立(或加载)的模板作为初始模板另存, 之后自训练重建的模板与初始模板差异超过maxDrift时
+    不替换, 避免良品中混入的缓慢变化(脏污、工艺漂移)被逐次学进模板
+===================================================================================================*/
+class GoldenTemplateManager
+{
+public:
+    static GoldenTemplateManager &instance();
+    ~GoldenTemplateManager();
+
+    /**
+     * @brief get cached template, try to load from sFilePath if not cached. the file is read without holding the cache lock,
+     *        callers of the same key during loading get nullptr. template and samples are dropped when params change.
+     */
+    std::shared_ptr<const GoldenTemplate> get(const std::string &sKey, const std::string &sFilePath, const stGoldenTemplateParams &params);
+
+    //初始模板的保存路径: sFilePath扩展名前加_anchor
+    static std::string getAnchorPath(const std::string &sFilePath);
+
+    /**
+     * @brief add a good sample, rebuild is scheduled in background when enough samples are collected.
+     */
+    void addSample(const std::string &sKey, const std::string &sFilePath, const cv::Mat &image, const stGoldenTemplateParams &params);
+
+    void clear(const std::string &sKey);
+
+private:
+    GoldenTemplateManager();
+    GoldenTemplateManager(const GoldenTemplateManager &) = delete;
+    GoldenTemplateManager &operator=(const GoldenTemplateManager &) = delete;
+
+    void runBuild();
+
+    struct stEntry
+    {
+        std::shared_ptr<const GoldenTemplate> pTemplate;
+        std::shared_ptr<const GoldenTemplate> pAnchor;  //初始模板, 重建时限制漂移
+        std::vector<cv::Mat> vSamples;
+        std::string sFilePath;
+        stGoldenTemplateParams params;
+        int numNewSamples = 0;
+        bool bIsLoaded = false;
+        bool bIsLoading = false;        //正在锁外读文件
+        bool bIsBuilding = false;
+    };
+    //更新条目的路径和参数, 参数变化时丢弃旧模板和样本; 调用时需持有m_mutex
+    void updateEntry(const std::string &sKey, stEntry &entry, const std::string &sFilePath, const stGoldenTemplateParams &params);
+
+    std::mutex m_mutex;
+    std::condition_variable m_condV;
+    std::map<std::string, stEntry> m_mapEntries;
+    std::vector<std::string> m_vBuildKeys;
+    std::deque<std::pair<std::shared_ptr<const GoldenTemplate>, std::string>> m_dqSaves;  //<模板, 保存路径>, 由后台线程写文件
+    bool m_bIsStop;
+    std::thread m_thread;
+};
+
+#endif // GOLDEN_TEMPLATE_H
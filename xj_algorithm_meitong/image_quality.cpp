@@ -0,0 +1,141 @@
+#include "image_quality.h"
+#include "utils.h"
+
+using namespace cv;
+using namespace std;
+
+string getImageQualityReasonName(const ImageQualityReason reason)
+{
+    switch(reason)
+    {
+    case ImageQualityReason::OK:            return "OK";
+    case ImageQualityReason::INVALID_IMAGE: return "INVALID_IMAGE";
+    case ImageQualityReason::UNDER_EXPOSED: return "UNDER_EXPOSED";
+    case ImageQualityReason::OVER_EXPOSED:  return "OVER_EXPOSED";
+    case ImageQualityReason::BLURRED:       return "BLURRED";
+    case ImageQualityReason::NO_LENS:       return "NO_LENS";
+    case ImageQualityReason::PARTIAL_LENS:  return "PARTIAL_LENS";
+    }
+    return "UNKNOWN";
+}
+
+static float getPercentile(const vector<int> &vHist, const int total, const float percentile)
+{
+    const int target = total * percentile / 100.0f;
+    int count = 0;
+    for(size_t i = 0; i != vHist.size(); ++i)
+    {
+        count += vHist[i];
+        if(count > target)
+        {
+            return i;
+        }
+    }
+    return vHist.size() - 1;
+}
+
+stImageQuality evaluateImageQuality(const Mat &image, const stImageQualityParams &params)
+{
+    AppTimer timer;
+    stImageQuality quality;
+    if(image.empty() || image.depth() != CV_8U)
+    {
+        quality.reason = ImageQualityReason::INVALID_IMAGE;
+        return quality;
+    }
+
+    //step1: 最近邻降采样, 只取样不插值, 代价与输出尺寸成正比
+    const float factor = std::max(1.0f, std::max(image.cols, image.rows) / (float)std::max(16, params.sampleSize));
+    Mat sample;
+    resize(image, sample, Size(cvRound(image.cols / factor), cvRound(image.rows / factor)), 0, 0, INTER_NEAREST);
+    Mat gray;
+    if(sample.channels() == 3)
+    {
+        cvtColor(sample, gray, COLOR_BGR2GRAY);
+    }
+    else
+    {
+        gray = sample;
+    }
+
+    //step2: 亮度均值及分位数
+    vector<int> vHist(256, 0);
+    double sum = 0;
+    for(int y = 0; y < gray.rows; ++y)
+    {
+        const uchar *pRow = gray.ptr<uchar>(y);
+        for(int x = 0; x < gray.cols; ++x)
+        {
+            vHist[pRow[x]]++;
+            sum += pRow[x];
+        }
+    }
+    const int total = gray.rows * gray.cols;
+    quality.meanGray = sum / total;
+    quality.lowGray = getPercentile(vHist, total, params.lowPercentile);
+    quality.highGray = getPercentile(vHist, total, params.highPercentile);
+    if(quality.meanGray < params.minMeanGray)
+    {
+        quality.reason = ImageQualityReason::UNDER_EXPOSED;
+    }
+    else if(quality.meanGray > params.maxMeanGray || quality.lowGray >= params.saturatedGray)
+    {
+        quality.reason = ImageQualityReason::OVER_EXPOSED;
+    }
+
+    //step3: 镜片有无及完整性
+    Rect lensRC;
+    if(quality.reason == ImageQualityReason::OK)
+    {
+        Mat binaryImage;
+        threshold(gray, binaryImage, params.binaryThreshold, 255, params.binaryType);
+        vector<vector<Point>> contours;
+        findContours(binaryImage, contours, RETR_EXTERNAL, CHAIN_APPROX_SIMPLE);
+        double maxArea = 0;
+        for(const auto &contour : contours)
+        {
+            const double area = contourArea(contour);
+            if(area > maxArea)
+            {
+                maxArea = area;
+                lensRC = boundingRect(contour);
+            }
+        }
+        quality.coverage = maxArea / total;
+
+        const float lensSize = std::max(lensRC.width, lensRC.height) * factor;
+        const bool bIsTouchBorder = lensRC.x < params.borderMargin || lensRC.y < params.borderMargin
+                || lensRC.br().x > gray.cols - params.borderMargin || lensRC.br().y > gray.rows - params.borderMargin;
+        if(maxArea <= 0 || lensSize < params.minLensSize * 0.5f)
+        {
+            quality.reason = ImageQualityReason::NO_LENS;
+        }
+        else if(bIsTouchBorder || lensSize < params.minLensSize || lensSize > params.maxLensSize)
+        {
+            quality.reason = ImageQualityReason::PARTIAL_LENS;
+        }
+    }
+
+    //step4: 清晰度, 在降采样图的镜片区域(含边缘)求拉普拉斯方差, 不再回到原图取窗口;
+    //最近邻降采样不平滑, 失焦造成的边缘、纹理变宽在降采样图上同样使方差下降
+    if(quality.reason == ImageQualityReason::OK)
+    {
+        const int margin = std::max(1, params.borderMargin);
+        const Rect focusRC = Rect(lensRC.x - margin, lensRC.y - margin, lensRC.width + 2 * margin, lensRC.height + 2 * margin) & Rect(0, 0, gray.cols, gray.rows);
+        if(focusRC.area() > 0)
+        {
+            Mat laplacian;
+            Laplacian(gray(focusRC), laplacian, CV_16S);
+            Scalar mean, stddev;
+            meanStdDev(laplacian, mean, stddev);
+            quality.focus = stddev[0] * stddev[0];
+        }
+        if(quality.focus < params.minFocus)
+        {
+            quality.reason = ImageQualityReason::BLURRED;
+        }
+    }
+
+    quality.elapsedMs = timer.elapsed() * 1000;
+    return quality;
+}
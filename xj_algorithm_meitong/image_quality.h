@@ -0,0 +1,34 @@
+#ifndef IMAGE_QUALITY_H
+#define IMAGE_QUALITY_H
+
+#include <opencv2/opencv.hpp>
+#include "xj_app_algorithm.h"
+
+//图像质量检查参数, 每个工位每次拍照一组
+struct stImageQualityParams
+{
+    bool bIsEnable = false;
+    int sampleSize = 256;           //降采样后长边像素
+    float lowPercentile = 5;        //低分位(%)
+    float highPercentile = 95;      //高分位(%)
+    float minMeanGray = 0;          //平均灰度下限, 低于为欠曝
+    float maxMeanGray = 255;        //平均灰度上限, 高于为过曝
+    float saturatedGray = 250;      //低分位灰度达到该值视为整体过曝
+    float minFocus = 0;             //拉普拉斯方差下限(降采样图上的镜片区域), 低于为失焦
+    int binaryThreshold = 30;       //镜片前景二值化阈值
+    int binaryType = cv::THRESH_BINARY;
+    float minLensSize = 2000;       //镜片外接框边长下限(原图像素)
+    float maxLensSize = 3000;       //镜片外接框边长上限(原图像素)
+    int borderMargin = 2;           //外接框距降采样图边界小于该值视为镜片不完整
+};
+
+/**
+ * @brief check brightness, focus and lens presence on a strongly downsampled frame.
+ *
+ * @param image source frame, gray or bgr.
+ * @param params quality params.
+ * @return quality metrics and the first failed reason.
+ */
+stImageQuality evaluateImageQuality(const cv::Mat &image, const stImageQualityParams &params);
+
+#endif // IMAGE_QUALITY_H
@@ -0,0 +1,490 @@
+#include "inference_service.h"
+#include <set>
+#include <algorithm>
+#include <iostream>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace cv;
+using namespace std;
+
+bool setCurrentThreadIdlePriority()
+{
+#ifdef __linux__
+    sched_param param;
+    param.sched_priority = 0;
+    if(pthread_setschedparam(pthread_self(), SCHED_IDLE, &param) == 0)
+    {
+        return true;
+    }
+    //Linux下nice按线程生效
+    return setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), 19) == 0;
+#else
+    return false;
+#endif
+}
+
+/*==================================================================================================
+                    推理后端
+===================================================================================================*/
+TensorrtInferenceBackend::TensorrtInferenceBackend(const stInferenceModelParams &params)
+{
+    m_pModel = make_shared<YoloClassifier>(params.sModelPath, YoloOutputType::DETECTION, params.maxBatchSize, params.numCategory, params.inputWidth, params.inputHeight, params.inputChannel);
+    m_pModel->setInferParameters(params.confThreshold, params.nmsThreshold, params.maskThreshold, params.segScaleFactor, params.segChannels, params.detboxNum);
+}
+
+bool TensorrtInferenceBackend::load()
+{
+    return m_pModel->loadModel();
+}
+
+bool TensorrtInferenceBackend::detect(const vector<Mat> &vBatchImage, vector<vector<YoloOutputDetect>> &vDetectOutput)
+{
+    return m_pModel->getDetectionResult(vBatchImage, vDetectOutput);
+}
+
+CpuInferenceBackend::CpuInferenceBackend(const stInferenceModelParams &params):
+    m_params(params)
+{
+}
+
+bool CpuInferenceBackend::load()
+{
+    try
+    {
+        m_net = dnn::readNet(m_params.sModelPath);
+        m_net.setPreferableBackend(dnn::DNN_BACKEND_OPENCV);
+        m_net.setPreferableTarget(dnn::DNN_TARGET_CPU);
+    }
+    catch(const cv::Exception &e)
+    {
+        cout << "[ERROR] failed to load cpu model " << m_params.sModelPath << ": " << e.what() << endl;
+        return false;
+    }
+    return !m_net.empty();
+}
+
+bool CpuInferenceBackend::detect(const vector<Mat> &vBatchImage, vector<vector<YoloOutputDetect>> &vDetectOutput)
+{
+    //导出的onnx多为固定batch=1, 逐张推理; 输出为1*(4+numCategory)*detboxNum, 与tensorrt后处理一致
+    for(const auto &image : vBatchImage)
+    {
+        Mat blob = dnn::blobFromImage(image, 1.0 / 255.0, Size(m_params.inputWidth, m_params.inputHeight), Scalar(), true, false);
+        m_net.setInput(blob);
+        Mat output = m_net.forward();
+        if(output.dims != 3 || output.size[1] != m_params.numCategory + 4)
+        {
+            cout << "[ERROR] cpu model output shape not match numCategory " << m_params.numCategory << endl;
+            return false;
+        }
+        const Mat detectionOut(output.size[1], output.size[2], CV_32F, output.ptr<float>());
+        const float ratioW = (float)image.cols / m_params.inputWidth;
+        const float ratioH = (float)image.rows / m_params.inputHeight;
+
+        vector<int> vClassIds;
+        vector<float> vConfidences;
+        vector<Rect> vBoxes;
+        for(int j = 0; j < detectionOut.cols; j++)
+        {
+            Point classIdPoint;
+            double maxScore = 0;
+            minMaxLoc(detectionOut(Rect(j, 4, 1, m_params.numCategory)), 0, &maxScore, 0, &classIdPoint);
+            if(maxScore < m_params.confThreshold)
+            {
+                continue;
+            }
+            const float w = detectionOut.at<float>(2, j) * ratioW;
+            const float h = detectionOut.at<float>(3, j) * ratioH;
+            const int left = std::max(0.0f, detectionOut.at<float>(0, j) * ratioW - 0.5f * w);
+            const int top = std::max(0.0f, detectionOut.at<float>(1, j) * ratioH - 0.5f * h);
+            if((int)w <= 0 || (int)h <= 0)
+            {
+                continue;
+            }
+            vClassIds.emplace_back(classIdPoint.y);
+            vConfidences.emplace_back(maxScore);
+            vBoxes.emplace_back(Rect(left, top, (int)w, (int)h));
+        }
+
+        vector<int> vNmsResult;
+        dnn::NMSBoxes(vBoxes, vConfidences, m_params.confThreshold, m_params.nmsThreshold, vNmsResult);
+        vector<YoloOutputDetect> vOutput;
+        const Rect imageRC(0, 0, image.cols, image.rows);
+        for(const auto &idx : vNmsResult)
+        {
+            YoloOutputDetect result;
+            result.id = vClassIds[idx];
+            result.confidence = vConfidences[idx];
+            result.box = vBoxes[idx] & imageRC;
+            vOutput.emplace_back(result);
+        }
+        vDetectOutput.emplace_back(vOutput);
+    }
+    return true;
+}
+
+/*==================================================================================================
+                    模型执行器
+===================================================================================================*/
+ModelExecutor::ModelExecutor(const stInferenceModelParams &params, const shared_ptr<InferenceBackend> &pBackend):
+    m_params(params),
+    m_pBackend(pBackend),
+    m_numPendingImages(0),
+    m_lastBoardId(-1),
+    m_bIsStop(false)
+{
+    m_params.maxBatchSize = std::max(1, m_params.maxBatchSize);
+    m_thread = thread(&ModelExecutor::run, this);
+}
+
+ModelExecutor::~ModelExecutor()
+{
+    {
+        unique_lock<mutex> lock(m_mutex);
+        m_bIsStop = true;
+    }
+    m_condV.notify_all();
+    if(m_thread.joinable())
+    {
+        m_thread.join();
+    }
+}
+
+bool ModelExecutor::infer(const int boardId, const vector<Mat> &vImages, vector<vector<YoloOutputDetect>> &vDetectOutput)
+{
+    vDetectOutput.clear();
+    if(vImages.empty())
+    {
+        return true;
+    }
+
+    shared_ptr<stRequest> pRequest = make_shared<stRequest>();
+    pRequest->boardId = boardId;
+    pRequest->vImages = vImages;
+    pRequest->submitTime = chrono::steady_clock::now();
+    future<bool> result = pRequest->promise.get_future();
+    {
+        unique_lock<mutex> lock(m_mutex);
+        if(m_bIsStop)
+        {
+            return false;
+        }
+        m_mapBoardQueues[boardId].emplace_back(pRequest);
+        m_numPendingImages += vImages.size();
+        m_stats.maxQueueDepth = std::max(m_stats.maxQueueDepth, m_numPendingImages);
+    }
+    m_condV.notify_all();
+
+    //请求结果只由执行器线程写入, promise兑现后再读取
+    const bool bIsOK = result.get();
+    vDetectOutput.swap(pRequest->vDetectOutput);
+    return bIsOK;
+}
+
+stInferenceStats ModelExecutor::getStats()
+{
+    unique_lock<mutex> lock(m_mutex);
+    stInferenceStats stats = m_stats;
+    stats.queueDepth = m_numPendingImages;
+    return stats;
+}
+
+void ModelExecutor::run()
+{
+    if(m_params.bIsLowPriority && !setCurrentThreadIdlePriority())
+    {
+        cout << "[WARNING] failed to lower priority of executor " << m_params.sModelPath << endl;
+    }
+    while(true)
+    {
+        vector<shared_ptr<stRequest>> vBatch;
+        {
+            unique_lock<mutex> lock(m_mutex);
+            //停止时先处理完已提交的请求, 不让调用者一直等待
+            m_condV.wait(lock, [this]{ return m_bIsStop || m_numPendingImages > 0; });
+            if(m_bIsStop && m_numPendingImages == 0)
+            {
+                break;
+            }
+
+            //step1: 不足一批时等待其它工位的请求, 最长等到最早请求提交后maxWaitMs
+            auto oldestTime = chrono::steady_clock::time_point::max();
+            for(const auto &iter : m_mapBoardQueues)
+            {
+                if(!iter.second.empty())
+                {
+                    oldestTime = std::min(oldestTime, iter.second.front()->submitTime);
+                }
+            }
+            const auto deadline = oldestTime + chrono::microseconds((long)(m_params.maxWaitMs * 1000));
+            m_condV.wait_until(lock, deadline, [this]{ return m_bIsStop || m_numPendingImages >= m_params.maxBatchSize; });
+
+            //step2: 按工位轮询取请求
+            vBatch = takeBatch();
+        }
+
+        //step3: 推理并按请求拆分结果
+        runBatch(vBatch);
+    }
+}
+
+vector<shared_ptr<ModelExecutor::stRequest>> ModelExecutor::takeBatch()
+{
+    vector<shared_ptr<stRequest>> vBatch;
+    int numImages = 0;
+    bool bIsTaken = true;
+    while(bIsTaken && numImages < m_params.maxBatchSize)
+    {
+        bIsTaken = false;
+        //每轮每个工位最多取一个请求, 从上一次取过的工位之后开始, 避免某个工位独占
+        vector<int> vBoardIds;
+        for(const auto &iter : m_mapBoardQueues)
+        {
+            vBoardIds.emplace_back(iter.first);
+        }
+        const size_t start = upper_bound(vBoardIds.begin(), vBoardIds.end(), m_lastBoardId) - vBoardIds.begin();
+        for(size_t n = 0; n != vBoardIds.size() && numImages < m_params.maxBatchSize; ++n)
+        {
+            const int boardId = vBoardIds[(start + n) % vBoardIds.size()];
+            deque<shared_ptr<stRequest>> &queue = m_mapBoardQueues[boardId];
+            if(queue.empty())
+            {
+                continue;
+            }
+            //请求不拆分; 批次为空时超大请求也整体取出, 推理时再分块
+            const int numRequestImages = queue.front()->vImages.size();
+            if(!vBatch.empty() && numImages + numRequestImages > m_params.maxBatchSize)
+            {
+                continue;
+            }
+            vBatch.emplace_back(queue.front());
+            queue.pop_front();
+            numImages += numRequestImages;
+            m_lastBoardId = boardId;
+            bIsTaken = true;
+        }
+    }
+    m_numPendingImages -= numImages;
+    return vBatch;
+}
+
+void ModelExecutor::runBatch(vector<shared_ptr<stRequest>> &vBatch)
+{
+    if(vBatch.empty())
+    {
+        return;
+    }
+
+    const auto startTime = chrono::steady_clock::now();
+    vector<Mat> vImages;
+    for(const auto &pRequest : vBatch)
+    {
+        vImages.insert(vImages.end(), pRequest->vImages.begin(), pRequest->vImages.end());
+    }
+
+    //step1: 按模型最大batch分块推理
+    vector<vector<YoloOutputDetect>> vDetectOutput;
+    bool bIsOK = true;
+    //后端异常不能逃出执行器线程, 否则进程终止, 所有等待的请求都得不到结果; 异常时整批按失败返回
+    try
+    {
+        for(size_t begin = 0; begin < vImages.size() && bIsOK; begin += m_params.maxBatchSize)
+        {
+            const size_t end = std::min(vImages.size(), begin + m_params.maxBatchSize);
+            const vector<Mat> vChunk(vImages.begin() + begin, vImages.begin() + end);
+            bIsOK = m_pBackend->detect(vChunk, vDetectOutput);
+        }
+    }
+    catch(const exception &e)
+    {
+        cout << "[ERROR] inference exception, model " << m_params.sModelPath << ": " << e.what() << endl;
+        bIsOK = false;
+    }
+    catch(...)
+    {
+        cout << "[ERROR] inference unknown exception, model " << m_params.sModelPath << endl;
+        bIsOK = false;
+    }
+    bIsOK = bIsOK && vDetectOutput.size() == vImages.size();
+    const double inferMs = chrono::duration<double, milli>(chrono::steady_clock::now() - startTime).count();
+
+    //step2: 按请求拆分结果并唤醒调用者
+    size_t offset = 0;
+    set<int> setBoards;
+    double maxWaitMs = 0;
+    double totalWaitMs = 0;
+    for(auto &pRequest : vBatch)
+    {
+        const size_t numRequestImages = pRequest->vImages.size();
+        if(bIsOK)
+        {
+            pRequest->vDetectOutput.assign(vDetectOutput.begin() + offset, vDetectOutput.begin() + offset + numRequestImages);
+        }
+        offset += numRequestImages;
+        setBoards.insert(pRequest->boardId);
+        const double waitMs = chrono::duration<double, milli>(startTime - pRequest->submitTime).count();
+        maxWaitMs = std::max(maxWaitMs, waitMs);
+        totalWaitMs += waitMs;
+    }
+
+    bool bIsPrint = false;
+    {
+        unique_lock<mutex> lock(m_mutex);
+        m_stats.numBatches++;
+        m_stats.numImages += vImages.size();
+        m_stats.numCrossBoardBatches += setBoards.size() > 1 ? 1 : 0;
+        m_stats.totalWaitMs += totalWaitMs;
+        m_stats.maxWaitMs = std::max(m_stats.maxWaitMs, maxWaitMs);
+        m_stats.totalInferMs += inferMs;
+        for(const auto &pRequest : vBatch)
+        {
+            m_stats.mapBoardImages[pRequest->boardId] += pRequest->vImages.size();
+        }
+        bIsPrint = m_params.statsInterval > 0 && m_stats.numBatches % m_params.statsInterval == 0;
+    }
+    for(auto &pRequest : vBatch)
+    {
+        pRequest->promise.set_value(bIsOK);
+    }
+    if(!bIsOK)
+    {
+        cout << "[ERROR] inference failed, model " << m_params.sModelPath << ", batch size " << vImages.size() << endl;
+    }
+    if(bIsPrint)
+    {
+        printStats();
+    }
+}
+
+void ModelExecutor::printStats()
+{
+    const stInferenceStats stats = getStats();
+    cout << "inference " << m_params.sModelPath << ": batches = " << stats.numBatches << ", images = " << stats.numImages
+         << ", avg batch = " << (double)stats.numImages / std::max(1L, stats.numBatches)
+         << ", cross board batches = " << stats.numCrossBoardBatches
+         << ", queue depth = " << stats.queueDepth << "/" << stats.maxQueueDepth
+         << ", avg wait = " << stats.totalWaitMs / std::max(1L, stats.numImages) << "ms, max wait = " << stats.maxWaitMs << "ms"
+         << ", avg infer = " << stats.totalInferMs / std::max(1L, stats.numBatches) << "ms";
+    for(const auto &iter : stats.mapBoardImages)
+    {
+        cout << ", board[" << iter.first << "] = " << iter.second;
+    }
+    cout << endl;
+}
+
+/*==================================================================================================
+                    推理服务
+===================================================================================================*/
+InferenceService &InferenceService::instance()
+{
+    static InferenceService service;
+    return service;
+}
+
+string getExecutorKey(const string &sBaseKey, const stInferenceModelParams &params)
+{
+    return sBaseKey + "#b" + to_string(params.maxBatchSize) + "c" + to_string(params.numCategory)
+        + "t" + to_string(params.confThreshold) + "n" + to_string(params.nmsThreshold);
+}
+
+//同一执行器的输出由批大小、类别数和阈值决定, 不一致时不能共用
+static bool isSharedParamsCompatible(const string &sKey, const stInferenceModelParams &loaded, const stInferenceModelParams &params)
+{
+    if(loaded.maxBatchSize != params.maxBatchSize || loaded.numCategory != params.numCategory
+        || loaded.confThreshold != params.confThreshold || loaded.nmsThreshold != params.nmsThreshold)
+    {
+        cout << "[ERROR] model " << sKey << " is loaded with different batch size, category or threshold" << endl;
+        return false;
+    }
+    return true;
+}
+
+//创建后端并加载模型, 失败返回nullptr
+static shared_ptr<ModelExecutor> loadExecutor(const string &sKey, const stInferenceModelParams &params)
+{
+    try
+    {
+        shared_ptr<InferenceBackend> pBackend;
+        if(params.backendType == InferenceBackendType::CPU)
+        {
+            pBackend = make_shared<CpuInferenceBackend>(params);
+        }
+        else
+        {
+            pBackend = make_shared<TensorrtInferenceBackend>(params);
+        }
+        if(!pBackend->load())
+        {
+            return nullptr;
+        }
+        return make_shared<ModelExecutor>(params, pBackend);
+    }
+    catch(const exception &e)
+    {
+        cout << "[ERROR] failed to load model " << sKey << ": " << e.what() << endl;
+    }
+    return nullptr;
+}
+
+shared_ptr<ModelExecutor> InferenceService::getExecutor(const string &sKey, const stInferenceModelParams &params)
+{
+    //step1: 已加载则直接返回; 同一模型正在加载时等待其结果, 不同模型互不阻塞
+    shared_ptr<promise<shared_ptr<ModelExecutor>>> pLoading;
+    shared_future<shared_ptr<ModelExecutor>> loading;
+    {
+        unique_lock<mutex> lock(m_mutex);
+        stExecutorEntry &entry = m_mapExecutors[sKey];
+        shared_ptr<ModelExecutor> pExecutor = entry.pExecutor.lock();
+        if(pExecutor != nullptr)
+        {
+            return isSharedParamsCompatible(sKey, pExecutor->params(), params) ? pExecutor : nullptr;
+        }
+        if(entry.loading.valid())
+        {
+            loading = entry.loading;
+        }
+        else
+        {
+            pLoading = make_shared<promise<shared_ptr<ModelExecutor>>>();
+            entry.loading = pLoading->get_future().share();
+        }
+    }
+    if(pLoading == nullptr)
+    {
+        shared_ptr<ModelExecutor> pExecutor = loading.get();
+        if(pExecutor != nullptr && !isSharedParamsCompatible(sKey, pExecutor->params(), params))
+        {
+            return nullptr;
+        }
+        return pExecutor;
+    }
+
+    //step2: 不持有全局锁加载模型, 加载慢的模型不影响其它工位取执行器
+    shared_ptr<ModelExecutor> pExecutor = loadExecutor(sKey, params);
+    {
+        unique_lock<mutex> lock(m_mutex);
+        stExecutorEntry &entry = m_mapExecutors[sKey];
+        entry.pExecutor = pExecutor;
+        entry.loading = shared_future<shared_ptr<ModelExecutor>>();
+    }
+    pLoading->set_value(pExecutor);
+    return pExecutor;
+}
+
+bool InferenceService::addExecutor(const string &sKey, const shared_ptr<ModelExecutor> &pExecutor)
+{
+    unique_lock<mutex> lock(m_mutex);
+    stExecutorEntry &entry = m_mapExecutors[sKey];
+    if(pExecutor == nullptr || entry.pExecutor.lock() != nullptr || entry.loading.valid())
+    {
+        cout << "[ERROR] model " << sKey << " is already loaded" << endl;
+        return false;
+    }
+    entry.pExecutor = pExecutor;
+    return true;
+}
@@ -0,0 +1,196 @@
+#ifndef INFERENCE_SERVICE_H
+#define INFERENCE_SERVICE_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <future>
+#include <chrono>
+#include <condition_variable>
+#include <opencv2/opencv.hpp>
+#include <opencv2/dnn.hpp>
+#include "xj_app_yolo_classifier.h"
+
+//推理后端类型
+enum class InferenceBackendType : int
+{
+    TENSORRT    = 0,
+    CPU         = 1     //OpenCV dnn加载onnx, 用于无显卡环境测试
+};
+
+//模型参数, 同一个执行器的所有工位共用
+struct stInferenceModelParams
+{
+    std::string sModelPath;
+    InferenceBackendType backendType = InferenceBackendType::TENSORRT;
+    int maxBatchSize = 1;
+    int numCategory = 1;
+    int inputWidth = 640;
+    int inputHeight = 640;
+    int inputChannel = 3;
+    float confThreshold = 0.3f;
+    float nmsThreshold = 0.5f;
+    float maskThreshold = 0.5f;
+    int segScaleFactor = 4;
+    int segChannels = 32;
+    int detboxNum = 0;
+    float maxWaitMs = 2;        //凑批最长等待时间(毫秒), 从最早请求提交时算起, 0表示不等待
+    int statsInterval = 0;      //每推理多少批打印一次统计, 0表示不打印
+    bool bIsLowPriority = false;    //推理线程以最低调度优先级运行(影子评估的候选模型), 只用空闲CPU
+};
+
+//执行器key: 模型key加上批大小、类别数和阈值, 这些参数不同的工位即使模型文件相同也不共用执行器
+std::string getExecutorKey(const std::string &sBaseKey, const stInferenceModelParams &params);
+
+//当前线程改为最低调度优先级(SCHED_IDLE), 不支持时退为nice 19; 只在有空闲CPU时运行, 不与生产线程争抢
+bool setCurrentThreadIdlePriority();
+
+//推理后端: 只在执行器线程中调用, 不需要自身加锁
+class InferenceBackend
+{
+public:
+    virtual ~InferenceBackend() {}
+    virtual bool load() = 0;
+    /**
+     * @brief detect a batch of images, batch size must not exceed maxBatchSize.
+     * @param vBatchImage input images.
+     * @param vDetectOutput detections of each image, appended in input order.
+     * @return true if inference succeeded.
+     */
+    virtual bool detect(const std::vector<cv::Mat> &vBatchImage, std::vector<std::vector<YoloOutputDetect>> &vDetectOutput) = 0;
+};
+
+class TensorrtInferenceBackend : public InferenceBackend
+{
+public:
+    TensorrtInferenceBackend(const stInferenceModelParams &params);
+    virtual bool load();
+    virtual bool detect(const std::vector<cv::Mat> &vBatchImage, std::vector<std::vector<YoloOutputDetect>> &vDetectOutput);
+
+private:
+    std::shared_ptr<YoloClassifier> m_pModel;
+};
+
+class CpuInferenceBackend : public InferenceBackend
+{
+public:
+    CpuInferenceBackend(const stInferenceModelParams &params);
+    virtual bool load();
+    virtual bool detect(const std::vector<cv::Mat> &vBatchImage, std::vector<std::vector<YoloOutputDetect>> &vDetectOutput);
+
+private:
+    stInferenceModelParams m_params;
+    cv::dnn::Net m_net;
+};
+
+//执行器统计
+struct stInferenceStats
+{
+    long numBatches = 0;
+    long numImages = 0;
+    long numCrossBoardBatches = 0;      //包含多个工位请求的批次数
+    int queueDepth = 0;                 //当前排队图片数
+    int maxQueueDepth = 0;              //排队图片数峰值
+    double totalWaitMs = 0;             //请求从提交到开始推理的累计等待
+    double maxWaitMs = 0;
+    double totalInferMs = 0;
+    std::map<int, long> mapBoardImages; //<工位, 推理图片数>
+};
+
+/*==================================================================================================
+                    模型执行器: 一个模型一个推理线程, 各工位请求按工位排队, 轮询取请求跨工位合批
+===================================================================================================*/
+class ModelExecutor
+{
+public:
+    ModelExecutor(const stInferenceModelParams &params, const std::shared_ptr<InferenceBackend> &pBackend);
+    ~ModelExecutor();
+
+    /**
+     * @brief submit images of one board and wait for the results.
+     * @param boardId board of the caller, used for fairness and statistics.
+     * @param vImages images of one request, kept in one batch if possible.
+     * @param vDetectOutput detections of each image, same order as vImages.
+     * @return true if inference succeeded.
+     */
+    bool infer(const int boardId, const std::vector<cv::Mat> &vImages, std::vector<std::vector<YoloOutputDetect>> &vDetectOutput);
+
+    stInferenceStats getStats();
+    const stInferenceModelParams &params() const { return m_params; }
+
+private:
+    struct stRequest
+    {
+        int boardId;
+        std::vector<cv::Mat> vImages;
+        std::vector<std::vector<YoloOutputDetect>> vDetectOutput;
+        std::promise<bool> promise;
+        std::chrono::steady_clock::time_point submitTime;
+    };
+
+    void run();
+    //按工位轮询取请求直到凑满一批, 调用时需持有m_mutex
+    std::vector<std::shared_ptr<stRequest>> takeBatch();
+    void runBatch(std::vector<std::shared_ptr<stRequest>> &vBatch);
+    void printStats();
+
+    stInferenceModelParams m_params;
+    std::shared_ptr<InferenceBackend> m_pBackend;
+
+    std::mutex m_mutex;
+    std::condition_variable m_condV;
+    std::map<int, std::deque<std::shared_ptr<stRequest>>> m_mapBoardQueues;  //<工位, 请求队列>
+    int m_numPendingImages;
+    int m_lastBoardId;          //上一次取请求的工位, 下一次从其后一个工位开始
+    stInferenceStats m_stats;
+    bool m_bIsStop;
+    std::thread m_thread;
+};
+
+/*==================================================================================================
+                    进程内推理服务: 按模型管理执行器, 所有工位共用同一个模型实例
+===================================================================================================*/
+class InferenceService
+{
+public:
+    static InferenceService &instance();
+
+    /**
+     * @brief get the executor of a model, load the model if no board is using it.
+     *        the model is loaded without holding the registry lock, callers of the same key wait for that load.
+     * @param sKey executor key, boards using the same key share one model and one batch queue.
+     * @param params model params, must match the batch size, category and thresholds of an executor already loaded.
+     * @return executor, nullptr if loading model failed or the loaded executor has different params.
+     */
+    std::shared_ptr<ModelExecutor> getExecutor(const std::string &sKey, const stInferenceModelParams &params);
+
+    /**
+     * @brief register an executor created by the caller (e.g. with a test backend), later getExecutor calls of sKey share it.
+     *        the service does not own it, the caller keeps it alive.
+     * @return false if sKey is loaded or loading.
+     */
+    bool addExecutor(const std::string &sKey, const std::shared_ptr<ModelExecutor> &pExecutor);
+
+private:
+    InferenceService() {}
+    ~InferenceService() {}
+    InferenceService(const InferenceService &) = delete;
+    InferenceService &operator=(const InferenceService &) = delete;
+
+    struct stExecutorEntry
+    {
+        //不持有执行器, 所有工位都释放后模型随之卸载
+        std::weak_ptr<ModelExecutor> pExecutor;
+        //正在加载时有效, 同一模型的其它调用者等待加载结果
+        std::shared_future<std::shared_ptr<ModelExecutor>> loading;
+    };
+
+    std::mutex m_mutex;
+    std::map<std::string, stExecutorEntry> m_mapExecutors;
+};
+
+#endif // INFERENCE_SERVICE_H
@@ -0,0 +1,139 @@
+#ifndef INSPECT_PLAN_H
+#define INSPECT_PLAN_H
+
+#include <vector>
+#include <bitset>
+#include "defect_cluster.h"
+
+//瑕疵类别数上限, 禁用类别按位存放
+#define MAX_DEFECT_CATEGORY 64
+//模型类别: 线伤、点伤
+#define XIANSHANG_CATEGORY 1
+#define DIANSHANG_CATEGORY 2
+
+//检测区域: 按瑕疵中心到镜片中心的距离划分, 中心区与非中心区使用不同阈值
+enum class InspectZone : int
+{
+    CENTER      = 0,
+    NON_CENTER  = 1,
+    NUM         = 2
+};
+
+//单次拍照的瑕疵阈值表: 置信度/面积/对角线按[区域][类别]展开为连续数组
+struct stThresholdTable
+{
+    int numCategory = 0;
+    std::vector<float> vMinProb;
+    std::vector<float> vMinArea;
+    std::vector<float> vMinDiag;
+
+    void init(const int num)
+    {
+        numCategory = num;
+        vMinProb.assign(num * (int)InspectZone::NUM, 0);
+        vMinArea.assign(num * (int)InspectZone::NUM, 0);
+        vMinDiag.assign(num * (int)InspectZone::NUM, 0);
+    }
+
+    //配置个数少于类别数时, 缺少的类别保持0
+    void set(const InspectZone zone, const std::vector<float> &vProb, const std::vector<float> &vArea, const std::vector<float> &vDiag)
+    {
+        for(int i = 0; i != numCategory; ++i)
+        {
+            const int idx = index(zone, i);
+            vMinProb[idx] = (i < (int)vProb.size()) ? vProb[i] : 0;
+            vMinArea[idx] = (i < (int)vArea.size()) ? vArea[i] : 0;
+            vMinDiag[idx] = (i < (int)vDiag.size()) ? vDiag[i] : 0;
+        }
+    }
+
+    int index(const InspectZone zone, const int category) const
+    {
+        return (int)zone * numCategory + category;
+    }
+
+    //面积须大于阈值, 对角线和置信度不小于阈值; 超出配置范围的类别不判为瑕疵
+    bool isDefect(const InspectZone zone, const int category, const float prob, const float area, const float diag) const
+    {
+        if(category < 0 || category >= numCategory)
+        {
+            return false;
+        }
+        const int idx = index(zone, category);
+        return area > vMinArea[idx] && diag >= vMinDiag[idx] && prob >= vMinProb[idx];
+    }
+
+    //只比较置信度, 聚类前筛选片段
+    bool isConfident(const InspectZone zone, const int category, const float prob) const
+    {
+        return category >= 0 && category < numCategory && prob >= vMinProb[index(zone, category)];
+    }
+};
+
+/*==================================================================================================
+    检测方案: init时由参数编译而成, 之后只读. 检测时按下标取用开关、区域半径和阈值, 不再按字符串查参数
+===================================================================================================*/
+struct stInspectPlan
+{
+    //开关
+    bool bIsDebug = false;
+    bool bIsSkipBoard = false;              //工位在is_board中, 不检测直接返回良品
+    bool bIsCheckCharacter = false;
+    bool bIsCheckTiaoxingma = false;
+    bool bIsCheckLogo = false;
+
+    //定位二值化阈值, 下标为拍照次数-1
+    std::vector<int> vBoxBinaryThreshold;
+
+    //区域半径, 相对镜片中心的像素距离
+    int centerRadius = 420;                 //中心区
+    int foregroundRadius = 1280;            //前景区, 中心在此之外的瑕疵视为背景, 留了一点点背景区
+    int edgeMargin = 116;                   //瑕疵框须与缩窄edgeMargin后的前景圆相交, 防止边缘附近背景误检
+    std::vector<int> vDarkFieldRadius;      //暗场屏蔽半径, 下标为拍照次数-1, 0-不屏蔽
+
+    //阈值表, 下标为拍照次数-1
+    std::vector<stThresholdTable> vThresholds;
+    //UI中关闭的瑕疵类别, 下标为模型类别
+    std::bitset<MAX_DEFECT_CATEGORY> disabledCategories;
+
+    //整片镜片内按类别聚类, 下标为模型类别, 连接距离为0的类别按框逐个判定
+    std::vector<stClusterParams> vClusterParams;
+    int xianshangMaxCount = 2;              //长度超过5像素的线伤簇数达到此值时都判NG, 0-不判
+    int dianshangMaxCount = 0;              //单簇点伤数达到此值时判NG, 0-不判
+
+    //小图保存策略: 良品/NG是否保存
+    bool bIsSaveTileOK = false;
+    bool bIsSaveTileNG = false;
+
+    const stThresholdTable *getThresholds(const int nCaptureTimes) const
+    {
+        return (nCaptureTimes >= 1 && nCaptureTimes <= (int)vThresholds.size()) ? &vThresholds[nCaptureTimes - 1] : nullptr;
+    }
+
+    int getBoxBinaryThreshold(const int nCaptureTimes) const
+    {
+        return (nCaptureTimes >= 1 && nCaptureTimes <= (int)vBoxBinaryThreshold.size()) ? vBoxBinaryThreshold[nCaptureTimes - 1] : 5;
+    }
+
+    int getDarkFieldRadius(const int nCaptureTimes) const
+    {
+        return (nCaptureTimes >= 1 && nCaptureTimes <= (int)vDarkFieldRadius.size()) ? vDarkFieldRadius[nCaptureTimes - 1] : 0;
+    }
+
+    bool isDisabled(const int category) const
+    {
+        return category >= 0 && category < MAX_DEFECT_CATEGORY && disabledCategories.test(category);
+    }
+
+    bool isClustered(const int category) const
+    {
+        return category >= 0 && category < (int)vClusterParams.size() && vClusterParams[category].linkDistance > 0;
+    }
+
+    bool isSaveTile(const bool bIsGood) const
+    {
+        return bIsGood ? bIsSaveTileOK : bIsSaveTileNG;
+    }
+};
+
+#endif // INSPECT_PLAN_H
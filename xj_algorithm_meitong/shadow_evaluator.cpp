@@ -0,0 +1,189 @@
+#include "shadow_evaluator.h"
+#include "xj_algorithm.h"
+#include "utils.h"
+#include <ctime>
+
+using namespace cv;
+using namespace std;
+
+//当前线程已使用的CPU时间(毫秒)
+static double getThreadCpuMs()
+{
+    timespec ts;
+    if(clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0)
+    {
+        return 0;
+    }
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+ShadowEvaluator &ShadowEvaluator::instance()
+{
+    static ShadowEvaluator evaluator;
+    return evaluator;
+}
+
+ShadowEvaluator::ShadowEvaluator():
+    m_maxQueueSize(8),
+    m_cpuShare(0.25f),
+    m_bIsStop(false)
+{
+}
+
+ShadowEvaluator::~ShadowEvaluator()
+{
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_bIsStop = true;
+        m_dqJobs.clear();
+    }
+    m_condV.notify_all();
+    if(m_thread.joinable())
+    {
+        m_thread.join();
+    }
+}
+
+void ShadowEvaluator::configure(const int maxQueueSize, const float cpuShare, const string &sSavePath)
+{
+    lock_guard<mutex> lock(m_mutex);
+    m_maxQueueSize = std::max(1, maxQueueSize);
+    m_cpuShare = std::min(1.0f, std::max(0.01f, cpuShare));
+    m_sSavePath = sSavePath;
+    if(!m_thread.joinable())
+    {
+        m_thread = thread(&ShadowEvaluator::run, this);
+    }
+}
+
+bool ShadowEvaluator::submit(stShadowJob &&job)
+{
+    {
+        lock_guard<mutex> lock(m_mutex);
+        stShadowReport &report = m_mapReports[job.boardId];
+        report.boardId = job.boardId;
+        report.sModelPath = job.sModelPath;
+        report.numSampled++;
+        if(!m_thread.joinable() || (int)m_dqJobs.size() >= m_maxQueueSize)
+        {
+            report.numDropped++;
+            return false;
+        }
+        m_dqJobs.emplace_back(std::move(job));
+    }
+    m_condV.notify_one();
+    return true;
+}
+
+vector<stShadowReport> ShadowEvaluator::getReports()
+{
+    lock_guard<mutex> lock(m_mutex);
+    vector<stShadowReport> vReports;
+    for(const auto &item : m_mapReports)
+    {
+        stShadowReport report = item.second;
+        report.queueDepth = 0;
+        for(const auto &job : m_dqJobs)
+        {
+            report.queueDepth += (job.boardId == item.first);
+        }
+        report.avgEvalMs = (report.numEvaluated > 0) ? m_mapTotalEvalMs[item.first] / report.numEvaluated : 0;
+        vReports.emplace_back(report);
+    }
+    return vReports;
+}
+
+void ShadowEvaluator::run()
+{
+    //最低优先级, 任务池任务在本线程执行, 不占用生产线程也不帮生产执行任务
+    if(!setCurrentThreadIdlePriority())
+    {
+        cout << "[WARNING] failed to lower priority of shadow evaluator" << endl;
+    }
+    TaskPool::setThreadInline(true);
+
+    while(true)
+    {
+        stShadowJob job;
+        float cpuShare;
+        {
+            unique_lock<mutex> lock(m_mutex);
+            m_condV.wait(lock, [this]{ return m_bIsStop || !m_dqJobs.empty(); });
+            if(m_bIsStop)
+            {
+                break;
+            }
+            job = std::move(m_dqJobs.front());
+            m_dqJobs.pop_front();
+            cpuShare = m_cpuShare;
+        }
+
+        //生产模型有排队请求时候选模型不提交推理
+        bool bIsStop = false;
+        while(!bIsStop && job.pProductionExecutor != nullptr && job.pProductionExecutor->getStats().queueDepth > 0)
+        {
+            unique_lock<mutex> lock(m_mutex);
+            bIsStop = m_condV.wait_for(lock, chrono::milliseconds(2), [this]{ return m_bIsStop; });
+        }
+        if(bIsStop)
+        {
+            break;
+        }
+
+        const double beginCpuMs = getThreadCpuMs();
+        try
+        {
+            evaluate(job);
+        }
+        catch(const std::exception &e)
+        {
+            cout << "[ERROR] board[" << job.boardId << "] shadow evaluation failed: " << e.what() << endl;
+        }
+        const double cpuMs = getThreadCpuMs() - beginCpuMs;
+        {
+            lock_guard<mutex> lock(m_mutex);
+            m_mapTotalEvalMs[job.boardId] += cpuMs;
+        }
+
+        //按占用比例休眠: cpuMs / (cpuMs + sleepMs) <= cpuShare
+        const double sleepMs = cpuMs * (1.0 / cpuShare - 1.0);
+        if(sleepMs > 0)
+        {
+            unique_lock<mutex> lock(m_mutex);
+            m_condV.wait_for(lock, chrono::microseconds((long)(sleepMs * 1000)), [this]{ return m_bIsStop; });
+        }
+    }
+}
+
+void ShadowEvaluator::evaluate(const stShadowJob &job)
+{
+    const bool bIsCandidateNG = job.pShadow->detectShadow(job.image, job.productCount, job.nCaptureTimes, job.maxLenses);
+    string sSavePath;
+    {
+        lock_guard<mutex> lock(m_mutex);
+        stShadowReport &report = m_mapReports[job.boardId];
+        report.numEvaluated++;
+        if(bIsCandidateNG == job.bIsProductionNG)
+        {
+            report.numAgree++;
+            return;
+        }
+        (bIsCandidateNG ? report.numCandidateNG : report.numCandidateOK)++;
+        sSavePath = m_sSavePath;
+    }
+
+    cout << "board[" << job.boardId << "] shadow model disagrees on product " << job.productCount << " pic" << job.nCaptureTimes
+         << ": production " << (job.bIsProductionNG ? "NG" : "OK") << ", candidate " << (bIsCandidateNG ? "NG" : "OK") << endl;
+    //分歧帧保存原图, 在本线程写盘, 占用计入CPU限额
+    if(!sSavePath.empty())
+    {
+        const string sFileName = "B" + to_string(job.boardId + 1) + "_CNT" + to_string(job.productCount) + "_PIC" + to_string(job.nCaptureTimes)
+            + (job.bIsProductionNG ? "_PROD-NG_CAND-OK_" : "_PROD-OK_CAND-NG_") + to_string(time(nullptr));
+        saveImage(job.image, sSavePath, sFileName, ".png");
+    }
+}
+
+vector<stShadowReport> getShadowReports()
+{
+    return ShadowEvaluator::instance().getReports();
+}
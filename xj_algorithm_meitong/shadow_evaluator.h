@@ -0,0 +1,73 @@
+#ifndef SHADOW_EVALUATOR_H
+#define SHADOW_EVALUATOR_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <opencv2/opencv.hpp>
+#include "xj_app_algorithm.h"
+#include "inference_service.h"
+
+class XJAlgorithm;
+
+//一帧影子评估任务: 候选模型实例在后台线程重新检测该帧, 结果只与生产判定比较
+struct stShadowJob
+{
+    int boardId = 0;
+    std::string sModelPath;
+    std::shared_ptr<const XJAlgorithm> pShadow;                 //候选模型实例, 除模型外参数与生产实例相同
+    std::shared_ptr<ModelExecutor> pProductionExecutor;         //生产模型执行器, 有排队请求时候选模型让路
+    cv::Mat image;
+    int productCount = 0;
+    int nCaptureTimes = 1;
+    int maxLenses = 1;
+    bool bIsProductionNG = false;
+};
+
+/*==================================================================================================
+    影子评估: 进程内一个后台线程, 最低调度优先级, 任务池任务在本线程直接执行;
+    队列有上限, 满时丢弃新样本; 按线程CPU时间休眠补足, 占用不超过cpuShare个核
+===================================================================================================*/
+class ShadowEvaluator
+{
+public:
+    static ShadowEvaluator &instance();
+
+    /**
+     * @brief set limits, start the worker thread on the first call.
+     * @param maxQueueSize <input> max frames waiting for evaluation, new frames are dropped when full
+     * @param cpuShare <input> max cpu share of the worker thread, in cores (0, 1]
+     * @param sSavePath <input> folder to save frames on which the candidate disagrees, empty means no saving
+     */
+    void configure(const int maxQueueSize, const float cpuShare, const std::string &sSavePath);
+    //队列满时丢弃并返回false
+    bool submit(stShadowJob &&job);
+    std::vector<stShadowReport> getReports();
+
+private:
+    ShadowEvaluator();
+    ~ShadowEvaluator();
+    ShadowEvaluator(const ShadowEvaluator &) = delete;
+    ShadowEvaluator &operator=(const ShadowEvaluator &) = delete;
+
+    void run();
+    void evaluate(const stShadowJob &job);
+
+    std::mutex m_mutex;
+    std::condition_variable m_condV;
+    std::deque<stShadowJob> m_dqJobs;
+    std::map<int, stShadowReport> m_mapReports;     //<工位, 统计>
+    std::map<int, double> m_mapTotalEvalMs;
+    int m_maxQueueSize;
+    float m_cpuShare;
+    std::string m_sSavePath;
+    bool m_bIsStop;
+    std::thread m_thread;
+};
+
+#endif // SHADOW_EVALUATOR_H
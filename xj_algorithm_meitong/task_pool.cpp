@@ -0,0 +1,278 @@
+#include "task_pool.h"
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+using namespace std;
+
+//当前线程在任务池中的序号, 非任务池线程为-1
+static thread_local int s_workerIndex = -1;
+//当前线程提交的任务是否在本线程直接执行
+static thread_local bool s_bIsInline = false;
+
+TaskPool &TaskPool::instance()
+{
+    static TaskPool pool;
+    return pool;
+}
+
+TaskPool::TaskPool()
+    : m_numPending(0)
+    , m_nextWorker(0)
+    , m_numWorkers(0)
+    , m_bIsStop(false)
+{
+}
+
+TaskPool::~TaskPool()
+{
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_bIsStop = true;
+    }
+    m_condV.notify_all();
+    for(auto &thread : m_vThreads)
+    {
+        if(thread.joinable())
+        {
+            thread.join();
+        }
+    }
+}
+
+void TaskPool::start(const int numThreads, const vector<int> &vCpuIds)
+{
+    lock_guard<mutex> lock(m_startMutex);
+    const int numWorkers = (numThreads > 0) ? numThreads : std::max(1, (int)thread::hardware_concurrency());
+    if(m_numWorkers.load() > 0)
+    {
+        if(numWorkers != m_numWorkers.load())
+        {
+            cout << "[WARNING] task pool already started with " << m_numWorkers.load() << " threads, ignore " << numWorkers << endl;
+        }
+        return;
+    }
+
+    //队列先全部建好再启动线程, 之后不再改动, 读取时不需要加锁
+    for(int i = 0; i != numWorkers; ++i)
+    {
+        m_vWorkers.emplace_back(new stWorker());
+    }
+    for(int i = 0; i != numWorkers; ++i)
+    {
+        const int cpuId = vCpuIds.empty() ? -1 : vCpuIds[i % vCpuIds.size()];
+        m_vThreads.emplace_back(&TaskPool::run, this, i, cpuId);
+    }
+    m_numWorkers.store(numWorkers);
+    cout << "task pool started with " << numWorkers << " threads" << (vCpuIds.empty() ? "" : ", pinned") << endl;
+}
+
+int TaskPool::size() const
+{
+    return m_numWorkers.load();
+}
+
+void TaskPool::setThreadInline(const bool bIsInline)
+{
+    s_bIsInline = bIsInline;
+}
+
+void TaskPool::parallelFor(const int begin, const int end, const function<void(int)> &func)
+{
+    if(end - begin == 1 || size() == 0 || s_bIsInline)
+    {
+        for(int i = begin; i < end; ++i)
+        {
+            func(i);
+        }
+        return;
+    }
+
+    TaskGroup group(*this);
+    for(int i = begin; i < end; ++i)
+    {
+        group.run([&func, i]() { func(i); });
+    }
+    group.wait();
+}
+
+void TaskPool::push(function<void()> task)
+{
+    //任务池线程放入自己队列尾部, 保持局部性; 外部线程轮流分散到各队列
+    const int numWorkers = size();
+    const int index = (s_workerIndex >= 0) ? s_workerIndex : (int)(m_nextWorker++ % numWorkers);
+    {
+        lock_guard<mutex> lock(m_vWorkers[index]->mutex);
+        m_vWorkers[index]->dqTasks.emplace_back(std::move(task));
+    }
+    ++m_numPending;
+    {
+        //持锁通知, 避免线程检查完条件后、进入等待前错过唤醒
+        lock_guard<mutex> lock(m_mutex);
+    }
+    m_condV.notify_one();
+}
+
+bool TaskPool::tryRunOne()
+{
+    const int numWorkers = size();
+    if(numWorkers == 0 || m_numPending.load() == 0)
+    {
+        return false;
+    }
+
+    function<void()> task;
+    if(s_workerIndex >= 0)
+    {
+        stWorker &self = *m_vWorkers[s_workerIndex];
+        lock_guard<mutex> lock(self.mutex);
+        if(!self.dqTasks.empty())
+        {
+            task = std::move(self.dqTasks.back());
+            self.dqTasks.pop_back();
+        }
+    }
+
+    const int first = (s_workerIndex >= 0) ? s_workerIndex + 1 : 0;
+    for(int i = 0; !task && i != numWorkers; ++i)
+    {
+        stWorker &victim = *m_vWorkers[(first + i) % numWorkers];
+        lock_guard<mutex> lock(victim.mutex);
+        if(!victim.dqTasks.empty())
+        {
+            task = std::move(victim.dqTasks.front());
+            victim.dqTasks.pop_front();
+        }
+    }
+
+    if(!task)
+    {
+        return false;
+    }
+    --m_numPending;
+    task();
+    return true;
+}
+
+void TaskPool::run(const int index, const int cpuId)
+{
+    s_workerIndex = index;
+#ifdef __linux__
+    if(cpuId >= 0)
+    {
+        cpu_set_t cpuSet;
+        CPU_ZERO(&cpuSet);
+        CPU_SET(cpuId, &cpuSet);
+        if(pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuSet) != 0)
+        {
+            cout << "[ERROR] task pool thread " << index << " pin to cpu " << cpuId << " failed" << endl;
+        }
+    }
+#endif
+
+    while(true)
+    {
+        if(tryRunOne())
+        {
+            continue;
+        }
+        unique_lock<mutex> lock(m_mutex);
+        m_condV.wait(lock, [this]() { return m_bIsStop || m_numPending.load() > 0; });
+        if(m_bIsStop && m_numPending.load() == 0)
+        {
+            return;
+        }
+    }
+}
+
+TaskGroup::TaskGroup(TaskPool &pool)
+    : m_pool(pool)
+    , m_numUnfinished(0)
+{
+}
+
+TaskGroup::~TaskGroup()
+{
+    try
+    {
+        wait();
+    }
+    catch(...)
+    {
+        cout << "[ERROR] task group destroyed with an unhandled task exception" << endl;
+    }
+}
+
+void TaskGroup::run(function<void()> task)
+{
+    if(m_pool.size() == 0 || s_bIsInline)
+    {
+        execute(task);
+        return;
+    }
+
+    {
+        lock_guard<mutex> lock(m_mutex);
+        ++m_numUnfinished;
+    }
+    m_pool.push([this, task]()
+    {
+        execute(task);
+        //持锁计数和通知, 保证wait返回(任务组析构)时已没有任务在访问本组
+        lock_guard<mutex> lock(m_mutex);
+        if(--m_numUnfinished == 0)
+        {
+            m_condV.notify_all();
+        }
+    });
+}
+
+void TaskGroup::wait()
+{
+    while(true)
+    {
+        {
+            lock_guard<mutex> lock(m_mutex);
+            if(m_numUnfinished == 0)
+            {
+                break;
+            }
+        }
+        //等待期间帮助执行任务池中的任务; 没有可取的任务说明本组剩余任务都已在其它线程执行, 短暂等待后再检查嵌套提交的任务
+        if(!m_pool.tryRunOne())
+        {
+            unique_lock<mutex> lock(m_mutex);
+            m_condV.wait_for(lock, chrono::milliseconds(1), [this]() { return m_numUnfinished == 0; });
+        }
+    }
+
+    exception_ptr pException;
+    {
+        lock_guard<mutex> lock(m_mutex);
+        std::swap(pException, m_pException);
+    }
+    if(pException)
+    {
+        rethrow_exception(pException);
+    }
+}
+
+void TaskGroup::execute(const function<void()> &task)
+{
+    try
+    {
+        task();
+    }
+    catch(...)
+    {
+        lock_guard<mutex> lock(m_mutex);
+        if(!m_pException)
+        {
+            m_pException = current_exception();
+        }
+    }
+}
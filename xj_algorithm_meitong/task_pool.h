@@ -0,0 +1,99 @@
+#ifndef TASK_POOL_H
+#define TASK_POOL_H
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <exception>
+#include <condition_variable>
+
+/*==================================================================================================
+                    进程内共享任务池: 每个线程一个任务队列, 本线程后进先出, 空闲时从其它线程队列头部窃取
+===================================================================================================*/
+class TaskPool
+{
+public:
+    static TaskPool &instance();
+
+    /**
+     * @brief start worker threads, shared by all boards, only the first call takes effect.
+     * @param numThreads number of workers, <= 0 means hardware concurrency.
+     * @param vCpuIds cpu cores to pin workers to, worker i is pinned to vCpuIds[i % size], empty means no pinning.
+     */
+    void start(const int numThreads, const std::vector<int> &vCpuIds);
+    int size() const;
+
+    /**
+     * @brief run func(i) for i in [begin, end) on the pool, caller helps and returns when all finished.
+     *        exception of the first failed task is rethrown in the caller.
+     */
+    void parallelFor(const int begin, const int end, const std::function<void(int)> &func);
+
+    /**
+     * @brief tasks submitted by the calling thread run inline, the thread never helps with pool tasks.
+     *        used by low priority background threads so that they neither occupy workers nor run production tasks.
+     */
+    static void setThreadInline(const bool bIsInline);
+
+private:
+    friend class TaskGroup;
+
+    struct stWorker
+    {
+        std::mutex mutex;
+        std::deque<std::function<void()>> dqTasks;
+    };
+
+    TaskPool();
+    ~TaskPool();
+    TaskPool(const TaskPool &) = delete;
+    TaskPool &operator=(const TaskPool &) = delete;
+
+    void push(std::function<void()> task);
+    //取一个任务执行: 先取本线程队列尾部, 再从其它线程队列头部窃取, 没有任务返回false
+    bool tryRunOne();
+    void run(const int index, const int cpuId);
+
+    std::vector<std::unique_ptr<stWorker>> m_vWorkers;
+    std::vector<std::thread> m_vThreads;
+    std::mutex m_mutex;
+    std::condition_variable m_condV;
+    std::atomic<int> m_numPending;      //所有队列中未取走的任务数
+    std::atomic<unsigned> m_nextWorker; //外部线程提交任务时轮流放入各线程队列
+    std::atomic<int> m_numWorkers;      //线程全部创建后才置位, 之前提交的任务在调用线程直接执行
+    std::mutex m_startMutex;
+    bool m_bIsStop;
+};
+
+/*==================================================================================================
+                    任务组: 一组任务提交到任务池, wait时调用线程参与执行, 允许在任务中嵌套使用
+===================================================================================================*/
+class TaskGroup
+{
+public:
+    explicit TaskGroup(TaskPool &pool = TaskPool::instance());
+    ~TaskGroup();
+
+    //任务池未启动时在调用线程直接执行
+    void run(std::function<void()> task);
+    //等待本组任务全部结束, 第一个失败任务的异常在这里重新抛出
+    void wait();
+
+private:
+    TaskGroup(const TaskGroup &) = delete;
+    TaskGroup &operator=(const TaskGroup &) = delete;
+
+    void execute(const std::function<void()> &task);
+
+    TaskPool &m_pool;
+    std::mutex m_mutex;
+    std::condition_variable m_condV;
+    int m_numUnfinished;
+    std::exception_ptr m_pException;
+};
+
+#endif // TASK_POOL_H
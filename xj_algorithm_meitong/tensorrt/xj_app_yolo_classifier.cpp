@@ -456,7 +456,7 @@ bool YoloClassifier::getDetectionResult(const vector<Mat> &vBatchImage, vector<v
         if (nms_result.empty())
         {
             vDetectOutput.emplace_back(vOutput);
-            return true;
+            continue;
         }
         
         Rect holeImgRect(0, 0, img_w, img_h);
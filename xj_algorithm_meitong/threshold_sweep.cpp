@@ -0,0 +1,329 @@
+#include "threshold_sweep.h"
+#include "task_pool.h"
+#include <cstring>
+#include <sys/stat.h>
+
+using namespace cv;
+using namespace std;
+
+void judgeTileDetections(const stInspectPlan &plan, const stThresholdTable &thresholds, const Size &maskSize, const Point &center,
+                         const Rect &tileRect, const vector<YoloOutputDetect> &vDetections, vector<stDefectInfo> &vDefects,
+                         vector<stDefectCandidate> &vCandidates)
+{
+    const int radius3 = plan.foregroundRadius - plan.edgeMargin;    //缩窄背景区域
+    int objectId = 0;
+    vector<Rect> boxesXianshang;
+    for(const auto &det : vDetections)
+    {
+        objectId = det.id;
+        Rect box(int(det.box.x + tileRect.x), int(det.box.y + tileRect.y), int(det.box.width), int(det.box.height));
+        const float tempS = box.area();
+        const float diagL = std::sqrt(box.width*box.width + box.height*box.height); //瑕疵对角线长度
+
+        //防止边缘附近的背景上的瑕疵误检
+        //瑕疵框与缩窄后前景圆的相交面积, 只在框内画圆计数, 与整幅ROI掩膜相与的结果一致
+        const Rect roi = box & Rect(0, 0, maskSize.width, maskSize.height);
+        int whiteArea = 0;
+        if(roi.area() > 0)
+        {
+            Mat mask5 = Mat::zeros(roi.size(), CV_8UC1);
+            circle(mask5, center - roi.tl(), radius3, Scalar(255), -1);
+            whiteArea = countNonZero(mask5);
+        }
+
+        //计算产品中心到瑕疵中心的距离，与中心区半径比较大小，由此判断调用松/紧参数
+        const float centerX = box.x + box.width/2;
+        const float centerY = box.y + box.height/2;
+        const float d_defect2center = std::sqrt((centerX-center.x)*(centerX-center.x) + (centerY-center.y)*(centerY-center.y));
+        if(d_defect2center >= plan.foregroundRadius)    //如果检测到的瑕疵的中心点在背景区（防止模型异常或早期的训练数据影响）
+        {
+            continue;
+        }
+        //UI中关闭的类别不判为瑕疵
+        if(plan.isDisabled(objectId))
+        {
+            continue;
+        }
+
+        const InspectZone zone = (d_defect2center <= plan.centerRadius) ? InspectZone::CENTER : InspectZone::NON_CENTER;
+        //聚类类别: 置信度达标的片段留到整片镜片聚类, 跨小图、断续的划伤合并后再按长度、面积判定
+        if(plan.isClustered(objectId))
+        {
+            if(whiteArea >= 1 && thresholds.isConfident(zone, objectId, det.confidence))
+            {
+                stDefectCandidate candidate;
+                candidate.category = objectId;
+                candidate.item.box = box;
+                candidate.item.confidence = det.confidence;
+                candidate.item.bIsCenter = (zone == InspectZone::CENTER);
+                vCandidates.emplace_back(candidate);
+            }
+            continue;
+        }
+
+        if(thresholds.isDefect(zone, objectId, det.confidence, tempS, diagL) && whiteArea >= 1)
+        {
+            stDefectInfo defect;
+            defect.type = objectId + 2;  //good是1，瑕疵从2开始
+            defect.box = box;
+            defect.confidence = det.confidence;
+            vDefects.emplace_back(defect);
+        }
+
+        if(objectId == XIANSHANG_CATEGORY && diagL > 5)  //线伤
+        {
+            boxesXianshang.push_back(box);
+        }
+    }
+
+    //线伤不聚类时沿用按小图的规则: 多条线伤时除最后一条外都计为瑕疵, 类别沿用最后一个检测结果
+    for(size_t i = 1; i < boxesXianshang.size(); i++)
+    {
+        stDefectInfo defect;
+        defect.type = objectId + 2;
+        defect.box = boxesXianshang[i-1];
+        vDefects.emplace_back(defect);
+    }
+}
+
+void judgeLensCandidates(const stInspectPlan &plan, const stThresholdTable &thresholds, const vector<stDefectCandidate> &vCandidates,
+                         vector<stDefectInfo> &vDefects)
+{
+    map<int, vector<stClusterItem>> mapItems;
+    for(const auto &candidate : vCandidates)
+    {
+        mapItems[candidate.category].push_back(candidate.item);
+    }
+
+    vector<stDefectCluster> vClusters;
+    for(const auto &items : mapItems)
+    {
+        const int category = items.first;
+        clusterDefects(items.second, plan.vClusterParams[category], vClusters);
+        vector<bool> vIsDefect(vClusters.size(), false);
+        int numLines = 0;
+        for(size_t k = 0; k != vClusters.size(); ++k)
+        {
+            const stDefectCluster &cluster = vClusters[k];
+            const InspectZone zone = cluster.bIsCenter ? InspectZone::CENTER : InspectZone::NON_CENTER;
+            vIsDefect[k] = thresholds.isDefect(zone, category, cluster.confidence, cluster.area, cluster.length);
+            if(category == DIANSHANG_CATEGORY && plan.dianshangMaxCount > 0 && cluster.count >= plan.dianshangMaxCount)
+            {
+                vIsDefect[k] = true;    //密集点伤
+            }
+            numLines += (category == XIANSHANG_CATEGORY && cluster.length > 5);
+        }
+
+        //整片镜片的线伤条数达到上限时, 长度超过5像素的线伤都判NG
+        const bool bIsTooManyLines = (plan.xianshangMaxCount > 0 && numLines >= plan.xianshangMaxCount);
+        for(size_t k = 0; k != vClusters.size(); ++k)
+        {
+            const stDefectCluster &cluster = vClusters[k];
+            if(!vIsDefect[k] && !(bIsTooManyLines && cluster.length > 5))
+            {
+                continue;
+            }
+            stDefectInfo defect;
+            defect.type = category + 2;
+            defect.box = cluster.box;
+            defect.confidence = cluster.confidence;
+            vDefects.emplace_back(defect);
+        }
+    }
+}
+
+bool judgeRawFrame(const stRawFrame &frame, const stInspectPlan &plan, const stThresholdTable &thresholds)
+{
+    for(const auto &lens : frame.vLenses)
+    {
+        if(!lens.vFixedDefects.empty())
+        {
+            return true;
+        }
+    }
+
+    vector<stDefectInfo> vDefects;
+    vector<vector<stDefectCandidate>> vLensCandidates(frame.vLenses.size());
+    for(const auto &tile : frame.vTiles)
+    {
+        if(tile.lensIdx < 0 || tile.lensIdx >= (int)frame.vLenses.size())
+        {
+            continue;
+        }
+        const stRawLens &lens = frame.vLenses[tile.lensIdx];
+        judgeTileDetections(plan, thresholds, lens.maskSize, lens.center, tile.rect, tile.vDetections, vDefects, vLensCandidates[tile.lensIdx]);
+        if(!vDefects.empty())
+        {
+            return true;
+        }
+    }
+    for(const auto &vCandidates : vLensCandidates)
+    {
+        judgeLensCandidates(plan, thresholds, vCandidates, vDefects);
+        if(!vDefects.empty())
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint64_t getImageHash(const Mat &image)
+{
+    const uint64_t prime = 1099511628211ULL;
+    uint64_t hash = 14695981039346656037ULL;
+    auto mix = [&hash, prime](const uint64_t value)
+    {
+        hash ^= value;
+        hash *= prime;
+    };
+    mix(image.rows);
+    mix(image.cols);
+    mix(image.type());
+
+    //按行处理, 支持不连续的ROI; 每次取8字节
+    const size_t rowBytes = image.cols * image.elemSize();
+    for(int y = 0; y < image.rows; ++y)
+    {
+        const uchar *pRow = image.ptr<uchar>(y);
+        size_t i = 0;
+        for(; i + 8 <= rowBytes; i += 8)
+        {
+            uint64_t value;
+            memcpy(&value, pRow + i, 8);
+            mix(value);
+        }
+        for(; i < rowBytes; ++i)
+        {
+            mix(pRow[i]);
+        }
+    }
+    return hash;
+}
+
+string getFileSignature(const string &sFilePath)
+{
+    struct stat fileStat;
+    if(stat(sFilePath.c_str(), &fileStat) != 0)
+    {
+        return sFilePath;
+    }
+    return sFilePath + "#" + to_string((long long)fileStat.st_size) + "#" + to_string((long long)fileStat.st_mtime);
+}
+
+RawDetectionCache &RawDetectionCache::instance()
+{
+    static RawDetectionCache cache;
+    return cache;
+}
+
+void RawDetectionCache::setCapacity(const int capacity)
+{
+    lock_guard<mutex> lock(m_mutex);
+    m_capacity = std::max(0, capacity);
+    while((int)m_lstEntries.size() > m_capacity)
+    {
+        m_mapEntries.erase(m_lstEntries.back().first);
+        m_lstEntries.pop_back();
+    }
+}
+
+bool RawDetectionCache::isEnabled()
+{
+    lock_guard<mutex> lock(m_mutex);
+    return m_capacity > 0;
+}
+
+shared_ptr<const stRawFrame> RawDetectionCache::get(const string &sKey)
+{
+    lock_guard<mutex> lock(m_mutex);
+    auto itr = m_mapEntries.find(sKey);
+    if(itr == m_mapEntries.end())
+    {
+        return nullptr;
+    }
+    m_lstEntries.splice(m_lstEntries.begin(), m_lstEntries, itr->second);
+    return itr->second->second;
+}
+
+void RawDetectionCache::put(const string &sKey, const shared_ptr<const stRawFrame> &pFrame)
+{
+    lock_guard<mutex> lock(m_mutex);
+    if(m_capacity == 0 || pFrame == nullptr)
+    {
+        return;
+    }
+    auto itr = m_mapEntries.find(sKey);
+    if(itr != m_mapEntries.end())
+    {
+        itr->second->second = pFrame;
+        m_lstEntries.splice(m_lstEntries.begin(), m_lstEntries, itr->second);
+        return;
+    }
+    m_lstEntries.emplace_front(sKey, pFrame);
+    m_mapEntries[sKey] = m_lstEntries.begin();
+    if((int)m_lstEntries.size() > m_capacity)
+    {
+        m_mapEntries.erase(m_lstEntries.back().first);
+        m_lstEntries.pop_back();
+    }
+}
+
+//按缩放比例生成一组阈值, category为-1时缩放全部类别
+static stThresholdTable scaleThresholds(const stThresholdTable &thresholds, const int category, const float probScale, const float areaScale, const float diagScale)
+{
+    stThresholdTable scaled = thresholds;
+    for(int zone = 0; zone != (int)InspectZone::NUM; ++zone)
+    {
+        for(int i = 0; i != thresholds.numCategory; ++i)
+        {
+            if(category >= 0 && category != i)
+            {
+                continue;
+            }
+            const int idx = thresholds.index((InspectZone)zone, i);
+            scaled.vMinProb[idx] *= probScale;
+            scaled.vMinArea[idx] *= areaScale;
+            scaled.vMinDiag[idx] *= diagScale;
+        }
+    }
+    return scaled;
+}
+
+void sweepThresholdGrid(const vector<stSweepSample> &vSamples, const stInspectPlan &plan, const stThresholdTable &thresholds,
+                        const stSweepRequest &request, vector<stSweepResult> &vResults)
+{
+    vResults.clear();
+    for(const auto &probScale : request.vProbScales)
+    {
+        for(const auto &areaScale : request.vAreaScales)
+        {
+            for(const auto &diagScale : request.vDiagScales)
+            {
+                stSweepResult result;
+                result.probScale = probScale;
+                result.areaScale = areaScale;
+                result.diagScale = diagScale;
+                vResults.emplace_back(result);
+            }
+        }
+    }
+
+    //各组阈值互不相关, 每组在任务池中独立判定全部样本
+    TaskPool::instance().parallelFor(0, vResults.size(), [&](int k)
+    {
+        stSweepResult &result = vResults[k];
+        const stThresholdTable scaled = scaleThresholds(thresholds, request.category, result.probScale, result.areaScale, result.diagScale);
+        for(const auto &sample : vSamples)
+        {
+            if(sample.pFrame == nullptr)
+            {
+                continue;
+            }
+            const bool bIsNG = judgeRawFrame(*sample.pFrame, plan, scaled);
+            result.numNG += bIsNG;
+            result.numOverkill += (bIsNG && !sample.bIsLabelNG);
+            result.numEscape += (!bIsNG && sample.bIsLabelNG);
+        }
+    });
+}
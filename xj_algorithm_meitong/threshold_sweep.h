@@ -0,0 +1,120 @@
+#ifndef THRESHOLD_SWEEP_H
+#define THRESHOLD_SWEEP_H
+
+#include <string>
+#include <vector>
+#include <list>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <opencv2/opencv.hpp>
+#include "xj_app_algorithm.h"
+#include "xj_app_yolo_classifier.h"
+#include "inspect_plan.h"
+
+//一张小图推理前后的原始结果, 框为小图内坐标, 未经阈值过滤
+struct stRawTile
+{
+    int lensIdx = 0;
+    int tileIdx = 0;
+    cv::Rect rect;                                  //小图在镜片ROI中的位置
+    std::vector<YoloOutputDetect> vDetections;
+};
+
+//一片镜片的几何信息和与阈值无关的结果
+struct stRawLens
+{
+    cv::Size maskSize;                              //镜片ROI大小
+    cv::Point center;                               //镜片中心, ROI坐标
+    std::vector<int> vFixedDefects;                 //定位/切图失败、物性、金样、印刷比对等与阈值无关的瑕疵
+};
+
+//一帧的原始检测结果: 阈值、区域半径、禁用类别都在判定时才使用, 同一帧换阈值不需要重新推理
+struct stRawFrame
+{
+    bool bIsInferOK = true;                         //推理失败的结果不缓存、不参与扫描
+    std::vector<stRawLens> vLenses;
+    std::vector<stRawTile> vTiles;                  //按推理批次顺序
+};
+
+//聚类类别的候选片段, 整片镜片的小图都判定完后再聚类
+struct stDefectCandidate
+{
+    int category = 0;
+    stClusterItem item;
+};
+
+/**
+ * @brief judge detections of one tile with the inspect plan, shared by detection and threshold sweep.
+ * @param maskSize <input> size of the lens roi
+ * @param center <input> lens center in roi coordinates
+ * @param tileRect <input> tile position in the lens roi, detections are offset by its top-left corner
+ * @param vDefects <output> defects of categories judged box by box, appended in detection order, box in roi coordinates
+ * @param vCandidates <output> fragments of clustered categories, judged later by judgeLensCandidates
+ */
+void judgeTileDetections(const stInspectPlan &plan, const stThresholdTable &thresholds, const cv::Size &maskSize, const cv::Point &center,
+                         const cv::Rect &tileRect, const std::vector<YoloOutputDetect> &vDetections, std::vector<stDefectInfo> &vDefects,
+                         std::vector<stDefectCandidate> &vCandidates);
+
+/**
+ * @brief cluster fragments of one lens by category and judge the merged defects:
+ *        thresholds apply to the merged length/area, then the xianshang count and dianshang density rules.
+ * @param vDefects <output> defects appended, box is the bounding box of the cluster
+ */
+void judgeLensCandidates(const stInspectPlan &plan, const stThresholdTable &thresholds, const std::vector<stDefectCandidate> &vCandidates,
+                         std::vector<stDefectInfo> &vDefects);
+
+//按检测方案判定一帧原始结果, 有任一瑕疵返回true
+bool judgeRawFrame(const stRawFrame &frame, const stInspectPlan &plan, const stThresholdTable &thresholds);
+
+//图像内容哈希(64位FNV-1a), 同时包含尺寸和类型
+uint64_t getImageHash(const cv::Mat &image);
+//文件签名: 路径、大小和修改时间, 用于区分模型版本
+std::string getFileSignature(const std::string &sFilePath);
+
+/*==================================================================================================
+                    原始检测结果缓存: 按(图像哈希, 模型, 推理前参数)缓存, 进程内共享, 超出容量时淘汰最久未用
+===================================================================================================*/
+class RawDetectionCache
+{
+public:
+    static RawDetectionCache &instance();
+
+    //容量为0时不缓存
+    void setCapacity(const int capacity);
+    bool isEnabled();
+    std::shared_ptr<const stRawFrame> get(const std::string &sKey);
+    void put(const std::string &sKey, const std::shared_ptr<const stRawFrame> &pFrame);
+
+private:
+    RawDetectionCache() : m_capacity(0) {}
+    RawDetectionCache(const RawDetectionCache &) = delete;
+    RawDetectionCache &operator=(const RawDetectionCache &) = delete;
+
+    typedef std::pair<std::string, std::shared_ptr<const stRawFrame>> CacheEntry;
+
+    std::mutex m_mutex;
+    int m_capacity;
+    std::list<CacheEntry> m_lstEntries;     //头部为最近使用
+    std::map<std::string, std::list<CacheEntry>::iterator> m_mapEntries;
+};
+
+//带标签的扫描样本
+struct stSweepSample
+{
+    std::string sImagePath;
+    bool bIsLabelNG = false;
+    std::shared_ptr<const stRawFrame> pFrame;
+};
+
+/**
+ * @brief evaluate every threshold setting on cached raw frames in parallel.
+ * @param vSamples <input> labeled samples, samples without raw frame are skipped
+ * @param request <input> grid of threshold scales, applied to thresholds of the plan
+ * @param vResults <output> one result per setting, in grid order (prob, then area, then diag)
+ */
+void sweepThresholdGrid(const std::vector<stSweepSample> &vSamples, const stInspectPlan &plan, const stThresholdTable &thresholds,
+                        const stSweepRequest &request, std::vector<stSweepResult> &vResults);
+
+#endif // THRESHOLD_SWEEP_H
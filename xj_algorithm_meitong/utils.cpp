@@ -1,4 +1,6 @@
 #include "utils.h"
+#include <sys/stat.h>
+#include <errno.h>
 
 using namespace cv;
 using namespace std;
@@ -20,6 +22,24 @@ void saveImage(const cv::Mat &image, const std::string &sImagePath, const std::s
     cv::imwrite(sSvaeImage, image);
 }
 
+bool createDirectories(const std::string &sPath)
+{
+    for(size_t pos = sPath.find('/', 1); ; pos = sPath.find('/', pos + 1))
+    {
+        const std::string sDir = sPath.substr(0, pos);
+        if(!sDir.empty() && mkdir(sDir.c_str(), 0755) != 0 && errno != EEXIST)
+        {
+            return false;
+        }
+        if(pos == std::string::npos)
+        {
+            break;
+        }
+    }
+    struct stat info;
+    return stat(sPath.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+}
+
 std::string getTimeString(const time_t &ttime, const std::string &format, const std::chrono::system_clock::duration duration)
 {
     struct tm mtime;
@@ -356,20 +376,27 @@ bool getOffsetPolyMasks(Mat& canvas,vector<Point2i>& offsets,vector<vector<Point
     return true;
 }
 
-bool getMaxContour(const vector<vector<Point>>& contours, int &maxAreaIdx, float& maxContourArea)
+//镜片外接框尺寸范围(原图像素), binning为轮廓所在图像相对原图的缩小倍数
+static bool isLensContourSize(const Rect &rect, const int binning = 1)
 {
-    maxAreaIdx = -1;
-    maxContourArea = 0.0;
-    Rect box;
+    const Rect box(rect.x * binning, rect.y * binning, rect.width * binning, rect.height * binning);
     int widthThr1 = 2100;
     int widthThr2 = 2900;
     int heightThr1 = 2100;
     int heightThr2 = 2900;
+    return widthThr1 < box.width && widthThr2 > box.width && heightThr1 < box.height && heightThr2 > box.height;
+}
+
+bool getMaxContour(const vector<vector<Point>>& contours, int &maxAreaIdx, float& maxContourArea)
+{
+    maxAreaIdx = -1;
+    maxContourArea = 0.0;
+    Rect box;
     for (int i = 0; i != contours.size(); i++)
     {
         box = boundingRect(contours[i]);
         // if ((widthThr1<box.width<widthThr2) & (heightThr1<box.height<heightThr2))
-        if (widthThr1 < box.width & widthThr2 > box.width & heightThr1 < box.height & heightThr2 > box.height )
+        if (isLensContourSize(box))
         {
             cout << "widthThr1.width:" << box.width << endl;
             cout << "widthThr1.height:" << box.height << endl;
@@ -385,6 +412,54 @@ bool getMaxContour(const vector<vector<Point>>& contours, int &maxAreaIdx, float
     return true;
 }
 
+bool getLensContours(const vector<vector<Point>>& contours, const int maxNum, vector<int> &vIdx, const int binning)
+{
+    vIdx.clear();
+    vector<pair<double, int>> vCandidates;
+    for (int i = 0; i != contours.size(); i++)
+    {
+        if (isLensContourSize(boundingRect(contours[i]), binning))
+        {
+            const double area = contourArea(contours[i]);
+            if (area > 0)
+            {
+                vCandidates.emplace_back(area, i);
+            }
+        }
+    }
+    sort(vCandidates.begin(), vCandidates.end(), [](const pair<double, int> &a, const pair<double, int> &b) { return a.first > b.first; });
+
+    //同一镜片的内外轮廓相互重叠, 只保留面积最大的一个
+    vector<Rect> vBoxes;
+    for (const auto &candidate : vCandidates)
+    {
+        if ((int)vIdx.size() >= maxNum)
+        {
+            break;
+        }
+        const Rect box = boundingRect(contours[candidate.second]);
+        bool bIsOverlap = false;
+        for (const auto &selected : vBoxes)
+        {
+            bIsOverlap = bIsOverlap || (box & selected).area() > 0;
+        }
+        if (!bIsOverlap)
+        {
+            vBoxes.emplace_back(box);
+            vIdx.emplace_back(candidate.second);
+        }
+    }
+
+    //按从左到右排列, 与料盘中的产品顺序一致
+    sort(vIdx.begin(), vIdx.end(), [&contours](const int a, const int b)
+    {
+        const Rect boxA = boundingRect(contours[a]);
+        const Rect boxB = boundingRect(contours[b]);
+        return boxA.x != boxB.x ? boxA.x < boxB.x : boxA.y < boxB.y;
+    });
+    return !vIdx.empty();
+}
+
 bool findHorizontalEdge(const cv::Mat &roiImage, int &x, int iThresh, bool bIsReverse, bool bIsDarkLight)
 {
      x  = -1;
@@ -13,6 +13,8 @@
 std::string getTime();
 std::string getAppFormatImageNameByCurrentTimeXJ(const int resultType, const int boardId, const int viewId, const int targetId, const std::string &sProductName,const std::string &sProductLot,const std::string &sCustomerEnd="");
 void saveImage(const cv::Mat &image, const std::string &sImagePath, const std::string &sImageName, const std::string &sImageExt);
+//逐级创建目录(同mkdir -p), 目录已存在也返回true
+bool createDirectories(const std::string &sPath);
 
 class AppTimer
 {
@@ -198,6 +200,16 @@ bool getOffsetPolyMasks(cv::Mat& canvas, std::vector<cv::Point2i>& offsets, std:
 
 bool getMaxContour(const std::vector<std::vector<cv::Point>>& contours, int &maxAreaIdx, float& maxContourArea);
 
+/**
+ * @brief get every lens-sized contour, at most maxNum, larger ones first and overlapping ones dropped.
+ * 
+ * @param contours contours to select from.
+ * @param maxNum max number of lenses.
+ * @param vIdx indexes of the selected contours, sorted left to right.
+ * @param binning downscale factor of the image the contours were found in, lens size limits are in full resolution.
+ */
+bool getLensContours(const std::vector<std::vector<cv::Point>>& contours, const int maxNum, std::vector<int> &vIdx, const int binning = 1);
+
 bool findHorizontalEdge(const cv::Mat &roiImage, int &x, int iThresh, bool bIsReverse, bool bIsDarkLight);
 bool findVerticalEdge(const cv::Mat &roiImage, int &y, int iThresh, bool bIsReverse, bool bIsDarkLight);
 
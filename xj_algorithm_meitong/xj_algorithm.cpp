@@ -1,6 +1,9 @@
 #include "xj_algorithm.h"
 #include "data.h"
 #include "utils.h"
+#include <random>
+#include <thread>
+#include <sstream>
 
 
 using namespace cv;
@@ -48,6 +51,9 @@ enum DefectType:int
 #define OK_SOURCE_IMAGE_SAVE_PATH "/opt/history/good"
 #define NG_SOURCE_IMAGE_SAVE_PATH "/opt/history/bad"
 
+//同时进行的阈值扫描请求数上限
+#define MAX_CONCURRENT_SWEEPS 1
+
 #define DRAW_OK_COLOR Scalar(0, 255, 0)
 #define DRAW_NG_COLOR Scalar(0, 0, 255)
 // #define TARGET_SIZE 1024
@@ -66,10 +72,12 @@ enum DefectType:int
 
 XJAlgorithm::XJAlgorithm(map<int, float> &mapAutoUpdateParams):
     m_mapAutoUpdateParams(mapAutoUpdateParams),
-    m_tensorrtYoloDL(nullptr),  //
-    m_maxBatchSize(1),  //在类的构造函数中初始化成员变量m_maxBatchSize为1
-    m_sProductName("N/A"),  //在类的构造函数中初始化成员变量m_sProductName为"N/A"
-    m_neituoHeight(120)
+    m_neituoHeight(120),
+    m_goldenTemplateMode(0),
+    m_goldenDefectType(10),
+    m_bayerPattern(BayerPattern::NONE),
+    m_shadowSampleRate(0),
+    m_shadowNGSampleRate(0)
 {
 }
 
@@ -83,269 +91,641 @@ bool XJAlgorithm::init(const stConfigParamsA &stParamsA, const stConfigParamsB &
     m_stParamsA = stParamsA;
     m_stParamsB = stParamsB;
     // if(!(m_stParamsA.boardId==0||m_stParamsA.boardId==1)){return true;}
-    ft2->loadFontData("/opt/app/simhei.ttf",0); //
-    const int numCategory = m_stParamsB.vecFParams.at("NUM_CATEGORY")[m_stParamsA.boardId]; //numCategory->m_vDisableDefectType
-    m_vDisableDefectType.clear();
-    for(float i=0;i<numCategory;i++)
+    //字体只用于结果图写中文, 缺少字体文件不影响检测
+    try
     {
-        if(!m_stParamsA.fParams.at(m_stParamsA.boardId+40) || !m_stParamsA.fParams.at(m_stParamsA.boardId*50+300+i))
-        {
-            m_vDisableDefectType.push_back(i);  //
-        }
+        ft2->loadFontData("/opt/app/simhei.ttf",0);
+    }
+    catch(const cv::Exception &e)
+    {
+        cout << "[WARNING] board[" << m_stParamsA.boardId << "] failed to load font: " << e.what() << endl;
     }
+    const int numCategory = m_stParamsB.vecFParams.at("NUM_CATEGORY")[m_stParamsA.boardId];
+    initImageQuality();
+
+    //原始Bayer输入: 相机不做去马赛克, 定位用分箱灰度图, 只对镜片区域转彩色
+    auto itrBayer = m_stParamsB.strParams.find("RAW_BAYER_PIXEL_FORMAT");
+    m_bayerPattern = (itrBayer == m_stParamsB.strParams.end()) ? BayerPattern::NONE : getBayerPattern(itrBayer->second);
 
-    if(m_sProductName != m_stParamsA.sProductName)
+    //进程内共享任务池, 各工位共用, 第一个初始化的工位按配置启动
+    vector<int> vCpuIds;
+    auto itrCpuIds = m_stParamsB.vecFParams.find("TASK_POOL_CPU_IDS");
+    if(itrCpuIds != m_stParamsB.vecFParams.end())
+    {
+        vCpuIds.assign(itrCpuIds->second.begin(), itrCpuIds->second.end());
+    }
+    TaskPool::instance().start(getFloatParam("TASK_POOL_THREAD_NUM", 0), vCpuIds);
+    //原始检测结果缓存(测试运行和阈值扫描), 0-不缓存
+    RawDetectionCache::instance().setCapacity(getFloatParam("RAW_DETECTION_CACHE_SIZE", 0));
+
+    //每次init都是新实例(见XJAppAlgorithm::init), 模型按路径在推理服务中共享, 不会重复加载
+    m_roiOffsetX = m_stParamsB.vecFParams.at("ROI_OFFSET_X")[m_stParamsA.boardId];//此处为取像roi
+    m_roiOffsetY = m_stParamsB.vecFParams.at("ROI_OFFSET_Y")[m_stParamsA.boardId];
+    m_roiWidth = m_stParamsB.vecFParams.at("ROI_WIDTH")[m_stParamsA.boardId];
+    m_roiHeight = m_stParamsB.vecFParams.at("ROI_HEIGHT")[m_stParamsA.boardId];
+
+    //传统
+    //检测物性
+    m_isCheckWuxing = m_stParamsB.vecFParams.at("IS_CHECK_WUXING")[m_stParamsA.boardId];
+    m_wuxingWidth = m_stParamsB.vecFParams.at("WUXING_X")[m_stParamsA.boardId];
+    m_wuxingHeight = m_stParamsB.vecFParams.at("WUXING_Y")[m_stParamsA.boardId];
+
+    //按拍照次数建立检测路由: 模型、切图方案
+    if(!initInspectRoutes(numCategory))
     {
-        const int inputWidth = TARGET_SIZE;
-        const int inputHeight = TARGET_SIZE;
-        const int inputChannel = 3;
+        cout << "board[" << m_stParamsA.boardId << "] failed to initial model!!!" << endl;
+        return false;
+    }
 
-        m_roiOffsetX = m_stParamsB.vecFParams.at("ROI_OFFSET_X")[m_stParamsA.boardId];//此处为取像roi
-        m_roiOffsetY = m_stParamsB.vecFParams.at("ROI_OFFSET_Y")[m_stParamsA.boardId];
-        m_roiWidth = m_stParamsB.vecFParams.at("ROI_WIDTH")[m_stParamsA.boardId];
-        m_roiHeight = m_stParamsB.vecFParams.at("ROI_HEIGHT")[m_stParamsA.boardId];
+    //开关、区域半径、阈值表、禁用类别和保存策略编译为检测方案
+    if(!initInspectPlan(numCategory))
+    {
+        cout << "board[" << m_stParamsA.boardId << "] failed to initial inspect plan!!!" << endl;
+        return false;
+    }
 
-        //传统
-        //检测物性
-        m_isCheckWuxing = m_stParamsB.vecFParams.at("IS_CHECK_WUXING")[m_stParamsA.boardId];
-        m_wuxingWidth = m_stParamsB.vecFParams.at("WUXING_X")[m_stParamsA.boardId];
-        m_wuxingHeight = m_stParamsB.vecFParams.at("WUXING_Y")[m_stParamsA.boardId];
+    if(!initGoldenTemplate())
+    {
+        cout << "board[" << m_stParamsA.boardId << "] failed to initial golden template!!!" << endl;
+        return false;
+    }
 
-        // m_vDisableDefectType = m_stParamsB.vecFParams.at("DISABLE_DEFECT_TYPE_DET_CAM" +  to_string(m_stParamsA.boardId + 1));
+    //影子评估在其它参数都就绪后建立, 候选实例拷贝本实例
+    initShadow(numCategory);
+    return true;
+}
 
-        m_vMinDefectArea.clear();
-        m_vMinDefectProb.clear();
-        m_vMinDefectDiag.clear();
-        m_vMinDefectProb_C.clear();
-        m_vMinDefectArea_C.clear();
-        m_vMinDefectDiag_C.clear();
-        m_vMinDefectProb_NC.clear();
-        m_vMinDefectArea_NC.clear();
-        m_vMinDefectDiag_NC.clear();
-        m_vDisableDefectType.clear();
-        
-        m_maxBatchSize = m_stParamsB.vecFParams.at("MAX_BATCH_SIZE")[m_stParamsA.boardId];
-        const float NmsThresh = m_stParamsB.vecFParams.at("MNS_THRESHOLD")[m_stParamsA.boardId];
-        const float ConfThresh = m_stParamsB.vecFParams.at("CONF_THRESHOLD")[m_stParamsA.boardId];
-        const string model_path = m_stParamsB.strParams.at("MODEL_PATH_CAM" +  to_string(m_stParamsA.boardId + 1));
+//只影响检测方案的参数: 修改后只需重新编译检测方案
+static bool isPlanParam(const string &sKey)
+{
+    static const vector<string> vPlanKeys = {"IS_DEBUG", "IS_SAVE_PROCESS_IMAGE", "IS_USE_MODEL_CONFIG", "is_board"};
+    static const vector<string> vPlanPrefixes = {"DEFECT_MIN_", "INSPECT_", "DARK_FIELD_MASK_RADIUS"};
+    if(std::find(vPlanKeys.begin(), vPlanKeys.end(), sKey) != vPlanKeys.end())
+    {
+        return true;
+    }
+    for(const auto &sPrefix : vPlanPrefixes)
+    {
+        if(sKey.compare(0, sPrefix.size(), sPrefix) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
 
-        //YOLOV8
-        const int maskThr = m_stParamsB.vecFParams.at("MASK_THR")[m_stParamsA.boardId]; 
-        const int detbox_num = inputWidth * inputHeight / 32 / 32 * 21; //yolo标准式可化简为：w*h/32/32*(4*4+2*2+1*1)
-        //YOLOV8
+//两组参数除检测方案参数外是否相同
+template <typename T>
+static bool isSameExceptPlanParams(const map<string, T> &mapParams1, const map<string, T> &mapParams2)
+{
+    auto itr1 = mapParams1.begin();
+    auto itr2 = mapParams2.begin();
+    while(true)
+    {
+        while(itr1 != mapParams1.end() && isPlanParam(itr1->first)) ++itr1;
+        while(itr2 != mapParams2.end() && isPlanParam(itr2->first)) ++itr2;
+        if(itr1 == mapParams1.end() || itr2 == mapParams2.end())
+        {
+            return itr1 == mapParams1.end() && itr2 == mapParams2.end();
+        }
+        if(itr1->first != itr2->first || itr1->second != itr2->second)
+        {
+            return false;
+        }
+        ++itr1;
+        ++itr2;
+    }
+}
+
+bool XJAlgorithm::isPlanParamsOnlyChanged(const stConfigParamsA &stParamsA, const stConfigParamsB &stParamsB) const
+{
+    //UI瑕疵参数(fParams)中只有类别开关参与检测, 保存方式、批次和保存句柄随方案更新;
+    //产品名只用于图片命名和模板键值, 换产时模型不变则同样热更新
+    if(stParamsA.runStatus != m_stParamsA.runStatus || stParamsA.viewId != m_stParamsA.viewId ||
+       stParamsA.boardId != m_stParamsA.boardId || stParamsA.numTargetInView != m_stParamsA.numTargetInView || stParamsA.mapBox != m_stParamsA.mapBox)
+    {
+        return false;
+    }
+    return stParamsB.strParams == m_stParamsB.strParams && stParamsB.vCameraNames == m_stParamsB.vCameraNames &&
+           isSameExceptPlanParams(stParamsB.fParams, m_stParamsB.fParams) && isSameExceptPlanParams(stParamsB.vecFParams, m_stParamsB.vecFParams);
+}
+
+bool XJAlgorithm::updateParams(const stConfigParamsA &stParamsA, const stConfigParamsB &stParamsB)
+{
+    if(m_vRoutes.empty() || !isPlanParamsOnlyChanged(stParamsA, stParamsB))
+    {
+        return false;
+    }
+    m_stParamsA = stParamsA;
+    m_stParamsB = stParamsB;
+    if(!initInspectPlan(m_stParamsB.vecFParams.at("NUM_CATEGORY")[m_stParamsA.boardId]))
+    {
+        return false;
+    }
+
+    //影子实例同步新的检测方案, 候选模型路由沿用, 不重新加载
+    if(m_pShadow != nullptr)
+    {
+        shared_ptr<XJAlgorithm> pShadow = make_shared<XJAlgorithm>(*this);
+        pShadow->m_pShadow = nullptr;
+        pShadow->m_vRoutes = m_pShadow->m_vRoutes;
+        m_pShadow = pShadow;
+    }
+    return true;
+}
+vector<vector<int>> XJAlgorithm::detectAnalyze(const Mat &image, Mat &processedImage, const int productCount, const int nCaptureTimes, vector<stDefectInfo> &vDefects) const
+{
+    vector<stLensResult> vLenses = detectAnalyzeLenses(image, productCount, nCaptureTimes, 1);
+    processedImage = vLenses[0].processedImage;
+    vDefects = std::move(vLenses[0].vDefects);
+    return vLenses[0].vResult;
+}
 
-        if(m_stParamsB.fParams.at("IS_USE_MODEL_CONFIG"))   //? 此处没有执行
+vector<stLensResult> XJAlgorithm::detectAnalyzeLenses(const Mat &image, const int productCount, const int nCaptureTimes, const int maxLenses) const
+{
+    vector<stLensResult> vLenses = detectLenses(image, productCount, nCaptureTimes, std::max(1, maxLenses));
+    for(auto &lens : vLenses)
+    {
+        //结果图为空时补齐: 整帧结果用整帧, 多片镜片时用镜片区域
+        if(lens.processedImage.empty())
         {
-            string json_path = model_path;
-            string tmp = ".engine";
-            json_path = json_path.replace(json_path.find(tmp), tmp.length(), ".json");
+            const Rect region = (vLenses.size() == 1 || lens.box.area() == 0) ? Rect(0, 0, image.cols, image.rows) : lens.box;
+            if(isRawBayer(image))
+            {
+                demosaicBayerROI(image, region, m_bayerPattern, lens.processedImage);
+            }
+            else
+            {
+                lens.processedImage = image(region).clone();
+            }
+        }
 
-            ifstream ifs(json_path, std::ios_base::in);
-            ptree rootNode;
-            vector<float> vTest1, vTest2;
-            read_json(ifs, rootNode);
-            for(ptree::iterator itr=rootNode.begin();itr!=rootNode.end();++itr)
+        //没有位置信息的结果(定位失败、印刷比对等)补充为空框瑕疵, 保证与defectResult一一对应
+        map<int, int> mapNumBoxes;
+        for(const auto &defect : lens.vDefects)
+        {
+            mapNumBoxes[defect.type]++;
+        }
+        for(const auto &vResult : lens.vResult)
+        {
+            for(const auto &type : vResult)
             {
-                string sKey = itr->first;   //itr->first获取当前元素的键，itr->second获取当前元素的值
-                if(sKey == "MIN_PROB")
-                {   
-                    for(const auto &it : rootNode.get_child(sKey)) //it为常量引用，表示不能修改其指向的内容；auto表示编译器自动推断it类型
-                    {
-                        m_vMinDefectProb.emplace_back(it.second.get_value<float>());
-                    }
-                }
-                else if(sKey == "MIN_AREA")
+                if(mapNumBoxes[type] > 0)
                 {
-                    for(const auto &it : rootNode.get_child(sKey))
-                    {
-                        m_vMinDefectArea.emplace_back(it.second.get_value<float>());
-                    }
+                    mapNumBoxes[type]--;
+                    continue;
                 }
+                stDefectInfo defect;
+                defect.type = type;
+                lens.vDefects.emplace_back(defect);
             }
         }
-        else    //此处执行
+        for(auto &defect : lens.vDefects)
         {
-            //中心区center
-            m_vMinDefectProb_C = m_stParamsB.vecFParams.at("DEFECT_MIN_PROB_CAM_C" + to_string(m_stParamsA.boardId + 1));
-            m_vMinDefectArea_C = m_stParamsB.vecFParams.at("DEFECT_MIN_AREA_CAM_C" + to_string(m_stParamsA.boardId + 1));
-            m_vMinDefectDiag_C = m_stParamsB.vecFParams.at("DEFECT_MIN_DIAG_CAM_C" + to_string(m_stParamsA.boardId + 1));
-            //非中心区not center
-            m_vMinDefectProb_NC = m_stParamsB.vecFParams.at("DEFECT_MIN_PROB_CAM_NC" + to_string(m_stParamsA.boardId + 1));
-            m_vMinDefectArea_NC = m_stParamsB.vecFParams.at("DEFECT_MIN_AREA_CAM_NC" + to_string(m_stParamsA.boardId + 1));
-            m_vMinDefectDiag_NC = m_stParamsB.vecFParams.at("DEFECT_MIN_DIAG_CAM_NC" + to_string(m_stParamsA.boardId + 1));
+            defect.nCaptureTimes = nCaptureTimes;
         }
+    }
 
-        // m_tensortRtInfer = make_shared<xj::TensorrtEngineBase>();
-        m_tensorrtYoloDL = make_shared<YoloClassifier>(model_path, YoloOutputType::DETECTION, m_maxBatchSize, numCategory, inputWidth, inputHeight, inputChannel);
-        
-        //if(m_stParamsA.boardId==200)
-        //{m_tensortRtInfer->setDetParameters(model_path, inputWidth, inputHeight, inputChannel, m_maxBatchSize, NmsThresh, ConfThresh);}
-        //else
-        //{m_tensortRtInfer->setYolo8Parameters(model_path, inputWidth, inputHeight, inputChannel, numCategory, m_maxBatchSize, NmsThresh, ConfThresh);}
-        m_tensorrtYoloDL->setInferParameters(ConfThresh, NmsThresh, maskThr, SEG_SCALEFACTOR, SEG_CHANNELS, detbox_num);
-
-        // if(m_stParamsA.boardId==200)
-        // {
-        //     // cout << "cam: " << m_stParamsA.boardId << "\t加载yolo5模型" << endl;
-        //     if(!m_tensortRtInfer->loadDetModel())
-        //     {
-        //         cout << "board[" << m_stParamsA.boardId << "] failed to initial model!!!" << endl;
-        //         return false;
-        //     }
-        // }
-        // else
-        // {
-        //     // cout << "cam: " << m_stParamsA.boardId << "\t加载yolo8模型" << endl;
-        //     if(!m_tensortRtInfer->loadYolo8Model())
-        //     {
-        //         cout << "board[" << m_stParamsA.boardId << "] failed to initial model!!!" << endl;
-        //         return false;
-        //     }
-        // }
-        if(!m_tensorrtYoloDL->loadModel())
-        {
-            cout << "board[" << m_stParamsA.boardId << "] failed to initial model!!!" << endl;
-            return false;
-        }
+    if(m_pShadow != nullptr)
+    {
+        submitShadow(image, productCount, nCaptureTimes, std::max(1, maxLenses), vLenses);
     }
-    return true;
+    return vLenses;
 }
-vector<vector<int>> XJAlgorithm::detectAnalyze(const Mat &image, Mat &processedImage, const int productCount, const int nCaptureTimes)
+
+//单片镜片定位后的检测中间结果, 各镜片需要DL的小图合并成一批推理
+struct stLensJob
 {
-    processedImage = image.clone();
+    bool bIsInspect = false;    //定位后的检查(切图、物性等)通过, 需要合并DL结果
+    int maskW = 0;
+    int maskH = 0;
+    Point center;
+    Mat roiImage;               //屏蔽背景后的镜片图, 瑕疵框画在上面
+    vector<Rect> vTargetRect;
+    vector<Mat> vTargetImage;
+    string sGoldenKey;
+    string sGoldenPath;
+    bool bIsCharacterOK = true;
+    bool bIsTiaoxingmaOK = true;
+    bool bIsLogoOK = true;
+    vector<stDrawBox> vCharacterBoxes;
+    vector<stDrawBox> vTiaoxingmaBoxes;
+    vector<stDrawBox> vLogoBoxes;
+};
+
+//定位前返回的整帧结果记为一片镜片的固定结果
+//调试图按工位、产品和线程区分文件名, 多个流水线线程同时检测时不互相覆盖
+static string getDebugImagePath(const int boardId, const string &sProductName, const string &sName)
+{
+    ostringstream oss;
+    oss << "debug_board" << boardId << "_" << sProductName << "_" << this_thread::get_id() << "_" << sName << ".png";
+    return oss.str();
+}
+
+static void recordFrameResult(const stLensResult &lens, stRawFrame *pRaw)
+{
+    if(pRaw != nullptr)
+    {
+        pRaw->vLenses.assign(1, stRawLens());
+        pRaw->vLenses[0].vFixedDefects = lens.vResult[0];
+    }
+}
+
+vector<stLensResult> XJAlgorithm::detectLenses(const Mat &image, const int productCount, const int nCaptureTimes, const int maxLenses, stRawFrame *pRaw) const
+{
+    //原始Bayer图不整帧去马赛克, 定位失败等整帧结果图在detectAnalyzeLenses中补齐
+    const bool bIsRawBayer = isRawBayer(image);
     int result = (int)DefectType::good; //1?
     //defectResult是行数为m_stParamsA.numTargetInView的二维向量，每一行初始化为vector<int>()，存储缺陷结果
-    vector<vector<int>> defectResult(m_stParamsA.numTargetInView, vector<int>());
+    //定位前返回的是整帧结果, 只有一片
+    vector<stLensResult> vLenses(1);
+    vLenses[0].vResult.assign(m_stParamsA.numTargetInView, vector<int>());
     if(nCaptureTimes == (int)CaptureImageTimes::UNKNOWN_TIMES)
     {
         result = (int)DefectType::defect1;
-        defectResult[0].emplace_back(result);
-        return defectResult;
+        vLenses[0].vResult[0].emplace_back(result);
+        recordFrameResult(vLenses[0], pRaw);
+        return vLenses;
     }
     // if(!(m_stParamsA.boardId==0||m_stParamsA.boardId==1)){return defectResult;}
-    vector<float> is_board = m_stParamsB.vecFParams.at("is_board");
-    if(m_stParamsA.boardId == is_board[0] || m_stParamsA.boardId == is_board[1] || m_stParamsA.boardId == is_board[2]){return defectResult;}
+    //检测方案整帧只取一次, 之后按下标读取开关和阈值
+    shared_ptr<const stInspectPlan> pPlan = m_pPlan;
+    const stInspectPlan &plan = *pPlan;
+    if(plan.bIsSkipBoard){return vLenses;}
+    shared_ptr<stInspectRoute> pRoute = getInspectRoute(nCaptureTimes);
+    const stThresholdTable *pThresholds = plan.getThresholds(nCaptureTimes);
+    if(pRoute == nullptr || pThresholds == nullptr)
+    {
+        cout << "[ERROR] board[" << m_stParamsA.boardId << "] no inspect route for capture " << nCaptureTimes << endl;
+        result = (int)DefectType::defect1;
+        vLenses[0].vResult[0].emplace_back(result);
+        recordFrameResult(vLenses[0], pRaw);
+        return vLenses;
+    }
     //step1: locate box
-    Rect roiRect;
-    if(!locateBox(image, roiRect, nCaptureTimes)) //当定位失败时，result被强制为defect1=2
+    vector<Rect> vBoxes;
+    if(!locateBoxes(image, vBoxes, nCaptureTimes, maxLenses)) //当定位失败时，result被强制为defect1=2
     {
         cout << "[ERROR] locateBox" << endl; 
         result = (int)DefectType::defect1;
-        defectResult[0].emplace_back(result);
+        vLenses[0].vResult[0].emplace_back(result);
         // imwrite("locateBox.png", image);
-        if(1)
+        recordFrameResult(vLenses[0], pRaw);
+        if(pRaw == nullptr)
         {
             string sFilePath = "/opt/history/temp";         
             string sCustomerEnd = "locateBox" + m_stParamsB.vCameraNames[m_stParamsA.boardId];
             string sFileName = getAppFormatImageNameByCurrentTimeXJ(1, m_stParamsA.boardId, 0, 0, m_stParamsA.sProductName, m_stParamsA.sProductLot, sCustomerEnd);
-            m_stParamsA.pSaveImageMultiThread->AddImageData(processedImage, sFilePath, sFileName, ".png");
-        }
-        return defectResult;
-    }
-    Mat roiImage = image(roiRect);
-
-    // Mat roiImage = image.clone();
-
-    //step2: detect defect by cv
-
-    //STEP1：定义一个空的掩膜图,对应光学区/非光学区
-    int maskW1 = roiImage.cols;
-    int maskH1 = roiImage.rows;
-    // cv::Mat mask1 = cv::Mat::zeros(maskH1, maskW1, CV_8UC1);
-    // cv::Mat mask2 = mask1.clone();  //
-    cv::Point center(maskW1/2, maskH1/2);
-    int radius1 = 420;
-    // cv::circle(mask1, center1, radius1, cv::Scalar(255), -1);
-
-    //STEP2：定义一个空的掩膜图,对应前景区/背景区
-    cv::Mat mask2 = cv::Mat::zeros(maskH1, maskW1, CV_8UC1);  //CV_8UC1：8位单通道图像
-    // cv::Point center2 = center1;
-    int radius2 = 1280;     //留了一点点背景区
-    cv::circle(mask2, center, radius2, cv::Scalar(255), -1);
-    // imwrite("/opt/test/mask2.png", mask2);
-    // imwrite("/opt/test/roiImage.png", roiImage);
-    //STEP3: 屏蔽背景区域,用mask2和输入图片做bitwise_and
-    cv::Mat roiImage_;
-    cv::bitwise_and(roiImage, roiImage, roiImage_, mask2);
-    // roiImage.copyTo(roiImage_,mask2);
-    // imwrite("/opt/test/roiImage_.png", roiImage_);
-
-    // 红光暗场屏蔽区域
-    if(nCaptureTimes == 2 && m_stParamsA.boardId == 0)
-    // if(m_stParamsA.boardId == 1)
-    {
-        int radius3 = 1100;
-        cv::Mat mask3 = cv::Mat::ones(maskH1, maskW1, CV_8UC1);  //CV_8UC1：8位单通道图像
-        cv::circle(mask3, center, radius3, cv::Scalar(0), -1);
-        cv::Mat dst;
-        roiImage_.copyTo(dst,mask3);
-        roiImage_ = dst.clone();
-    }
-
-    //step3:split ROI 
-    vector<Rect> vTargetRect;
-    vector<Mat> vTargetImage;
-    if(!extractROI(roiImage_, roiRect, vTargetRect, vTargetImage))
+            m_stParamsA.pSaveImageMultiThread->AddImageData(bIsRawBayer ? image : image.clone(), sFilePath, sFileName, ".png");
+        }
+        return vLenses;
+    }
+
+    const int numLenses = vBoxes.size();
+    vLenses.assign(numLenses, stLensResult());
+    //任务组中的印刷比对任务引用各镜片的stLensJob, 数量固定后不再改变
+    vector<stLensJob> vJobs(numLenses);
+    vector<pair<int, int>> vBatchIndex;  //<镜片, 小图>
+    TaskGroup printMarkGroup;
+    for(int lensIdx = 0; lensIdx != numLenses; ++lensIdx)
     {
-        cout << "ERROR extractROI" << endl; 
-        result = (int)DefectType::defect1;
-        defectResult[0].emplace_back(result);
-        imwrite("extractROI.png", roiImage);
-        return defectResult;
+        stLensResult &lens = vLenses[lensIdx];
+        stLensJob &job = vJobs[lensIdx];
+        const Rect &roiRect = vBoxes[lensIdx];
+        vector<vector<int>> &defectResult = lens.vResult;
+        lens.box = roiRect;
+        defectResult.assign(m_stParamsA.numTargetInView, vector<int>());
+
+        Mat roiImage;
+        if(!bIsRawBayer)
+        {
+            roiImage = image(roiRect);
+        }
+        else if(!demosaicBayerROI(image, roiRect, m_bayerPattern, roiImage))
+        {
+            cout << "[ERROR] board[" << m_stParamsA.boardId << "] demosaic roi failed" << endl;
+            result = (int)DefectType::defect1;
+            defectResult[0].emplace_back(result);
+            continue;
+        }
+
+        // Mat roiImage = image.clone();
+
+        //step2: detect defect by cv
+
+        //STEP1：定义一个空的掩膜图,对应光学区/非光学区
+        job.maskW = roiImage.cols;
+        job.maskH = roiImage.rows;
+        // cv::Mat mask1 = cv::Mat::zeros(maskH1, maskW1, CV_8UC1);
+        // cv::Mat mask2 = mask1.clone();  //
+        job.center = Point(job.maskW/2, job.maskH/2);
+        // cv::circle(mask1, center1, radius1, cv::Scalar(255), -1);
+
+        //STEP2：定义一个空的掩膜图,对应前景区/背景区
+        cv::Mat mask2 = cv::Mat::zeros(job.maskH, job.maskW, CV_8UC1);  //CV_8UC1：8位单通道图像
+        // cv::Point center2 = center1;
+        cv::circle(mask2, job.center, plan.foregroundRadius, cv::Scalar(255), -1);
+        // imwrite("/opt/test/mask2.png", mask2);
+        // imwrite("/opt/test/roiImage.png", roiImage);
+        //STEP3: 屏蔽背景区域,用mask2和输入图片做bitwise_and
+        cv::bitwise_and(roiImage, roiImage, job.roiImage, mask2);
+        // roiImage.copyTo(roiImage_,mask2);
+        // imwrite("/opt/test/roiImage_.png", roiImage_);
+
+        // 红光暗场屏蔽区域, 半径按工位和拍照次数配置(DARK_FIELD_MASK_RADIUS)
+        const int radius3 = plan.getDarkFieldRadius(nCaptureTimes);
+        if(radius3 > 0)
+        {
+            cv::Mat mask3 = cv::Mat::ones(job.maskH, job.maskW, CV_8UC1);  //CV_8UC1：8位单通道图像
+            cv::circle(mask3, job.center, radius3, cv::Scalar(0), -1);
+            cv::Mat dst;
+            job.roiImage.copyTo(dst,mask3);
+            job.roiImage = dst.clone();
+        }
+
+        //step3:split ROI 
+        if(!extractROI(job.roiImage, roiRect, pRoute->numTargetX, pRoute->numTargetY, job.vTargetRect, job.vTargetImage))
+        {
+            cout << "ERROR extractROI" << endl; 
+            result = (int)DefectType::defect1;
+            defectResult[0].emplace_back(result);
+            if(plan.bIsDebug)
+            {
+                imwrite(getDebugImagePath(m_stParamsA.boardId, m_stParamsA.sProductName, "extractROI"), roiImage);
+            }
+            continue;
+        }
+
+        //step2.1: 传统检测物性
+        if (m_isCheckWuxing == 1 && !checkWuxing(roiRect)){
+            // cout << "传统检测物性" <<endl;
+            result = (int)DefectType::defect10;
+            defectResult[0].emplace_back(result);
+            continue;
+        }
+
+        //step2.2: 金样模板比对, 模板未建好前照常走DL并累计良品
+        job.sGoldenKey = m_stParamsA.sProductName + "_B" + to_string(m_stParamsA.boardId) + "_P" + to_string(nCaptureTimes);
+        job.sGoldenPath = m_sGoldenTemplatePath.empty() ? "" : (m_sGoldenTemplatePath + "/" + job.sGoldenKey + ".yml.gz");
+        vector<bool> vIsNeedDL(job.vTargetImage.size(), true);
+        if(m_goldenTemplateMode > 0)
+        {
+            shared_ptr<const GoldenTemplate> pGolden = GoldenTemplateManager::instance().get(job.sGoldenKey, job.sGoldenPath, m_stGoldenParams);
+            vector<stGoldenBlob> vBlobs;
+            if(pGolden && pGolden->compare(job.roiImage, vBlobs))
+            {
+                for(size_t i = 0; i != job.vTargetRect.size(); ++i)
+                {
+                    //预筛: 只有与差分斑块相交的小图才需要DL
+                    vIsNeedDL[i] = false;
+                    for(const auto &blob : vBlobs)
+                    {
+                        if((job.vTargetRect[i] & blob.box).area() > 0)
+                        {
+                            vIsNeedDL[i] = (m_goldenTemplateMode == 1);
+                            break;
+                        }
+                    }
+                }
+
+                if(m_goldenTemplateMode == 2)
+                {
+                    for(const auto &blob : vBlobs)
+                    {
+                        result = m_goldenDefectType + 2;
+                        defectResult[0].emplace_back(result);
+                        stDefectInfo defect;
+                        defect.type = result;
+                        defect.box = blob.box;
+                        lens.vDefects.emplace_back(defect);
+                        rectangle(job.roiImage, blob.box, DRAW_NG_COLOR, 5, 8);
+                    }
+                }
+                if(plan.bIsDebug)
+                {
+                    cout << "board[" << m_stParamsA.boardId << "] golden template blobs: " << vBlobs.size() << endl;
+                }
+            }
+        }
+        //step3.1: 印刷图案(字符/条形码/logo)与模板比对, 只读job.roiImage, 提交任务池与DL并行执行, 结果在DL之后合并
+        if(plan.bIsCheckCharacter)
+        {
+            printMarkGroup.run([this, &job, &roiRect, nCaptureTimes]() { job.bIsCharacterOK = detectCharacter(job.roiImage, roiRect, job.vCharacterBoxes, nCaptureTimes); });
+        }
+        if(plan.bIsCheckTiaoxingma)
+        {
+            printMarkGroup.run([this, &job, &roiRect, nCaptureTimes]() { job.bIsTiaoxingmaOK = detectTiaoxingma(job.roiImage, roiRect, job.vTiaoxingmaBoxes, nCaptureTimes); });
+        }
+        if(plan.bIsCheckLogo)
+        {
+            printMarkGroup.run([this, &job, &roiRect, nCaptureTimes]() { job.bIsLogoOK = detectLogo(job.roiImage, roiRect, job.vLogoBoxes, nCaptureTimes); });
+        }
+
+        job.bIsInspect = true;
+        for (int i = 0; i < job.vTargetImage.size(); i++)
+        {
+            if(vIsNeedDL[i])
+            {
+                vBatchIndex.emplace_back(lensIdx, i);
+            }
+        }
     }
 
-    //step2.1: 传统检测物性
-    if (m_isCheckWuxing == 1 && !checkWuxing(roiRect)){
-        // cout << "传统检测物性" <<endl;
-        result = (int)DefectType::defect10;
-        defectResult[0].emplace_back(result);
-        return defectResult;
+    //原始检测结果: 阈值扫描时返回给调用者, 测试运行时缓存, 同一图像再次检测(如预览调阈值)不重新推理
+    stRawFrame rawFrame;
+    string sCacheKey;
+    shared_ptr<const stRawFrame> pCached;
+    if(pRaw == nullptr && m_stParamsA.runStatus != (int)RunStatus::PRODUCT_RUN && RawDetectionCache::instance().isEnabled())
+    {
+        sCacheKey = getRawCacheKey(image, nCaptureTimes, maxLenses, plan, *pRoute);
+        pCached = RawDetectionCache::instance().get(sCacheKey);
+        //金样预筛等导致需要DL的小图不同时不复用
+        if(pCached != nullptr && pCached->vTiles.size() != vBatchIndex.size())
+        {
+            pCached = nullptr;
+        }
+        for(size_t k = 0; pCached != nullptr && k < vBatchIndex.size(); k++)
+        {
+            if(pCached->vTiles[k].lensIdx != vBatchIndex[k].first || pCached->vTiles[k].tileIdx != vBatchIndex[k].second)
+            {
+                pCached = nullptr;
+            }
+        }
+    }
+    const bool bIsRecordRaw = (pRaw != nullptr) || (!sCacheKey.empty() && pCached == nullptr);
+    if(bIsRecordRaw)
+    {
+        rawFrame.vLenses.assign(numLenses, stRawLens());
+        for(int lensIdx = 0; lensIdx != numLenses; ++lensIdx)
+        {
+            stRawLens &rawLens = rawFrame.vLenses[lensIdx];
+            rawLens.maskSize = Size(vJobs[lensIdx].maskW, vJobs[lensIdx].maskH);
+            rawLens.center = vJobs[lensIdx].center;
+            rawLens.vFixedDefects = vLenses[lensIdx].vResult[0];
+        }
     }
 
+    //step4: get detect result by DL, 所有镜片需要DL的小图整批提交推理服务, 与其它工位的请求合批推理
+    vector<Mat> vBatchImage(vBatchIndex.size());
+    TaskPool::instance().parallelFor(0, vBatchIndex.size(), [&](int k)
+    {
+        stLensJob &job = vJobs[vBatchIndex[k].first];
+        const int i = vBatchIndex[k].second;
+        job.vTargetImage[i] = preprocessImage(job.vTargetImage[i]);
+        vBatchImage[k] = job.vTargetImage[i];
+    });
+    vector<vector<YoloOutputDetect>> vDetectOutput;
+    bool bIsInferOK = true;
+    if(pCached != nullptr)
+    {
+        for(const auto &tile : pCached->vTiles)
+        {
+            vDetectOutput.push_back(tile.vDetections);
+        }
+    }
+    else
+    {
+        bIsInferOK = pRoute->pExecutor->infer(m_stParamsA.boardId, vBatchImage, vDetectOutput);
+    }
+    rawFrame.bIsInferOK = bIsInferOK;
+    if(bIsRecordRaw && bIsInferOK)
+    {
+        rawFrame.vTiles.resize(vBatchIndex.size());
+        for(size_t k = 0; k < vBatchIndex.size(); k++)
+        {
+            stRawTile &rawTile = rawFrame.vTiles[k];
+            rawTile.lensIdx = vBatchIndex[k].first;
+            rawTile.tileIdx = vBatchIndex[k].second;
+            rawTile.rect = vJobs[rawTile.lensIdx].vTargetRect[rawTile.tileIdx];
+            rawTile.vDetections = vDetectOutput[k];
+        }
+    }
 
-    //step4: get detect result by DL
-    for (int i = 0; i < vTargetImage.size(); i++)   // 
+    //各小图后处理并行, 结果写入各自的stTileResult, 之后按镜片、小图顺序合并, 与串行结果一致
+    struct stTileResult
+    {
+        bool bIsOK;
+        int result;
+        vector<vector<int>> defectResult;
+        vector<stDefectInfo> vDefects;
+        vector<stDrawBox> vDrawBoxes;
+        vector<stDefectCandidate> vCandidates;
+    };
+    vector<stTileResult> vTileResults(vBatchIndex.size());
+    TaskPool::instance().parallelFor(0, vBatchIndex.size(), [&](int k)
     {
-        result = (int)DefectType::good;
-        if(!detectByDL(maskW1, maskH1, radius1, radius2, center, roiImage_, vTargetRect[i], vTargetImage[i], result, defectResult, processedImage))
+        const stLensJob &job = vJobs[vBatchIndex[k].first];
+        stTileResult &tile = vTileResults[k];
+        tile.result = (int)DefectType::good;
+        tile.defectResult.resize(1);
+        tile.bIsOK = bIsInferOK && detectByDL(plan, *pThresholds, job.maskW, job.maskH, job.center, job.vTargetRect[vBatchIndex[k].second], vDetectOutput[k], tile.result, tile.defectResult, tile.vDefects, tile.vDrawBoxes, tile.vCandidates);
+    });
+    printMarkGroup.wait();
+
+    //聚类类别的片段按镜片汇总, 小图都合并后再聚类判定
+    vector<vector<stDefectCandidate>> vLensCandidates(numLenses);
+    for (size_t k = 0; k < vBatchIndex.size(); k++)
+    {
+        const int lensIdx = vBatchIndex[k].first;
+        const int i = vBatchIndex[k].second;
+        stLensJob &job = vJobs[lensIdx];
+        vector<vector<int>> &defectResult = vLenses[lensIdx].vResult;
+        stTileResult &tile = vTileResults[k];
+        result = tile.result;
+        defectResult[0].insert(defectResult[0].end(), tile.defectResult[0].begin(), tile.defectResult[0].end());
+        vLenses[lensIdx].vDefects.insert(vLenses[lensIdx].vDefects.end(), tile.vDefects.begin(), tile.vDefects.end());
+        vLensCandidates[lensIdx].insert(vLensCandidates[lensIdx].end(), tile.vCandidates.begin(), tile.vCandidates.end());
+        for(const auto &drawBox : tile.vDrawBoxes)
+        {
+            rectangle(job.roiImage, drawBox.box, drawBox.color, drawBox.thickness, 8);
+        }
+        if(!tile.bIsOK)
         {
             result = (int)DefectType::defect1;
             defectResult[0].emplace_back(result);
         }
-        // cout << "defectResult----  " << i << "____" << defectResult[i].size() << endl;
 
-        for (size_t j = 0; j < defectResult[i].size() ; j++)
+        //step5: save image
+        if(pRaw == nullptr && plan.isSaveTile(result == (int)DefectType::good) && (m_pProcessImageSave == nullptr || m_pProcessImageSave->load()))
         {
-            cout  << "____" << defectResult[i][0] << endl;
+            string sFilePath = (result == (int)DefectType::good) ? OK_SOURCE_IMAGE_SAVE_PATH : NG_SOURCE_IMAGE_SAVE_PATH;         
+            string sCustomerEnd = "CNT" + to_string(productCount) + "-PIC" + to_string(nCaptureTimes) + (numLenses > 1 ? "-L" + to_string(lensIdx + 1) : "") + "_" + m_stParamsB.vCameraNames[m_stParamsA.boardId];
+            string sFileName = getAppFormatImageNameByCurrentTimeXJ(result, m_stParamsA.boardId, 0, i, m_stParamsA.sProductName, m_stParamsA.sProductLot, sCustomerEnd);
+            m_stParamsA.pSaveImageMultiThread->AddImageData(job.vTargetImage[i], sFilePath, sFileName, ".png");
         }
+    }  
 
-        //step5: save image
-        if(m_stParamsA.pSaveImageMultiThread && m_stParamsB.fParams.at("IS_SAVE_PROCESS_IMAGE"))
+    for(int lensIdx = 0; lensIdx != numLenses; ++lensIdx)
+    {
+        stLensJob &job = vJobs[lensIdx];
+        if(!job.bIsInspect)
         {
-            if(m_stParamsA.saveImageType == (int)SaveImageType::ALL || ((result != (int)DefectType::good) && m_stParamsA.saveImageType == (int)SaveImageType::NG_ONLY))
+            continue;
+        }
+        vector<vector<int>> &defectResult = vLenses[lensIdx].vResult;
+        //线伤/点伤等聚类类别: 跨小图合并片段后判定
+        vector<stDefectInfo> vClusterDefects;
+        judgeLensCandidates(plan, *pThresholds, vLensCandidates[lensIdx], vClusterDefects);
+        for(const auto &defect : vClusterDefects)
+        {
+            defectResult[0].emplace_back(defect.type);
+            rectangle(job.roiImage, defect.box, DRAW_NG_COLOR, 5, 8);
+        }
+        vLenses[lensIdx].vDefects.insert(vLenses[lensIdx].vDefects.end(), vClusterDefects.begin(), vClusterDefects.end());
+
+        //DL框画完后只拷贝一次结果图, 不再每个瑕疵拷贝整幅ROI
+        Mat &processedImage = vLenses[lensIdx].processedImage;
+        processedImage = job.roiImage.clone();
+
+        //印刷比对结果在DL之后合并, 顺序与串行检测一致
+        const bool vIsPrintMarkOK[] = {job.bIsCharacterOK, job.bIsTiaoxingmaOK, job.bIsLogoOK};
+        const vector<stDrawBox> *pPrintMarkBoxes[] = {&job.vCharacterBoxes, &job.vTiaoxingmaBoxes, &job.vLogoBoxes};
+        for(int i = 0; i != 3; ++i)
+        {
+            for(const auto &drawBox : *pPrintMarkBoxes[i])
             {
-                string sFilePath = (result == (int)DefectType::good) ? OK_SOURCE_IMAGE_SAVE_PATH : NG_SOURCE_IMAGE_SAVE_PATH;         
-                string sCustomerEnd = "CNT" + to_string(productCount) + "-PIC" + to_string(nCaptureTimes) + "_" + m_stParamsB.vCameraNames[m_stParamsA.boardId];
-                string sFileName = getAppFormatImageNameByCurrentTimeXJ(result, m_stParamsA.boardId, 0, i, m_stParamsA.sProductName, m_stParamsA.sProductLot, sCustomerEnd);
-                m_stParamsA.pSaveImageMultiThread->AddImageData(vTargetImage[i], sFilePath, sFileName, ".png");
+                rectangle(processedImage, drawBox.box, drawBox.color, drawBox.thickness, 8);
+            }
+            if(!vIsPrintMarkOK[i])
+            {
+                defectResult[0].emplace_back(m_goldenDefectType + 2);
+                if(bIsRecordRaw)
+                {
+                    rawFrame.vLenses[lensIdx].vFixedDefects.emplace_back(m_goldenDefectType + 2);
+                }
             }
         }
-    }  
-    //在roiImage上画圆，可视化区分中心区/非中心区
-    cv::circle(processedImage, center, radius1, Scalar(0, 255, 0), 2, cv::LINE_8);
+
+        //良品累计为金样样本, 满足数量后后台重建模板
+        if(pRaw == nullptr && m_goldenTemplateMode > 0 && defectResult[0].empty())
+        {
+            GoldenTemplateManager::instance().addSample(job.sGoldenKey, job.sGoldenPath, job.roiImage, m_stGoldenParams);
+        }
+
+        //在roiImage上画圆，可视化区分中心区/非中心区
+        cv::circle(processedImage, job.center, plan.centerRadius, Scalar(0, 255, 0), 2, cv::LINE_8);
+    }
 
     // for (int i = 0; i < vTargetRect.size(); i++)
     // {
     //     rectangle(processedImage, vTargetRect[i], Scalar(255, 255, 255), 5, 8); 
     // }  
-                      
-    return defectResult;
+
+    if(!sCacheKey.empty() && pCached == nullptr && bIsInferOK)
+    {
+        RawDetectionCache::instance().put(sCacheKey, make_shared<const stRawFrame>(rawFrame));
+    }
+    if(pRaw != nullptr)
+    {
+        *pRaw = std::move(rawFrame);
+    }
+    return vLenses;
 }
 
-bool XJAlgorithm::locateBox(const Mat& image, Rect &box, const int nCaptureTimes)
+bool XJAlgorithm::locateBoxes(const Mat& image, vector<Rect> &vBoxes, const int nCaptureTimes, const int maxLenses) const
 {
     Rect globalRC(0, 0, image.cols, image.rows);
-    Rect roiRC(m_roiOffsetX, m_roiOffsetX, m_roiWidth, m_roiHeight);
+    Rect roiRC(m_roiOffsetX, m_roiOffsetY, m_roiWidth, m_roiHeight);
     roiRC &= globalRC;
     if(roiRC.height<=0 || roiRC.width<=0)
     {
@@ -356,33 +736,35 @@ bool XJAlgorithm::locateBox(const Mat& image, Rect &box, const int nCaptureTimes
     //step1: preprocess
     // int thresholdValue  = m_stParamsB.fParams.at("BOX_BINARY_THRESHOLD");
     // int areaThreshold  = m_stParamsB.fParams.at("BOX_BINARY_AREA_THRESHOLD"); //大约2500*2500
-    int thresholdValue(5);
-    int areaThreshold(40000);
-    int thresh_binary;
-    if (nCaptureTimes == 1)
-    // if(m_stParamsA.boardId == 0 ||m_stParamsA.boardId == 2)
-    {  
-        thresholdValue = m_stParamsB.vecFParams.at("BOX_BINARY_THRESHOLD" + to_string(m_stParamsA.boardId + 1))[0];
-        areaThreshold  = m_stParamsB.vecFParams.at("BOX_BINARY_AREA_THRESHOLD" + to_string(m_stParamsA.boardId + 1))[0]; //大约2500*2500
-        thresh_binary = 1;  //
-    }
-    if(nCaptureTimes == 2)
-    // if(m_stParamsA.boardId == 1 ||m_stParamsA.boardId == 3)
-    {
-        thresholdValue = m_stParamsB.vecFParams.at("BOX_BINARY_THRESHOLD" + to_string(m_stParamsA.boardId + 1))[1];
-        areaThreshold  = m_stParamsB.vecFParams.at("BOX_BINARY_AREA_THRESHOLD" + to_string(m_stParamsA.boardId + 1))[1]; //大约2500*2500
-        thresh_binary = 0;
-    }
+    //二值化阈值来自检测方案(BOX_BINARY_THRESHOLD), 第一次拍照取反
+    const int thresholdValue = m_pPlan->getBoxBinaryThreshold(nCaptureTimes);
+    const int thresh_binary = (nCaptureTimes == (int)CaptureImageTimes::FIRST_TIMES) ? THRESH_BINARY_INV : THRESH_BINARY;
     //通过传统算法判断是4种图像中的哪种图像？根据判断结果设置BOX_BINARY_THRESHOLD和BOX_BINARY_AREA_THRESHOLD参数
 
 
+    //原始Bayer图在2x2分箱灰度图上定位, 结果坐标再放大回原图
     Mat grayImage, binaryImage;
-    cvtColor(roiImage, grayImage, COLOR_RGB2GRAY);
-    imwrite("grayImage.png", grayImage);
+    int binning = 1;
+    if(isRawBayer(image))
+    {
+        getBayerBinnedGray(roiImage, grayImage);
+        binning = 2;
+    }
+    else
+    {
+        cvtColor(roiImage, grayImage, COLOR_RGB2GRAY);
+    }
+    if(m_pPlan->bIsDebug)
+    {
+        imwrite(getDebugImagePath(m_stParamsA.boardId, m_stParamsA.sProductName, "grayImage"), grayImage);
+    }
     //blur(grayImage, grayImage, Size(3, 3));
     // threshold(grayImage, binaryImage, thresholdValue, 255, THRESH_BINARY_INV); //an 取反
     threshold(grayImage, binaryImage, thresholdValue, 255, thresh_binary); //an 取反
-    imwrite("binaryImage.png", binaryImage);
+    if(m_pPlan->bIsDebug)
+    {
+        imwrite(getDebugImagePath(m_stParamsA.boardId, m_stParamsA.sProductName, "binaryImage"), binaryImage);
+    }
 
     //step2: find contour
     vector<vector<Point>> contours;
@@ -392,49 +774,58 @@ bool XJAlgorithm::locateBox(const Mat& image, Rect &box, const int nCaptureTimes
         return false;
     }
 
-    Mat roiImage_ = roiImage.clone();
-    cout << "contours.size()___" << contours.size() << endl;
-    for (size_t i = 0; i < contours.size(); i++)
+    if(m_pPlan->bIsDebug)
     {
-        box = boundingRect(contours[i]);
-        rectangle(roiImage_, box, Scalar(0,255,255),4);
+        Mat roiImage_ = (binning == 1) ? roiImage.clone() : grayImage.clone();
+        for (size_t i = 0; i < contours.size(); i++)
+        {
+            const Rect box = boundingRect(contours[i]);
+            rectangle(roiImage_, box, Scalar(0,255,255),4);
+        }
+        // drawContours(roiImage_, contours, 936, Scalar(0,255,255), 4);
+        imwrite(getDebugImagePath(m_stParamsA.boardId, m_stParamsA.sProductName, "rectangle"), roiImage_);
     }
-    // drawContours(roiImage_, contours, 936, Scalar(0,255,255), 4);
-    imwrite("rectangle.png", roiImage_);
 
-    //step3: get max contour
-    int maxIdx = 0;
-    float maxArea = 0;
-    getMaxContour(contours, maxIdx, maxArea);
-    if(maxArea <= 0)
+    //step3: get lens contours, 只检测一片时取面积最大的轮廓
+    vector<int> vIdx;
+    if(!getLensContours(contours, maxLenses, vIdx, binning))
     {
         cout << "[ERROR] locateBox  maxArea<=0 " << endl;
         return false;
     }
 
-    //step4: get max bounding box and return result
-    box = boundingRect(contours[maxIdx]);
-    cout << "box.width:" << box.width << endl;
-    cout << "box.height:" << box.height << endl;
-
-    box.x += m_roiOffsetX;  //得到配置文件中的ROI_OFFSET_X=0
-    box.y += m_roiOffsetY;  //得到配置文件中的m_roiOffsetY=0
-
-    //step5: extend foreground ROI edge
-    box.x -= EXTEND_LENGTH; //左上角横坐标
-    box.y -= EXTEND_LENGTH; //左上角纵坐标
-    box.width += EXTEND_LENGTH * 2;
-    box.height += EXTEND_LENGTH * 2;
-    box &= globalRC;
-    if(box.height<=0 || box.width<=0)
+    vBoxes.clear();
+    for(const auto &idx : vIdx)
     {
-        return false;
+        //step4: get bounding box and return result
+        Rect box = boundingRect(contours[idx]);
+        box = Rect(box.x * binning, box.y * binning, box.width * binning, box.height * binning);
+
+        box.x += m_roiOffsetX;  //得到配置文件中的ROI_OFFSET_X=0
+        box.y += m_roiOffsetY;  //得到配置文件中的m_roiOffsetY=0
+
+        //step5: extend foreground ROI edge
+        box.x -= EXTEND_LENGTH; //左上角横坐标
+        box.y -= EXTEND_LENGTH; //左上角纵坐标
+        box.width += EXTEND_LENGTH * 2;
+        box.height += EXTEND_LENGTH * 2;
+        box &= globalRC;
+        if(box.height<=0 || box.width<=0)
+        {
+            return false;
+        }
+        vBoxes.emplace_back(box);
     }
 
     return true;
 }
 
-bool XJAlgorithm::checkWuxing(Rect &box)
+bool XJAlgorithm::isRawBayer(const Mat &image) const
+{
+    return m_bayerPattern != BayerPattern::NONE && image.channels() == 1;
+}
+
+bool XJAlgorithm::checkWuxing(const Rect &box) const
 {
     if (m_wuxingWidth < ((box.width-EXTEND_LENGTH*2)-40) || m_wuxingWidth > ((box.width-EXTEND_LENGTH*2)+40) || m_wuxingHeight < ((box.height-EXTEND_LENGTH*2)-40) || m_wuxingHeight > ((box.height-EXTEND_LENGTH*2)+40))
     {
@@ -448,10 +839,8 @@ bool XJAlgorithm::checkWuxing(Rect &box)
 }
 
 //split box to ROI
-bool XJAlgorithm::extractROI(const Mat &roiImage, const Rect &roiRect, vector<Rect> &vTargetRect, vector<Mat> &vTargetImage)
+bool XJAlgorithm::extractROI(const Mat &roiImage, const Rect &roiRect, const int numTargetX, const int numTargetY, vector<Rect> &vTargetRect, vector<Mat> &vTargetImage) const
 {
-    const int numTargetX = 5;
-    const int numTargetY = 5;
     const int width = roiImage.cols;
     const int height = roiImage.rows;
     const int targetSize = TARGET_SIZE;
@@ -483,231 +872,44 @@ bool XJAlgorithm::extractROI(const Mat &roiImage, const Rect &roiRect, vector<Re
 			}
 
             Rect targetRc = Rect(Point(left, top), Point(right, bot));
-            Mat targetImage = roiImage(targetRc).clone();
         
 			//fix coor in source image not roi region
 			// targetRc.x += roiRect.tl().x;
 			// targetRc.y += roiRect.tl().y;
 			vTargetRect.emplace_back(targetRc);
-            vTargetImage.emplace_back(targetImage);
         }
     }
+
+    //小图拷贝在任务池中并行
+    vTargetImage.resize(vTargetRect.size());
+    TaskPool::instance().parallelFor(0, vTargetRect.size(), [&](int i)
+    {
+        vTargetImage[i] = roiImage(vTargetRect[i]).clone();
+    });
     return true;
 }
 
-Mat XJAlgorithm::preprocessImage(const Mat &roiImage)
+Mat XJAlgorithm::preprocessImage(const Mat &roiImage) const
 {
     Mat targetImage = makeSquareImage(roiImage).clone();
     resize(targetImage, targetImage, Size(TARGET_SIZE, TARGET_SIZE));
     return targetImage;
 }
 
-// // add
-// //计算两个box之间的最小距离
-// int XJAlgorithm::calculateMinDistance(const cv::Rect& box1, const cv::Rect& box2)
-// {
-//     int dx = std::max(box1.x - (box2.x + box2.w), box2.x - (box1.x + box1.w));
-//     int dy = std::max(box1.y - (box2.y + box2.h), box2.y - (box1.y + box1.h));
-//     return std::max(dx, 0) + std::max(dy, 0); // 返回横向和纵向距离之和
-// }
-
-// // cv::Rect getRect() const {
-// //     return cv::Rect(x, y, w, h);
-// cv::Rect XJAlgorithm::getRect(cv::Rect& box){    //?
-//     return cv::Rect(x, y, w, h);
-// }
-
-// //判断两个box是否相交
-// bool XJAlgorithm::isIntersecting(const cv::Rect& box1, const cv::Rect& box2) {
-//     // return (box1.getRect() & box2.getRect()).area() > 0; // 使用 OpenCV 检查相交
-//     return (getRect(box1) & getRect(box2)).area() > 0;
-// }
-
-// // 计算相交的面积
-// int XJAlgorithm::calculateIntersectionArea(const cv::Rect& box1, const cv::Rect& box2) {
-//     // return (box1.getRect() & box2.getRect()).area();    return (getRect(box1) & getRect(box2)).area();
-// }
-
-// // 计算相并的面积
-// int XJAlgorithm::calculateUnionArea(const cv::Rect& box1, const cv::Rect& box2) {
-//     // return (box1.getRect() & box2.getRect()).area();
-//     return (getRect(box1) | getRect(box2)).area();
-// }
-
-// //
-// int XJAlgorithm::itrXianshang(std::vector<cv::Rect>& boxes, float& diagLXianshang) 
-// {
-    
-//     // 遍历所有 box，计算相近边的最小距离和相交情况
-//     for (size_t i = 0; i < boxes.size(); ++i) {
-//         for (size_t j = i + 1; j < boxes.size(); ++j) {
-            
-//             const Box& box1 = boxes[i];
-//             const Box& box2 = boxes[j];
-
-//             // 计算最小距离
-//             int minDistance = calculateMinDistance(box1, box2);
-//             std::cout << "Box " << i << " 和 Box " << j << " 之间的最小距离: " << minDistance << std::endl;
-//             if (minDistance < 20){
-//                 float diagLi = std::sqrt(boxes[i].width*boxes[i].width + boxes[i].height*boxes[i].height);
-//                 float diagLj = std::sqrt(boxes[j].width*boxes[j].width + boxes[j].height*boxes[j].height);
-//                 diagLXianshang = diagLXianshang + diagLi + diagLj;
-//             }
-
-//             // 判断是否相交
-//             if (isIntersecting(box1, box2)) {
-//                 int intersectionArea = calculateIntersectionArea(box1, box2);
-//                 int unionArea = calculateUnionArea(box1, box2);
-//                 if ((intersectionArea/unionArea) > 0.01){   //交并比
-//                     float diagLi = std::sqrt(boxes[i].width*boxes[i].width + boxes[i].height*boxes[i].height);
-//                     float diagLj = std::sqrt(boxes[j].width*boxes[j].width + boxes[j].height*boxes[j].height);
-//                     diagLXianshang = diagLXianshang + diagLi + diagLj;
-//                 }
-//                 std::cout << "Box " << i << " 和 Box " << j << " 相交，交集面积: " << intersectionArea << std::endl;
-//                 if 
-//             } else {
-//                 std::cout << "Box " << i << " 和 Box " << j << " 不相交。" << std::endl;
-//             }
-//         }
-//     }
-
-//     return 0;
-// }
-// // add
-
 // bool XJAlgorithm::detectByDL(Mat &roiImage, const Rect &roiRect, Mat &targetImage, int &result, vector<vector<int>> &defectResult, Mat &processedImage)
-bool XJAlgorithm::detectByDL(int &maskW1, int &maskH1, int &radius1, int &radius2, cv::Point &center1, cv::Mat &roiImage, const cv::Rect &roiRect, cv::Mat &targetImage, int &result, std::vector<std::vector<int>> &defectResult, cv::Mat &processedImage)
-{
-    processedImage = roiImage.clone();
-    //step1:pre-process
-    vector<Mat> images;
-    vector<Rect> roiRect_;
-    vector<vector<YoloOutputDetect>> detectionOutput;
-    targetImage = preprocessImage(targetImage);
-    // Mat targetImage_ = imread("bad.png");
-    images.push_back(targetImage);
-    roiRect_.push_back(roiRect);
-    
-    //step2:detect by DL
-    // vector<vector<Detection>> vResult;
-	// cout<<"images.size():  "<< images.size() <<endl;
-    m_tensorrtYoloDL->getDetectionResult(images, detectionOutput);  
-
-    // step3:post-process
-    // float scale = std::max(roiImage.rows, roiImage.cols) / (float)TARGET_SIZE;  //归一化系数
-	// cout<<"detectionOutput.size():  "<< detectionOutput.size() <<endl;
-
-    int numDianshang = 0;
-    std::vector<cv::Rect> boxesDianshang;
-
-    for	(int j=0; j<detectionOutput.size(); j++) {
-		Rect box;
-		int objectId;
-		float confidences;
-		float tempS;
-        float diagL;
-        
-        // float diagXianshang = 0;
-        // cv::Mat maskXianshang = cv::Mat::zeros(640, 640, CV_8UC1);
-
-        int numXianshang = 0;
-        std::vector<cv::Rect> boxesXianshang;
-        // float diagLXianshang;
-
-	    // cout<<"detectionOutput.at(j).size():  "<< detectionOutput.at(j).size() <<endl;
-		for	(int i=0; i<detectionOutput.at(j).size(); i++) {
-            YoloOutputDetect &det = detectionOutput[j][i];
-			objectId = detectionOutput.at(j).at(i).id;
-			// cout<<"objectId " << objectId<<endl;
-
-			box.x = int(detectionOutput.at(j).at(i).box.x + roiRect.x);    //相对扣图的坐标
-			box.y = int(detectionOutput.at(j).at(i).box.y + roiRect.y);    //相对扣图的坐标
-			box.width = int(detectionOutput.at(j).at(i).box.width);
-			box.height = int(detectionOutput.at(j).at(i).box.height);
-
-			//tempS = box.width*box.width*m_fPPS*m_fPPS + box.height*box.height*m_fPPS*m_fPPS;    //转化为物理尺寸的对角线平方
-            //tempS = box.width*m_fPPS*box.height*m_fPPS;    //物理尺寸的面积
-            tempS = box.area();     
-            diagL = std::sqrt(box.width*box.width + box.height*box.height); //瑕疵对角线长度
-
-            
-
-            //防止边缘附近的背景上的瑕疵误检
-            //定义一个空的掩膜图，对应ROI区
-            cv::Mat mask3 = cv::Mat::zeros(maskH1, maskW1, CV_8UC1);
-            cv::Mat mask4 = mask3.clone();
-            cv::Point center3 = center1;
-            int radius3 = radius2-116;    //缩窄背景区域
-            cv::circle(mask3, center3, radius3, cv::Scalar(255), -1);
-            //对每个检测到的瑕疵定义一个掩膜图
-            cv::Rect roi(box.x, box.y, box.width, box.height);
-            cv::rectangle(mask4, roi, cv::Scalar(255), -1);
-            cv::Mat mask5;
-            cv::bitwise_and(mask3, mask4, mask5);
-            int whiteArea = cv::countNonZero(mask5);
-            // std::cout << "相交区域的面积： " << whiteArea << std::endl;
-
-            float centerX = box.x + box.width/2;    
-            float centerY = box.y + box.height/2;
-            //计算产品中心到瑕疵中心的距离，与radius1比较大小，由此判断调用松/紧参数
-            float d_defect2center = std::sqrt((centerX-maskW1/2)*(centerX-maskW1/2) + (centerY-maskH1/2)*(centerY-maskH1/2));
-            if (d_defect2center >= radius2){    //如果检测到的瑕疵的中心点在背景区（防止模型异常或早期的训练数据影响）
-                continue;
-            }
-            if (d_defect2center <= radius1){
-                m_vMinDefectArea = m_vMinDefectArea_C;
-                m_vMinDefectProb = m_vMinDefectProb_C;
-                m_vMinDefectDiag = m_vMinDefectDiag_C;
-            }
-            if (d_defect2center > radius1){
-                m_vMinDefectArea = m_vMinDefectArea_NC;
-                m_vMinDefectProb = m_vMinDefectProb_NC;
-                m_vMinDefectDiag = m_vMinDefectDiag_NC;
-            }
-
-            
-            if (tempS > m_vMinDefectArea[(int)det.id] && diagL >= m_vMinDefectDiag[(int)det.id] && det.confidence >= m_vMinDefectProb[(int)det.id] && whiteArea >= 1)
-            {  
-                Scalar scalar = Scalar(0,0,255);
-                // value = (int)LocalLevel::C;
-                result = objectId + 2;  //good是1，瑕疵从2开始
-                defectResult[0].emplace_back(result);
-                //rectangle(m_workflowProcessedImage, box, scalar, 2, 8);
-                rectangle(roiImage, box, scalar, 5, 8);     
-                processedImage = roiImage.clone();          
-            
-            }	  
-            
-            //TO DO 2: 对角线、长宽、面积之间的模糊关系？
-			//string sizeStr = "S" + getStringFromFloat(tempS,1) + " C" + getStringFromFloat(detectionOutput.at(j).at(i).confidence);
-            if (objectId == 1)  //线伤
-            {   
-                if (diagL > 5)
-                {
-                    numXianshang += 1;
-                    boxesXianshang.push_back(box);    
-                }
-            }    
-
-            if (objectId == 2)  //点伤
-            {
-                numDianshang += 1;
-                boxesDianshang.push_back(box); 	
-            }
-		}
-        
-        //在同一张小图上检测更小的线伤
-        for (int i = 1; i < boxesXianshang.size(); i++)
-        {
-            Scalar scalar = Scalar(0,0,255);
-            // value = (int)LocalLevel::C;
-            result = objectId + 2;  //good是1，瑕疵从2开始
-            defectResult[0].emplace_back(result);
-            //rectangle(m_workflowProcessedImage, box, scalar, 2, 8);
-            rectangle(roiImage, boxesXianshang[i-1], scalar, 5, 8);     
-            processedImage = roiImage.clone();
-        }                  		
-	}
+bool XJAlgorithm::detectByDL(const stInspectPlan &plan, const stThresholdTable &thresholds, const int maskW1, const int maskH1, const cv::Point &center1, const cv::Rect &roiRect, const std::vector<YoloOutputDetect> &vDetections, int &result, std::vector<std::vector<int>> &defectResult, std::vector<stDefectInfo> &vDefects, std::vector<stDrawBox> &vDrawBoxes, std::vector<stDefectCandidate> &vCandidates) const
+{
+    //在任务池中按小图并行调用, 只写本小图的输出, 不修改共享图像
+    //推理已由推理服务按批完成, 这里只做单张小图的后处理; 判定规则与阈值扫描共用judgeTileDetections
+    vector<stDefectInfo> vTileDefects;
+    judgeTileDetections(plan, thresholds, Size(maskW1, maskH1), center1, roiRect, vDetections, vTileDefects, vCandidates);
+    for(const auto &defect : vTileDefects)
+    {
+        result = defect.type;
+        defectResult[0].emplace_back(result);
+        vDrawBoxes.push_back({defect.box, DRAW_NG_COLOR, 5});
+    }
+    vDefects.insert(vDefects.end(), vTileDefects.begin(), vTileDefects.end());
 
     //在这里判断点伤（基于整张ROI图），以及别的需要基于整张ROI图判断的瑕疵，以及存ROI图
 
@@ -752,33 +954,692 @@ bool XJAlgorithm::detectByDL(int &maskW1, int &maskH1, int &radius1, int &radius
 
 }
 
-// bool XJAlgorithm::isDisableDet(const float defectType)
-// {
-//     for(size_t i = 0; i != m_vDisableDefectType.size(); ++i)
-//     {
-//         if(m_vDisableDefectType[i] ==  defectType)  //比较输出结果和配置文件类别
-//         {
-//             return true;
-//         }
-//     }
-//     return false;
-// }
+float XJAlgorithm::getFloatParam(const string &sKey, const float defaultValue) const
+{
+    auto itr = m_stParamsB.fParams.find(sKey);
+    return (itr == m_stParamsB.fParams.end()) ? defaultValue : itr->second;
+}
+
+float XJAlgorithm::getBoardParam(const string &sKey, const float defaultValue) const
+{
+    auto itr = m_stParamsB.vecFParams.find(sKey);
+    if(itr == m_stParamsB.vecFParams.end() || m_stParamsA.boardId >= (int)itr->second.size())
+    {
+        return defaultValue;
+    }
+    return itr->second[m_stParamsA.boardId];
+}
+
+bool XJAlgorithm::initInspectRoutes(const int numCategory)
+{
+    //先建新路由再替换, 换型时仍在用的模型不会被卸载重载
+    vector<shared_ptr<stInspectRoute>> vRoutes;
+    if(!buildInspectRoutes(numCategory, "MODEL_PATH_CAM", "", vRoutes))
+    {
+        return false;
+    }
+    m_vRoutes.swap(vRoutes);
+    return !m_vRoutes.empty();
+}
+
+bool XJAlgorithm::buildInspectRoutes(const int numCategory, const string &sModelKey, const string &sBackgroundTag, vector<shared_ptr<stInspectRoute>> &vRoutes) const
+{
+    const int inputWidth = TARGET_SIZE;
+    const int inputHeight = TARGET_SIZE;
+    const int inputChannel = 3;
+    const string sBoard = to_string(m_stParamsA.boardId + 1);
+
+    const int maxBatchSize = m_stParamsB.vecFParams.at("MAX_BATCH_SIZE")[m_stParamsA.boardId];
+    const float NmsThresh = m_stParamsB.vecFParams.at("MNS_THRESHOLD")[m_stParamsA.boardId];
+    const float ConfThresh = m_stParamsB.vecFParams.at("CONF_THRESHOLD")[m_stParamsA.boardId];
+    //YOLOV8
+    const int maskThr = m_stParamsB.vecFParams.at("MASK_THR")[m_stParamsA.boardId]; 
+    const int detbox_num = inputWidth * inputHeight / 32 / 32 * 21; //yolo标准式可化简为：w*h/32/32*(4*4+2*2+1*1)
+    //相同模型是否共用执行器: 共用时各工位、各次拍照的小图跨工位合批, 不共用则每次拍照独占执行器
+    const bool bIsShareModel = getFloatParam("IS_SHARE_MODEL_BETWEEN_CAPTURES", 1);
+    stInferenceModelParams modelParams;
+    modelParams.maxBatchSize = maxBatchSize;
+    modelParams.numCategory = numCategory;
+    modelParams.inputWidth = inputWidth;
+    modelParams.inputHeight = inputHeight;
+    modelParams.inputChannel = inputChannel;
+    modelParams.confThreshold = ConfThresh;
+    modelParams.nmsThreshold = NmsThresh;
+    modelParams.maskThreshold = maskThr;
+    modelParams.segScaleFactor = SEG_SCALEFACTOR;
+    modelParams.segChannels = SEG_CHANNELS;
+    modelParams.detboxNum = detbox_num;
+    modelParams.maxWaitMs = getFloatParam("INFERENCE_MAX_WAIT_MS", 2);
+    modelParams.statsInterval = getFloatParam("INFERENCE_STATS_INTERVAL", 0);
+    modelParams.bIsLowPriority = !sBackgroundTag.empty();
+    auto itrBackend = m_stParamsB.strParams.find("INFERENCE_BACKEND");
+    modelParams.backendType = (itrBackend != m_stParamsB.strParams.end() && itrBackend->second == "cpu") ? InferenceBackendType::CPU : InferenceBackendType::TENSORRT;
+    //拍照次数与BOX_BINARY_THRESHOLD一致, 按[pic1, pic2]配置
+    const int numCaptures = m_stParamsB.vecFParams.at("BOX_BINARY_THRESHOLD" + sBoard).size();
+
+    auto getTileNum = [this, &sBoard](const string &sKey, const int nCaptureTimes)->int
+    {
+        auto itr = m_stParamsB.vecFParams.find(sKey + sBoard);
+        if(itr == m_stParamsB.vecFParams.end() || nCaptureTimes > (int)itr->second.size())
+        {
+            return 5;
+        }
+        return std::max(1, (int)itr->second[nCaptureTimes - 1]);
+    };
+
+    vRoutes.clear();
+    for(int nCaptureTimes = (int)CaptureImageTimes::FIRST_TIMES; nCaptureTimes <= numCaptures; ++nCaptureTimes)
+    {
+        shared_ptr<stInspectRoute> pRoute = make_shared<stInspectRoute>();
+        auto itr = m_stParamsB.strParams.find(sModelKey + sBoard + "_PIC" + to_string(nCaptureTimes));
+        pRoute->sModelPath = (itr != m_stParamsB.strParams.end()) ? itr->second : m_stParamsB.strParams.at(sModelKey + sBoard);
+        pRoute->numTargetX = getTileNum("TILE_NUM_X", nCaptureTimes);
+        pRoute->numTargetY = getTileNum("TILE_NUM_Y", nCaptureTimes);
+
+        //cpu后端加载与engine同名的onnx
+        modelParams.sModelPath = pRoute->sModelPath;
+        if(modelParams.backendType == InferenceBackendType::CPU && modelParams.sModelPath.find(".engine") != string::npos)
+        {
+            modelParams.sModelPath.replace(modelParams.sModelPath.find(".engine"), string(".engine").length(), ".onnx");
+        }
+        //共用模型时只有批大小、类别数和阈值都相同的工位共用执行器
+        string sExecutorKey = getExecutorKey(bIsShareModel ? modelParams.sModelPath : (modelParams.sModelPath + "#B" + sBoard + "_PIC" + to_string(nCaptureTimes)), modelParams);
+        //影子评估、阈值扫描的模型即使与生产模型同名也单独加载, 推理线程为低优先级
+        if(!sBackgroundTag.empty())
+        {
+            sExecutorKey += "#" + sBackgroundTag;
+        }
+        pRoute->pExecutor = InferenceService::instance().getExecutor(sExecutorKey, modelParams);
+        if(pRoute->pExecutor == nullptr)
+        {
+            cout << "[ERROR] board[" << m_stParamsA.boardId << "] pic" << nCaptureTimes << " failed to load model " << modelParams.sModelPath << endl;
+            return false;
+        }
+        vRoutes.emplace_back(pRoute);
+    }
+    return true;
+}
+
+shared_ptr<stInspectRoute> XJAlgorithm::getInspectRoute(const int nCaptureTimes) const
+{
+    if(nCaptureTimes < (int)CaptureImageTimes::FIRST_TIMES || nCaptureTimes > (int)m_vRoutes.size())
+    {
+        return nullptr;
+    }
+    return m_vRoutes[nCaptureTimes - 1];
+}
+
+bool XJAlgorithm::initInspectPlan(const int numCategory)
+{
+    if(numCategory <= 0 || numCategory > MAX_DEFECT_CATEGORY)
+    {
+        cout << "[ERROR] board[" << m_stParamsA.boardId << "] NUM_CATEGORY " << numCategory << " out of range (0, " << MAX_DEFECT_CATEGORY << "]" << endl;
+        return false;
+    }
+    const int boardId = m_stParamsA.boardId;
+    const string sBoard = to_string(boardId + 1);
+    shared_ptr<stInspectPlan> pPlan = make_shared<stInspectPlan>();
+
+    //开关
+    pPlan->bIsDebug = getFloatParam("IS_DEBUG", 0);
+    pPlan->bIsCheckCharacter = getFloatParam("IS_CHECK_CHARACTER", 0);
+    pPlan->bIsCheckTiaoxingma = getFloatParam("IS_CHECK_TIAOXINGMA", 0);
+    pPlan->bIsCheckLogo = getFloatParam("IS_CHECK_LOGO", 0);
+    auto itrSkip = m_stParamsB.vecFParams.find("is_board");
+    if(itrSkip != m_stParamsB.vecFParams.end())
+    {
+        pPlan->bIsSkipBoard = std::find(itrSkip->second.begin(), itrSkip->second.end(), (float)boardId) != itrSkip->second.end();
+    }
+
+    //定位二值化阈值, 配置个数即拍照次数
+    const vector<float> &vBoxThreshold = m_stParamsB.vecFParams.at("BOX_BINARY_THRESHOLD" + sBoard);
+    pPlan->vBoxBinaryThreshold.assign(vBoxThreshold.begin(), vBoxThreshold.end());
+
+    //区域半径
+    pPlan->centerRadius = getFloatParam("INSPECT_CENTER_RADIUS", 420);
+    pPlan->foregroundRadius = getFloatParam("INSPECT_FOREGROUND_RADIUS", 1280);
+    pPlan->edgeMargin = getFloatParam("INSPECT_EDGE_MARGIN", 116);
+    auto itrDarkField = m_stParamsB.vecFParams.find("DARK_FIELD_MASK_RADIUS" + sBoard);
+    pPlan->vDarkFieldRadius.assign(m_vRoutes.size(), 0);
+    for(size_t i = 0; itrDarkField != m_stParamsB.vecFParams.end() && i != itrDarkField->second.size() && i != m_vRoutes.size(); ++i)
+    {
+        pPlan->vDarkFieldRadius[i] = itrDarkField->second[i];
+    }
+
+    //线伤/点伤聚类: 连接距离和方向容差按类别配置, 没有配置的类别不聚类
+    auto getCategoryVector = [this, &sBoard](const string &sKey)->vector<float>
+    {
+        auto itr = m_stParamsB.vecFParams.find(sKey + sBoard);
+        return (itr != m_stParamsB.vecFParams.end()) ? itr->second : vector<float>();
+    };
+    const vector<float> vLinkDistance = getCategoryVector("INSPECT_CLUSTER_LINK_DISTANCE");
+    const vector<float> vAngleTolerance = getCategoryVector("INSPECT_CLUSTER_ANGLE_TOLERANCE");
+    pPlan->vClusterParams.assign(numCategory, stClusterParams());
+    for(int i = 0; i != numCategory; ++i)
+    {
+        pPlan->vClusterParams[i].linkDistance = (i < (int)vLinkDistance.size()) ? vLinkDistance[i] : 0;
+        pPlan->vClusterParams[i].angleTolerance = (i < (int)vAngleTolerance.size()) ? vAngleTolerance[i] : 180;
+    }
+    pPlan->xianshangMaxCount = getFloatParam("INSPECT_XIANSHANG_MAX_COUNT", 2);
+    pPlan->dianshangMaxCount = getFloatParam("INSPECT_DIANSHANG_MAX_COUNT", 0);
+
+    //阈值表: 带_PIC{n}后缀的配置优先, 没有则沿用工位配置
+    auto getRouteVector = [this](const string &sKey, const int nCaptureTimes)->vector<float>
+    {
+        auto itr = m_stParamsB.vecFParams.find(sKey + "_PIC" + to_string(nCaptureTimes));
+        return (itr != m_stParamsB.vecFParams.end()) ? itr->second : m_stParamsB.vecFParams.at(sKey);
+    };
+    for(size_t i = 0; i != m_vRoutes.size(); ++i)
+    {
+        const int nCaptureTimes = i + 1;
+        stThresholdTable thresholds;
+        thresholds.init(numCategory);
+        if(getFloatParam("IS_USE_MODEL_CONFIG", 0))
+        {
+            //模型同名json中的阈值, 中心区与非中心区相同
+            string json_path = m_vRoutes[i]->sModelPath;
+            string tmp = ".engine";
+            json_path = json_path.replace(json_path.find(tmp), tmp.length(), ".json");
+
+            ifstream ifs(json_path, std::ios_base::in);
+            ptree rootNode;
+            read_json(ifs, rootNode);
+            vector<float> vMinProb, vMinArea;
+            for(const auto &it : rootNode.get_child("MIN_PROB"))
+            {
+                vMinProb.emplace_back(it.second.get_value<float>());
+            }
+            for(const auto &it : rootNode.get_child("MIN_AREA"))
+            {
+                vMinArea.emplace_back(it.second.get_value<float>());
+            }
+            thresholds.set(InspectZone::CENTER, vMinProb, vMinArea, vector<float>());
+            thresholds.set(InspectZone::NON_CENTER, vMinProb, vMinArea, vector<float>());
+        }
+        else
+        {
+            thresholds.set(InspectZone::CENTER, getRouteVector("DEFECT_MIN_PROB_CAM_C" + sBoard, nCaptureTimes),
+                                                getRouteVector("DEFECT_MIN_AREA_CAM_C" + sBoard, nCaptureTimes),
+                                                getRouteVector("DEFECT_MIN_DIAG_CAM_C" + sBoard, nCaptureTimes));
+            thresholds.set(InspectZone::NON_CENTER, getRouteVector("DEFECT_MIN_PROB_CAM_NC" + sBoard, nCaptureTimes),
+                                                    getRouteVector("DEFECT_MIN_AREA_CAM_NC" + sBoard, nCaptureTimes),
+                                                    getRouteVector("DEFECT_MIN_DIAG_CAM_NC" + sBoard, nCaptureTimes));
+        }
+        pPlan->vThresholds.emplace_back(thresholds);
+    }
+
+    //禁用类别: UI中工位检测开关(boardId+40)或类别开关(boardId*50+300+类别)关闭, 没有配置的视为开启
+    auto isSwitchOn = [this](const int index)->bool
+    {
+        auto itr = m_stParamsA.fParams.find(index);
+        return itr == m_stParamsA.fParams.end() || itr->second != 0;
+    };
+    const bool bIsBoardOn = isSwitchOn(boardId + 40);
+    for(int i = 0; i != numCategory; ++i)
+    {
+        pPlan->disabledCategories.set(i, !bIsBoardOn || !isSwitchOn(boardId * 50 + 300 + i));
+    }
+
+    //小图保存策略
+    const bool bIsSaveProcessImage = (m_stParamsA.pSaveImageMultiThread != nullptr) && getFloatParam("IS_SAVE_PROCESS_IMAGE", 0);
+    pPlan->bIsSaveTileOK = bIsSaveProcessImage && m_stParamsA.saveImageType == (int)SaveImageType::ALL;
+    pPlan->bIsSaveTileNG = bIsSaveProcessImage && (m_stParamsA.saveImageType == (int)SaveImageType::ALL || m_stParamsA.saveImageType == (int)SaveImageType::NG_ONLY);
+
+    if(pPlan->disabledCategories.any())
+    {
+        cout << "board[" << boardId << "] disabled defect categories:";
+        for(int i = 0; i != numCategory; ++i)
+        {
+            if(pPlan->isDisabled(i))
+            {
+                cout << " " << i;
+            }
+        }
+        cout << endl;
+    }
+    m_pPlan = pPlan;
+    return true;
+}
+
+void XJAlgorithm::initImageQuality()
+{
+    //每次拍照一组参数, 与BOX_BINARY_THRESHOLD相同按[pic1, pic2]配置
+    const string sBoard = to_string(m_stParamsA.boardId + 1);
+    auto getCaptureParam = [this, &sBoard](const string &sKey, const int idx, const float defaultValue)->float
+    {
+        auto itr = m_stParamsB.vecFParams.find(sKey + sBoard);
+        return (itr == m_stParamsB.vecFParams.end() || idx >= (int)itr->second.size()) ? defaultValue : itr->second[idx];
+    };
+
+    m_vImageQualityParams.assign(2, stImageQualityParams());
+    for(int i = 0; i != (int)m_vImageQualityParams.size(); ++i)
+    {
+        stImageQualityParams &params = m_vImageQualityParams[i];
+        params.bIsEnable = getBoardParam("IS_CHECK_IMAGE_QUALITY", 0);
+        params.sampleSize = getFloatParam("IMAGE_QUALITY_SAMPLE_SIZE", 256);
+        params.lowPercentile = getFloatParam("IMAGE_QUALITY_LOW_PERCENTILE", 5);
+        params.highPercentile = getFloatParam("IMAGE_QUALITY_HIGH_PERCENTILE", 95);
+        params.saturatedGray = getFloatParam("IMAGE_QUALITY_SATURATED_GRAY", 250);
+        params.minLensSize = getFloatParam("IMAGE_QUALITY_MIN_LENS_SIZE", 2000);
+        params.maxLensSize = getFloatParam("IMAGE_QUALITY_MAX_LENS_SIZE", 3000);
+        params.borderMargin = getFloatParam("IMAGE_QUALITY_BORDER_MARGIN", 2);
+        params.minMeanGray = getCaptureParam("IMAGE_QUALITY_MIN_MEAN", i, 0);
+        params.maxMeanGray = getCaptureParam("IMAGE_QUALITY_MAX_MEAN", i, 255);
+        params.minFocus = getCaptureParam("IMAGE_QUALITY_MIN_FOCUS", i, 0);
+        //与locateBox一致: 第一次拍照暗背景取反, 第二次拍照亮背景
+        params.binaryThreshold = getCaptureParam("BOX_BINARY_THRESHOLD", i, 30);
+        params.binaryType = (i == 0) ? THRESH_BINARY_INV : THRESH_BINARY;
+    }
+}
+
+stImageQuality XJAlgorithm::checkImageQuality(const Mat &image, const int nCaptureTimes) const
+{
+    stImageQuality quality;
+    if(nCaptureTimes < 1 || nCaptureTimes > (int)m_vImageQualityParams.size() || !m_vImageQualityParams[nCaptureTimes - 1].bIsEnable)
+    {
+        return quality;
+    }
+    if(image.empty())
+    {
+        quality.reason = ImageQualityReason::INVALID_IMAGE;
+        return quality;
+    }
+
+    //只在取像roi内评估, 与locateBox一致
+    Rect roiRC(m_roiOffsetX, m_roiOffsetY, m_roiWidth, m_roiHeight);
+    roiRC &= Rect(0, 0, image.cols, image.rows);
+    if(roiRC.width <= 0 || roiRC.height <= 0)
+    {
+        roiRC = Rect(0, 0, image.cols, image.rows);
+    }
+    if(!isRawBayer(image))
+    {
+        return evaluateImageQuality(image(roiRC), m_vImageQualityParams[nCaptureTimes - 1]);
+    }
+
+    //原始Bayer图在分箱灰度图上评估, 尺寸类参数同步减半
+    Mat grayImage;
+    getBayerBinnedGray(image(roiRC), grayImage);
+    stImageQualityParams params = m_vImageQualityParams[nCaptureTimes - 1];
+    params.minLensSize /= 2;
+    params.maxLensSize /= 2;
+    return evaluateImageQuality(grayImage, params);
+}
+
+string XJAlgorithm::getRawCacheKey(const Mat &image, const int nCaptureTimes, const int maxLenses, const stInspectPlan &plan, const stInspectRoute &route) const
+{
+    //定位、屏蔽、切图、物性/金样/印刷比对开关会改变小图或固定结果, 计入key; 阈值、中心区半径和禁用类别在判定时使用, 不计入
+    return to_string(getImageHash(image)) + "|" + getFileSignature(route.sModelPath)
+        + "|" + m_stParamsA.sProductName + "|B" + to_string(m_stParamsA.boardId) + "|P" + to_string(nCaptureTimes) + "|L" + to_string(maxLenses)
+        + "|" + to_string(plan.getBoxBinaryThreshold(nCaptureTimes)) + "|" + to_string(plan.foregroundRadius) + "|" + to_string(plan.getDarkFieldRadius(nCaptureTimes))
+        + "|" + to_string(route.numTargetX) + "x" + to_string(route.numTargetY) + "|" + to_string(m_isCheckWuxing) + "|" + to_string(m_goldenTemplateMode)
+        + "|" + to_string(plan.bIsCheckCharacter) + to_string(plan.bIsCheckTiaoxingma) + to_string(plan.bIsCheckLogo);
+}
+
+//各工位最近一次阈值扫描的检测路由: 持有扫描执行器, 下次扫描模型和推理参数不变时直接复用, 不重新加载模型
+static mutex s_sweepRoutesMutex;
+static map<int, vector<shared_ptr<stInspectRoute>>> s_mapSweepRoutes;
 
+bool XJAlgorithm::sweepThresholds(const stSweepRequest &request, stSweepReport &report) const
+{
+    report = stSweepReport();
+    shared_ptr<const stInspectPlan> pPlan = m_pPlan;
+    shared_ptr<stInspectRoute> pRoute = getInspectRoute(request.nCaptureTimes);
+    const stThresholdTable *pThresholds = (pPlan == nullptr) ? nullptr : pPlan->getThresholds(request.nCaptureTimes);
+    if(pRoute == nullptr || pThresholds == nullptr)
+    {
+        cout << "[ERROR] board[" << m_stParamsA.boardId << "] sweep thresholds: no inspect route for capture " << request.nCaptureTimes << endl;
+        return false;
+    }
+    if(request.vProbScales.empty() || request.vAreaScales.empty() || request.vDiagScales.empty() || request.category >= pThresholds->numCategory)
+    {
+        cout << "[ERROR] board[" << m_stParamsA.boardId << "] sweep thresholds: invalid threshold grid" << endl;
+        return false;
+    }
 
+    //样本目录下OK、NG子目录
+    vector<stSweepSample> vSamples;
+    const string vLabels[] = {"OK", "NG"};
+    for(const auto &sLabel : vLabels)
+    {
+        vector<String> vPaths;
+        try
+        {
+            glob(request.sImagePath + "/" + sLabel, vPaths, false);
+        }
+        catch(const cv::Exception &)
+        {
+            cout << "[ERROR] sweep thresholds: no " << sLabel << " samples in " << request.sImagePath << endl;
+            continue;
+        }
+        for(const auto &sPath : vPaths)
+        {
+            stSweepSample sample;
+            sample.sImagePath = sPath;
+            sample.bIsLabelNG = (sLabel == "NG");
+            vSamples.emplace_back(sample);
+        }
+    }
+    if(vSamples.empty())
+    {
+        cout << "[ERROR] board[" << m_stParamsA.boardId << "] sweep thresholds: no samples in " << request.sImagePath << endl;
+        return false;
+    }
 
+    //同时进行的扫描请求有上限, 超出直接拒绝, 不排队
+    static atomic<int> s_numSweeps(0);
+    if(++s_numSweeps > MAX_CONCURRENT_SWEEPS)
+    {
+        --s_numSweeps;
+        cout << "[ERROR] board[" << m_stParamsA.boardId << "] sweep thresholds: another sweep is running" << endl;
+        return false;
+    }
+    //本线程的任务池任务(阈值网格判定)直接执行, 不进入也不帮助执行生产任务
+    struct stSweepGuard
+    {
+        stSweepGuard() { TaskPool::setThreadInline(true); }
+        ~stSweepGuard() { TaskPool::setThreadInline(false); --s_numSweeps; }
+    } sweepGuard;
+
+    //样本在单独的低优先级执行器上推理, 不进入生产模型的合批队列; 执行器在两次扫描之间保留,
+    //key相同时buildInspectRoutes取到已加载的执行器, 模型或推理参数变化后旧执行器随旧路由释放
+    vector<shared_ptr<stInspectRoute>> vSweepRoutes;
+    if(!buildInspectRoutes(m_stParamsB.vecFParams.at("NUM_CATEGORY")[m_stParamsA.boardId], "MODEL_PATH_CAM", "SWEEP", vSweepRoutes) || vSweepRoutes.size() != m_vRoutes.size())
+    {
+        cout << "[ERROR] board[" << m_stParamsA.boardId << "] sweep thresholds: failed to load model" << endl;
+        return false;
+    }
+    {
+        lock_guard<mutex> lock(s_sweepRoutesMutex);
+        s_mapSweepRoutes[m_stParamsA.boardId] = vSweepRoutes;
+    }
+    shared_ptr<XJAlgorithm> pSweep = make_shared<XJAlgorithm>(*this);
+    pSweep->m_pShadow = nullptr;
+    pSweep->m_vRoutes.swap(vSweepRoutes);
+    pRoute = pSweep->getInspectRoute(request.nCaptureTimes);
+
+    //step1: 每张样本推理一次, 命中缓存的不再推理; 样本由几个专用的低优先级线程分担, 与影子评估一样任务池任务在本线程执行
+    const auto beginTime = chrono::steady_clock::now();
+    const int maxLenses = std::max(1, request.maxLenses);
+    std::atomic<int> numCached(0);
+    std::atomic<int> nextSample(0);
+    auto inferSamples = [&]()
+    {
+        if(!setCurrentThreadIdlePriority())
+        {
+            cout << "[WARNING] failed to lower priority of sweep thread" << endl;
+        }
+        TaskPool::setThreadInline(true);
+        for(int k = nextSample++; k < (int)vSamples.size(); k = nextSample++)
+        {
+            stSweepSample &sample = vSamples[k];
+            try
+            {
+                Mat image = imread(sample.sImagePath, IMREAD_UNCHANGED);
+                if(image.empty())
+                {
+                    cout << "[ERROR] sweep thresholds: failed to read " << sample.sImagePath << endl;
+                    continue;
+                }
+                const string sKey = pSweep->getRawCacheKey(image, request.nCaptureTimes, maxLenses, *pPlan, *pRoute);
+                sample.pFrame = RawDetectionCache::instance().get(sKey);
+                if(sample.pFrame != nullptr)
+                {
+                    ++numCached;
+                    continue;
+                }
+                shared_ptr<stRawFrame> pFrame = make_shared<stRawFrame>();
+                pSweep->detectLenses(image, 0, request.nCaptureTimes, maxLenses, pFrame.get());
+                if(!pFrame->bIsInferOK)
+                {
+                    cout << "[ERROR] sweep thresholds: infer failed " << sample.sImagePath << endl;
+                    continue;
+                }
+                RawDetectionCache::instance().put(sKey, pFrame);
+                sample.pFrame = pFrame;
+            }
+            catch(const std::exception &e)
+            {
+                cout << "[ERROR] sweep thresholds: " << sample.sImagePath << " failed: " << e.what() << endl;
+            }
+        }
+    };
+    const int numThreads = std::max(1, std::min((int)vSamples.size(), (int)getFloatParam("SWEEP_THREAD_NUM", 2)));
+    vector<thread> vThreads;
+    for(int i = 0; i < numThreads; ++i)
+    {
+        vThreads.emplace_back(inferSamples);
+    }
+    for(auto &itr : vThreads)
+    {
+        itr.join();
+    }
+    const auto inferTime = chrono::steady_clock::now();
 
+    //step2: 阈值网格只在原始结果上判定, 不再推理
+    for(const auto &sample : vSamples)
+    {
+        report.numSamples += (sample.pFrame != nullptr);
+        report.numLabelNG += (sample.pFrame != nullptr && sample.bIsLabelNG);
+    }
+    report.numCached = numCached;
+    sweepThresholdGrid(vSamples, *pPlan, *pThresholds, request, report.vResults);
+    const auto endTime = chrono::steady_clock::now();
+    report.inferSeconds = chrono::duration<double>(inferTime - beginTime).count();
+    report.sweepSeconds = chrono::duration<double>(endTime - inferTime).count();
+
+    cout << "board[" << m_stParamsA.boardId << "] sweep thresholds: " << report.numSamples << " samples (" << report.numCached << " cached), "
+         << report.vResults.size() << " settings, infer " << report.inferSeconds << "s, sweep " << report.sweepSeconds << "s" << endl;
+    return true;
+}
 
+bool XJAlgorithm::detectShadow(const Mat &image, const int productCount, const int nCaptureTimes, const int maxLenses) const
+{
+    //按阈值扫描的方式检测: 记录原始结果即不保存图像、不累计金样样本
+    stRawFrame rawFrame;
+    const vector<stLensResult> vLenses = detectLenses(image, productCount, nCaptureTimes, maxLenses, &rawFrame);
+    for(const auto &lens : vLenses)
+    {
+        for(const auto &vResult : lens.vResult)
+        {
+            if(!vResult.empty())
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
 
+void XJAlgorithm::initShadow(const int numCategory)
+{
+    m_pShadow = nullptr;
+    m_shadowSampleRate = getFloatParam("SHADOW_SAMPLE_RATE", 0);
+    m_shadowNGSampleRate = getFloatParam("SHADOW_NG_SAMPLE_RATE", m_shadowSampleRate);
+    const string sModelKey = "SHADOW_MODEL_PATH_CAM";
+    const string sBoard = to_string(m_stParamsA.boardId + 1);
+    if((m_shadowSampleRate <= 0 && m_shadowNGSampleRate <= 0) || m_stParamsB.strParams.find(sModelKey + sBoard) == m_stParamsB.strParams.end())
+    {
+        return;
+    }
 
+    //候选模型与生产模型类别相同, 共用阈值和检测方案
+    vector<shared_ptr<stInspectRoute>> vRoutes;
+    if(!buildInspectRoutes(numCategory, sModelKey, "SHADOW", vRoutes) || vRoutes.size() != m_vRoutes.size())
+    {
+        cout << "[ERROR] board[" << m_stParamsA.boardId << "] failed to load shadow model, shadow evaluation disabled" << endl;
+        return;
+    }
+    shared_ptr<XJAlgorithm> pShadow = make_shared<XJAlgorithm>(*this);
+    pShadow->m_vRoutes.swap(vRoutes);
+    m_pShadow = pShadow;
+
+    auto itrPath = m_stParamsB.strParams.find("SHADOW_SAVE_PATH");
+    ShadowEvaluator::instance().configure(getFloatParam("SHADOW_QUEUE_SIZE", 8), getFloatParam("SHADOW_CPU_SHARE", 0.25),
+                                          (itrPath == m_stParamsB.strParams.end()) ? "" : itrPath->second);
+    cout << "board[" << m_stParamsA.boardId << "] shadow evaluation: " << m_pShadow->m_vRoutes[0]->sModelPath
+         << ", sample rate " << m_shadowSampleRate << ", NG sample rate " << m_shadowNGSampleRate << endl;
+}
 
+void XJAlgorithm::submitShadow(const Mat &image, const int productCount, const int nCaptureTimes, const int maxLenses, const vector<stLensResult> &vLenses) const
+{
+    bool bIsNG = false;
+    for(const auto &lens : vLenses)
+    {
+        for(const auto &vResult : lens.vResult)
+        {
+            bIsNG = bIsNG || !vResult.empty();
+        }
+    }
 
+    //抽中才拷贝图像, 未抽中的帧只多一次随机数
+    static thread_local std::mt19937 generator(std::random_device{}());
+    std::uniform_real_distribution<float> distribution(0, 1);
+    const shared_ptr<stInspectRoute> pRoute = getInspectRoute(nCaptureTimes);
+    if(pRoute == nullptr || distribution(generator) >= (bIsNG ? m_shadowNGSampleRate : m_shadowSampleRate))
+    {
+        return;
+    }
 
+    stShadowJob job;
+    job.boardId = m_stParamsA.boardId;
+    job.sModelPath = m_pShadow->m_vRoutes[0]->sModelPath;
+    job.pShadow = m_pShadow;
+    job.pProductionExecutor = pRoute->pExecutor;
+    job.image = image.clone();
+    job.productCount = productCount;
+    job.nCaptureTimes = nCaptureTimes;
+    job.maxLenses = maxLenses;
+    job.bIsProductionNG = bIsNG;
+    ShadowEvaluator::instance().submit(std::move(job));
+}
+
+bool XJAlgorithm::initGoldenTemplate()
+{
+    m_goldenTemplateMode = getBoardParam("IS_CHECK_GOLDEN_TEMPLATE", 0);
+    m_goldenDefectType = getFloatParam("GOLDEN_TEMPLATE_DEFECT_TYPE", 10);
+    auto itr = m_stParamsB.strParams.find("GOLDEN_TEMPLATE_PATH");
+    m_sGoldenTemplatePath = (itr == m_stParamsB.strParams.end()) ? "" : itr->second;
+
+    m_stGoldenParams.sampleNum = std::max(1, (int)getFloatParam("GOLDEN_TEMPLATE_SAMPLE_NUM", 10));
+    m_stGoldenParams.rebuildInterval = getFloatParam("GOLDEN_TEMPLATE_REBUILD_INTERVAL", 0);
+    m_stGoldenParams.scale = getFloatParam("GOLDEN_TEMPLATE_SCALE", 0.25f);
+    m_stGoldenParams.size = getFloatParam("GOLDEN_TEMPLATE_SIZE", 768);
+    m_stGoldenParams.pyramidLevels = getFloatParam("GOLDEN_TEMPLATE_PYRAMID_LEVELS", 3);
+    m_stGoldenParams.bIsUseRotation = getFloatParam("GOLDEN_TEMPLATE_IS_USE_ROTATION", 1);
+    m_stGoldenParams.diffThreshold = getFloatParam("GOLDEN_TEMPLATE_DIFF_THRESHOLD", 25);
+    m_stGoldenParams.toleranceScale = getFloatParam("GOLDEN_TEMPLATE_TOLERANCE_SCALE", 3);
+    m_stGoldenParams.envelopeSize = getFloatParam("GOLDEN_TEMPLATE_ENVELOPE_SIZE", 3);
+    m_stGoldenParams.minBlobArea = getFloatParam("GOLDEN_TEMPLATE_MIN_BLOB_AREA", 6);
+    m_stGoldenParams.maskRadius = getFloatParam("GOLDEN_TEMPLATE_MASK_RADIUS", 0);
+    m_stGoldenParams.maxDrift = getFloatParam("GOLDEN_TEMPLATE_MAX_DRIFT", 8);
+    //模板目录不存在时建立, 否则模板无法保存, 重启后需要重新累计良品
+    if(m_goldenTemplateMode > 0 && !m_sGoldenTemplatePath.empty() && !createDirectories(m_sGoldenTemplatePath))
+    {
+        cout << "[ERROR] failed to create golden template directory " << m_sGoldenTemplatePath << endl;
+        return false;
+    }
+
+    //印刷图案模板: 单张模板图即参考图, 不缩放不旋转
+    auto loadPrintTemplate = [this](const string &sCheckKey, const string &sPathKey, Mat &templImage, shared_ptr<GoldenTemplate> &pTemplate)->bool
+    {
+        templImage.release();
+        pTemplate = nullptr;
+        if(!getFloatParam(sCheckKey, 0))
+        {
+            return true;
+        }
+        auto itr = m_stParamsB.strParams.find(sPathKey);
+        if(itr == m_stParamsB.strParams.end())
+        {
+            return false;
+        }
+        templImage = imread(itr->second, IMREAD_GRAYSCALE);
+        if(templImage.empty())
+        {
+            cout << "[ERROR] failed to read template image " << itr->second << endl;
+            return false;
+        }
+        stGoldenTemplateParams params = m_stGoldenParams;
+        params.scale = 1.0f;
+        params.size = std::max(templImage.cols, templImage.rows);
+        params.pyramidLevels = 2;
+        params.bIsUseRotation = false;
+        params.maskRadius = 0;
+        pTemplate = GoldenTemplate::build({GoldenTemplate::normalize(templImage, params)}, params);
+        return pTemplate != nullptr;
+    };
+
+    return loadPrintTemplate("IS_CHECK_CHARACTER", "CHARACTER_IMAGE_PATH", m_templateCharacterImage, m_pCharacterTemplate)
+        && loadPrintTemplate("IS_CHECK_TIAOXINGMA", "TIAOXINGMA_IMAGE_PATH", m_templateTiaoxingmaImage, m_pTiaoxingmaTemplate)
+        && loadPrintTemplate("IS_CHECK_LOGO", "LOGO_IMAGE_PATH", m_templateLogoImage, m_pLogoTemplate);
+}
 
+//模板定位印刷图案, 再与模板做差分; 找不到图案或存在差分斑块为NG
+bool XJAlgorithm::detectPrintMark(const Mat &roiImage, const Mat &templImage, const shared_ptr<GoldenTemplate> &pTemplate, const float score, const float scale, vector<stDrawBox> &vDrawBoxes) const
+{
+    if(templImage.empty() || !pTemplate)
+    {
+        return true;
+    }
 
+    Mat grayImage;
+    if(roiImage.channels() == 3)
+    {
+        cvtColor(roiImage, grayImage, COLOR_BGR2GRAY);
+    }
+    else
+    {
+        grayImage = roiImage;
+    }
 
+    Mat resizedTempl;
+    resize(templImage, resizedTempl, Size(0, 0), scale, scale);
+    Rect matchRC;
+    if(!xjTemplateMatch(grayImage, resizedTempl, matchRC, score, scale))
+    {
+        return false;
+    }
+    matchRC &= Rect(0, 0, grayImage.cols, grayImage.rows);
+    if(matchRC.area() <= 0)
+    {
+        return false;
+    }
 
+    Mat patch = grayImage(matchRC);
+    if(patch.size() != templImage.size())
+    {
+        resize(patch, patch, templImage.size());
+    }
 
+    vector<stGoldenBlob> vBlobs;
+    if(!pTemplate->compare(patch, vBlobs))
+    {
+        return false;
+    }
 
+    const float fx = matchRC.width / (float)templImage.cols;
+    const float fy = matchRC.height / (float)templImage.rows;
+    for(const auto &blob : vBlobs)
+    {
+        Rect box(matchRC.x + blob.box.x * fx, matchRC.y + blob.box.y * fy, blob.box.width * fx, blob.box.height * fy);
+        vDrawBoxes.push_back({box, DRAW_NG_COLOR, 5});
+    }
+    vDrawBoxes.push_back({matchRC, vBlobs.empty() ? DRAW_OK_COLOR : DRAW_NG_COLOR, 2});
+    return vBlobs.empty();
+}
 
+bool XJAlgorithm::detectCharacter(const Mat &roiImage, const Rect &roiRect, vector<stDrawBox> &vDrawBoxes, const int nCaptureTimes) const
+{
+    return detectPrintMark(roiImage, m_templateCharacterImage, m_pCharacterTemplate, getFloatParam("CHARACTER_MATCH_SCORE", 0.5f), getFloatParam("CHARACTER_MATCH_RESIZE_SCALE", 1.0f), vDrawBoxes);
+}
 
+bool XJAlgorithm::detectTiaoxingma(const Mat &roiImage, const Rect &roiRect, vector<stDrawBox> &vDrawBoxes, const int nCaptureTimes) const
+{
+    return detectPrintMark(roiImage, m_templateTiaoxingmaImage, m_pTiaoxingmaTemplate, getFloatParam("TIAOXINGMA_MATCH_SCORE", 0.5f), getFloatParam("TIAOXINGMA_MATCH_RESIZE_SCALE", 1.0f), vDrawBoxes);
+}
 
+bool XJAlgorithm::detectLogo(const Mat &roiImage, const Rect &roiRect, vector<stDrawBox> &vDrawBoxes, const int nCaptureTimes) const
+{
+    return detectPrintMark(roiImage, m_templateLogoImage, m_pLogoTemplate, getFloatParam("LOGO_MATCH_SCORE", 0.5f), getFloatParam("LOGO_MATCH_RESIZE_SCALE", 1.0f), vDrawBoxes);
+}
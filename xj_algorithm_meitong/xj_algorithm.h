@@ -4,6 +4,8 @@
 #include <string>
 #include <map>
 #include <memory>
+#include <atomic>
+#include <mutex>
 #include <opencv2/opencv.hpp>
 #include <opencv2/freetype.hpp>
 #include <iostream>
@@ -13,9 +15,36 @@
 #include <boost/property_tree/json_parser.hpp>
 #include "xj_app_algorithm.h"
 // #include "tensorrt_engine_base.h"
-#include "xj_app_yolo_classifier.h"
+#include "inference_service.h"
+#include "golden_template.h"
+#include "image_quality.h"
+#include "bayer_view.h"
+#include "task_pool.h"
+#include "inspect_plan.h"
+#include "threshold_sweep.h"
+#include "shadow_evaluator.h"
+
+//检测路由: 按(工位, 拍照次数)区分模型和切图方案, 不同打光可使用专用模型; 阈值在检测方案stInspectPlan中
+struct stInspectRoute
+{
+    std::string sModelPath;
+    std::shared_ptr<ModelExecutor> pExecutor;   //推理服务中的模型执行器, 模型相同的工位和拍照共用并跨工位合批
+    int numTargetX = 5;                         //切图方案: 横向/纵向小图数量
+    int numTargetY = 5;
+};
 
+//待绘制的框: 并行检测时先收集, 回到检测线程后按顺序统一画到结果图
+struct stDrawBox
+{
+    cv::Rect box;
+    cv::Scalar color;
+    int thickness;
+};
 
+/*==================================================================================================
+    配置和模型在init中建立, 之后只读: 检测接口都是const, 单次检测的中间图像和结果只放在调用栈上,
+    同一实例可被多个线程并发调用. 重新初始化时新建实例, 阈值热更新时拷贝实例, 成功后由XJAppAlgorithm整体替换
+===================================================================================================*/
 class XJAlgorithm
 {
 public:
@@ -23,19 +52,37 @@ public:
     ~XJAlgorithm();
 
     bool init(const stConfigParamsA &stParamsA, const stConfigParamsB &stParamsB);
-    std::vector<std::vector<int>> detectAnalyze(const cv:: Mat &image, cv::Mat &processedImage, const int productCount, const int nCaptureTimes);
+    //过程小图保存开关, 由XJAppAlgorithm持有, 拷贝实例时共享
+    void setProcessImageSaveSwitch(const std::shared_ptr<const std::atomic<bool>> &pSwitch) { m_pProcessImageSave = pSwitch; }
+    //在已初始化实例的拷贝上调用: 只有检测方案相关参数变化时重新编译检测方案, 否则返回false
+    bool updateParams(const stConfigParamsA &stParamsA, const stConfigParamsB &stParamsB);
+    std::vector<std::vector<int>> detectAnalyze(const cv:: Mat &image, cv::Mat &processedImage, const int productCount, const int nCaptureTimes, std::vector<stDefectInfo> &vDefects) const;
+    std::vector<stLensResult> detectAnalyzeLenses(const cv::Mat &image, const int productCount, const int nCaptureTimes, const int maxLenses) const;
+    stImageQuality checkImageQuality(const cv::Mat &image, const int nCaptureTimes) const;
+    //对带标签的样本目录推理一次(命中缓存则不推理), 在专用低优先级线程和执行器上进行, 不占用生产任务池; 同时只允许一个扫描
+    bool sweepThresholds(const stSweepRequest &request, stSweepReport &report) const;
+    //在候选模型实例上检测一帧(影子评估), 不保存图像、不累计金样样本, 返回是否NG
+    bool detectShadow(const cv::Mat &image, const int productCount, const int nCaptureTimes, const int maxLenses) const;
 
 private:
-    bool locateBox(const cv::Mat& image, cv::Rect &box, const int nCaptureTimes);
-    bool checkWuxing(cv::Rect &box);    //
-    bool extractROI(const cv::Mat &roiImage, const cv::Rect &roiRect, std::vector<cv::Rect> &vTargetRect, std::vector<cv::Mat> &vTargetImage);
-
-    cv::Mat preprocessImage(const cv::Mat &roiImage);
-    bool detectByDL(int &maskW1, int &maskH1, int &radius1, int &radius2, cv::Point &center1, cv::Mat &roiImage, const cv::Rect &roiRect, cv::Mat &targetImage, int &result, std::vector<std::vector<int>> &defectResult, cv::Mat &processedImage);
-
-    bool detectCharacter(const cv::Mat &roiImage, const cv::Rect &roiRect, cv::Mat &processedImage, const int nCaptureTimes);
-    bool detectTiaoxingma(const cv::Mat &roiImage, const cv::Rect &roiRect, cv::Mat &processedImage, const int nCaptureTimes);
-    bool detectLogo(const cv::Mat &roiImage, const cv::Rect &roiRect, cv::Mat &processedImage, const int nCaptureTimes);
+    //定位并检测一帧中的镜片, 各镜片需要DL的小图合并成一批推理.
+    //pRaw不为空时(阈值扫描)记录原始检测结果, 不保存图像、不累计金样样本
+    std::vector<stLensResult> detectLenses(const cv::Mat &image, const int productCount, const int nCaptureTimes, const int maxLenses, stRawFrame *pRaw = nullptr) const;
+    //原始检测结果缓存的key: 图像哈希、模型文件和推理前参数, 不含阈值
+    std::string getRawCacheKey(const cv::Mat &image, const int nCaptureTimes, const int maxLenses, const stInspectPlan &plan, const stInspectRoute &route) const;
+    //定位最多maxLenses片镜片, 从左到右排列
+    bool locateBoxes(const cv::Mat& image, std::vector<cv::Rect> &vBoxes, const int nCaptureTimes, const int maxLenses) const;
+    bool isRawBayer(const cv::Mat &image) const;
+    bool checkWuxing(const cv::Rect &box) const;    //
+    bool extractROI(const cv::Mat &roiImage, const cv::Rect &roiRect, const int numTargetX, const int numTargetY, std::vector<cv::Rect> &vTargetRect, std::vector<cv::Mat> &vTargetImage) const;
+
+    cv::Mat preprocessImage(const cv::Mat &roiImage) const;
+    bool detectByDL(const stInspectPlan &plan, const stThresholdTable &thresholds, const int maskW1, const int maskH1, const cv::Point &center1, const cv::Rect &roiRect, const std::vector<YoloOutputDetect> &vDetections, int &result, std::vector<std::vector<int>> &defectResult, std::vector<stDefectInfo> &vDefects, std::vector<stDrawBox> &vDrawBoxes, std::vector<stDefectCandidate> &vCandidates) const;
+
+    bool detectPrintMark(const cv::Mat &roiImage, const cv::Mat &templImage, const std::shared_ptr<GoldenTemplate> &pTemplate, const float score, const float scale, std::vector<stDrawBox> &vDrawBoxes) const;
+    bool detectCharacter(const cv::Mat &roiImage, const cv::Rect &roiRect, std::vector<stDrawBox> &vDrawBoxes, const int nCaptureTimes) const;
+    bool detectTiaoxingma(const cv::Mat &roiImage, const cv::Rect &roiRect, std::vector<stDrawBox> &vDrawBoxes, const int nCaptureTimes) const;
+    bool detectLogo(const cv::Mat &roiImage, const cv::Rect &roiRect, std::vector<stDrawBox> &vDrawBoxes, const int nCaptureTimes) const;
     bool detectLogoHunliao(const cv::Mat& image, cv::Mat &processedImage);
 
     bool locateNeituoGapROI(const cv::Mat& image, const cv::Rect &roiRC,  cv::Rect &dstRC, const int nCaptureTimes);
@@ -52,7 +99,24 @@ private:
     bool detectDiGaiNeiChangHeight(const cv::Mat &image, const cv::Rect &roiRect, cv::Mat &processedImage, const int nCaptureTimes);
     bool detectDiGaiBaoHuMo(const cv::Mat &roiImage, const cv::Rect &roiRect, cv::Mat &processedImage, const int nCaptureTimes);
     bool detectTianGaiBaoHuMo(const cv::Mat &roiImage, const cv::Rect &roiRect, cv::Mat &processedImage, const int nCaptureTimes);
-    bool isDisableDet(const float defectType);
+
+    float getFloatParam(const std::string &sKey, const float defaultValue) const;
+    float getBoardParam(const std::string &sKey, const float defaultValue) const;
+    bool initInspectRoutes(const int numCategory);
+    //按模型路径参数(sModelKey + 工位[_PIC拍照次数])建立各次拍照的检测路由; sBackgroundTag不为空时(影子评估、阈值扫描)
+    //使用以该标记区分的独立低优先级执行器, 不与生产合批
+    bool buildInspectRoutes(const int numCategory, const std::string &sModelKey, const std::string &sBackgroundTag, std::vector<std::shared_ptr<stInspectRoute>> &vRoutes) const;
+    std::shared_ptr<stInspectRoute> getInspectRoute(const int nCaptureTimes) const;
+    //由参数和检测路由编译检测方案, 须在initInspectRoutes之后调用
+    bool initInspectPlan(const int numCategory);
+    //新参数与当前参数相比, 是否只有检测方案相关参数变化
+    bool isPlanParamsOnlyChanged(const stConfigParamsA &stParamsA, const stConfigParamsB &stParamsB) const;
+    bool initGoldenTemplate();
+    void initImageQuality();
+    //配置了候选模型时建立影子实例, 失败只关闭影子评估, 不影响检测
+    void initShadow(const int numCategory);
+    //按抽样率把本帧提交影子评估
+    void submitShadow(const cv::Mat &image, const int productCount, const int nCaptureTimes, const int maxLenses, const std::vector<stLensResult> &vLenses) const;
 
     //参数结构体成员变量
 	stConfigParamsA m_stParamsA;
@@ -61,29 +125,12 @@ private:
     //自动更新参数
     std::map<int, float> &m_mapAutoUpdateParams;
 
-    //产品名称
-	std::string m_sProductName;
-
-    //深度学习tensorrt引擎
-    // std::shared_ptr<xj::TensorrtEngineBase> m_tensortRtInfer;
-    // std::shared_ptr<xj::TensorrtEngineBase> m_tensortRtInfer_cls;
-    // std::shared_ptr<xj::TensorrtEngineBase> m_tensortRtInfer_emb;
-    int m_maxBatchSize;
-
-    // std::shared_ptr<YoloClassifier> m_model; 			//yolo模型数据
-	// std::shared_ptr<TensorrtClassifier> m_tensorrtDL;	//DLAV2模型数据
-	std::shared_ptr<YoloClassifier> m_tensorrtYoloDL;	//YOLOV8模型数据
-
-    std::vector<float> m_vMinDefectProb;
-    std::vector<float> m_vMinDefectArea;
-    std::vector<float> m_vMinDefectDiag;
-    std::vector<float> m_vMinDefectProb_C;
-    std::vector<float> m_vMinDefectArea_C;
-    std::vector<float> m_vMinDefectDiag_C;
-    std::vector<float> m_vMinDefectProb_NC;
-    std::vector<float> m_vMinDefectArea_NC;
-    std::vector<float> m_vMinDefectDiag_NC;
-    std::vector<float> m_vDisableDefectType;
+    //检测路由, 下标为拍照次数-1
+    std::vector<std::shared_ptr<stInspectRoute>> m_vRoutes;
+
+    //检测方案, 检测时只读
+    std::shared_ptr<const stInspectPlan> m_pPlan;
+    std::shared_ptr<const std::atomic<bool>> m_pProcessImageSave;
 
     float m_neituoHeight;
     int m_roiOffsetX;
@@ -106,6 +153,26 @@ private:
     cv::Mat m_templateCharacterImage;
     cv::Mat m_templateTiaoxingmaImage;
     cv::Mat m_templateLogoImage;
+    std::shared_ptr<GoldenTemplate> m_pCharacterTemplate;
+    std::shared_ptr<GoldenTemplate> m_pTiaoxingmaTemplate;
+    std::shared_ptr<GoldenTemplate> m_pLogoTemplate;
+
+    //金样模板比对
+    int m_goldenTemplateMode;   //0-不比对 1-预筛,只对差分斑块所在小图做DL 2-替代DL
+    int m_goldenDefectType;     //比对NG对应的瑕疵类别
+    std::string m_sGoldenTemplatePath;
+    stGoldenTemplateParams m_stGoldenParams;
+
+    //图像质量检查参数, 下标为拍照次数-1
+    std::vector<stImageQualityParams> m_vImageQualityParams;
+
+    //原始Bayer输入时的排列, NONE表示输入已是gray或bgr
+    BayerPattern m_bayerPattern;
+
+    //影子评估: 候选模型实例和抽样率, 生产判定为NG的帧可用单独的抽样率
+    std::shared_ptr<const XJAlgorithm> m_pShadow;
+    float m_shadowSampleRate;
+    float m_shadowNGSampleRate;
 
     cv::Ptr<cv::freetype::FreeType2> ft2 = cv::freetype::createFreeType2();
 };
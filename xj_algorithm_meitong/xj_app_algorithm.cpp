@@ -4,22 +4,32 @@
 using namespace cv;
 using namespace std;
 
-
-XJAppAlgorithm::XJAppAlgorithm(map<int, float> &mapAutoUpdateParams):m_pBase(nullptr)
+//算法实例句柄: 初始化好的实例只读共享, 检测调用各自持有一份快照, 重新初始化时整体替换
+struct stAlgorithmHandle
 {
-    XJAlgorithm *p = (XJAlgorithm *)m_pBase;
-    if( p!= nullptr)
+    stAlgorithmHandle(map<int, float> &mapParams) : mapAutoUpdateParams(mapParams) {}
+
+    shared_ptr<const XJAlgorithm> get()
     {
-        delete p;
-        p = nullptr;
+        lock_guard<mutex> lock(mtx);
+        return pAlgorithm;
     }
 
-    m_pBase = new XJAlgorithm(mapAutoUpdateParams);
+    map<int, float> &mapAutoUpdateParams;
+    mutex mtx;
+    shared_ptr<const XJAlgorithm> pAlgorithm;
+    //过程小图保存开关, 各实例共享
+    shared_ptr<atomic<bool>> pProcessImageSave = make_shared<atomic<bool>>(true);
+};
+
+XJAppAlgorithm::XJAppAlgorithm(map<int, float> &mapAutoUpdateParams):m_pBase(nullptr)
+{
+    m_pBase = new stAlgorithmHandle(mapAutoUpdateParams);
 }
 
 XJAppAlgorithm::~XJAppAlgorithm()
 {
-    XJAlgorithm *p = (XJAlgorithm *)m_pBase;
+    stAlgorithmHandle *p = (stAlgorithmHandle *)m_pBase;
     if( p!= nullptr)
     {
         delete p;
@@ -29,12 +39,109 @@ XJAppAlgorithm::~XJAppAlgorithm()
 
 bool XJAppAlgorithm::init(const stConfigParamsA &stParamsA, const stConfigParamsB &stParamsB)
 {
-    XJAlgorithm *pXJAlgorithm = (XJAlgorithm *)m_pBase;
-    return pXJAlgorithm && pXJAlgorithm->init(stParamsA, stParamsB);
+    stAlgorithmHandle *pHandle = (stAlgorithmHandle *)m_pBase;
+    if(pHandle == nullptr)
+    {
+        return false;
+    }
+
+    //新实例初始化成功后再替换, 正在检测的调用继续使用旧实例直到返回; 初始化失败保留旧实例
+    shared_ptr<XJAlgorithm> pXJAlgorithm = make_shared<XJAlgorithm>(pHandle->mapAutoUpdateParams);
+    pXJAlgorithm->setProcessImageSaveSwitch(pHandle->pProcessImageSave);
+    if(!pXJAlgorithm->init(stParamsA, stParamsB))
+    {
+        return false;
+    }
+    lock_guard<mutex> lock(pHandle->mtx);
+    pHandle->pAlgorithm = pXJAlgorithm;
+    return true;
+}
+
+bool XJAppAlgorithm::updateParams(const stConfigParamsA &stParamsA, const stConfigParamsB &stParamsB)
+{
+    stAlgorithmHandle *pHandle = (stAlgorithmHandle *)m_pBase;
+    shared_ptr<const XJAlgorithm> pCurrent = (pHandle == nullptr) ? nullptr : pHandle->get();
+    if(pCurrent == nullptr)
+    {
+        return false;
+    }
+
+    //拷贝当前实例, 模型执行器和模板按指针共享, 只重新编译检测方案
+    shared_ptr<XJAlgorithm> pXJAlgorithm = make_shared<XJAlgorithm>(*pCurrent);
+    if(!pXJAlgorithm->updateParams(stParamsA, stParamsB))
+    {
+        return false;
+    }
+    lock_guard<mutex> lock(pHandle->mtx);
+    //拷贝期间被重新初始化时放弃, 以新实例为准
+    if(pHandle->pAlgorithm != pCurrent)
+    {
+        return false;
+    }
+    pHandle->pAlgorithm = pXJAlgorithm;
+    return true;
 }
 
 std::vector<std::vector<int>> XJAppAlgorithm::detectAnalyze(const cv::Mat &image, cv::Mat &processedImage, const int productCount, const int nCaptureTimes)
 {
-    XJAlgorithm *pXJAlgorithm = (XJAlgorithm *)m_pBase;
-    return pXJAlgorithm->detectAnalyze(image, processedImage, productCount, nCaptureTimes);
+    std::vector<stDefectInfo> vDefects;
+    return detectAnalyze(image, processedImage, productCount, nCaptureTimes, vDefects);
+}
+
+std::vector<std::vector<int>> XJAppAlgorithm::detectAnalyze(const cv::Mat &image, cv::Mat &processedImage, const int productCount, const int nCaptureTimes, std::vector<stDefectInfo> &vDefects)
+{
+    shared_ptr<const XJAlgorithm> pXJAlgorithm = ((stAlgorithmHandle *)m_pBase)->get();
+    if(pXJAlgorithm == nullptr)
+    {
+        cout << "[ERROR] detectAnalyze before algorithm initialized" << endl;
+        stDefectInfo defect;
+        defect.type = (int)DefectType::defect1;
+        defect.nCaptureTimes = nCaptureTimes;
+        vDefects.assign(1, defect);
+        processedImage = image.clone();
+        return vector<vector<int>>(1, vector<int>(1, defect.type));
+    }
+    return pXJAlgorithm->detectAnalyze(image, processedImage, productCount, nCaptureTimes, vDefects);
+}
+
+vector<stLensResult> XJAppAlgorithm::detectAnalyzeLenses(const cv::Mat &image, const int productCount, const int nCaptureTimes, const int maxLenses)
+{
+    shared_ptr<const XJAlgorithm> pXJAlgorithm = ((stAlgorithmHandle *)m_pBase)->get();
+    if(pXJAlgorithm == nullptr)
+    {
+        vector<stLensResult> vLenses(1);
+        vLenses[0].vResult = detectAnalyze(image, vLenses[0].processedImage, productCount, nCaptureTimes, vLenses[0].vDefects);
+        return vLenses;
+    }
+    return pXJAlgorithm->detectAnalyzeLenses(image, productCount, nCaptureTimes, maxLenses);
+}
+
+stImageQuality XJAppAlgorithm::checkImageQuality(const cv::Mat &image, const int nCaptureTimes)
+{
+    shared_ptr<const XJAlgorithm> pXJAlgorithm = ((stAlgorithmHandle *)m_pBase)->get();
+    if(pXJAlgorithm == nullptr)
+    {
+        return stImageQuality();
+    }
+    return pXJAlgorithm->checkImageQuality(image, nCaptureTimes);
+}
+
+void XJAppAlgorithm::setProcessImageSaveEnabled(const bool bIsEnable)
+{
+    stAlgorithmHandle *pHandle = (stAlgorithmHandle *)m_pBase;
+    if(pHandle != nullptr)
+    {
+        pHandle->pProcessImageSave->store(bIsEnable);
+    }
+}
+
+bool XJAppAlgorithm::sweepThresholds(const stSweepRequest &request, stSweepReport &report)
+{
+    shared_ptr<const XJAlgorithm> pXJAlgorithm = ((stAlgorithmHandle *)m_pBase)->get();
+    if(pXJAlgorithm == nullptr)
+    {
+        cout << "[ERROR] sweepThresholds before algorithm initialized" << endl;
+        return false;
+    }
+    return pXJAlgorithm->sweepThresholds(request, report);
 }